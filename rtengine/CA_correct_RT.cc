@@ -825,6 +825,45 @@ float* RawImageSource::CA_correct_RT(
                                 }
                             }
                         }
+
+                        if (processpasstwo && it > 0 && settings->caAutoConvergence > 0.0) {
+                            // the fit of this iteration describes the CA left by the previous ones.
+                            // If it would not shift any block noticeably, another correction pass is not worth it
+                            float maxShift = 0.f;
+
+                            for (int vblock = 1; vblock < vblsz - 1; vblock++) {
+                                for (int hblock = 1; hblock < hblsz - 1; hblock++) {
+                                    double lblockshifts[2][2] = {};
+                                    double powVblock = 1.0;
+                                    for (int i = 0; i < polyord; i++) {
+                                        double powHblock = powVblock;
+                                        for (int j = 0; j < polyord; j++) {
+                                            for (int c = 0; c < 2; c++) {
+                                                for (int dir = 0; dir < 2; dir++) {
+                                                    lblockshifts[c][dir] += powHblock * fitparams[c][dir][polyord * i + j];
+                                                }
+                                            }
+                                            powHblock *= hblock;
+                                        }
+                                        powVblock *= vblock;
+                                    }
+                                    for (int c = 0; c < 2; c++) {
+                                        for (int dir = 0; dir < 2; dir++) {
+                                            maxShift = max(maxShift, static_cast<float>(fabs(lblockshifts[c][dir])));
+                                        }
+                                    }
+                                }
+                            }
+
+                            if (maxShift < settings->caAutoConvergence) {
+                                if (settings->verbose) {
+                                    std::cout << "CA correction converged after " << it << " iterations, remaining shift " << maxShift << std::endl;
+                                }
+                                // only ends the iterations, the earlier passes have changed rawData
+                                // so the colour shift avoidance below still has to run
+                                processpasstwo = false;
+                            }
+                        }
                     }
                     //fitparams[polyord*i+j] gives the coefficients of (vblock^i hblock^j) in a polynomial fit for i,j<=4
                 }
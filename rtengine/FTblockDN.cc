@@ -26,6 +26,7 @@
 #include <fftw3.h>
 #include "../rtgui/threadutils.h"
 #include "rtengine.h"
+#include "fftwplancache.h"
 #include "improcfun.h"
 #include "LUT.h"
 #include "array2D.h"
@@ -744,8 +745,8 @@ BENCHFUN
             //now we have tile dimensions, overlaps
             //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
-            // According to FFTW-Doc 'it is safe to execute the same plan in parallel by multiple threads', so we now create 4 plans
-            // outside the parallel region and use them inside the parallel region.
+            // According to FFTW-Doc 'it is safe to execute the same plan in parallel by multiple threads', so we now get 4 plans
+            // outside the parallel region and use them inside the parallel region. They are kept by the plan cache for the next calls.
 
             // calculate max size of numblox_W.
             int max_numblox_W = ceil((static_cast<float>(MIN(imwidth, tilewidth))) / (offset)) + 2 * blkrad;
@@ -767,10 +768,11 @@ BENCHFUN
                 fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
 
                 // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-                plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                FFTWPlanCache &planCache = FFTWPlanCache::getInstance();
+                plan_forward_blox[0]  = planCache.planManyR2R(2, nfwd, max_numblox_W, Lbloxtmp, TS * TS, fLbloxtmp, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                plan_backward_blox[0] = planCache.planManyR2R(2, nfwd, max_numblox_W, fLbloxtmp, TS * TS, Lbloxtmp, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                plan_forward_blox[1]  = planCache.planManyR2R(2, nfwd, min_numblox_W, Lbloxtmp, TS * TS, fLbloxtmp, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                plan_backward_blox[1] = planCache.planManyR2R(2, nfwd, min_numblox_W, fLbloxtmp, TS * TS, Lbloxtmp, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
                 fftwf_free(Lbloxtmp);
                 fftwf_free(fLbloxtmp);
             }
@@ -1766,14 +1768,6 @@ BENCHFUN
                     }
                 }
             }
-
-            if (denoiseLuminance) {
-                // destroy the plans
-                fftwf_destroy_plan(plan_forward_blox[0]);
-                fftwf_destroy_plan(plan_backward_blox[0]);
-                fftwf_destroy_plan(plan_forward_blox[1]);
-                fftwf_destroy_plan(plan_backward_blox[1]);
-            }
         } while (memoryAllocationFailed && numTries < 2 && (options.rgbDenoiseThreadLimit == 0) && !ponder);
 
         if (memoryAllocationFailed) {
@@ -34,12 +34,13 @@
 #include "opthelper.h"
 #include "median.h"
 #include "procparams.h"
+#include "rt_algo.h"
 #include "StopWatch.h"
 
 namespace rtengine
 {
 
-void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, size_t chunkSize, bool measure)
+void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, size_t chunkSize, bool measure, const float * const *detailMask)
 {
 
     std::unique_ptr<StopWatch> stop;
@@ -188,11 +189,17 @@ void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw, int winh, c
 
         for (int top = winy - 16; top < winy + height; top += ts - 32) {
             for (int left = winx - 16; left < winx + width; left += ts - 32) {
-                memset(&nyquist[3 * tsh], 0, sizeof(unsigned char) * (ts - 6) * tsh);
                 //location of tile bottom edge
                 int bottom = min(top + ts, winy + height + 16);
                 //location of tile right edge
                 int right  = min(left + ts, winx + width + 16);
+
+                if (detailMask && !maskHasPositive(detailMask, max(top + 16, winy), max(left + 16, winx), min(bottom - 16, winy + height), min(right - 16, winx + width))) {
+                    // the output of this tile would not be used
+                    continue;
+                }
+
+                memset(&nyquist[3 * tsh], 0, sizeof(unsigned char) * (ts - 6) * tsh);
                 //tile width  (=ts except for right edge of image)
                 int rr1 = bottom - top;
                 //tile height (=ts except for bottom edge of image)
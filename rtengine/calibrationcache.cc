@@ -0,0 +1,540 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include <glib/gstdio.h>
+#include <glibmm.h>
+
+#include "calibrationcache.h"
+
+#include "demosaiccache.h"
+#include "imagedata.h"
+#include "rawimage.h"
+#include "settings.h"
+#include "utils.h"
+
+#include "../rtgui/version.h"
+
+namespace
+{
+
+constexpr char cacheMagic[4] = {'R', 'T', 'C', 'F'};
+constexpr std::uint32_t cacheVersion = 1;
+
+enum class PixelEncoding : std::int32_t {
+    UINT16, // integer values which fit into 16 bit, the usual case for averaged and median filtered raw data
+    FLOAT
+};
+
+struct CacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    rtengine::RawImage::FrameLayout layout;
+    PixelEncoding encoding;
+    std::uint32_t hotPixels;
+};
+
+bool readHeader(FILE* f, CacheHeader& header)
+{
+    if (fread(&header, sizeof(header), 1, f) != 1
+            || std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic))
+            || header.version != cacheVersion
+            || (header.encoding != PixelEncoding::UINT16 && header.encoding != PixelEncoding::FLOAT)
+            || header.layout.width <= 0
+            || header.layout.height <= 0) {
+        return false;
+    }
+
+    // Nothing in the header is trusted before the file size confirms it, a truncated or foreign file
+    // must not make us allocate a buffer sized from garbage
+    const std::uint64_t pixels = static_cast<std::uint64_t>(header.layout.width) * static_cast<std::uint64_t>(header.layout.height);
+
+    if (header.hotPixels > pixels) {
+        return false;
+    }
+
+    const long start = ftell(f);
+
+    if (start < 0 || fseek(f, 0, SEEK_END) != 0) {
+        return false;
+    }
+
+    const long end = ftell(f);
+
+    if (end < start || fseek(f, start, SEEK_SET) != 0) {
+        return false;
+    }
+
+    const std::uint64_t pixelSize = header.encoding == PixelEncoding::UINT16 ? sizeof(std::uint16_t) : sizeof(float);
+    return static_cast<std::uint64_t>(end - start) == header.hotPixels * static_cast<std::uint64_t>(sizeof(rtengine::badPix)) + pixels * pixelSize;
+}
+
+// writes to a temporary file which is renamed at the end, so readers never see a partial entry
+void writeEntry(const Glib::ustring& filename, const CacheHeader& header, const std::function<bool(FILE*)>& writeData)
+{
+    const Glib::ustring tmpFilename = Glib::ustring::compose("%1.%2.tmp", filename, g_get_real_time());
+    FILE* const f = g_fopen(tmpFilename.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && writeData(f);
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || g_rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        g_remove(tmpFilename.c_str());
+    }
+}
+
+}
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+CalibrationCache& CalibrationCache::getInstance()
+{
+    static CalibrationCache instance;
+    return instance;
+}
+
+CalibrationCache::ShotInfo CalibrationCache::readShotInfo(const Glib::ustring& filename)
+{
+    ShotInfo shot;
+    RawImage ri(filename);
+
+    if (ri.loadRaw(false) != 0) { // Read information about shot
+        return shot;
+    }
+
+    const FramesData idata(filename, std::unique_ptr<RawMetaDataLocation>(new RawMetaDataLocation(ri.get_exifBase(), ri.get_ciffBase(), ri.get_ciffLen())), true);
+    shot.valid = true;
+    shot.maker = idata.getMake();
+    shot.model = idata.getModel();
+    shot.lens = idata.getLens();
+    shot.iso = idata.getISOSpeed();
+    shot.shutter = idata.getShutterSpeed();
+    shot.focalLength = idata.getFocalLen();
+    shot.aperture = idata.getFNumber();
+    shot.timestamp = idata.getDateTimeAsTS();
+    shot.rawTimestamp = ri.get_timestamp();
+    return shot;
+}
+
+std::string CalibrationCache::getFrameKey(const std::string& kind, const std::list<Glib::ustring>& filenames)
+{
+    std::string ids;
+
+    for (const auto& filename : filenames) {
+        const std::string id = DemosaicCache::getFileId(filename);
+
+        if (id.empty()) {
+            return {};
+        }
+
+        ids += id + '|';
+    }
+
+    return kind + '-' + Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, ids);
+}
+
+std::string CalibrationCache::getBlurredFlatFieldKey(const std::string& frameKey, int boxH, int boxW)
+{
+    if (frameKey.empty()) {
+        return {};
+    }
+
+    // the box sizes are all that differs between the blur types
+    std::ostringstream id;
+    id << RTVERSION << ' ' << boxH << ' ' << boxW;
+    return frameKey + '-' + Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, id.str());
+}
+
+CalibrationCache::ShotInfo CalibrationCache::getShotInfo(const Glib::ustring& filename)
+{
+    if (!settings->calibrationCache) {
+        return readShotInfo(filename);
+    }
+
+    const std::string id = DemosaicCache::getFileId(filename);
+    // file names can contain characters which are not allowed in group names
+    const Glib::ustring group = Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, filename);
+
+    {
+        MyMutex::MyLock lock(mutex);
+        loadIndex();
+
+        try {
+            if (!id.empty() && index.has_group(group) && index.get_string(group, "Id") == id) {
+                ShotInfo shot;
+                shot.valid = index.get_boolean(group, "Valid");
+
+                if (shot.valid) {
+                    shot.maker = index.get_string(group, "Maker");
+                    shot.model = index.get_string(group, "Model");
+                    shot.lens = index.get_string(group, "Lens");
+                    shot.iso = index.get_integer(group, "ISO");
+                    shot.shutter = index.get_double(group, "Shutter");
+                    shot.focalLength = index.get_double(group, "FocalLength");
+                    shot.aperture = index.get_double(group, "Aperture");
+                    shot.timestamp = index.get_int64(group, "Timestamp");
+                    shot.rawTimestamp = index.get_int64(group, "RawTimestamp");
+                }
+
+                return shot;
+            }
+        } catch (Glib::KeyFileError&) {}
+    }
+
+    const ShotInfo shot = readShotInfo(filename);
+
+    if (!id.empty()) {
+        MyMutex::MyLock lock(mutex);
+
+        if (index.has_group(group)) {
+            index.remove_group(group);
+        }
+
+        index.set_string(group, "Id", id);
+        index.set_boolean(group, "Valid", shot.valid);
+
+        if (shot.valid) {
+            index.set_string(group, "Maker", shot.maker);
+            index.set_string(group, "Model", shot.model);
+            index.set_string(group, "Lens", shot.lens);
+            index.set_integer(group, "ISO", shot.iso);
+            index.set_double(group, "Shutter", shot.shutter);
+            index.set_double(group, "FocalLength", shot.focalLength);
+            index.set_double(group, "Aperture", shot.aperture);
+            index.set_int64(group, "Timestamp", shot.timestamp);
+            index.set_int64(group, "RawTimestamp", shot.rawTimestamp);
+        }
+
+        indexModified = true;
+    }
+
+    return shot;
+}
+
+void CalibrationCache::storeShotInfo()
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!indexModified || g_mkdir_with_parents(settings->calibrationCacheDir.c_str(), 0755) != 0) {
+        return;
+    }
+
+    const Glib::ustring filename = Glib::build_filename(settings->calibrationCacheDir, "shotinfo");
+    const Glib::ustring tmpFilename = Glib::ustring::compose("%1.%2.tmp", filename, g_get_real_time());
+
+    try {
+        Glib::file_set_contents(tmpFilename, index.to_data());
+
+        if (g_rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+            g_remove(tmpFilename.c_str());
+            return;
+        }
+
+        indexModified = false;
+    } catch (Glib::FileError&) {
+        g_remove(tmpFilename.c_str());
+    }
+}
+
+RawImage* CalibrationCache::loadFrame(const std::string& key, const Glib::ustring& filename, std::vector<badPix>* hotPixels)
+{
+    if (!settings->calibrationCache || key.empty()) {
+        return nullptr;
+    }
+
+    const Glib::ustring cacheFilename = getFilename(key);
+    FILE* const f = g_fopen(cacheFilename.c_str(), "rb");
+
+    if (!f) {
+        return nullptr;
+    }
+
+    CacheHeader header = {};
+    bool ok = readHeader(f, header);
+    std::unique_ptr<RawImage> frame;
+
+    if (ok) {
+        frame.reset(new RawImage(filename));
+        // The cached frame was stored after the camera's raw crop, so it can be smaller than the
+        // dimensions reported by the header of the source raw, but never larger
+        ok = frame->loadRaw(false) == 0
+             && header.layout.width <= frame->get_width()
+             && header.layout.height <= frame->get_height()
+             && header.layout.colors == frame->get_colors()
+             && frame->allocateFrame(header.layout);
+    }
+
+    if (ok) {
+        std::vector<badPix> pixels(header.hotPixels, badPix(0, 0));
+        ok = fread(pixels.data(), sizeof(badPix), pixels.size(), f) == pixels.size();
+
+        if (ok && hotPixels) {
+            *hotPixels = std::move(pixels);
+        }
+    }
+
+    const int W = header.layout.width;
+    const int H = header.layout.height;
+
+    if (ok && header.encoding == PixelEncoding::UINT16) {
+        std::vector<std::uint16_t> buffer(W);
+
+        for (int i = 0; ok && i < H; ++i) {
+            ok = fread(buffer.data(), sizeof(std::uint16_t), W, f) == static_cast<std::size_t>(W);
+
+            for (int j = 0; ok && j < W; ++j) {
+                frame->data[i][j] = buffer[j];
+            }
+        }
+    } else if (ok) {
+        for (int i = 0; ok && i < H; ++i) {
+            ok = fread(frame->data[i], sizeof(float), W, f) == static_cast<std::size_t>(W);
+        }
+    }
+
+    fclose(f);
+
+    if (!ok) {
+        g_remove(cacheFilename.c_str());
+        return nullptr;
+    }
+
+    if (settings->verbose) {
+        std::cout << "Calibration cache hit: " << cacheFilename << std::endl;
+    }
+
+    return frame.release();
+}
+
+bool CalibrationCache::loadHotPixels(const std::string& key, std::vector<badPix>& hotPixels)
+{
+    if (!settings->calibrationCache || key.empty()) {
+        return false;
+    }
+
+    FILE* const f = g_fopen(getFilename(key).c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    CacheHeader header = {};
+    bool ok = readHeader(f, header);
+
+    if (ok) {
+        std::vector<badPix> pixels(header.hotPixels, badPix(0, 0));
+        ok = fread(pixels.data(), sizeof(badPix), pixels.size(), f) == pixels.size();
+
+        if (ok) {
+            hotPixels = std::move(pixels);
+        }
+    }
+
+    fclose(f);
+    return ok;
+}
+
+void CalibrationCache::storeFrame(const std::string& key, const RawImage* frame, const std::vector<badPix>* hotPixels)
+{
+    if (!settings->calibrationCache || key.empty() || !frame || !frame->data) {
+        return;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.layout = frame->getFrameLayout();
+    header.encoding = PixelEncoding::UINT16;
+    header.hotPixels = hotPixels ? hotPixels->size() : 0;
+
+    if (header.layout.filters == 0 && header.layout.colors != 1) {
+        // only single channel frames can be restored
+        return;
+    }
+
+    const int W = header.layout.width;
+    const int H = header.layout.height;
+
+    for (int i = 0; i < H && header.encoding == PixelEncoding::UINT16; ++i) {
+        for (int j = 0; j < W; ++j) {
+            const float value = frame->data[i][j];
+
+            if (!(value >= 0.f && value <= 65535.f && value == std::floor(value))) {
+                header.encoding = PixelEncoding::FLOAT;
+                break;
+            }
+        }
+    }
+
+    MyMutex::MyLock lock(mutex);
+
+    if (g_mkdir_with_parents(settings->calibrationCacheDir.c_str(), 0755) != 0) {
+        return;
+    }
+
+    writeEntry(getFilename(key), header, [&](FILE* f) {
+        bool ok = true;
+
+        if (hotPixels) {
+            ok = fwrite(hotPixels->data(), sizeof(badPix), hotPixels->size(), f) == hotPixels->size();
+        }
+
+        if (header.encoding == PixelEncoding::UINT16) {
+            std::vector<std::uint16_t> buffer(W);
+
+            for (int i = 0; ok && i < H; ++i) {
+                for (int j = 0; j < W; ++j) {
+                    buffer[j] = frame->data[i][j];
+                }
+
+                ok = fwrite(buffer.data(), sizeof(std::uint16_t), W, f) == static_cast<std::size_t>(W);
+            }
+        } else {
+            for (int i = 0; ok && i < H; ++i) {
+                ok = fwrite(frame->data[i], sizeof(float), W, f) == static_cast<std::size_t>(W);
+            }
+        }
+
+        return ok;
+    });
+}
+
+bool CalibrationCache::loadBlurredFlatField(const std::string& key, int W, int H, std::vector<float>& data)
+{
+    if (!settings->calibrationCache || key.empty()) {
+        return false;
+    }
+
+    const Glib::ustring cacheFilename = getFilename(key);
+    FILE* const f = g_fopen(cacheFilename.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    CacheHeader header = {};
+    bool ok = readHeader(f, header)
+              && header.encoding == PixelEncoding::FLOAT
+              && header.hotPixels == 0
+              && header.layout.width == W
+              && header.layout.height == H;
+
+    if (ok) {
+        data.resize(static_cast<std::size_t>(W) * H);
+        ok = fread(data.data(), sizeof(float), data.size(), f) == data.size();
+    }
+
+    fclose(f);
+
+    if (!ok) {
+        g_remove(cacheFilename.c_str());
+        return false;
+    }
+
+    if (settings->verbose) {
+        std::cout << "Calibration cache hit: " << cacheFilename << std::endl;
+    }
+
+    return true;
+}
+
+void CalibrationCache::storeBlurredFlatField(const std::string& key, int W, int H, const std::vector<float>& data)
+{
+    if (!settings->calibrationCache || key.empty() || data.size() != static_cast<std::size_t>(W) * H) {
+        return;
+    }
+
+    // only the dimensions of the layout are used, the blurred data is never restored into a RawImage
+    CacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.layout.width = W;
+    header.layout.height = H;
+    header.encoding = PixelEncoding::FLOAT;
+    header.hotPixels = 0;
+
+    MyMutex::MyLock lock(mutex);
+
+    if (g_mkdir_with_parents(settings->calibrationCacheDir.c_str(), 0755) != 0) {
+        return;
+    }
+
+    writeEntry(getFilename(key), header, [&data](FILE* f) {
+        return fwrite(data.data(), sizeof(float), data.size(), f) == data.size();
+    });
+}
+
+void CalibrationCache::prune(const std::string& kind, const std::set<std::string>& keys)
+{
+    if (!settings->calibrationCache) {
+        return;
+    }
+
+    MyMutex::MyLock lock(mutex);
+
+    try {
+        Glib::Dir dir(settings->calibrationCacheDir);
+
+        for (const auto& name : dir) {
+            if (getFileExtension(name) != "rtcc" || name.compare(0, kind.size() + 1, kind + '-') != 0) {
+                continue;
+            }
+
+            // blurred flat fields are stored as <frame key>-<blur id> and go together with their frame
+            const std::string key = name.substr(0, name.size() - 5);
+            const std::string frameKey = key.substr(0, key.find('-', kind.size() + 1));
+
+            if (!keys.count(frameKey)) {
+                g_remove(Glib::build_filename(settings->calibrationCacheDir, name).c_str());
+            }
+        }
+    } catch (Glib::FileError&) {}
+}
+
+Glib::ustring CalibrationCache::getFilename(const std::string& key) const
+{
+    return Glib::build_filename(settings->calibrationCacheDir, key + ".rtcc");
+}
+
+void CalibrationCache::loadIndex()
+{
+    if (indexLoaded) {
+        return;
+    }
+
+    indexLoaded = true;
+
+    try {
+        index.load_from_file(Glib::build_filename(settings->calibrationCacheDir, "shotinfo"));
+    } catch (Glib::Error&) {}
+}
+
+}
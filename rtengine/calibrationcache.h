@@ -0,0 +1,101 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <ctime>
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glibmm/keyfile.h>
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+#include "pixelsmap.h"
+
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+class RawImage;
+
+/*
+ * On-disk cache for the dark frame and flat field managers, stored in settings->calibrationCacheDir:
+ * the shot information of the files in the template directories, so that they don't have to be parsed
+ * on every start, and the master frames (averaged, and median filtered for flat fields) together with
+ * the hot pixels found in dark frames, and the box blurred flat fields. Entries are keyed on the names,
+ * sizes and modification times of their source files. There is no size limit: the managers prune the
+ * entries which don't belong to their current templates on init, so the cache holds at most one master
+ * frame per template, plus one blurred map per blur size used with a flat field.
+ * All methods do nothing when settings->calibrationCache is off.
+ */
+class CalibrationCache final :
+    public NonCopyable
+{
+public:
+    struct ShotInfo {
+        bool valid = false; // false for files which could not be read as raw files
+        std::string maker;
+        std::string model;
+        std::string lens;
+        int iso = 0;
+        double shutter = 0.0;
+        double focalLength = 0.0;
+        double aperture = 0.0;
+        time_t timestamp = 0;    // from the exif data
+        time_t rawTimestamp = 0; // as reported by dcraw
+    };
+
+    static CalibrationCache& getInstance();
+
+    // parses the shot information of a raw file
+    static ShotInfo readShotInfo(const Glib::ustring& filename);
+    // key of the master frame of the given kind ("df" or "ff") made from filenames
+    static std::string getFrameKey(const std::string& kind, const std::list<Glib::ustring>& filenames);
+    // key of the box blur of the flat field with frameKey, the blur type is given by the box sizes
+    static std::string getBlurredFlatFieldKey(const std::string& frameKey, int boxH, int boxW);
+
+    ShotInfo getShotInfo(const Glib::ustring& filename);
+    // writes the shot information gathered since the last call to disk
+    void storeShotInfo();
+
+    // returns a frame with the layout of filename and the cached pixel data, or nullptr
+    RawImage* loadFrame(const std::string& key, const Glib::ustring& filename, std::vector<badPix>* hotPixels);
+    bool loadHotPixels(const std::string& key, std::vector<badPix>& hotPixels);
+    void storeFrame(const std::string& key, const RawImage* frame, const std::vector<badPix>* hotPixels);
+
+    bool loadBlurredFlatField(const std::string& key, int W, int H, std::vector<float>& data);
+    void storeBlurredFlatField(const std::string& key, int W, int H, const std::vector<float>& data);
+
+    // removes the entries of the given kind which are not in keys, regardless of their age
+    void prune(const std::string& kind, const std::set<std::string>& keys);
+
+private:
+    CalibrationCache() = default;
+
+    Glib::ustring getFilename(const std::string& key) const;
+    void loadIndex();
+
+    MyMutex mutex;
+    Glib::KeyFile index;
+    bool indexLoaded = false;
+    bool indexModified = false;
+};
+
+}
@@ -0,0 +1,113 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "cpufeatures.h"
+#include "rawunpack.h"
+
+#include <atomic>
+#include <sstream>
+
+namespace
+{
+
+std::atomic<bool> avx2DispatchEnabled(true);
+
+}
+
+namespace rtengine
+{
+
+bool cpuHasAvx2()
+{
+#if defined(__AVX2__)
+    return true;
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2 && avx2DispatchEnabled;
+#else
+    return false;
+#endif
+}
+
+bool usesAvx2Clones()
+{
+#ifdef RT_AVX2_CLONES
+    return cpuHasAvx2();
+#else
+    return false;
+#endif
+}
+
+void setAvx2Dispatch(bool enabled)
+{
+    avx2DispatchEnabled = enabled;
+}
+
+bool cpuHasSsse3()
+{
+#if defined(__SSSE3__)
+    return true;
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    static const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+    return hasSsse3;
+#else
+    return false;
+#endif
+}
+
+std::string getCpuDispatchInfo()
+{
+    // kernels with a *_avx2.cc clone
+    static const char* const kernels[] = {
+        "RCD demosaic",
+        "Gaussian blur"
+    };
+
+#if defined(__AVX2__)
+    const std::string buildTarget = "AVX2";
+#elif defined(__AVX__)
+    const std::string buildTarget = "AVX";
+#elif defined(__SSE4_1__)
+    const std::string buildTarget = "SSE4.1";
+#elif defined(__SSE2__)
+    const std::string buildTarget = "SSE2";
+#else
+    const std::string buildTarget = "generic";
+#endif
+
+#ifdef RT_AVX2_CLONES
+    const std::string path = usesAvx2Clones() ? "AVX2 (runtime dispatch)" : buildTarget + " (build target)";
+#else
+    const std::string path = buildTarget + " (build target)";
+#endif
+
+    std::ostringstream info;
+    info << "CPU supports AVX2: " << (cpuHasAvx2() ? "yes" : "no") << std::endl;
+
+    for (const auto kernel : kernels) {
+        info << kernel << ": " << path << std::endl;
+    }
+
+#if defined(__SSSE3__)
+    info << "Packed raw unpacking: SSSE3 (build target)" << std::endl;
+#else
+    info << "Packed raw unpacking: " << (unpackBitsMsbUsesSsse3() ? "SSSE3 (runtime dispatch)" : "scalar") << std::endl;
+#endif
+
+    return info.str();
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+
+/*
+ * Some compute bound kernels are built a second time for AVX2 in a *_avx2.cc file, which includes
+ * the original source after switching the target with RT_AVX2_TARGET_BEGIN. The default build then
+ * calls the AVX2 variant when the cpu supports it.
+ *
+ * The clones are only built for x86 with gcc or clang and only if the whole build does not already
+ * target AVX2 (e.g. -march=native on a recent cpu).
+ * FMA is not enabled for the clones: the compiler would contract multiplications and additions,
+ * which changes the rounding, and the output would then depend on the cpu.
+ *
+ * Only RCD demosaic and the Gaussian blur are cloned, their plain loops get auto vectorized 8 floats
+ * wide. Code written with vfloat stays 4 wide in a clone and gains nothing, which rules out AMaZE,
+ * most of ipwavelet and the wavelet transforms of FTblockDN, whose FFTs are dispatched by fftw itself.
+ * Everything else still runs the build target code chosen in ProcessorTargets.cmake.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__AVX2__)
+#define RT_AVX2_CLONES
+
+// Headers have to be included before this, so their inline functions keep the default target
+#ifdef __clang__
+#define RT_AVX2_TARGET_BEGIN _Pragma("clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)")
+#define RT_AVX2_TARGET_END _Pragma("clang attribute pop")
+#else
+#define RT_AVX2_TARGET_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define RT_AVX2_TARGET_END _Pragma("GCC pop_options")
+#endif
+#endif
+
+/*
+ * Single functions with SSSE3 intrinsics are marked with RT_SSSE3_TARGET and called after
+ * checking cpuHasSsse3(), unless the whole build already targets SSSE3.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__SSSE3__)
+#define RT_SSSE3_DISPATCH
+#define RT_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
+namespace rtengine
+{
+
+// true if the cpu (and the os) support AVX2, and the AVX2 clones are not disabled by setAvx2Dispatch(false)
+bool cpuHasAvx2();
+
+// true if the dispatched kernels run their AVX2 clones, false if they run the build target code
+bool usesAvx2Clones();
+
+// allows to disable the AVX2 clones, e.g. to compare their output with the build target code
+void setAvx2Dispatch(bool enabled);
+
+// true if the cpu supports SSSE3
+bool cpuHasSsse3();
+
+// one line per dispatched kernel, naming the instruction set it uses on this cpu
+std::string getCpuDispatchInfo();
+
+}
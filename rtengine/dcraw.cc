@@ -26,9 +26,11 @@
 /*RT*/#include <omp.h>
 /*RT*/#endif
 
+#include <array>
 #include <utility>
 #include <vector>
 #include "opthelper.h"
+#include "rawunpack.h"
 //#define BENCHMARK
 #include "StopWatch.h"
 
@@ -838,6 +840,11 @@ struct jhead {
 };
 
 int CLASS ljpeg_start (struct jhead *jh, int info_only)
+{
+  return ljpeg_start (jh, info_only, ifp, getbithuff, zero_after_ff);
+}
+
+int CLASS ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp, getbithuff_t &getbithuff, unsigned &zero_after_ff)
 {
   ushort c, tag, len;
   uchar data[0x10000];
@@ -902,6 +909,11 @@ void CLASS ljpeg_end (struct jhead *jh)
 }
 
 inline int CLASS ljpeg_diff (ushort *huff)
+{
+  return ljpeg_diff (huff, ifp, getbithuff);
+}
+
+inline int CLASS ljpeg_diff (ushort *huff, IMFILE *ifp, getbithuff_t &getbithuff)
 {
   int len, diff;
 
@@ -915,6 +927,11 @@ inline int CLASS ljpeg_diff (ushort *huff)
 }
 
 ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
+{
+  return ljpeg_row (jrow, jh, ifp, getbithuff);
+}
+
+ushort * CLASS ljpeg_row (int jrow, struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff)
 {
   int col, c, diff, pred, spred=0;
   ushort mark=0, *row[3];
@@ -931,7 +948,7 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
   FORC3 row[c] = (jh->row + ((jrow & 1) + 1) * (jh->wide*jh->clrs*((jrow+c) & 1)));
   for (col=0; col < jh->wide; col++)
     FORC(jh->clrs) {
-      diff = ljpeg_diff (jh->huff[c]);
+      diff = ljpeg_diff (jh->huff[c], ifp, getbithuff);
       if (jh->sraw && c <= jh->sraw && (col | c))
 		    pred = spred;
       else if (col) pred = row[0][-jh->clrs];
@@ -952,36 +969,100 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
   return row[2];
 }
 
-void CLASS lossless_jpeg_load_raw()
+/*
+   RT: Decode all rows of a lossless JPEG scan into dest (jh->high rows of
+   jh->wide * jh->clrs samples) on several threads, one restart interval per task.
+   Only streams where every interval covers whole rows and rows don't predict from
+   the row above are split. Returns false if the stream can't be split, ifp is
+   unchanged then.
+ */
+bool CLASS ljpeg_decode_restart_intervals (struct jhead *jh, ushort *dest)
 {
-  struct jhead jh;
-  int row=0, col=0;
+  if (jh->restart >= INT_MAX || jh->restart % jh->wide || jh->psv != 1 || jh->sraw) {
+    return false;
+  }
 
-  if (!ljpeg_start (&jh, 0)) return;
-  int jwide = jh.wide * jh.clrs;
-  ushort *rp[2];
-  rp[0] = ljpeg_row (0, &jh);
+  const int jwide = jh->wide * jh->clrs;
+  const int rowsPerInterval = jh->restart / jh->wide;
+  const int intervals = (jh->high + rowsPerInterval - 1) / rowsPerInterval;
+
+  if (intervals < 2) {
+    return false;
+  }
+
+  // Find the start of each interval, right after its RSTn marker
+  std::vector<int> start(intervals);
+  start[0] = ftell(ifp);
+  const uchar *data = fdata(0, ifp);
+  int found = 1;
+
+  for (ssize_t pos = start[0]; pos + 1 < ifp->size && found < intervals; pos++) {
+    if (data[pos] != 0xff) {
+      continue;
+    }
+    const uchar next = data[pos + 1];
+    if (next >= 0xd0 && next <= 0xd7) {
+      start[found++] = pos + 2;
+      pos++;
+    } else if (next == 0x00) {
+      pos++; // stuffed byte
+    } else if (next != 0xff) {
+      break; // end of scan
+    }
+  }
+
+  if (found != intervals) {
+    return false;
+  }
 
-  for (int jrow=0; jrow < jh.high; jrow++) {
 #ifdef _OPENMP
-#pragma omp parallel sections
+  #pragma omp parallel
 #endif
-{
+  {
+    IMFILE ifpthr = *ifp;
+    ifpthr.plistener = nullptr;
 #ifdef _OPENMP
-    #pragma omp section
+    #pragma omp master
 #endif
     {
-        if(jrow < jh.high - 1)
-            rp[(jrow + 1)&1] = ljpeg_row (jrow + 1, &jh);
+      ifpthr.plistener = ifp->plistener;
     }
+    IMFILE *ifpptr = &ifpthr;
+    unsigned zero_after_ff_thr = 1;
+    getbithuff_t getbithuff_thr(this, ifpptr, zero_after_ff_thr);
+    struct jhead jhthr = *jh;
+    std::vector<ushort> rowBuffer(4 * jwide);
+    jhthr.row = rowBuffer.data();
+
 #ifdef _OPENMP
-     #pragma omp section
+    #pragma omp for schedule(dynamic)
 #endif
-    {
+    for (int i = 0; i < intervals; i++) {
+      // ljpeg_row() steps back over the RSTn marker itself when it starts a new interval
+      fseek (&ifpthr, start[i], SEEK_SET);
+      const int endRow = std::min<int>(jh->high, (i + 1) * rowsPerInterval);
+      for (int jrow = i * rowsPerInterval; jrow < endRow; jrow++) {
+        memcpy (dest + jrow * jwide, ljpeg_row (jrow, &jhthr, &ifpthr, getbithuff_thr), jwide * sizeof(ushort));
+      }
+    }
+  }
+
+  return true;
+}
+
+void CLASS lossless_jpeg_load_raw()
+{
+  struct jhead jh;
+  int row=0, col=0;
+
+  if (!ljpeg_start (&jh, 0)) return;
+  int jwide = jh.wide * jh.clrs;
+
+  const auto copy_row = [&](int jrow, const ushort *rp) {
     if (load_flags & 1)
       row = jrow & 1 ? height-1-jrow/2 : jrow/2;
     for (int jcol=0; jcol < jwide; jcol++) {
-      int val = curve[*rp[jrow&1]++];
+      int val = curve[*rp++];
       if (cr2_slice[0]) {
 	int jidx = jrow*jwide + jcol;
 	int i = jidx / (cr2_slice[1]*raw_height);
@@ -998,6 +1079,39 @@ void CLASS lossless_jpeg_load_raw()
       if (++col >= raw_width)
 	col = (row++,0);
     }
+  };
+
+  // RT: streams with restart markers are decoded on several threads first
+  if (jh.restart < INT_MAX) {
+    std::vector<ushort> decoded(static_cast<size_t>(jh.high) * jwide);
+    if (ljpeg_decode_restart_intervals (&jh, decoded.data())) {
+      for (int jrow=0; jrow < jh.high; jrow++)
+        copy_row (jrow, &decoded[static_cast<size_t>(jrow) * jwide]);
+      ljpeg_end (&jh);
+      return;
+    }
+  }
+
+  ushort *rp[2];
+  rp[0] = ljpeg_row (0, &jh);
+
+  for (int jrow=0; jrow < jh.high; jrow++) {
+#ifdef _OPENMP
+#pragma omp parallel sections
+#endif
+{
+#ifdef _OPENMP
+    #pragma omp section
+#endif
+    {
+        if(jrow < jh.high - 1)
+            rp[(jrow + 1)&1] = ljpeg_row (jrow + 1, &jh);
+    }
+#ifdef _OPENMP
+     #pragma omp section
+#endif
+    {
+      copy_row (jrow, rp[jrow&1]);
     }
 }
   }
@@ -1096,20 +1210,29 @@ void CLASS adobe_copy_pixel (unsigned row, unsigned col, ushort **rp)
 }
 
 void CLASS ljpeg_idct (struct jhead *jh)
+{
+  ljpeg_idct (jh, ifp, getbithuff);
+}
+
+void CLASS ljpeg_idct (struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff)
 {
   int c, i, j, len, skip, coef;
   float work[3][8][8];
-  static float cs[106] = { 0 };
+  // RT: initialized once in a thread safe way, ljpeg_idct may be called from several threads
+  static const std::array<float, 106> cs = [] {
+    std::array<float, 106> table;
+    for (int c = 0; c < 106; c++)
+      table[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
+    return table;
+  }();
   static const uchar zigzag[80] =
   {  0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,12,19,26,33,
     40,48,41,34,27,20,13, 6, 7,14,21,28,35,42,49,56,57,50,43,36,
     29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,
     47,55,62,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63 };
 
-  if (!cs[0])
-    FORC(106) cs[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
   memset (work, 0, sizeof work);
-  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0]) * jh->quant[0];
+  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0], ifp, getbithuff) * jh->quant[0];
   for (i=1; i < 64; i++ ) {
     len = gethuff (jh->huff[16]);
     i += skip = len >> 4;
@@ -1188,48 +1311,84 @@ void CLASS lossless_dnglj92_load_raw()
 
 void CLASS lossless_dng_load_raw()
 {
-  unsigned save, trow=0, tcol=0, jwide, jrow, jcol, row, col, i, j;
-  struct jhead jh;
-  ushort *rp;
+  BENCHFUN
 
-  while (trow < raw_height) {
-    save = ftell(ifp);
-    if (tile_length < INT_MAX)
-      fseek (ifp, get4(), SEEK_SET);
-    if (!ljpeg_start (&jh, 0)) break;
-    jwide = jh.wide;
-    if (filters || (colors == 1 && jh.clrs > 1)) jwide *= jh.clrs;
-    jwide /= MIN (is_raw, tiff_samples);
-    switch (jh.algo) {
-      case 0xc1:
-	jh.vpred[0] = 16384;
-	getbits(-1);
-	for (jrow=0; jrow+7 < jh.high; jrow += 8) {
-	  for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
-	    ljpeg_idct (&jh);
-	    rp = jh.idct;
-	    row = trow + jcol/tile_width + jrow*2;
-	    col = tcol + jcol%tile_width;
-	    for (i=0; i < 16; i+=2)
-	      for (j=0; j < 8; j++)
-		adobe_copy_pixel (row+i, col+j, &rp);
-	  }
-	}
-	break;
-      case 0xc3:
-	for (row=col=jrow=0; jrow < jh.high; jrow++) {
-	  rp = ljpeg_row (jrow, &jh);
-	  for (jcol=0; jcol < jwide; jcol++) {
-	    adobe_copy_pixel (trow+row, tcol+col, &rp);
-	    if (++col >= tile_width || col >= raw_width)
-	      row += 1 + (col = 0);
-	  }
-	}    }
-    fseek (ifp, save+4, SEEK_SET);
+  // RT: tiles are independent lossless JPEG streams. Collect their offsets first and
+  // decode them in parallel, each thread with its own file cursor and bit reader.
+  struct Tile {
+    unsigned offset, trow, tcol;
+  };
+  std::vector<Tile> tiles;
+
+  const unsigned save = ftell(ifp);
+  for (unsigned trow = 0, tcol = 0; trow < raw_height; ) {
+    tiles.push_back({tile_length < INT_MAX ? get4() : save, trow, tcol});
     if ((tcol += tile_width) >= raw_width)
       trow += tile_length + (tcol = 0);
-    ljpeg_end (&jh);
   }
+  const int tileCount = tiles.size();
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(std::max(1, std::min<int>(tileCount, omp_get_max_threads())))
+#endif
+  {
+    IMFILE ifpthr = *ifp;
+    ifpthr.plistener = nullptr;
+#ifdef _OPENMP
+    #pragma omp master
+#endif
+    {
+      ifpthr.plistener = ifp->plistener;
+    }
+    IMFILE *ifpptr = &ifpthr;
+    unsigned zero_after_ff_thr = 0;
+    getbithuff_t getbithuff_thr(this, ifpptr, zero_after_ff_thr);
+
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic)
+#endif
+    for (int t = 0; t < tileCount; t++) {
+      const unsigned trow = tiles[t].trow, tcol = tiles[t].tcol;
+      unsigned jwide, jrow, jcol, row, col, i, j;
+      struct jhead jh;
+      ushort *rp;
+
+      fseek (&ifpthr, tiles[t].offset, SEEK_SET);
+      if (!ljpeg_start (&jh, 0, &ifpthr, getbithuff_thr, zero_after_ff_thr)) continue;
+      jwide = jh.wide;
+      if (filters || (colors == 1 && jh.clrs > 1)) jwide *= jh.clrs;
+      jwide /= MIN (is_raw, tiff_samples);
+      switch (jh.algo) {
+        case 0xc1:
+	  jh.vpred[0] = 16384;
+	  getbithuff_thr(-1, 0);
+	  for (jrow=0; jrow+7 < jh.high; jrow += 8) {
+	    for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
+	      ljpeg_idct (&jh, &ifpthr, getbithuff_thr);
+	      rp = jh.idct;
+	      row = trow + jcol/tile_width + jrow*2;
+	      col = tcol + jcol%tile_width;
+	      for (i=0; i < 16; i+=2)
+		for (j=0; j < 8; j++)
+		  adobe_copy_pixel (row+i, col+j, &rp);
+	    }
+	  }
+	  break;
+        case 0xc3:
+	  for (row=col=jrow=0; jrow < jh.high; jrow++) {
+	    rp = ljpeg_row (jrow, &jh, &ifpthr, getbithuff_thr);
+	    for (jcol=0; jcol < jwide; jcol++) {
+	      adobe_copy_pixel (trow+row, tcol+col, &rp);
+	      if (++col >= tile_width || col >= raw_width)
+	        row += 1 + (col = 0);
+	    }
+	  }
+      }
+      ljpeg_end (&jh);
+    }
+  }
+  zero_after_ff = 1;
+  fseek (ifp, tile_length < INT_MAX ? save + 4 * tileCount : save, SEEK_SET);
 }
 
 static uint32_t DNG_HalfToFloat(uint16_t halfValue);
@@ -1243,6 +1402,31 @@ void CLASS packed_dng_load_raw()
     float_raw_image = new float[raw_width * raw_height];
   }
 
+  // RT: getbits(-1) restarts each row at a byte boundary, so without 0xff stuffing
+  // the packed rows can be unpacked in parallel straight from the file buffer
+  const int start = ftell(ifp);
+  const size_t rowBytes = (static_cast<size_t>(raw_width) * tiff_samples * tiff_bps + 7) / 8;
+  if (!isfloat && tiff_bps > 0 && tiff_bps < 16 && !zero_after_ff && start + rowBytes * raw_height <= static_cast<size_t>(ifp->size)) {
+    const uchar *data = fdata(start, ifp);
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector<ushort> rowPixel(raw_width * tiff_samples);
+#ifdef _OPENMP
+      #pragma omp for schedule(dynamic,16)
+#endif
+      for (int prow = 0; prow < raw_height; prow++) {
+        rtengine::unpackBitsMsb (data + prow * rowBytes, rowPixel.data(), rowPixel.size(), tiff_bps, rowBytes);
+        ushort *prp = rowPixel.data();
+        for (int pcol = 0; pcol < raw_width; pcol++)
+          adobe_copy_pixel (prow, pcol, &prp);
+      }
+    }
+    fseek (ifp, start + rowBytes * raw_height, SEEK_SET);
+    return;
+  }
+
   pixel = (ushort *) calloc (raw_width, tiff_samples*sizeof *pixel);
   merror (pixel, "packed_dng_load_raw()");
   for (row=0; row < raw_height; row++) {
@@ -2507,23 +2691,32 @@ void CLASS leaf_hdr_load_raw()
 
 void CLASS unpacked_load_raw()
 {
-  int row, col, bits=0;
+  int bits=0;
 
   while (1 << ++bits < maximum);
   read_shorts (raw_image, raw_width*raw_height);
+  // RT: rows are independent, shift and check them in parallel and report an error once
+  bool error = false;
   if (load_flags) {
-      for (row=0; row < raw_height; row++)
-        for (col=0; col < raw_width; col++)
+#ifdef _OPENMP
+      #pragma omp parallel for reduction(||:error) schedule(dynamic,16)
+#endif
+      for (int row=0; row < raw_height; row++)
+        for (int col=0; col < raw_width; col++)
           if ((RAW(row,col) >>= load_flags) >> bits
         && (unsigned) (row-top_margin) < height
-        && (unsigned) (col-left_margin) < width) derror();
+        && (unsigned) (col-left_margin) < width) error = true;
   } else if (bits < 16) {
-      for (row=0; row < raw_height; row++)
-        for (col=0; col < raw_width; col++)
+#ifdef _OPENMP
+      #pragma omp parallel for reduction(||:error) schedule(dynamic,16)
+#endif
+      for (int row=0; row < raw_height; row++)
+        for (int col=0; col < raw_width; col++)
           if (RAW(row,col) >> bits
         && (unsigned) (row-top_margin) < height
-        && (unsigned) (col-left_margin) < width) derror();
+        && (unsigned) (col-left_margin) < width) error = true;
   }
+  if (error) derror();
 }
 
 
@@ -2613,6 +2806,48 @@ void CLASS packed_load_raw()
   if (load_flags & 1) bwide = bwide * 16 / 15;
   bite = 8 + (load_flags & 56);
   half = (raw_height+1) >> 1;
+
+  // RT: without interleaved rows and check bytes, and if a row holds all its bits (rbits >= 0),
+  // every row starts at a byte boundary, so the rows can be unpacked in parallel straight from the file buffer
+  const int start = ftell(ifp);
+  const int colxor = load_flags >> 6 & 3;
+  if (!(load_flags & 7) && rbits >= 0 && tiff_bps <= 16 && (bwide * 8) % bite == 0 && (!colxor || raw_width % 4 == 0) &&
+      start + static_cast<INT64>(bwide) * raw_height <= ifp->size) {
+    const uchar *data = fdata(start, ifp);
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector<ushort> pixel(colxor ? raw_width : 0);
+#ifdef _OPENMP
+      #pragma omp for schedule(dynamic,16)
+#endif
+      for (int row = 0; row < raw_height; row++) {
+        const uchar *dp = data + static_cast<size_t>(row) * bwide;
+        ushort *dest = colxor ? pixel.data() : &RAW(row,0);
+        if (bite == 8) {
+          rtengine::unpackBitsMsb (dp, dest, raw_width, tiff_bps, bwide);
+        } else {
+          UINT64 rowbuf = 0;
+          int rowbits = 0;
+          for (int col = 0; col < raw_width; col++) {
+            for (rowbits -= tiff_bps; rowbits < 0; rowbits += bite) {
+              rowbuf <<= bite;
+              for (int b = 0; b < bite; b += 8)
+                rowbuf |= ((UINT64) *dp++ << b);
+            }
+            dest[col] = rowbuf << (64-tiff_bps-rowbits) >> (64-tiff_bps);
+          }
+        }
+        if (colxor)
+          for (int col = 0; col < raw_width; col++)
+            RAW(row,col ^ colxor) = pixel[col];
+      }
+    }
+    fseek (ifp, start + bwide * raw_height, SEEK_SET);
+    return;
+  }
+
   for (irow=0; irow < raw_height; irow++) {
     row = irow;
     if (load_flags & 2 &&
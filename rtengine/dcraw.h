@@ -124,7 +124,6 @@ protected:
         unsigned	max_read_size;	 // Amount of data to be read
         int         cur_buf_size;    // buffer size
         uchar       *cur_buf;        // currently read block
-        int         fillbytes;          // Counter to add extra byte for block size N*16
         IMFILE      *input;
         struct int_pair grad_even[3][41];    // tables of gradients
         struct int_pair grad_odd[3][41];
@@ -296,6 +295,12 @@ int ljpeg_diff (ushort *huff);
 ushort * ljpeg_row (int jrow, struct jhead *jh);
 void lossless_jpeg_load_raw();
 void ljpeg_idct (struct jhead *jh);
+// RT: variants reading from the given file cursor and bit reader instead of the members, used to decode independent streams in parallel
+int ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp, getbithuff_t &getbithuff, unsigned &zero_after_ff);
+int ljpeg_diff (ushort *huff, IMFILE *ifp, getbithuff_t &getbithuff);
+ushort * ljpeg_row (int jrow, struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff);
+void ljpeg_idct (struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff);
+bool ljpeg_decode_restart_intervals (struct jhead *jh, ushort *dest);
 
 
 void canon_sraw_load_raw();
@@ -18,6 +18,7 @@
  */
 #include <cmath>
 #include <cassert>
+#include <cstring>
 
 #include "rawimagesource.h"
 #include "rawimage.h"
@@ -495,14 +496,20 @@ void RawImageSource::jdl_interpolate_omp()  // from "Lassus"
 // Dec. 2005.
 // Adapted to RawTherapee by Jacques Desmis 3/2013
 // Improved speed and reduced memory consumption by Ingo Weyrich 2/2015
-//TODO Tiles to reduce memory consumption
 void RawImageSource::lmmse_interpolate_omp(int winw, int winh, array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, int iterations)
 {
     const int width = winw, height = winh;
     const int ba = 10;
     const int rr1 = height + 2 * ba;
     const int cc1 = width + 2 * ba;
-    const int w1 = cc1;
+    // The image is processed in tiles of ts x ts pixels (including the ba border around the image).
+    // Tiles overlap by tsBorder pixels, which is at least the sum of the filter radii of all steps
+    // (2 + 4 + 4 + 1 + 1 + 3 median passes), so the inner part of each tile gets the same values as
+    // processing the whole image at once.
+    constexpr int ts = 256;
+    constexpr int tsBorder = 16;
+    constexpr int tsCore = ts - 2 * tsBorder;
+    const int w1 = ts;
     const int w2 = 2 * w1;
     const int w3 = 3 * w1;
     const int w4 = 4 * w1;
@@ -541,567 +548,456 @@ void RawImageSource::lmmse_interpolate_omp(int winw, int winh, array2D<float> &r
         applyGamma = true;
     }
 
-    float *rix[5];
-    float *qix[5];
-    float *buffer = (float *)calloc(rr1 * cc1 * 5 * sizeof(float), 1);
-
-    if(buffer == nullptr) { // allocation of big block of memory failed, try to get 5 smaller ones
-        printf("lmmse_interpolate_omp: allocation of big memory block failed, try to get 5 smaller ones now...\n");
-        bool allocationFailed = false;
-
-        for(int i = 0; i < 5; i++) {
-            qix[i] = (float *)calloc(rr1 * cc1 * sizeof(float), 1);
-
-            if(!qix[i]) { // allocation of at least one small block failed
-                allocationFailed = true;
-            }
-        }
-
-        if(allocationFailed) { // fall back to igv_interpolate
-            printf("lmmse_interpolate_omp: allocation of 5 small memory blocks failed, falling back to igv_interpolate...\n");
-
-            for(int i = 0; i < 5; i++) { // free the already allocated buffers
-                if(qix[i]) {
-                    free(qix[i]);
-                }
-            }
-
-            igv_interpolate(winw, winh);
-            return;
-        }
-    } else {
-        qix[0] = buffer;
-
-        for(int i = 1; i < 5; i++) {
-            qix[i] = qix[i - 1] + rr1 * cc1;
-        }
-    }
-
     if (plistener) {
         plistener->setProgressStr (Glib::ustring::compose(M("TP_RAW_DMETHOD_PROGRESSBAR"), M("TP_RAW_LMMSE")));
         plistener->setProgress (0.0);
     }
 
+    LUTf *gamtab = &(Color::gammatab_24_17a);
+    LUTf *igamtab = &(Color::igammatab_24_17);
+    LUTf identity;
+    LUTf identityInv;
 
-    LUTf *gamtab;
-
-    if(applyGamma) {
-        gamtab = &(Color::gammatab_24_17a);
-    } else {
-        gamtab = new LUTf(65536, LUT_CLIP_ABOVE | LUT_CLIP_BELOW);
-        gamtab->makeIdentity(65535.f);
+    if(!applyGamma) {
+        identity(65536, LUT_CLIP_ABOVE | LUT_CLIP_BELOW);
+        identity.makeIdentity(65535.f);
+        identityInv(65536, LUT_CLIP_ABOVE | LUT_CLIP_BELOW);
+        identityInv.makeIdentity();
+        gamtab = &identity;
+        igamtab = &identityInv;
     }
 
+    array2D<float>* rgb[3];
+    rgb[0] = &red;
+    rgb[1] = &green;
+    rgb[2] = &blue;
+
+    const int numTilesH = (height + tsCore - 1) / tsCore;
+    const int numTilesW = (width + tsCore - 1) / tsCore;
+    double progress = 0.0;
 
 #ifdef _OPENMP
-    #pragma omp parallel private(rix)
+    #pragma omp parallel
 #endif
     {
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for (int rrr = ba; rrr < rr1 - ba; rrr++) {
-            for (int ccc = ba, row = rrr - ba; ccc < cc1 - ba; ccc++) {
-                int col = ccc - ba;
-                float *rix = qix[4] + rrr * cc1 + ccc;
-                rix[0] = (*gamtab)[rawData[row][col]];
-            }
-        }
+        int progresscounter = 0;
+        float *buffer = (float *)malloc(ts * ts * 5 * sizeof(float));
+        float *qix[5];
+        float *rix[5];
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.1);
-            }
+        for(int i = 0; i < 5; i++) {
+            qix[i] = buffer + i * ts * ts;
         }
 
-        // G-R(B)
 #ifdef _OPENMP
-        #pragma omp for schedule(dynamic,16)
+        #pragma omp for schedule(dynamic) collapse(2) nowait
 #endif
 
-        for (int rr = 2; rr < rr1 - 2; rr++) {
-            // G-R(B) at R(B) location
-            for (int cc = 2 + (FC(rr, 2) & 1); cc < cc1 - 2; cc += 2) {
-                rix[4] = qix[4] + rr * cc1 + cc;
-                float v0 = x00625(rix[4][-w1 - 1] + rix[4][-w1 + 1] + rix[4][w1 - 1] + rix[4][w1 + 1]) + x0250(rix[4][0]);
-                // horizontal
-                rix[0] = qix[0] + rr * cc1 + cc;
-                rix[0][0] = - x0250(rix[4][ -2] + rix[4][ 2]) + xdiv2f(rix[4][ -1] + rix[4][0] + rix[4][ 1]);
-                float Y = v0 + xdiv2f(rix[0][0]);
-
-                if (rix[4][0] > 1.75f * Y) {
-                    rix[0][0] = median(rix[0][0], rix[4][ -1], rix[4][ 1]);
-                } else {
-                    rix[0][0] = LIM(rix[0][0], 0.0f, 1.0f);
-                }
+        for (int tr = 0; tr < numTilesH; tr++) {
+            for (int tc = 0; tc < numTilesW; tc++) {
+                // tile position in bordered coordinates, FC() always gets absolute coordinates to support cfa periods > 2
+                const int top = std::max(tr * tsCore + ba - tsBorder, 0);
+                const int left = std::max(tc * tsCore + ba - tsBorder, 0);
+                const int th = std::min(tr * tsCore + ba + tsCore + tsBorder, rr1) - top;
+                const int tw = std::min(tc * tsCore + ba + tsCore + tsBorder, cc1) - left;
 
-                rix[0][0] -= rix[4][0];
-                // vertical
-                rix[1] = qix[1] + rr * cc1 + cc;
-                rix[1][0] = -x0250(rix[4][-w2] + rix[4][w2]) + xdiv2f(rix[4][-w1] + rix[4][0] + rix[4][w1]);
-                Y = v0 + xdiv2f(rix[1][0]);
+                memset(buffer, 0, ts * ts * 4 * sizeof(float));
 
-                if (rix[4][0] > 1.75f * Y) {
-                    rix[1][0] = median(rix[1][0], rix[4][-w1], rix[4][w1]);
-                } else {
-                    rix[1][0] = LIM(rix[1][0], 0.0f, 1.0f);
+                for (int rr = 0; rr < th; rr++) {
+                    for (int cc = 0, row = top + rr - ba; cc < tw; cc++) {
+                        int col = left + cc - ba;
+                        float *rix = qix[4] + rr * ts + cc;
+                        rix[0] = (row >= 0 && row < height && col >= 0 && col < width) ? (*gamtab)[rawData[row][col]] : 0.f;
+                    }
                 }
 
-                rix[1][0] -= rix[4][0];
-            }
-
-            // G-R(B) at G location
-            for (int ccc = 2 + (FC(rr, 3) & 1); ccc < cc1 - 2; ccc += 2) {
-                rix[0] = qix[0] + rr * cc1 + ccc;
-                rix[1] = qix[1] + rr * cc1 + ccc;
-                rix[4] = qix[4] + rr * cc1 + ccc;
-                rix[0][0] = x0250(rix[4][ -2] + rix[4][ 2]) - xdiv2f(rix[4][ -1] + rix[4][0] + rix[4][ 1]);
-                rix[1][0] = x0250(rix[4][-w2] + rix[4][w2]) - xdiv2f(rix[4][-w1] + rix[4][0] + rix[4][w1]);
-                rix[0][0] = LIM(rix[0][0], -1.0f, 0.0f) + rix[4][0];
-                rix[1][0] = LIM(rix[1][0], -1.0f, 0.0f) + rix[4][0];
-            }
-        }
-
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.2);
-            }
-        }
-
-
-        // apply low pass filter on differential colors
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for (int rr = 4; rr < rr1 - 4; rr++)
-            for (int cc = 4; cc < cc1 - 4; cc++) {
-                rix[0] = qix[0] + rr * cc1 + cc;
-                rix[2] = qix[2] + rr * cc1 + cc;
-                rix[2][0] = h0 * rix[0][0] + h1 * (rix[0][ -1] + rix[0][ 1]) + h2 * (rix[0][ -2] + rix[0][ 2]) + h3 * (rix[0][ -3] + rix[0][ 3]) + h4 * (rix[0][ -4] + rix[0][ 4]);
-                rix[1] = qix[1] + rr * cc1 + cc;
-                rix[3] = qix[3] + rr * cc1 + cc;
-                rix[3][0] = h0 * rix[1][0] + h1 * (rix[1][-w1] + rix[1][w1]) + h2 * (rix[1][-w2] + rix[1][w2]) + h3 * (rix[1][-w3] + rix[1][w3]) + h4 * (rix[1][-w4] + rix[1][w4]);
-            }
+                // G-R(B)
+                for (int rr = 2; rr < th - 2; rr++) {
+                    // G-R(B) at R(B) location
+                    for (int cc = 2 + (FC(top + rr, left + 2) & 1); cc < tw - 2; cc += 2) {
+                        rix[4] = qix[4] + rr * ts + cc;
+                        float v0 = x00625(rix[4][-w1 - 1] + rix[4][-w1 + 1] + rix[4][w1 - 1] + rix[4][w1 + 1]) + x0250(rix[4][0]);
+                        // horizontal
+                        rix[0] = qix[0] + rr * ts + cc;
+                        rix[0][0] = - x0250(rix[4][ -2] + rix[4][ 2]) + xdiv2f(rix[4][ -1] + rix[4][0] + rix[4][ 1]);
+                        float Y = v0 + xdiv2f(rix[0][0]);
+
+                        if (rix[4][0] > 1.75f * Y) {
+                            rix[0][0] = median(rix[0][0], rix[4][ -1], rix[4][ 1]);
+                        } else {
+                            rix[0][0] = LIM(rix[0][0], 0.0f, 1.0f);
+                        }
+
+                        rix[0][0] -= rix[4][0];
+                        // vertical
+                        rix[1] = qix[1] + rr * ts + cc;
+                        rix[1][0] = -x0250(rix[4][-w2] + rix[4][w2]) + xdiv2f(rix[4][-w1] + rix[4][0] + rix[4][w1]);
+                        Y = v0 + xdiv2f(rix[1][0]);
+
+                        if (rix[4][0] > 1.75f * Y) {
+                            rix[1][0] = median(rix[1][0], rix[4][-w1], rix[4][w1]);
+                        } else {
+                            rix[1][0] = LIM(rix[1][0], 0.0f, 1.0f);
+                        }
+
+                        rix[1][0] -= rix[4][0];
+                    }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.3);
-            }
-        }
+                    // G-R(B) at G location
+                    for (int ccc = 2 + (FC(top + rr, left + 3) & 1); ccc < tw - 2; ccc += 2) {
+                        rix[0] = qix[0] + rr * ts + ccc;
+                        rix[1] = qix[1] + rr * ts + ccc;
+                        rix[4] = qix[4] + rr * ts + ccc;
+                        rix[0][0] = x0250(rix[4][ -2] + rix[4][ 2]) - xdiv2f(rix[4][ -1] + rix[4][0] + rix[4][ 1]);
+                        rix[1][0] = x0250(rix[4][-w2] + rix[4][w2]) - xdiv2f(rix[4][-w1] + rix[4][0] + rix[4][w1]);
+                        rix[0][0] = LIM(rix[0][0], -1.0f, 0.0f) + rix[4][0];
+                        rix[1][0] = LIM(rix[1][0], -1.0f, 0.0f) + rix[4][0];
+                    }
+                }
 
-        // interpolate G-R(B) at R(B)
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                // apply low pass filter on differential colors
+                for (int rr = 4; rr < th - 4; rr++)
+                    for (int cc = 4; cc < tw - 4; cc++) {
+                        rix[0] = qix[0] + rr * ts + cc;
+                        rix[2] = qix[2] + rr * ts + cc;
+                        rix[2][0] = h0 * rix[0][0] + h1 * (rix[0][ -1] + rix[0][ 1]) + h2 * (rix[0][ -2] + rix[0][ 2]) + h3 * (rix[0][ -3] + rix[0][ 3]) + h4 * (rix[0][ -4] + rix[0][ 4]);
+                        rix[1] = qix[1] + rr * ts + cc;
+                        rix[3] = qix[3] + rr * ts + cc;
+                        rix[3][0] = h0 * rix[1][0] + h1 * (rix[1][-w1] + rix[1][w1]) + h2 * (rix[1][-w2] + rix[1][w2]) + h3 * (rix[1][-w3] + rix[1][w3]) + h4 * (rix[1][-w4] + rix[1][w4]);
+                    }
 
-        for (int rr = 4; rr < rr1 - 4; rr++) {
-            int cc = 4 + (FC(rr, 4) & 1);
+                // interpolate G-R(B) at R(B)
+                for (int rr = 4; rr < th - 4; rr++) {
+                    int cc = 4 + (FC(top + rr, left + 4) & 1);
 #ifdef __SSE2__
-            __m128 p1v, p2v, p3v, p4v, p5v, p6v, p7v, p8v, p9v, muv, vxv, vnv, xhv, vhv, xvv, vvv;
-            __m128 epsv = _mm_set1_ps(1e-7);
-            __m128 ninev = _mm_set1_ps(9.f);
-
-            for (; cc < cc1 - 10; cc += 8) {
-                rix[0] = qix[0] + rr * cc1 + cc;
-                rix[1] = qix[1] + rr * cc1 + cc;
-                rix[2] = qix[2] + rr * cc1 + cc;
-                rix[3] = qix[3] + rr * cc1 + cc;
-                rix[4] = qix[4] + rr * cc1 + cc;
-                // horizontal
-                p1v = LC2VFU(rix[2][-4]);
-                p2v = LC2VFU(rix[2][-3]);
-                p3v = LC2VFU(rix[2][-2]);
-                p4v = LC2VFU(rix[2][-1]);
-                p5v = LC2VFU(rix[2][ 0]);
-                p6v = LC2VFU(rix[2][ 1]);
-                p7v = LC2VFU(rix[2][ 2]);
-                p8v = LC2VFU(rix[2][ 3]);
-                p9v = LC2VFU(rix[2][ 4]);
-                muv = (p1v + p2v + p3v + p4v + p5v + p6v + p7v + p8v + p9v) / ninev;
-                vxv = epsv + SQRV(p1v - muv) + SQRV(p2v - muv) + SQRV(p3v - muv) + SQRV(p4v - muv) + SQRV(p5v - muv) + SQRV(p6v - muv) + SQRV(p7v - muv) + SQRV(p8v - muv) + SQRV(p9v - muv);
-                p1v -= LC2VFU(rix[0][-4]);
-                p2v -= LC2VFU(rix[0][-3]);
-                p3v -= LC2VFU(rix[0][-2]);
-                p4v -= LC2VFU(rix[0][-1]);
-                p5v -= LC2VFU(rix[0][ 0]);
-                p6v -= LC2VFU(rix[0][ 1]);
-                p7v -= LC2VFU(rix[0][ 2]);
-                p8v -= LC2VFU(rix[0][ 3]);
-                p9v -= LC2VFU(rix[0][ 4]);
-                vnv = epsv + SQRV(p1v) + SQRV(p2v) + SQRV(p3v) + SQRV(p4v) + SQRV(p5v) + SQRV(p6v) + SQRV(p7v) + SQRV(p8v) + SQRV(p9v);
-                xhv = (LC2VFU(rix[0][0]) * vxv + LC2VFU(rix[2][0]) * vnv) / (vxv + vnv);
-                vhv = vxv * vnv / (vxv + vnv);
-
-                // vertical
-                p1v = LC2VFU(rix[3][-w4]);
-                p2v = LC2VFU(rix[3][-w3]);
-                p3v = LC2VFU(rix[3][-w2]);
-                p4v = LC2VFU(rix[3][-w1]);
-                p5v = LC2VFU(rix[3][  0]);
-                p6v = LC2VFU(rix[3][ w1]);
-                p7v = LC2VFU(rix[3][ w2]);
-                p8v = LC2VFU(rix[3][ w3]);
-                p9v = LC2VFU(rix[3][ w4]);
-                muv = (p1v + p2v + p3v + p4v + p5v + p6v + p7v + p8v + p9v) / ninev;
-                vxv = epsv + SQRV(p1v - muv) + SQRV(p2v - muv) + SQRV(p3v - muv) + SQRV(p4v - muv) + SQRV(p5v - muv) + SQRV(p6v - muv) + SQRV(p7v - muv) + SQRV(p8v - muv) + SQRV(p9v - muv);
-                p1v -= LC2VFU(rix[1][-w4]);
-                p2v -= LC2VFU(rix[1][-w3]);
-                p3v -= LC2VFU(rix[1][-w2]);
-                p4v -= LC2VFU(rix[1][-w1]);
-                p5v -= LC2VFU(rix[1][  0]);
-                p6v -= LC2VFU(rix[1][ w1]);
-                p7v -= LC2VFU(rix[1][ w2]);
-                p8v -= LC2VFU(rix[1][ w3]);
-                p9v -= LC2VFU(rix[1][ w4]);
-                vnv = epsv + SQRV(p1v) + SQRV(p2v) + SQRV(p3v) + SQRV(p4v) + SQRV(p5v) + SQRV(p6v) + SQRV(p7v) + SQRV(p8v) + SQRV(p9v);
-                xvv = (LC2VFU(rix[1][0]) * vxv + LC2VFU(rix[3][0]) * vnv) / (vxv + vnv);
-                vvv = vxv * vnv / (vxv + vnv);
-                // interpolated G-R(B)
-                muv = (xhv * vvv + xvv * vhv) / (vhv + vvv);
-                STC2VFU(rix[4][0], muv);
-            }
-
-#endif
-
-            for (; cc < cc1 - 4; cc += 2) {
-                rix[0] = qix[0] + rr * cc1 + cc;
-                rix[1] = qix[1] + rr * cc1 + cc;
-                rix[2] = qix[2] + rr * cc1 + cc;
-                rix[3] = qix[3] + rr * cc1 + cc;
-                rix[4] = qix[4] + rr * cc1 + cc;
-                // horizontal
-                float p1 = rix[2][-4];
-                float p2 = rix[2][-3];
-                float p3 = rix[2][-2];
-                float p4 = rix[2][-1];
-                float p5 = rix[2][ 0];
-                float p6 = rix[2][ 1];
-                float p7 = rix[2][ 2];
-                float p8 = rix[2][ 3];
-                float p9 = rix[2][ 4];
-                float mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.f;
-                float vx = 1e-7 + SQR(p1 - mu) + SQR(p2 - mu) + SQR(p3 - mu) + SQR(p4 - mu) + SQR(p5 - mu) + SQR(p6 - mu) + SQR(p7 - mu) + SQR(p8 - mu) + SQR(p9 - mu);
-                p1 -= rix[0][-4];
-                p2 -= rix[0][-3];
-                p3 -= rix[0][-2];
-                p4 -= rix[0][-1];
-                p5 -= rix[0][ 0];
-                p6 -= rix[0][ 1];
-                p7 -= rix[0][ 2];
-                p8 -= rix[0][ 3];
-                p9 -= rix[0][ 4];
-                float vn = 1e-7 + SQR(p1) + SQR(p2) + SQR(p3) + SQR(p4) + SQR(p5) + SQR(p6) + SQR(p7) + SQR(p8) + SQR(p9);
-                float xh = (rix[0][0] * vx + rix[2][0] * vn) / (vx + vn);
-                float vh = vx * vn / (vx + vn);
-
-                // vertical
-                p1 = rix[3][-w4];
-                p2 = rix[3][-w3];
-                p3 = rix[3][-w2];
-                p4 = rix[3][-w1];
-                p5 = rix[3][  0];
-                p6 = rix[3][ w1];
-                p7 = rix[3][ w2];
-                p8 = rix[3][ w3];
-                p9 = rix[3][ w4];
-                mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.f;
-                vx = 1e-7 + SQR(p1 - mu) + SQR(p2 - mu) + SQR(p3 - mu) + SQR(p4 - mu) + SQR(p5 - mu) + SQR(p6 - mu) + SQR(p7 - mu) + SQR(p8 - mu) + SQR(p9 - mu);
-                p1 -= rix[1][-w4];
-                p2 -= rix[1][-w3];
-                p3 -= rix[1][-w2];
-                p4 -= rix[1][-w1];
-                p5 -= rix[1][  0];
-                p6 -= rix[1][ w1];
-                p7 -= rix[1][ w2];
-                p8 -= rix[1][ w3];
-                p9 -= rix[1][ w4];
-                vn = 1e-7 + SQR(p1) + SQR(p2) + SQR(p3) + SQR(p4) + SQR(p5) + SQR(p6) + SQR(p7) + SQR(p8) + SQR(p9);
-                float xv = (rix[1][0] * vx + rix[3][0] * vn) / (vx + vn);
-                float vv = vx * vn / (vx + vn);
-                // interpolated G-R(B)
-                rix[4][0] = (xh * vv + xv * vh) / (vh + vv);
-            }
-        }
-
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.4);
-            }
-        }
+                    __m128 p1v, p2v, p3v, p4v, p5v, p6v, p7v, p8v, p9v, muv, vxv, vnv, xhv, vhv, xvv, vvv;
+                    __m128 epsv = _mm_set1_ps(1e-7);
+                    __m128 ninev = _mm_set1_ps(9.f);
+
+                    for (; cc < tw - 10; cc += 8) {
+                        rix[0] = qix[0] + rr * ts + cc;
+                        rix[1] = qix[1] + rr * ts + cc;
+                        rix[2] = qix[2] + rr * ts + cc;
+                        rix[3] = qix[3] + rr * ts + cc;
+                        rix[4] = qix[4] + rr * ts + cc;
+                        // horizontal
+                        p1v = LC2VFU(rix[2][-4]);
+                        p2v = LC2VFU(rix[2][-3]);
+                        p3v = LC2VFU(rix[2][-2]);
+                        p4v = LC2VFU(rix[2][-1]);
+                        p5v = LC2VFU(rix[2][ 0]);
+                        p6v = LC2VFU(rix[2][ 1]);
+                        p7v = LC2VFU(rix[2][ 2]);
+                        p8v = LC2VFU(rix[2][ 3]);
+                        p9v = LC2VFU(rix[2][ 4]);
+                        muv = (p1v + p2v + p3v + p4v + p5v + p6v + p7v + p8v + p9v) / ninev;
+                        vxv = epsv + SQRV(p1v - muv) + SQRV(p2v - muv) + SQRV(p3v - muv) + SQRV(p4v - muv) + SQRV(p5v - muv) + SQRV(p6v - muv) + SQRV(p7v - muv) + SQRV(p8v - muv) + SQRV(p9v - muv);
+                        p1v -= LC2VFU(rix[0][-4]);
+                        p2v -= LC2VFU(rix[0][-3]);
+                        p3v -= LC2VFU(rix[0][-2]);
+                        p4v -= LC2VFU(rix[0][-1]);
+                        p5v -= LC2VFU(rix[0][ 0]);
+                        p6v -= LC2VFU(rix[0][ 1]);
+                        p7v -= LC2VFU(rix[0][ 2]);
+                        p8v -= LC2VFU(rix[0][ 3]);
+                        p9v -= LC2VFU(rix[0][ 4]);
+                        vnv = epsv + SQRV(p1v) + SQRV(p2v) + SQRV(p3v) + SQRV(p4v) + SQRV(p5v) + SQRV(p6v) + SQRV(p7v) + SQRV(p8v) + SQRV(p9v);
+                        xhv = (LC2VFU(rix[0][0]) * vxv + LC2VFU(rix[2][0]) * vnv) / (vxv + vnv);
+                        vhv = vxv * vnv / (vxv + vnv);
+
+                        // vertical
+                        p1v = LC2VFU(rix[3][-w4]);
+                        p2v = LC2VFU(rix[3][-w3]);
+                        p3v = LC2VFU(rix[3][-w2]);
+                        p4v = LC2VFU(rix[3][-w1]);
+                        p5v = LC2VFU(rix[3][  0]);
+                        p6v = LC2VFU(rix[3][ w1]);
+                        p7v = LC2VFU(rix[3][ w2]);
+                        p8v = LC2VFU(rix[3][ w3]);
+                        p9v = LC2VFU(rix[3][ w4]);
+                        muv = (p1v + p2v + p3v + p4v + p5v + p6v + p7v + p8v + p9v) / ninev;
+                        vxv = epsv + SQRV(p1v - muv) + SQRV(p2v - muv) + SQRV(p3v - muv) + SQRV(p4v - muv) + SQRV(p5v - muv) + SQRV(p6v - muv) + SQRV(p7v - muv) + SQRV(p8v - muv) + SQRV(p9v - muv);
+                        p1v -= LC2VFU(rix[1][-w4]);
+                        p2v -= LC2VFU(rix[1][-w3]);
+                        p3v -= LC2VFU(rix[1][-w2]);
+                        p4v -= LC2VFU(rix[1][-w1]);
+                        p5v -= LC2VFU(rix[1][  0]);
+                        p6v -= LC2VFU(rix[1][ w1]);
+                        p7v -= LC2VFU(rix[1][ w2]);
+                        p8v -= LC2VFU(rix[1][ w3]);
+                        p9v -= LC2VFU(rix[1][ w4]);
+                        vnv = epsv + SQRV(p1v) + SQRV(p2v) + SQRV(p3v) + SQRV(p4v) + SQRV(p5v) + SQRV(p6v) + SQRV(p7v) + SQRV(p8v) + SQRV(p9v);
+                        xvv = (LC2VFU(rix[1][0]) * vxv + LC2VFU(rix[3][0]) * vnv) / (vxv + vnv);
+                        vvv = vxv * vnv / (vxv + vnv);
+                        // interpolated G-R(B)
+                        muv = (xhv * vvv + xvv * vhv) / (vhv + vvv);
+                        STC2VFU(rix[4][0], muv);
+                    }
 
-        // copy CFA values
-#ifdef _OPENMP
-        #pragma omp for
 #endif
 
-        for (int rr = 0; rr < rr1; rr++)
-            for (int cc = 0, row = rr - ba; cc < cc1; cc++) {
-                int col = cc - ba;
-                int c = FC(rr, cc);
-                rix[c] = qix[c] + rr * cc1 + cc;
-
-                if ((row >= 0) & (row < height) & (col >= 0) & (col < width)) {
-                    rix[c][0] = (*gamtab)[rawData[row][col]];
-                } else {
-                    rix[c][0] = 0.f;
-                }
-
-                if (c != 1) {
-                    rix[1] = qix[1] + rr * cc1 + cc;
-                    rix[4] = qix[4] + rr * cc1 + cc;
-                    rix[1][0] = rix[c][0] + rix[4][0];
+                    for (; cc < tw - 4; cc += 2) {
+                        rix[0] = qix[0] + rr * ts + cc;
+                        rix[1] = qix[1] + rr * ts + cc;
+                        rix[2] = qix[2] + rr * ts + cc;
+                        rix[3] = qix[3] + rr * ts + cc;
+                        rix[4] = qix[4] + rr * ts + cc;
+                        // horizontal
+                        float p1 = rix[2][-4];
+                        float p2 = rix[2][-3];
+                        float p3 = rix[2][-2];
+                        float p4 = rix[2][-1];
+                        float p5 = rix[2][ 0];
+                        float p6 = rix[2][ 1];
+                        float p7 = rix[2][ 2];
+                        float p8 = rix[2][ 3];
+                        float p9 = rix[2][ 4];
+                        float mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.f;
+                        float vx = 1e-7f + SQR(p1 - mu) + SQR(p2 - mu) + SQR(p3 - mu) + SQR(p4 - mu) + SQR(p5 - mu) + SQR(p6 - mu) + SQR(p7 - mu) + SQR(p8 - mu) + SQR(p9 - mu);
+                        p1 -= rix[0][-4];
+                        p2 -= rix[0][-3];
+                        p3 -= rix[0][-2];
+                        p4 -= rix[0][-1];
+                        p5 -= rix[0][ 0];
+                        p6 -= rix[0][ 1];
+                        p7 -= rix[0][ 2];
+                        p8 -= rix[0][ 3];
+                        p9 -= rix[0][ 4];
+                        float vn = 1e-7f + SQR(p1) + SQR(p2) + SQR(p3) + SQR(p4) + SQR(p5) + SQR(p6) + SQR(p7) + SQR(p8) + SQR(p9);
+                        float xh = (rix[0][0] * vx + rix[2][0] * vn) / (vx + vn);
+                        float vh = vx * vn / (vx + vn);
+
+                        // vertical
+                        p1 = rix[3][-w4];
+                        p2 = rix[3][-w3];
+                        p3 = rix[3][-w2];
+                        p4 = rix[3][-w1];
+                        p5 = rix[3][  0];
+                        p6 = rix[3][ w1];
+                        p7 = rix[3][ w2];
+                        p8 = rix[3][ w3];
+                        p9 = rix[3][ w4];
+                        mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.f;
+                        vx = 1e-7f + SQR(p1 - mu) + SQR(p2 - mu) + SQR(p3 - mu) + SQR(p4 - mu) + SQR(p5 - mu) + SQR(p6 - mu) + SQR(p7 - mu) + SQR(p8 - mu) + SQR(p9 - mu);
+                        p1 -= rix[1][-w4];
+                        p2 -= rix[1][-w3];
+                        p3 -= rix[1][-w2];
+                        p4 -= rix[1][-w1];
+                        p5 -= rix[1][  0];
+                        p6 -= rix[1][ w1];
+                        p7 -= rix[1][ w2];
+                        p8 -= rix[1][ w3];
+                        p9 -= rix[1][ w4];
+                        vn = 1e-7f + SQR(p1) + SQR(p2) + SQR(p3) + SQR(p4) + SQR(p5) + SQR(p6) + SQR(p7) + SQR(p8) + SQR(p9);
+                        float xv = (rix[1][0] * vx + rix[3][0] * vn) / (vx + vn);
+                        float vv = vx * vn / (vx + vn);
+                        // interpolated G-R(B)
+                        rix[4][0] = (xh * vv + xv * vh) / (vh + vv);
+                    }
                 }
-            }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.5);
-            }
-        }
-
-        // bilinear interpolation for R/B
-        // interpolate R/B at G location
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for (int rr = 1; rr < rr1 - 1; rr++)
-            for (int cc = 1 + (FC(rr, 2) & 1), c = FC(rr, cc + 1); cc < cc1 - 1; cc += 2) {
-                rix[c] = qix[c] + rr * cc1 + cc;
-                rix[1] = qix[1] + rr * cc1 + cc;
-                rix[c][0] = rix[1][0] + xdiv2f(rix[c][ -1] - rix[1][ -1] + rix[c][ 1] - rix[1][ 1]);
-                c = 2 - c;
-                rix[c] = qix[c] + rr * cc1 + cc;
-                rix[c][0] = rix[1][0] + xdiv2f(rix[c][-w1] - rix[1][-w1] + rix[c][w1] - rix[1][w1]);
-                c = 2 - c;
-            }
-
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.6);
-            }
-        }
-
-        // interpolate R/B at B/R location
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for (int rr = 1; rr < rr1 - 1; rr++)
-            for (int cc = 1 + (FC(rr, 1) & 1), c = 2 - FC(rr, cc); cc < cc1 - 1; cc += 2) {
-                rix[c] = qix[c] + rr * cc1 + cc;
-                rix[1] = qix[1] + rr * cc1 + cc;
-                rix[c][0] = rix[1][0] + x0250(rix[c][-w1] - rix[1][-w1] + rix[c][ -1] - rix[1][ -1] + rix[c][  1] - rix[1][  1] + rix[c][ w1] - rix[1][ w1]);
-            }
-
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.7);
-            }
-        }
-
-    }// End of parallelization 1
+                // copy CFA values
+                for (int rr = 0; rr < th; rr++)
+                    for (int cc = 0, row = top + rr - ba; cc < tw; cc++) {
+                        int col = left + cc - ba;
+                        int c = FC(top + rr, left + cc);
+                        rix[c] = qix[c] + rr * ts + cc;
+
+                        if ((row >= 0) & (row < height) & (col >= 0) & (col < width)) {
+                            rix[c][0] = (*gamtab)[rawData[row][col]];
+                        } else {
+                            rix[c][0] = 0.f;
+                        }
+
+                        if (c != 1) {
+                            rix[1] = qix[1] + rr * ts + cc;
+                            rix[4] = qix[4] + rr * ts + cc;
+                            rix[1][0] = rix[c][0] + rix[4][0];
+                        }
+                    }
 
-    // median filter/
-    for (int pass = 0; pass < iter; pass++) {
-        // Apply 3x3 median filter
-        // Compute median(R-G) and median(B-G)
+                // bilinear interpolation for R/B
+                // interpolate R/B at G location
+                for (int rr = 1; rr < th - 1; rr++)
+                    for (int cc = 1 + (FC(top + rr, left + 2) & 1), c = FC(top + rr, left + cc + 1); cc < tw - 1; cc += 2) {
+                        rix[c] = qix[c] + rr * ts + cc;
+                        rix[1] = qix[1] + rr * ts + cc;
+                        rix[c][0] = rix[1][0] + xdiv2f(rix[c][ -1] - rix[1][ -1] + rix[c][ 1] - rix[1][ 1]);
+                        c = 2 - c;
+                        rix[c] = qix[c] + rr * ts + cc;
+                        rix[c][0] = rix[1][0] + xdiv2f(rix[c][-w1] - rix[1][-w1] + rix[c][w1] - rix[1][w1]);
+                        c = 2 - c;
+                    }
 
-#ifdef _OPENMP
-        #pragma omp parallel for private(rix)
-#endif
+                // interpolate R/B at B/R location
+                for (int rr = 1; rr < th - 1; rr++)
+                    for (int cc = 1 + (FC(top + rr, left + 1) & 1), c = 2 - FC(top + rr, left + cc); cc < tw - 1; cc += 2) {
+                        rix[c] = qix[c] + rr * ts + cc;
+                        rix[1] = qix[1] + rr * ts + cc;
+                        rix[c][0] = rix[1][0] + x0250(rix[c][-w1] - rix[1][-w1] + rix[c][ -1] - rix[1][ -1] + rix[c][  1] - rix[1][  1] + rix[c][ w1] - rix[1][ w1]);
+                    }
 
-        for (int rr = 1; rr < rr1 - 1; rr++) {
-            for (int c = 0; c < 3; c += 2) {
-                int d = c + 3 - (c == 0 ? 0 : 1);
-                int cc = 1;
+                // median filter/
+                for (int pass = 0; pass < iter; pass++) {
+                    // Apply 3x3 median filter
+                    // Compute median(R-G) and median(B-G)
+                    for (int rr = 1; rr < th - 1; rr++) {
+                        for (int c = 0; c < 3; c += 2) {
+                            int d = c + 3 - (c == 0 ? 0 : 1);
+                            int cc = 1;
 #ifdef __SSE2__
 
-                for (; cc < cc1 - 4; cc += 4) {
-                    rix[d] = qix[d] + rr * cc1 + cc;
-                    rix[c] = qix[c] + rr * cc1 + cc;
-                    rix[1] = qix[1] + rr * cc1 + cc;
-                    // Assign 3x3 differential color values
-                    const std::array<vfloat, 9> p = {
-                        LVFU(rix[c][-w1 - 1]) - LVFU(rix[1][-w1 - 1]),
-                        LVFU(rix[c][-w1]) - LVFU(rix[1][-w1]),
-                        LVFU(rix[c][-w1 + 1]) - LVFU(rix[1][-w1 + 1]),
-                        LVFU(rix[c][   -1]) - LVFU(rix[1][   -1]),
-                        LVFU(rix[c][  0]) - LVFU(rix[1][  0]),
-                        LVFU(rix[c][    1]) - LVFU(rix[1][    1]),
-                        LVFU(rix[c][ w1 - 1]) - LVFU(rix[1][ w1 - 1]),
-                        LVFU(rix[c][ w1]) - LVFU(rix[1][ w1]),
-                        LVFU(rix[c][ w1 + 1]) - LVFU(rix[1][ w1 + 1])
-                    };
-                    _mm_storeu_ps(&rix[d][0], median(p));
-                }
-
-#endif
-
-                for (; cc < cc1 - 1; cc++) {
-                    rix[d] = qix[d] + rr * cc1 + cc;
-                    rix[c] = qix[c] + rr * cc1 + cc;
-                    rix[1] = qix[1] + rr * cc1 + cc;
-                    // Assign 3x3 differential color values
-                    const std::array<float, 9> p = {
-                        rix[c][-w1 - 1] - rix[1][-w1 - 1],
-                        rix[c][-w1] - rix[1][-w1],
-                        rix[c][-w1 + 1] - rix[1][-w1 + 1],
-                        rix[c][   -1] - rix[1][   -1],
-                        rix[c][  0] - rix[1][  0],
-                        rix[c][    1] - rix[1][    1],
-                        rix[c][ w1 - 1] - rix[1][ w1 - 1],
-                        rix[c][ w1] - rix[1][ w1],
-                        rix[c][ w1 + 1] - rix[1][ w1 + 1]
-                    };
-                    rix[d][0] = median(p);
-                }
-            }
-        }
-
-        // red/blue at GREEN pixel locations & red/blue and green at BLUE/RED pixel locations
-#ifdef _OPENMP
-        #pragma omp parallel for private (rix)
-#endif
-
-        for (int rr = 0; rr < rr1; rr++) {
-            rix[0] = qix[0] + rr * cc1;
-            rix[1] = qix[1] + rr * cc1;
-            rix[2] = qix[2] + rr * cc1;
-            rix[3] = qix[3] + rr * cc1;
-            rix[4] = qix[4] + rr * cc1;
-            int c0 = FC(rr, 0);
-            int c1 = FC(rr, 1);
-
-            if(c0 == 1) {
-                c1 = 2 - c1;
-                int d = c1 + 3 - (c1 == 0 ? 0 : 1);
-                int cc;
-
-                for (cc = 0; cc < cc1 - 1; cc += 2) {
-                    rix[0][0] = rix[1][0] + rix[3][0];
-                    rix[2][0] = rix[1][0] + rix[4][0];
-                    rix[0]++;
-                    rix[1]++;
-                    rix[2]++;
-                    rix[3]++;
-                    rix[4]++;
-                    rix[c1][0] = rix[1][0] + rix[d][0];
-                    rix[1][0] = 0.5f * (rix[0][0] - rix[3][0] + rix[2][0] - rix[4][0]);
-                    rix[0]++;
-                    rix[1]++;
-                    rix[2]++;
-                    rix[3]++;
-                    rix[4]++;
-                }
+                            for (; cc < tw - 4; cc += 4) {
+                                rix[d] = qix[d] + rr * ts + cc;
+                                rix[c] = qix[c] + rr * ts + cc;
+                                rix[1] = qix[1] + rr * ts + cc;
+                                // Assign 3x3 differential color values
+                                const std::array<vfloat, 9> p = {
+                                    LVFU(rix[c][-w1 - 1]) - LVFU(rix[1][-w1 - 1]),
+                                    LVFU(rix[c][-w1]) - LVFU(rix[1][-w1]),
+                                    LVFU(rix[c][-w1 + 1]) - LVFU(rix[1][-w1 + 1]),
+                                    LVFU(rix[c][   -1]) - LVFU(rix[1][   -1]),
+                                    LVFU(rix[c][  0]) - LVFU(rix[1][  0]),
+                                    LVFU(rix[c][    1]) - LVFU(rix[1][    1]),
+                                    LVFU(rix[c][ w1 - 1]) - LVFU(rix[1][ w1 - 1]),
+                                    LVFU(rix[c][ w1]) - LVFU(rix[1][ w1]),
+                                    LVFU(rix[c][ w1 + 1]) - LVFU(rix[1][ w1 + 1])
+                                };
+                                _mm_storeu_ps(&rix[d][0], median(p));
+                            }
+
+#endif
+
+                            for (; cc < tw - 1; cc++) {
+                                rix[d] = qix[d] + rr * ts + cc;
+                                rix[c] = qix[c] + rr * ts + cc;
+                                rix[1] = qix[1] + rr * ts + cc;
+                                // Assign 3x3 differential color values
+                                const std::array<float, 9> p = {
+                                    rix[c][-w1 - 1] - rix[1][-w1 - 1],
+                                    rix[c][-w1] - rix[1][-w1],
+                                    rix[c][-w1 + 1] - rix[1][-w1 + 1],
+                                    rix[c][   -1] - rix[1][   -1],
+                                    rix[c][  0] - rix[1][  0],
+                                    rix[c][    1] - rix[1][    1],
+                                    rix[c][ w1 - 1] - rix[1][ w1 - 1],
+                                    rix[c][ w1] - rix[1][ w1],
+                                    rix[c][ w1 + 1] - rix[1][ w1 + 1]
+                                };
+                                rix[d][0] = median(p);
+                            }
+                        }
+                    }
 
-                if(cc < cc1) { // remaining pixel, only if width is odd
-                    rix[0][0] = rix[1][0] + rix[3][0];
-                    rix[2][0] = rix[1][0] + rix[4][0];
-                }
-            } else {
-                c0 = 2 - c0;
-                int d = c0 + 3 - (c0 == 0 ? 0 : 1);
-                int cc;
-
-                for (cc = 0; cc < cc1 - 1; cc += 2) {
-                    rix[c0][0] = rix[1][0] + rix[d][0];
-                    rix[1][0] = 0.5f * (rix[0][0] - rix[3][0] + rix[2][0] - rix[4][0]);
-                    rix[0]++;
-                    rix[1]++;
-                    rix[2]++;
-                    rix[3]++;
-                    rix[4]++;
-                    rix[0][0] = rix[1][0] + rix[3][0];
-                    rix[2][0] = rix[1][0] + rix[4][0];
-                    rix[0]++;
-                    rix[1]++;
-                    rix[2]++;
-                    rix[3]++;
-                    rix[4]++;
+                    // red/blue at GREEN pixel locations & red/blue and green at BLUE/RED pixel locations
+                    for (int rr = 0; rr < th; rr++) {
+                        rix[0] = qix[0] + rr * ts;
+                        rix[1] = qix[1] + rr * ts;
+                        rix[2] = qix[2] + rr * ts;
+                        rix[3] = qix[3] + rr * ts;
+                        rix[4] = qix[4] + rr * ts;
+                        int c0 = FC(top + rr, left);
+                        int c1 = FC(top + rr, left + 1);
+
+                        if(c0 == 1) {
+                            c1 = 2 - c1;
+                            int d = c1 + 3 - (c1 == 0 ? 0 : 1);
+                            int cc;
+
+                            for (cc = 0; cc < tw - 1; cc += 2) {
+                                rix[0][0] = rix[1][0] + rix[3][0];
+                                rix[2][0] = rix[1][0] + rix[4][0];
+                                rix[0]++;
+                                rix[1]++;
+                                rix[2]++;
+                                rix[3]++;
+                                rix[4]++;
+                                rix[c1][0] = rix[1][0] + rix[d][0];
+                                rix[1][0] = 0.5f * (rix[0][0] - rix[3][0] + rix[2][0] - rix[4][0]);
+                                rix[0]++;
+                                rix[1]++;
+                                rix[2]++;
+                                rix[3]++;
+                                rix[4]++;
+                            }
+
+                            if(cc < tw) { // remaining pixel, only if width is odd
+                                rix[0][0] = rix[1][0] + rix[3][0];
+                                rix[2][0] = rix[1][0] + rix[4][0];
+                            }
+                        } else {
+                            c0 = 2 - c0;
+                            int d = c0 + 3 - (c0 == 0 ? 0 : 1);
+                            int cc;
+
+                            for (cc = 0; cc < tw - 1; cc += 2) {
+                                rix[c0][0] = rix[1][0] + rix[d][0];
+                                rix[1][0] = 0.5f * (rix[0][0] - rix[3][0] + rix[2][0] - rix[4][0]);
+                                rix[0]++;
+                                rix[1]++;
+                                rix[2]++;
+                                rix[3]++;
+                                rix[4]++;
+                                rix[0][0] = rix[1][0] + rix[3][0];
+                                rix[2][0] = rix[1][0] + rix[4][0];
+                                rix[0]++;
+                                rix[1]++;
+                                rix[2]++;
+                                rix[3]++;
+                                rix[4]++;
+                            }
+
+                            if(cc < tw) { // remaining pixel, only if width is odd
+                                rix[c0][0] = rix[1][0] + rix[d][0];
+                                rix[1][0] = 0.5f * (rix[0][0] - rix[3][0] + rix[2][0] - rix[4][0]);
+                            }
+                        }
+                    }
                 }
 
-                if(cc < cc1) { // remaining pixel, only if width is odd
-                    rix[c0][0] = rix[1][0] + rix[d][0];
-                    rix[1][0] = 0.5f * (rix[0][0] - rix[3][0] + rix[2][0] - rix[4][0]);
+                // copy the inner part of the tile back to image matrix
+                const int rowEnd = std::min((tr + 1) * tsCore, height);
+                const int colEnd = std::min((tc + 1) * tsCore, width);
+
+                for (int row = tr * tsCore; row < rowEnd; row++) {
+                    for (int col = tc * tsCore, rr = row + ba - top; col < colEnd; col++) {
+                        int cc = col + ba - left;
+                        int c = FC(row, col);
+
+                        for (int ii = 0; ii < 3; ii++)
+                            if (ii != c) {
+                                float *rix = qix[ii] + rr * ts + cc;
+                                (*(rgb[ii]))[row][col] = (*igamtab)[65535.f * rix[0]];
+                            } else {
+                                (*(rgb[ii]))[row][col] = CLIP(rawData[row][col]);
+                            }
+                    }
                 }
-            }
-        }
-    }
 
-    if (plistener) {
-        plistener->setProgress (0.8);
-    }
-
-    if(applyGamma) {
-        gamtab = &(Color::igammatab_24_17);
-    } else {
-        gamtab->makeIdentity();
-    }
-
-    array2D<float>* rgb[3];
-    rgb[0] = &red;
-    rgb[1] = &green;
-    rgb[2] = &blue;
+                if(plistener) {
+                    progresscounter++;
 
-    // copy result back to image matrix
+                    if(progresscounter % 16 == 0) {
 #ifdef _OPENMP
-    #pragma omp parallel for
+                        #pragma omp critical (lmmseprogress)
 #endif
-
-    for (int row = 0; row < height; row++) {
-        for (int col = 0, rr = row + ba; col < width; col++) {
-            int cc = col + ba;
-            int c = FC(row, col);
-
-            for (int ii = 0; ii < 3; ii++)
-                if (ii != c) {
-                    float *rix = qix[ii] + rr * cc1 + cc;
-                    (*(rgb[ii]))[row][col] = (*gamtab)[65535.f * rix[0]];
-                } else {
-                    (*(rgb[ii]))[row][col] = CLIP(rawData[row][col]);
+                        {
+                            progress += (double)16 * (tsCore * tsCore) / (height * width);
+                            progress = progress > 1.0 ? 1.0 : progress;
+                            plistener->setProgress(progress);
+                        }
+                    }
                 }
+            }
         }
+
+        free(buffer);
     }
 
     if (plistener) {
         plistener->setProgress (1.0);
     }
 
-    if(buffer) {
-        free(buffer);
-    } else
-        for(int i = 0; i < 5; i++) {
-            free(qix[i]);
-        }
-
-    if(!applyGamma) {
-        delete gamtab;
-    }
-
     if(iterations > 4 && iterations <= 6) {
         refinement(passref);
     } else if(iterations > 6) {
@@ -1134,32 +1030,24 @@ void RawImageSource::igv_interpolate(int winw, int winh)
 
     static const int h1 = 1, h2 = 2, h3 = 3, h5 = 5;
     const int width = winw, height = winh;
-    const int v1 = 1 * width, v2 = 2 * width, v3 = 3 * width, v5 = 5 * width;
-    float* rgb[2];
-    float* chr[4];
-    float *rgbarray, *vdif, *hdif, *chrarray;
-    rgbarray    = (float (*)) malloc((width * height) * sizeof( float ) );
-    rgb[0] = rgbarray;
-    rgb[1] = rgbarray + (width * height) / 2;
-
-    vdif  = (float (*)) calloc( width * height / 2, sizeof * vdif );
-    hdif  = (float (*)) calloc( width * height / 2, sizeof * hdif );
-
-    chrarray    = (float (*)) calloc( width * height, sizeof( float ) );
-    chr[0] = chrarray;
-    chr[1] = chrarray + (width * height) / 2;
-
-    // mapped chr[2] and chr[3] to hdif and hdif, because these are out of use, when chr[2] and chr[3] are used
-    chr[2] = hdif;
-    chr[3] = vdif;
+    // The image is processed in tiles of ts x ts pixels. Tiles overlap by tsBorder pixels, which is
+    // more than the sum of the filter radii of all steps (5 + 6 + 3 + 3), so the inner part of each
+    // tile gets the same values as processing the whole image at once.
+    constexpr int ts = 256;
+    constexpr int tsBorder = 18;
+    constexpr int tsCore = ts - 2 * tsBorder;
 
     if (plistener) {
         plistener->setProgressStr (Glib::ustring::compose(M("TP_RAW_DMETHOD_PROGRESSBAR"), M("TP_RAW_IGV")));
         plistener->setProgress (0.0);
     }
 
+    const int numTilesH = (height + tsCore - 1) / tsCore;
+    const int numTilesW = (width + tsCore - 1) / tsCore;
+    double progress = 0.0;
+
 #ifdef _OPENMP
-    #pragma omp parallel shared(rgb,vdif,hdif,chr)
+    #pragma omp parallel
 #endif
     {
         __m128 ngv, egv, wgv, sgv, nvv, evv, wvv, svv, nwgv, negv, swgv, segv, nwvv, nevv, swvv, sevv, tempv, temp1v, temp2v, temp3v, temp4v, temp5v, temp6v, temp7v, temp8v;
@@ -1185,338 +1073,326 @@ void RawImageSource::igv_interpolate(int winw, int winh)
 
         float *dest1, *dest2;
         float ng, eg, wg, sg, nv, ev, wv, sv, nwg, neg, swg, seg, nwv, nev, swv, sev;
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for (int row = 0; row < height - 0; row++) {
-            dest1 = rgb[FC(row, 0) & 1];
-            dest2 = rgb[FC(row, 1) & 1];
-            int col, indx;
-
-            for (col = 0, indx = row * width + col; col < width - 7; col += 8, indx += 8) {
-                temp1v = LVFU( rawData[row][col] );
-                temp1v = CLIPV( temp1v );
-                temp2v = LVFU( rawData[row][col + 4] );
-                temp2v = CLIPV( temp2v );
-                tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 2, 0, 2, 0 ) );
-                _mm_storeu_ps( &dest1[indx >> 1], tempv );
-                tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 3, 1, 3, 1 ) );
-                _mm_storeu_ps( &dest2[indx >> 1], tempv );
-            }
-
-            for (; col < width; col++, indx += 2) {
-                dest1[indx >> 1] = CLIP(rawData[row][col]); //rawData = RT data
-                col++;
-                if(col < width)
-                    dest2[indx >> 1] = CLIP(rawData[row][col]); //rawData = RT data
-            }
-        }
-
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.13);
-            }
-        }
+        float *src1, *src2, *redsrc0, *redsrc1, *bluesrc0, *bluesrc1;
 
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+        float* rgb[2];
+        float* chr[4];
+        float *rgbarray, *vdif, *hdif, *chrarray;
+        rgbarray = (float (*)) malloc(ts * ts * sizeof(float));
+        rgb[0] = rgbarray;
+        rgb[1] = rgbarray + (ts * ts) / 2;
+
+        vdif = (float (*)) malloc(ts * ts / 2 * sizeof * vdif);
+        hdif = (float (*)) malloc(ts * ts / 2 * sizeof * hdif);
+
+        chrarray = (float (*)) malloc(ts * ts * sizeof(float));
+        chr[0] = chrarray;
+        chr[1] = chrarray + (ts * ts) / 2;
+
+        // mapped chr[2] and chr[3] to hdif and hdif, because these are out of use, when chr[2] and chr[3] are used
+        chr[2] = hdif;
+        chr[3] = vdif;
+
+        int progresscounter = 0;
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic) collapse(2) nowait
+#endif
+
+        for (int tr = 0; tr < numTilesH; tr++) {
+            for (int tc = 0; tc < numTilesW; tc++) {
+                // tile position, top and left are even for the packed arrays, FC() always gets absolute coordinates
+                const int top = std::max(tr * tsCore - tsBorder, 0);
+                const int left = std::max(tc * tsCore - tsBorder, 0);
+                const int th = std::min(tr * tsCore + tsCore + tsBorder, height) - top;
+                const int tw = (std::min(tc * tsCore + tsCore + tsBorder, width) - left) & ~1;
+                const int v1 = 1 * tw, v2 = 2 * tw, v3 = 3 * tw, v5 = 5 * tw;
+
+                memset(vdif, 0, ts * ts / 2 * sizeof * vdif);
+                memset(hdif, 0, ts * ts / 2 * sizeof * hdif);
+                memset(chrarray, 0, ts * ts * sizeof(float));
+
+                for (int row = 0; row < th - 0; row++) {
+                    dest1 = rgb[FC(top + row, left) & 1];
+                    dest2 = rgb[FC(top + row, left + 1) & 1];
+                    int col, indx;
+
+                    for (col = 0, indx = row * tw + col; col < tw - 7; col += 8, indx += 8) {
+                        temp1v = LVFU( rawData[top + row][left + col] );
+                        temp1v = CLIPV( temp1v );
+                        temp2v = LVFU( rawData[top + row][left + col + 4] );
+                        temp2v = CLIPV( temp2v );
+                        tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+                        _mm_storeu_ps( &dest1[indx >> 1], tempv );
+                        tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+                        _mm_storeu_ps( &dest2[indx >> 1], tempv );
+                    }
 
-        for (int row = 5; row < height - 5; row++) {
-            int col, indx, indx1;
-
-            for (col = 5 + (FC(row, 1) & 1), indx = row * width + col, indx1 = indx >> 1; col < width - 12; col += 8, indx += 8, indx1 += 4) {
-                //N,E,W,S Gradients
-                ngv = (epsv + (vabsf(LVFU(rgb[1][(indx - v1) >> 1]) - LVFU(rgb[1][(indx - v3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 - v1)]))) / c65535v);
-                egv = (epsv + (vabsf(LVFU(rgb[1][(indx + h1) >> 1]) - LVFU(rgb[1][(indx + h3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 + h1)]))) / c65535v);
-                wgv = (epsv + (vabsf(LVFU(rgb[1][(indx - h1) >> 1]) - LVFU(rgb[1][(indx - h3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 - h1)]))) / c65535v);
-                sgv = (epsv + (vabsf(LVFU(rgb[1][(indx + v1) >> 1]) - LVFU(rgb[1][(indx + v3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 + v1)]))) / c65535v);
-                //N,E,W,S High Order Interpolation (Li & Randhawa)
-                //N,E,W,S Hamilton Adams Interpolation
-                // (48.f * 65535.f) = 3145680.f
-                tempv = c40v * LVFU(rgb[0][indx1]);
-                nvv = vclampf(((c23v * LVFU(rgb[1][(indx - v1) >> 1]) + c23v * LVFU(rgb[1][(indx - v3) >> 1]) + LVFU(rgb[1][(indx - v5) >> 1]) + LVFU(rgb[1][(indx + v1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 - v1)]) - c8v * LVFU(rgb[0][(indx1 - v2)]))) / c3145680v, zerov, onev);
-                evv = vclampf(((c23v * LVFU(rgb[1][(indx + h1) >> 1]) + c23v * LVFU(rgb[1][(indx + h3) >> 1]) + LVFU(rgb[1][(indx + h5) >> 1]) + LVFU(rgb[1][(indx - h1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 + h1)]) - c8v * LVFU(rgb[0][(indx1 + h2)]))) / c3145680v, zerov, onev);
-                wvv = vclampf(((c23v * LVFU(rgb[1][(indx - h1) >> 1]) + c23v * LVFU(rgb[1][(indx - h3) >> 1]) + LVFU(rgb[1][(indx - h5) >> 1]) + LVFU(rgb[1][(indx + h1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 - h1)]) - c8v * LVFU(rgb[0][(indx1 - h2)]))) / c3145680v, zerov, onev);
-                svv = vclampf(((c23v * LVFU(rgb[1][(indx + v1) >> 1]) + c23v * LVFU(rgb[1][(indx + v3) >> 1]) + LVFU(rgb[1][(indx + v5) >> 1]) + LVFU(rgb[1][(indx - v1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 + v1)]) - c8v * LVFU(rgb[0][(indx1 + v2)]))) / c3145680v, zerov, onev);
-                //Horizontal and vertical color differences
-                tempv = LVFU( rgb[0][indx1] ) / c65535v;
-                _mm_storeu_ps( &vdif[indx1], (sgv * nvv + ngv * svv) / (ngv + sgv) - tempv );
-                _mm_storeu_ps( &hdif[indx1], (wgv * evv + egv * wvv) / (egv + wgv) - tempv );
-            }
+                    for (; col < tw; col++, indx += 2) {
+                        dest1[indx >> 1] = CLIP(rawData[top + row][left + col]); //rawData = RT data
+                        col++;
+                        if(col < tw)
+                            dest2[indx >> 1] = CLIP(rawData[top + row][left + col]); //rawData = RT data
+                    }
+                }
 
-            // borders without SSE
-            for (; col < width - 5; col += 2, indx += 2, indx1++) {
-                //N,E,W,S Gradients
-                ng = (eps + (fabsf(rgb[1][(indx - v1) >> 1] - rgb[1][(indx - v3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 - v1)])) / 65535.f);;
-                eg = (eps + (fabsf(rgb[1][(indx + h1) >> 1] - rgb[1][(indx + h3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 + h1)])) / 65535.f);
-                wg = (eps + (fabsf(rgb[1][(indx - h1) >> 1] - rgb[1][(indx - h3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 - h1)])) / 65535.f);
-                sg = (eps + (fabsf(rgb[1][(indx + v1) >> 1] - rgb[1][(indx + v3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 + v1)])) / 65535.f);
-                //N,E,W,S High Order Interpolation (Li & Randhawa)
-                //N,E,W,S Hamilton Adams Interpolation
-                // (48.f * 65535.f) = 3145680.f
-                nv = LIM(((23.0f * rgb[1][(indx - v1) >> 1] + 23.0f * rgb[1][(indx - v3) >> 1] + rgb[1][(indx - v5) >> 1] + rgb[1][(indx + v1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 - v1)] - 8.0f * rgb[0][(indx1 - v2)])) / 3145680.f, 0.0f, 1.0f);
-                ev = LIM(((23.0f * rgb[1][(indx + h1) >> 1] + 23.0f * rgb[1][(indx + h3) >> 1] + rgb[1][(indx + h5) >> 1] + rgb[1][(indx - h1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 + h1)] - 8.0f * rgb[0][(indx1 + h2)])) / 3145680.f, 0.0f, 1.0f);
-                wv = LIM(((23.0f * rgb[1][(indx - h1) >> 1] + 23.0f * rgb[1][(indx - h3) >> 1] + rgb[1][(indx - h5) >> 1] + rgb[1][(indx + h1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 - h1)] - 8.0f * rgb[0][(indx1 - h2)])) / 3145680.f, 0.0f, 1.0f);
-                sv = LIM(((23.0f * rgb[1][(indx + v1) >> 1] + 23.0f * rgb[1][(indx + v3) >> 1] + rgb[1][(indx + v5) >> 1] + rgb[1][(indx - v1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 + v1)] - 8.0f * rgb[0][(indx1 + v2)])) / 3145680.f, 0.0f, 1.0f);
-                //Horizontal and vertical color differences
-                vdif[indx1] = (sg * nv + ng * sv) / (ng + sg) - (rgb[0][indx1]) / 65535.f;
-                hdif[indx1] = (wg * ev + eg * wv) / (eg + wg) - (rgb[0][indx1]) / 65535.f;
-            }
-        }
+                for (int row = 5; row < th - 5; row++) {
+                    int col, indx, indx1;
+
+                    for (col = 5 + (FC(top + row, left + 1) & 1), indx = row * tw + col, indx1 = indx >> 1; col < tw - 12; col += 8, indx += 8, indx1 += 4) {
+                        //N,E,W,S Gradients
+                        ngv = (epsv + (vabsf(LVFU(rgb[1][(indx - v1) >> 1]) - LVFU(rgb[1][(indx - v3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 - v1)]))) / c65535v);
+                        egv = (epsv + (vabsf(LVFU(rgb[1][(indx + h1) >> 1]) - LVFU(rgb[1][(indx + h3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 + h1)]))) / c65535v);
+                        wgv = (epsv + (vabsf(LVFU(rgb[1][(indx - h1) >> 1]) - LVFU(rgb[1][(indx - h3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 - h1)]))) / c65535v);
+                        sgv = (epsv + (vabsf(LVFU(rgb[1][(indx + v1) >> 1]) - LVFU(rgb[1][(indx + v3) >> 1])) + vabsf(LVFU(rgb[0][indx1]) - LVFU(rgb[0][(indx1 + v1)]))) / c65535v);
+                        //N,E,W,S High Order Interpolation (Li & Randhawa)
+                        //N,E,W,S Hamilton Adams Interpolation
+                        // (48.f * 65535.f) = 3145680.f
+                        tempv = c40v * LVFU(rgb[0][indx1]);
+                        nvv = vclampf(((c23v * LVFU(rgb[1][(indx - v1) >> 1]) + c23v * LVFU(rgb[1][(indx - v3) >> 1]) + LVFU(rgb[1][(indx - v5) >> 1]) + LVFU(rgb[1][(indx + v1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 - v1)]) - c8v * LVFU(rgb[0][(indx1 - v2)]))) / c3145680v, zerov, onev);
+                        evv = vclampf(((c23v * LVFU(rgb[1][(indx + h1) >> 1]) + c23v * LVFU(rgb[1][(indx + h3) >> 1]) + LVFU(rgb[1][(indx + h5) >> 1]) + LVFU(rgb[1][(indx - h1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 + h1)]) - c8v * LVFU(rgb[0][(indx1 + h2)]))) / c3145680v, zerov, onev);
+                        wvv = vclampf(((c23v * LVFU(rgb[1][(indx - h1) >> 1]) + c23v * LVFU(rgb[1][(indx - h3) >> 1]) + LVFU(rgb[1][(indx - h5) >> 1]) + LVFU(rgb[1][(indx + h1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 - h1)]) - c8v * LVFU(rgb[0][(indx1 - h2)]))) / c3145680v, zerov, onev);
+                        svv = vclampf(((c23v * LVFU(rgb[1][(indx + v1) >> 1]) + c23v * LVFU(rgb[1][(indx + v3) >> 1]) + LVFU(rgb[1][(indx + v5) >> 1]) + LVFU(rgb[1][(indx - v1) >> 1]) + tempv - c32v * LVFU(rgb[0][(indx1 + v1)]) - c8v * LVFU(rgb[0][(indx1 + v2)]))) / c3145680v, zerov, onev);
+                        //Horizontal and vertical color differences
+                        tempv = LVFU( rgb[0][indx1] ) / c65535v;
+                        _mm_storeu_ps( &vdif[indx1], (sgv * nvv + ngv * svv) / (ngv + sgv) - tempv );
+                        _mm_storeu_ps( &hdif[indx1], (wgv * evv + egv * wvv) / (egv + wgv) - tempv );
+                    }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.26);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                    // borders without SSE
+                    for (; col < tw - 5; col += 2, indx += 2, indx1++) {
+                        //N,E,W,S Gradients
+                        ng = (eps + (fabsf(rgb[1][(indx - v1) >> 1] - rgb[1][(indx - v3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 - v1)])) / 65535.f);;
+                        eg = (eps + (fabsf(rgb[1][(indx + h1) >> 1] - rgb[1][(indx + h3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 + h1)])) / 65535.f);
+                        wg = (eps + (fabsf(rgb[1][(indx - h1) >> 1] - rgb[1][(indx - h3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 - h1)])) / 65535.f);
+                        sg = (eps + (fabsf(rgb[1][(indx + v1) >> 1] - rgb[1][(indx + v3) >> 1]) + fabsf(rgb[0][indx1] - rgb[0][(indx1 + v1)])) / 65535.f);
+                        //N,E,W,S High Order Interpolation (Li & Randhawa)
+                        //N,E,W,S Hamilton Adams Interpolation
+                        // (48.f * 65535.f) = 3145680.f
+                        nv = LIM(((23.0f * rgb[1][(indx - v1) >> 1] + 23.0f * rgb[1][(indx - v3) >> 1] + rgb[1][(indx - v5) >> 1] + rgb[1][(indx + v1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 - v1)] - 8.0f * rgb[0][(indx1 - v2)])) / 3145680.f, 0.0f, 1.0f);
+                        ev = LIM(((23.0f * rgb[1][(indx + h1) >> 1] + 23.0f * rgb[1][(indx + h3) >> 1] + rgb[1][(indx + h5) >> 1] + rgb[1][(indx - h1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 + h1)] - 8.0f * rgb[0][(indx1 + h2)])) / 3145680.f, 0.0f, 1.0f);
+                        wv = LIM(((23.0f * rgb[1][(indx - h1) >> 1] + 23.0f * rgb[1][(indx - h3) >> 1] + rgb[1][(indx - h5) >> 1] + rgb[1][(indx + h1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 - h1)] - 8.0f * rgb[0][(indx1 - h2)])) / 3145680.f, 0.0f, 1.0f);
+                        sv = LIM(((23.0f * rgb[1][(indx + v1) >> 1] + 23.0f * rgb[1][(indx + v3) >> 1] + rgb[1][(indx + v5) >> 1] + rgb[1][(indx - v1) >> 1] + 40.0f * rgb[0][indx1] - 32.0f * rgb[0][(indx1 + v1)] - 8.0f * rgb[0][(indx1 + v2)])) / 3145680.f, 0.0f, 1.0f);
+                        //Horizontal and vertical color differences
+                        vdif[indx1] = (sg * nv + ng * sv) / (ng + sg) - (rgb[0][indx1]) / 65535.f;
+                        hdif[indx1] = (wg * ev + eg * wv) / (eg + wg) - (rgb[0][indx1]) / 65535.f;
+                    }
+                }
 
-        for (int row = 7; row < height - 7; row++) {
-            int col, d, indx1;
-
-            for (col = 7 + (FC(row, 1) & 1), indx1 = (row * width + col) >> 1, d = FC(row, col) / 2; col < width - 14; col += 8, indx1 += 4) {
-                //H&V integrated gaussian vector over variance on color differences
-                //Mod Jacques 3/2013
-                ngv = vclampf(epssqv + c78v * SQRV(LVFU(vdif[indx1])) + c69v * (SQRV(LVFU(vdif[indx1 - v1])) + SQRV(LVFU(vdif[indx1 + v1]))) + c51v * (SQRV(LVFU(vdif[indx1 - v2])) + SQRV(LVFU(vdif[indx1 + v2]))) + c21v * (SQRV(LVFU(vdif[indx1 - v3])) + SQRV(LVFU(vdif[indx1 + v3]))) - c6v * SQRV(LVFU(vdif[indx1 - v1]) + LVFU(vdif[indx1]) + LVFU(vdif[indx1 + v1]))
-                           - c10v * (SQRV(LVFU(vdif[indx1 - v2]) + LVFU(vdif[indx1 - v1]) + LVFU(vdif[indx1])) + SQRV(LVFU(vdif[indx1]) + LVFU(vdif[indx1 + v1]) + LVFU(vdif[indx1 + v2]))) - c7v * (SQRV(LVFU(vdif[indx1 - v3]) + LVFU(vdif[indx1 - v2]) + LVFU(vdif[indx1 - v1])) + SQRV(LVFU(vdif[indx1 + v1]) + LVFU(vdif[indx1 + v2]) + LVFU(vdif[indx1 + v3]))), zerov, onev);
-                egv = vclampf(epssqv + c78v * SQRV(LVFU(hdif[indx1])) + c69v * (SQRV(LVFU(hdif[indx1 - h1])) + SQRV(LVFU(hdif[indx1 + h1]))) + c51v * (SQRV(LVFU(hdif[indx1 - h2])) + SQRV(LVFU(hdif[indx1 + h2]))) + c21v * (SQRV(LVFU(hdif[indx1 - h3])) + SQRV(LVFU(hdif[indx1 + h3]))) - c6v * SQRV(LVFU(hdif[indx1 - h1]) + LVFU(hdif[indx1]) + LVFU(hdif[indx1 + h1]))
-                           - c10v * (SQRV(LVFU(hdif[indx1 - h2]) + LVFU(hdif[indx1 - h1]) + LVFU(hdif[indx1])) + SQRV(LVFU(hdif[indx1]) + LVFU(hdif[indx1 + h1]) + LVFU(hdif[indx1 + h2]))) - c7v * (SQRV(LVFU(hdif[indx1 - h3]) + LVFU(hdif[indx1 - h2]) + LVFU(hdif[indx1 - h1])) + SQRV(LVFU(hdif[indx1 + h1]) + LVFU(hdif[indx1 + h2]) + LVFU(hdif[indx1 + h3]))), zerov, onev);
-                //Limit chrominance using H/V neighbourhood
-                nvv = median(d725v * LVFU(vdif[indx1]) + d1375v * LVFU(vdif[indx1 - v1]) + d1375v * LVFU(vdif[indx1 + v1]), LVFU(vdif[indx1 - v1]), LVFU(vdif[indx1 + v1]));
-                evv = median(d725v * LVFU(hdif[indx1]) + d1375v * LVFU(hdif[indx1 - h1]) + d1375v * LVFU(hdif[indx1 + h1]), LVFU(hdif[indx1 - h1]), LVFU(hdif[indx1 + h1]));
-                //Chrominance estimation
-                tempv = (egv * nvv + ngv * evv) / (ngv + egv);
-                _mm_storeu_ps(&(chr[d][indx1]), tempv);
-                //Green channel population
-                temp1v = c65535v * tempv + LVFU(rgb[0][indx1]);
-                _mm_storeu_ps( &(rgb[0][indx1]), temp1v );
-            }
+                for (int row = 7; row < th - 7; row++) {
+                    int col, d, indx1;
+
+                    for (col = 7 + (FC(top + row, left + 1) & 1), indx1 = (row * tw + col) >> 1, d = FC(top + row, left + col) / 2; col < tw - 14; col += 8, indx1 += 4) {
+                        //H&V integrated gaussian vector over variance on color differences
+                        //Mod Jacques 3/2013
+                        ngv = vclampf(epssqv + c78v * SQRV(LVFU(vdif[indx1])) + c69v * (SQRV(LVFU(vdif[indx1 - v1])) + SQRV(LVFU(vdif[indx1 + v1]))) + c51v * (SQRV(LVFU(vdif[indx1 - v2])) + SQRV(LVFU(vdif[indx1 + v2]))) + c21v * (SQRV(LVFU(vdif[indx1 - v3])) + SQRV(LVFU(vdif[indx1 + v3]))) - c6v * SQRV(LVFU(vdif[indx1 - v1]) + LVFU(vdif[indx1]) + LVFU(vdif[indx1 + v1]))
+                                   - c10v * (SQRV(LVFU(vdif[indx1 - v2]) + LVFU(vdif[indx1 - v1]) + LVFU(vdif[indx1])) + SQRV(LVFU(vdif[indx1]) + LVFU(vdif[indx1 + v1]) + LVFU(vdif[indx1 + v2]))) - c7v * (SQRV(LVFU(vdif[indx1 - v3]) + LVFU(vdif[indx1 - v2]) + LVFU(vdif[indx1 - v1])) + SQRV(LVFU(vdif[indx1 + v1]) + LVFU(vdif[indx1 + v2]) + LVFU(vdif[indx1 + v3]))), zerov, onev);
+                        egv = vclampf(epssqv + c78v * SQRV(LVFU(hdif[indx1])) + c69v * (SQRV(LVFU(hdif[indx1 - h1])) + SQRV(LVFU(hdif[indx1 + h1]))) + c51v * (SQRV(LVFU(hdif[indx1 - h2])) + SQRV(LVFU(hdif[indx1 + h2]))) + c21v * (SQRV(LVFU(hdif[indx1 - h3])) + SQRV(LVFU(hdif[indx1 + h3]))) - c6v * SQRV(LVFU(hdif[indx1 - h1]) + LVFU(hdif[indx1]) + LVFU(hdif[indx1 + h1]))
+                                   - c10v * (SQRV(LVFU(hdif[indx1 - h2]) + LVFU(hdif[indx1 - h1]) + LVFU(hdif[indx1])) + SQRV(LVFU(hdif[indx1]) + LVFU(hdif[indx1 + h1]) + LVFU(hdif[indx1 + h2]))) - c7v * (SQRV(LVFU(hdif[indx1 - h3]) + LVFU(hdif[indx1 - h2]) + LVFU(hdif[indx1 - h1])) + SQRV(LVFU(hdif[indx1 + h1]) + LVFU(hdif[indx1 + h2]) + LVFU(hdif[indx1 + h3]))), zerov, onev);
+                        //Limit chrominance using H/V neighbourhood
+                        nvv = median(d725v * LVFU(vdif[indx1]) + d1375v * LVFU(vdif[indx1 - v1]) + d1375v * LVFU(vdif[indx1 + v1]), LVFU(vdif[indx1 - v1]), LVFU(vdif[indx1 + v1]));
+                        evv = median(d725v * LVFU(hdif[indx1]) + d1375v * LVFU(hdif[indx1 - h1]) + d1375v * LVFU(hdif[indx1 + h1]), LVFU(hdif[indx1 - h1]), LVFU(hdif[indx1 + h1]));
+                        //Chrominance estimation
+                        tempv = (egv * nvv + ngv * evv) / (ngv + egv);
+                        _mm_storeu_ps(&(chr[d][indx1]), tempv);
+                        //Green channel population
+                        temp1v = c65535v * tempv + LVFU(rgb[0][indx1]);
+                        _mm_storeu_ps( &(rgb[0][indx1]), temp1v );
+                    }
 
-            for (; col < width - 7; col += 2, indx1++) {
-                //H&V integrated gaussian vector over variance on color differences
-                //Mod Jacques 3/2013
-                ng = LIM(epssq + 78.0f * SQR(vdif[indx1]) + 69.0f * (SQR(vdif[indx1 - v1]) + SQR(vdif[indx1 + v1])) + 51.0f * (SQR(vdif[indx1 - v2]) + SQR(vdif[indx1 + v2])) + 21.0f * (SQR(vdif[indx1 - v3]) + SQR(vdif[indx1 + v3])) - 6.0f * SQR(vdif[indx1 - v1] + vdif[indx1] + vdif[indx1 + v1])
-                         - 10.0f * (SQR(vdif[indx1 - v2] + vdif[indx1 - v1] + vdif[indx1]) + SQR(vdif[indx1] + vdif[indx1 + v1] + vdif[indx1 + v2])) - 7.0f * (SQR(vdif[indx1 - v3] + vdif[indx1 - v2] + vdif[indx1 - v1]) + SQR(vdif[indx1 + v1] + vdif[indx1 + v2] + vdif[indx1 + v3])), 0.f, 1.f);
-                eg = LIM(epssq + 78.0f * SQR(hdif[indx1]) + 69.0f * (SQR(hdif[indx1 - h1]) + SQR(hdif[indx1 + h1])) + 51.0f * (SQR(hdif[indx1 - h2]) + SQR(hdif[indx1 + h2])) + 21.0f * (SQR(hdif[indx1 - h3]) + SQR(hdif[indx1 + h3])) - 6.0f * SQR(hdif[indx1 - h1] + hdif[indx1] + hdif[indx1 + h1])
-                         - 10.0f * (SQR(hdif[indx1 - h2] + hdif[indx1 - h1] + hdif[indx1]) + SQR(hdif[indx1] + hdif[indx1 + h1] + hdif[indx1 + h2])) - 7.0f * (SQR(hdif[indx1 - h3] + hdif[indx1 - h2] + hdif[indx1 - h1]) + SQR(hdif[indx1 + h1] + hdif[indx1 + h2] + hdif[indx1 + h3])), 0.f, 1.f);
-                //Limit chrominance using H/V neighbourhood
-                nv = median(0.725f * vdif[indx1] + 0.1375f * vdif[indx1 - v1] + 0.1375f * vdif[indx1 + v1], vdif[indx1 - v1], vdif[indx1 + v1]);
-                ev = median(0.725f * hdif[indx1] + 0.1375f * hdif[indx1 - h1] + 0.1375f * hdif[indx1 + h1], hdif[indx1 - h1], hdif[indx1 + h1]);
-                //Chrominance estimation
-                chr[d][indx1] = (eg * nv + ng * ev) / (ng + eg);
-                //Green channel population
-                rgb[0][indx1] = rgb[0][indx1] + 65535.f * chr[d][indx1];
-            }
-        }
+                    for (; col < tw - 7; col += 2, indx1++) {
+                        //H&V integrated gaussian vector over variance on color differences
+                        //Mod Jacques 3/2013
+                        ng = LIM(epssq + 78.0f * SQR(vdif[indx1]) + 69.0f * (SQR(vdif[indx1 - v1]) + SQR(vdif[indx1 + v1])) + 51.0f * (SQR(vdif[indx1 - v2]) + SQR(vdif[indx1 + v2])) + 21.0f * (SQR(vdif[indx1 - v3]) + SQR(vdif[indx1 + v3])) - 6.0f * SQR(vdif[indx1 - v1] + vdif[indx1] + vdif[indx1 + v1])
+                                 - 10.0f * (SQR(vdif[indx1 - v2] + vdif[indx1 - v1] + vdif[indx1]) + SQR(vdif[indx1] + vdif[indx1 + v1] + vdif[indx1 + v2])) - 7.0f * (SQR(vdif[indx1 - v3] + vdif[indx1 - v2] + vdif[indx1 - v1]) + SQR(vdif[indx1 + v1] + vdif[indx1 + v2] + vdif[indx1 + v3])), 0.f, 1.f);
+                        eg = LIM(epssq + 78.0f * SQR(hdif[indx1]) + 69.0f * (SQR(hdif[indx1 - h1]) + SQR(hdif[indx1 + h1])) + 51.0f * (SQR(hdif[indx1 - h2]) + SQR(hdif[indx1 + h2])) + 21.0f * (SQR(hdif[indx1 - h3]) + SQR(hdif[indx1 + h3])) - 6.0f * SQR(hdif[indx1 - h1] + hdif[indx1] + hdif[indx1 + h1])
+                                 - 10.0f * (SQR(hdif[indx1 - h2] + hdif[indx1 - h1] + hdif[indx1]) + SQR(hdif[indx1] + hdif[indx1 + h1] + hdif[indx1 + h2])) - 7.0f * (SQR(hdif[indx1 - h3] + hdif[indx1 - h2] + hdif[indx1 - h1]) + SQR(hdif[indx1 + h1] + hdif[indx1 + h2] + hdif[indx1 + h3])), 0.f, 1.f);
+                        //Limit chrominance using H/V neighbourhood
+                        nv = median(0.725f * vdif[indx1] + 0.1375f * vdif[indx1 - v1] + 0.1375f * vdif[indx1 + v1], vdif[indx1 - v1], vdif[indx1 + v1]);
+                        ev = median(0.725f * hdif[indx1] + 0.1375f * hdif[indx1 - h1] + 0.1375f * hdif[indx1 + h1], hdif[indx1 - h1], hdif[indx1 + h1]);
+                        //Chrominance estimation
+                        chr[d][indx1] = (eg * nv + ng * ev) / (ng + eg);
+                        //Green channel population
+                        rgb[0][indx1] = rgb[0][indx1] + 65535.f * chr[d][indx1];
+                    }
+                }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.39);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                for (int row = 7; row < th - 7; row++) {
+                    int col, indx, c;
+
+                    for (col = 7 + (FC(top + row, left + 1) & 1), indx = row * tw + col, c = 1 - FC(top + row, left + col) / 2; col < tw - 14; col += 8, indx += 8) {
+                        //NW,NE,SW,SE Gradients
+                        nwgv = onev / (epsv + vabsf(LVFU(chr[c][(indx - v1 - h1) >> 1]) - LVFU(chr[c][(indx - v3 - h3) >> 1])) + vabsf(LVFU(chr[c][(indx + v1 + h1) >> 1]) - LVFU(chr[c][(indx - v3 - h3) >> 1])));
+                        negv = onev / (epsv + vabsf(LVFU(chr[c][(indx - v1 + h1) >> 1]) - LVFU(chr[c][(indx - v3 + h3) >> 1])) + vabsf(LVFU(chr[c][(indx + v1 - h1) >> 1]) - LVFU(chr[c][(indx - v3 + h3) >> 1])));
+                        swgv = onev / (epsv + vabsf(LVFU(chr[c][(indx + v1 - h1) >> 1]) - LVFU(chr[c][(indx + v3 + h3) >> 1])) + vabsf(LVFU(chr[c][(indx - v1 + h1) >> 1]) - LVFU(chr[c][(indx + v3 - h3) >> 1])));
+                        segv = onev / (epsv + vabsf(LVFU(chr[c][(indx + v1 + h1) >> 1]) - LVFU(chr[c][(indx + v3 - h3) >> 1])) + vabsf(LVFU(chr[c][(indx - v1 - h1) >> 1]) - LVFU(chr[c][(indx + v3 + h3) >> 1])));
+                        //Limit NW,NE,SW,SE Color differences
+                        nwvv = median(LVFU(chr[c][(indx - v1 - h1) >> 1]), LVFU(chr[c][(indx - v3 - h1) >> 1]), LVFU(chr[c][(indx - v1 - h3) >> 1]));
+                        nevv = median(LVFU(chr[c][(indx - v1 + h1) >> 1]), LVFU(chr[c][(indx - v3 + h1) >> 1]), LVFU(chr[c][(indx - v1 + h3) >> 1]));
+                        swvv = median(LVFU(chr[c][(indx + v1 - h1) >> 1]), LVFU(chr[c][(indx + v3 - h1) >> 1]), LVFU(chr[c][(indx + v1 - h3) >> 1]));
+                        sevv = median(LVFU(chr[c][(indx + v1 + h1) >> 1]), LVFU(chr[c][(indx + v3 + h1) >> 1]), LVFU(chr[c][(indx + v1 + h3) >> 1]));
+                        //Interpolate chrominance: R@B and B@R
+                        tempv = (nwgv * nwvv + negv * nevv + swgv * swvv + segv * sevv) / (nwgv + negv + swgv + segv);
+                        _mm_storeu_ps( &(chr[c][indx >> 1]), tempv);
+                    }
 
-        for (int row = 7; row < height - 7; row++) {
-            int col, indx, c;
-
-            for (col = 7 + (FC(row, 1) & 1), indx = row * width + col, c = 1 - FC(row, col) / 2; col < width - 14; col += 8, indx += 8) {
-                //NW,NE,SW,SE Gradients
-                nwgv = onev / (epsv + vabsf(LVFU(chr[c][(indx - v1 - h1) >> 1]) - LVFU(chr[c][(indx - v3 - h3) >> 1])) + vabsf(LVFU(chr[c][(indx + v1 + h1) >> 1]) - LVFU(chr[c][(indx - v3 - h3) >> 1])));
-                negv = onev / (epsv + vabsf(LVFU(chr[c][(indx - v1 + h1) >> 1]) - LVFU(chr[c][(indx - v3 + h3) >> 1])) + vabsf(LVFU(chr[c][(indx + v1 - h1) >> 1]) - LVFU(chr[c][(indx - v3 + h3) >> 1])));
-                swgv = onev / (epsv + vabsf(LVFU(chr[c][(indx + v1 - h1) >> 1]) - LVFU(chr[c][(indx + v3 + h3) >> 1])) + vabsf(LVFU(chr[c][(indx - v1 + h1) >> 1]) - LVFU(chr[c][(indx + v3 - h3) >> 1])));
-                segv = onev / (epsv + vabsf(LVFU(chr[c][(indx + v1 + h1) >> 1]) - LVFU(chr[c][(indx + v3 - h3) >> 1])) + vabsf(LVFU(chr[c][(indx - v1 - h1) >> 1]) - LVFU(chr[c][(indx + v3 + h3) >> 1])));
-                //Limit NW,NE,SW,SE Color differences
-                nwvv = median(LVFU(chr[c][(indx - v1 - h1) >> 1]), LVFU(chr[c][(indx - v3 - h1) >> 1]), LVFU(chr[c][(indx - v1 - h3) >> 1]));
-                nevv = median(LVFU(chr[c][(indx - v1 + h1) >> 1]), LVFU(chr[c][(indx - v3 + h1) >> 1]), LVFU(chr[c][(indx - v1 + h3) >> 1]));
-                swvv = median(LVFU(chr[c][(indx + v1 - h1) >> 1]), LVFU(chr[c][(indx + v3 - h1) >> 1]), LVFU(chr[c][(indx + v1 - h3) >> 1]));
-                sevv = median(LVFU(chr[c][(indx + v1 + h1) >> 1]), LVFU(chr[c][(indx + v3 + h1) >> 1]), LVFU(chr[c][(indx + v1 + h3) >> 1]));
-                //Interpolate chrominance: R@B and B@R
-                tempv = (nwgv * nwvv + negv * nevv + swgv * swvv + segv * sevv) / (nwgv + negv + swgv + segv);
-                _mm_storeu_ps( &(chr[c][indx >> 1]), tempv);
-            }
+                    for (; col < tw - 7; col += 2, indx += 2) {
+                        //NW,NE,SW,SE Gradients
+                        nwg = 1.0f / (eps + fabsf(chr[c][(indx - v1 - h1) >> 1] - chr[c][(indx - v3 - h3) >> 1]) + fabsf(chr[c][(indx + v1 + h1) >> 1] - chr[c][(indx - v3 - h3) >> 1]));
+                        neg = 1.0f / (eps + fabsf(chr[c][(indx - v1 + h1) >> 1] - chr[c][(indx - v3 + h3) >> 1]) + fabsf(chr[c][(indx + v1 - h1) >> 1] - chr[c][(indx - v3 + h3) >> 1]));
+                        swg = 1.0f / (eps + fabsf(chr[c][(indx + v1 - h1) >> 1] - chr[c][(indx + v3 + h3) >> 1]) + fabsf(chr[c][(indx - v1 + h1) >> 1] - chr[c][(indx + v3 - h3) >> 1]));
+                        seg = 1.0f / (eps + fabsf(chr[c][(indx + v1 + h1) >> 1] - chr[c][(indx + v3 - h3) >> 1]) + fabsf(chr[c][(indx - v1 - h1) >> 1] - chr[c][(indx + v3 + h3) >> 1]));
+                        //Limit NW,NE,SW,SE Color differences
+                        nwv = median(chr[c][(indx - v1 - h1) >> 1], chr[c][(indx - v3 - h1) >> 1], chr[c][(indx - v1 - h3) >> 1]);
+                        nev = median(chr[c][(indx - v1 + h1) >> 1], chr[c][(indx - v3 + h1) >> 1], chr[c][(indx - v1 + h3) >> 1]);
+                        swv = median(chr[c][(indx + v1 - h1) >> 1], chr[c][(indx + v3 - h1) >> 1], chr[c][(indx + v1 - h3) >> 1]);
+                        sev = median(chr[c][(indx + v1 + h1) >> 1], chr[c][(indx + v3 + h1) >> 1], chr[c][(indx + v1 + h3) >> 1]);
+                        //Interpolate chrominance: R@B and B@R
+                        chr[c][indx >> 1] = (nwg * nwv + neg * nev + swg * swv + seg * sev) / (nwg + neg + swg + seg);
+                    }
+                }
 
-            for (; col < width - 7; col += 2, indx += 2) {
-                //NW,NE,SW,SE Gradients
-                nwg = 1.0f / (eps + fabsf(chr[c][(indx - v1 - h1) >> 1] - chr[c][(indx - v3 - h3) >> 1]) + fabsf(chr[c][(indx + v1 + h1) >> 1] - chr[c][(indx - v3 - h3) >> 1]));
-                neg = 1.0f / (eps + fabsf(chr[c][(indx - v1 + h1) >> 1] - chr[c][(indx - v3 + h3) >> 1]) + fabsf(chr[c][(indx + v1 - h1) >> 1] - chr[c][(indx - v3 + h3) >> 1]));
-                swg = 1.0f / (eps + fabsf(chr[c][(indx + v1 - h1) >> 1] - chr[c][(indx + v3 + h3) >> 1]) + fabsf(chr[c][(indx - v1 + h1) >> 1] - chr[c][(indx + v3 - h3) >> 1]));
-                seg = 1.0f / (eps + fabsf(chr[c][(indx + v1 + h1) >> 1] - chr[c][(indx + v3 - h3) >> 1]) + fabsf(chr[c][(indx - v1 - h1) >> 1] - chr[c][(indx + v3 + h3) >> 1]));
-                //Limit NW,NE,SW,SE Color differences
-                nwv = median(chr[c][(indx - v1 - h1) >> 1], chr[c][(indx - v3 - h1) >> 1], chr[c][(indx - v1 - h3) >> 1]);
-                nev = median(chr[c][(indx - v1 + h1) >> 1], chr[c][(indx - v3 + h1) >> 1], chr[c][(indx - v1 + h3) >> 1]);
-                swv = median(chr[c][(indx + v1 - h1) >> 1], chr[c][(indx + v3 - h1) >> 1], chr[c][(indx + v1 - h3) >> 1]);
-                sev = median(chr[c][(indx + v1 + h1) >> 1], chr[c][(indx + v3 + h1) >> 1], chr[c][(indx + v1 + h3) >> 1]);
-                //Interpolate chrominance: R@B and B@R
-                chr[c][indx >> 1] = (nwg * nwv + neg * nev + swg * swv + seg * sev) / (nwg + neg + swg + seg);
-            }
-        }
+                for (int row = 7; row < th - 7; row++) {
+                    int col, indx;
+
+                    for (col = 7 + (FC(top + row, left) & 1), indx = row * tw + col; col < tw - 14; col += 8, indx += 8) {
+                        //N,E,W,S Gradients
+                        ngv = onev / (epsv + vabsf(LVFU(chr[0][(indx - v1) >> 1]) - LVFU(chr[0][(indx - v3) >> 1])) + vabsf(LVFU(chr[0][(indx + v1) >> 1]) - LVFU(chr[0][(indx - v3) >> 1])));
+                        egv = onev / (epsv + vabsf(LVFU(chr[0][(indx + h1) >> 1]) - LVFU(chr[0][(indx + h3) >> 1])) + vabsf(LVFU(chr[0][(indx - h1) >> 1]) - LVFU(chr[0][(indx + h3) >> 1])));
+                        wgv = onev / (epsv + vabsf(LVFU(chr[0][(indx - h1) >> 1]) - LVFU(chr[0][(indx - h3) >> 1])) + vabsf(LVFU(chr[0][(indx + h1) >> 1]) - LVFU(chr[0][(indx - h3) >> 1])));
+                        sgv = onev / (epsv + vabsf(LVFU(chr[0][(indx + v1) >> 1]) - LVFU(chr[0][(indx + v3) >> 1])) + vabsf(LVFU(chr[0][(indx - v1) >> 1]) - LVFU(chr[0][(indx + v3) >> 1])));
+                        //Interpolate chrominance: R@G and B@G
+                        tempv = ((ngv * LVFU(chr[0][(indx - v1) >> 1]) + egv * LVFU(chr[0][(indx + h1) >> 1]) + wgv * LVFU(chr[0][(indx - h1) >> 1]) + sgv * LVFU(chr[0][(indx + v1) >> 1])) / (ngv + egv + wgv + sgv));
+                        _mm_storeu_ps( &chr[0 + 2][indx >> 1], tempv);
+                    }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.65);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                    for (; col < tw - 7; col += 2, indx += 2) {
+                        //N,E,W,S Gradients
+                        ng = 1.0f / (eps + fabsf(chr[0][(indx - v1) >> 1] - chr[0][(indx - v3) >> 1]) + fabsf(chr[0][(indx + v1) >> 1] - chr[0][(indx - v3) >> 1]));
+                        eg = 1.0f / (eps + fabsf(chr[0][(indx + h1) >> 1] - chr[0][(indx + h3) >> 1]) + fabsf(chr[0][(indx - h1) >> 1] - chr[0][(indx + h3) >> 1]));
+                        wg = 1.0f / (eps + fabsf(chr[0][(indx - h1) >> 1] - chr[0][(indx - h3) >> 1]) + fabsf(chr[0][(indx + h1) >> 1] - chr[0][(indx - h3) >> 1]));
+                        sg = 1.0f / (eps + fabsf(chr[0][(indx + v1) >> 1] - chr[0][(indx + v3) >> 1]) + fabsf(chr[0][(indx - v1) >> 1] - chr[0][(indx + v3) >> 1]));
+                        //Interpolate chrominance: R@G and B@G
+                        chr[0 + 2][indx >> 1] = ((ng * chr[0][(indx - v1) >> 1] + eg * chr[0][(indx + h1) >> 1] + wg * chr[0][(indx - h1) >> 1] + sg * chr[0][(indx + v1) >> 1]) / (ng + eg + wg + sg));
+                    }
+                }
 
-        for (int row = 7; row < height - 7; row++) {
-            int col, indx;
-
-            for (col = 7 + (FC(row, 0) & 1), indx = row * width + col; col < width - 14; col += 8, indx += 8) {
-                //N,E,W,S Gradients
-                ngv = onev / (epsv + vabsf(LVFU(chr[0][(indx - v1) >> 1]) - LVFU(chr[0][(indx - v3) >> 1])) + vabsf(LVFU(chr[0][(indx + v1) >> 1]) - LVFU(chr[0][(indx - v3) >> 1])));
-                egv = onev / (epsv + vabsf(LVFU(chr[0][(indx + h1) >> 1]) - LVFU(chr[0][(indx + h3) >> 1])) + vabsf(LVFU(chr[0][(indx - h1) >> 1]) - LVFU(chr[0][(indx + h3) >> 1])));
-                wgv = onev / (epsv + vabsf(LVFU(chr[0][(indx - h1) >> 1]) - LVFU(chr[0][(indx - h3) >> 1])) + vabsf(LVFU(chr[0][(indx + h1) >> 1]) - LVFU(chr[0][(indx - h3) >> 1])));
-                sgv = onev / (epsv + vabsf(LVFU(chr[0][(indx + v1) >> 1]) - LVFU(chr[0][(indx + v3) >> 1])) + vabsf(LVFU(chr[0][(indx - v1) >> 1]) - LVFU(chr[0][(indx + v3) >> 1])));
-                //Interpolate chrominance: R@G and B@G
-                tempv = ((ngv * LVFU(chr[0][(indx - v1) >> 1]) + egv * LVFU(chr[0][(indx + h1) >> 1]) + wgv * LVFU(chr[0][(indx - h1) >> 1]) + sgv * LVFU(chr[0][(indx + v1) >> 1])) / (ngv + egv + wgv + sgv));
-                _mm_storeu_ps( &chr[0 + 2][indx >> 1], tempv);
-            }
+                for (int row = 7; row < th - 7; row++) {
+                    int col, indx;
+
+                    for (col = 7 + (FC(top + row, left) & 1), indx = row * tw + col; col < tw - 14; col += 8, indx += 8) {
+                        //N,E,W,S Gradients
+                        ngv = onev / (epsv + vabsf(LVFU(chr[1][(indx - v1) >> 1]) - LVFU(chr[1][(indx - v3) >> 1])) + vabsf(LVFU(chr[1][(indx + v1) >> 1]) - LVFU(chr[1][(indx - v3) >> 1])));
+                        egv = onev / (epsv + vabsf(LVFU(chr[1][(indx + h1) >> 1]) - LVFU(chr[1][(indx + h3) >> 1])) + vabsf(LVFU(chr[1][(indx - h1) >> 1]) - LVFU(chr[1][(indx + h3) >> 1])));
+                        wgv = onev / (epsv + vabsf(LVFU(chr[1][(indx - h1) >> 1]) - LVFU(chr[1][(indx - h3) >> 1])) + vabsf(LVFU(chr[1][(indx + h1) >> 1]) - LVFU(chr[1][(indx - h3) >> 1])));
+                        sgv = onev / (epsv + vabsf(LVFU(chr[1][(indx + v1) >> 1]) - LVFU(chr[1][(indx + v3) >> 1])) + vabsf(LVFU(chr[1][(indx - v1) >> 1]) - LVFU(chr[1][(indx + v3) >> 1])));
+                        //Interpolate chrominance: R@G and B@G
+                        tempv = ((ngv * LVFU(chr[1][(indx - v1) >> 1]) + egv * LVFU(chr[1][(indx + h1) >> 1]) + wgv * LVFU(chr[1][(indx - h1) >> 1]) + sgv * LVFU(chr[1][(indx + v1) >> 1])) / (ngv + egv + wgv + sgv));
+                        _mm_storeu_ps( &chr[1 + 2][indx >> 1], tempv);
+                    }
 
-            for (; col < width - 7; col += 2, indx += 2) {
-                //N,E,W,S Gradients
-                ng = 1.0f / (eps + fabsf(chr[0][(indx - v1) >> 1] - chr[0][(indx - v3) >> 1]) + fabsf(chr[0][(indx + v1) >> 1] - chr[0][(indx - v3) >> 1]));
-                eg = 1.0f / (eps + fabsf(chr[0][(indx + h1) >> 1] - chr[0][(indx + h3) >> 1]) + fabsf(chr[0][(indx - h1) >> 1] - chr[0][(indx + h3) >> 1]));
-                wg = 1.0f / (eps + fabsf(chr[0][(indx - h1) >> 1] - chr[0][(indx - h3) >> 1]) + fabsf(chr[0][(indx + h1) >> 1] - chr[0][(indx - h3) >> 1]));
-                sg = 1.0f / (eps + fabsf(chr[0][(indx + v1) >> 1] - chr[0][(indx + v3) >> 1]) + fabsf(chr[0][(indx - v1) >> 1] - chr[0][(indx + v3) >> 1]));
-                //Interpolate chrominance: R@G and B@G
-                chr[0 + 2][indx >> 1] = ((ng * chr[0][(indx - v1) >> 1] + eg * chr[0][(indx + h1) >> 1] + wg * chr[0][(indx - h1) >> 1] + sg * chr[0][(indx + v1) >> 1]) / (ng + eg + wg + sg));
-            }
-        }
+                    for (; col < tw - 7; col += 2, indx += 2) {
+                        //N,E,W,S Gradients
+                        ng = 1.0f / (eps + fabsf(chr[1][(indx - v1) >> 1] - chr[1][(indx - v3) >> 1]) + fabsf(chr[1][(indx + v1) >> 1] - chr[1][(indx - v3) >> 1]));
+                        eg = 1.0f / (eps + fabsf(chr[1][(indx + h1) >> 1] - chr[1][(indx + h3) >> 1]) + fabsf(chr[1][(indx - h1) >> 1] - chr[1][(indx + h3) >> 1]));
+                        wg = 1.0f / (eps + fabsf(chr[1][(indx - h1) >> 1] - chr[1][(indx - h3) >> 1]) + fabsf(chr[1][(indx + h1) >> 1] - chr[1][(indx - h3) >> 1]));
+                        sg = 1.0f / (eps + fabsf(chr[1][(indx + v1) >> 1] - chr[1][(indx + v3) >> 1]) + fabsf(chr[1][(indx - v1) >> 1] - chr[1][(indx + v3) >> 1]));
+                        //Interpolate chrominance: R@G and B@G
+                        chr[1 + 2][indx >> 1] = ((ng * chr[1][(indx - v1) >> 1] + eg * chr[1][(indx + h1) >> 1] + wg * chr[1][(indx - h1) >> 1] + sg * chr[1][(indx + v1) >> 1]) / (ng + eg + wg + sg));
+                    }
+                }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.78);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                // copy the inner part of the tile to the output
+                const int rowEnd = std::min(tr * tsCore + tsCore - top, th - 7);
+                const int colStart = std::max(tc * tsCore - left, 7);
+                const int colEnd = std::min(tc * tsCore + tsCore - left, tw - 7);
+
+                for(int row = std::max(tr * tsCore - top, 7); row < rowEnd; row++) {
+                    int col, indx, fc;
+                    fc = FC(top + row, left + colStart) & 1;
+                    src1 = rgb[fc];
+                    src2 = rgb[fc ^ 1];
+                    redsrc0 = chr[fc << 1];
+                    redsrc1 = chr[(fc ^ 1) << 1];
+                    bluesrc0 = chr[(fc << 1) + 1];
+                    bluesrc1 = chr[((fc ^ 1) << 1) + 1];
+                    float* redrow = red[top + row] + left;
+                    float* greenrow = green[top + row] + left;
+                    float* bluerow = blue[top + row] + left;
+
+                    for(col = colStart, indx = row * tw + col; col < colEnd - 7; col += 8, indx += 8) {
+                        temp1v = LVFU( src1[indx >> 1] );
+                        temp2v = LVFU( src2[(indx + 1) >> 1] );
+                        tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+                        tempv = _mm_shuffle_ps( tempv, tempv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+                        _mm_storeu_ps( &greenrow[col], CLIPV( tempv ));
+                        temp5v = LVFU(redsrc0[indx >> 1]);
+                        temp6v = LVFU(redsrc1[(indx + 1) >> 1]);
+                        temp3v = _mm_shuffle_ps( temp5v, temp6v, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+                        temp3v = _mm_shuffle_ps( temp3v, temp3v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+                        temp3v = CLIPV( tempv - c65535v * temp3v );
+                        _mm_storeu_ps( &redrow[col], temp3v);
+                        temp7v = LVFU(bluesrc0[indx >> 1]);
+                        temp8v = LVFU(bluesrc1[(indx + 1) >> 1]);
+                        temp4v = _mm_shuffle_ps( temp7v, temp8v, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+                        temp4v = _mm_shuffle_ps( temp4v, temp4v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+                        temp4v = CLIPV( tempv - c65535v * temp4v );
+                        _mm_storeu_ps( &bluerow[col], temp4v);
+
+                        tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+                        tempv = _mm_shuffle_ps( tempv, tempv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+                        _mm_storeu_ps( &greenrow[col + 4], CLIPV( tempv ));
+
+                        temp3v = _mm_shuffle_ps( temp5v, temp6v, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+                        temp3v = _mm_shuffle_ps( temp3v, temp3v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+                        temp3v = CLIPV( tempv - c65535v * temp3v );
+                        _mm_storeu_ps( &redrow[col + 4], temp3v);
+                        temp4v = _mm_shuffle_ps( temp7v, temp8v, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+                        temp4v = _mm_shuffle_ps( temp4v, temp4v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+                        temp4v = CLIPV( tempv - c65535v * temp4v );
+                        _mm_storeu_ps( &bluerow[col + 4], temp4v);
+                    }
 
-        for (int row = 7; row < height - 7; row++) {
-            int col, indx;
-
-            for (col = 7 + (FC(row, 0) & 1), indx = row * width + col; col < width - 14; col += 8, indx += 8) {
-                //N,E,W,S Gradients
-                ngv = onev / (epsv + vabsf(LVFU(chr[1][(indx - v1) >> 1]) - LVFU(chr[1][(indx - v3) >> 1])) + vabsf(LVFU(chr[1][(indx + v1) >> 1]) - LVFU(chr[1][(indx - v3) >> 1])));
-                egv = onev / (epsv + vabsf(LVFU(chr[1][(indx + h1) >> 1]) - LVFU(chr[1][(indx + h3) >> 1])) + vabsf(LVFU(chr[1][(indx - h1) >> 1]) - LVFU(chr[1][(indx + h3) >> 1])));
-                wgv = onev / (epsv + vabsf(LVFU(chr[1][(indx - h1) >> 1]) - LVFU(chr[1][(indx - h3) >> 1])) + vabsf(LVFU(chr[1][(indx + h1) >> 1]) - LVFU(chr[1][(indx - h3) >> 1])));
-                sgv = onev / (epsv + vabsf(LVFU(chr[1][(indx + v1) >> 1]) - LVFU(chr[1][(indx + v3) >> 1])) + vabsf(LVFU(chr[1][(indx - v1) >> 1]) - LVFU(chr[1][(indx + v3) >> 1])));
-                //Interpolate chrominance: R@G and B@G
-                tempv = ((ngv * LVFU(chr[1][(indx - v1) >> 1]) + egv * LVFU(chr[1][(indx + h1) >> 1]) + wgv * LVFU(chr[1][(indx - h1) >> 1]) + sgv * LVFU(chr[1][(indx + v1) >> 1])) / (ngv + egv + wgv + sgv));
-                _mm_storeu_ps( &chr[1 + 2][indx >> 1], tempv);
-            }
+                    for(; col < colEnd; col++, indx += 2) {
+                        redrow  [col] = CLIP(src1[indx >> 1] - 65535.f * redsrc0[indx >> 1]);
+                        greenrow[col] = CLIP(src1[indx >> 1]);
+                        bluerow [col] = CLIP(src1[indx >> 1] - 65535.f * bluesrc0[indx >> 1]);
+                        col++;
+                        if (col < colEnd) {
+                            redrow  [col] = CLIP(src2[(indx + 1) >> 1] - 65535.f * redsrc1[(indx + 1) >> 1]);
+                            greenrow[col] = CLIP(src2[(indx + 1) >> 1]);
+                            bluerow [col] = CLIP(src2[(indx + 1) >> 1] - 65535.f * bluesrc1[(indx + 1) >> 1]);
+                        }
+                    }
+                }
 
-            for (; col < width - 7; col += 2, indx += 2) {
-                //N,E,W,S Gradients
-                ng = 1.0f / (eps + fabsf(chr[1][(indx - v1) >> 1] - chr[1][(indx - v3) >> 1]) + fabsf(chr[1][(indx + v1) >> 1] - chr[1][(indx - v3) >> 1]));
-                eg = 1.0f / (eps + fabsf(chr[1][(indx + h1) >> 1] - chr[1][(indx + h3) >> 1]) + fabsf(chr[1][(indx - h1) >> 1] - chr[1][(indx + h3) >> 1]));
-                wg = 1.0f / (eps + fabsf(chr[1][(indx - h1) >> 1] - chr[1][(indx - h3) >> 1]) + fabsf(chr[1][(indx + h1) >> 1] - chr[1][(indx - h3) >> 1]));
-                sg = 1.0f / (eps + fabsf(chr[1][(indx + v1) >> 1] - chr[1][(indx + v3) >> 1]) + fabsf(chr[1][(indx - v1) >> 1] - chr[1][(indx + v3) >> 1]));
-                //Interpolate chrominance: R@G and B@G
-                chr[1 + 2][indx >> 1] = ((ng * chr[1][(indx - v1) >> 1] + eg * chr[1][(indx + h1) >> 1] + wg * chr[1][(indx - h1) >> 1] + sg * chr[1][(indx + v1) >> 1]) / (ng + eg + wg + sg));
-            }
-        }
+                if(plistener) {
+                    progresscounter++;
 
+                    if(progresscounter % 16 == 0) {
 #ifdef _OPENMP
-        #pragma omp single
+                        #pragma omp critical (igvprogress)
 #endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.91);
+                        {
+                            progress += (double)16 * (tsCore * tsCore) / (height * width);
+                            progress = progress > 1.0 ? 1.0 : progress;
+                            plistener->setProgress(progress);
+                        }
+                    }
+                }
             }
         }
-        float *src1, *src2, *redsrc0, *redsrc1, *bluesrc0, *bluesrc1;
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for(int row = 7; row < height - 7; row++) {
-            int col, indx, fc;
-            fc = FC(row, 7) & 1;
-            src1 = rgb[fc];
-            src2 = rgb[fc ^ 1];
-            redsrc0 = chr[fc << 1];
-            redsrc1 = chr[(fc ^ 1) << 1];
-            bluesrc0 = chr[(fc << 1) + 1];
-            bluesrc1 = chr[((fc ^ 1) << 1) + 1];
-
-            for(col = 7, indx = row * width + col; col < width - 14; col += 8, indx += 8) {
-                temp1v = LVFU( src1[indx >> 1] );
-                temp2v = LVFU( src2[(indx + 1) >> 1] );
-                tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 1, 0, 1, 0 ) );
-                tempv = _mm_shuffle_ps( tempv, tempv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
-                _mm_storeu_ps( &green[row][col], CLIPV( tempv ));
-                temp5v = LVFU(redsrc0[indx >> 1]);
-                temp6v = LVFU(redsrc1[(indx + 1) >> 1]);
-                temp3v = _mm_shuffle_ps( temp5v, temp6v, _MM_SHUFFLE( 1, 0, 1, 0 ) );
-                temp3v = _mm_shuffle_ps( temp3v, temp3v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
-                temp3v = CLIPV( tempv - c65535v * temp3v );
-                _mm_storeu_ps( &red[row][col], temp3v);
-                temp7v = LVFU(bluesrc0[indx >> 1]);
-                temp8v = LVFU(bluesrc1[(indx + 1) >> 1]);
-                temp4v = _mm_shuffle_ps( temp7v, temp8v, _MM_SHUFFLE( 1, 0, 1, 0 ) );
-                temp4v = _mm_shuffle_ps( temp4v, temp4v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
-                temp4v = CLIPV( tempv - c65535v * temp4v );
-                _mm_storeu_ps( &blue[row][col], temp4v);
-
-                tempv = _mm_shuffle_ps( temp1v, temp2v, _MM_SHUFFLE( 3, 2, 3, 2 ) );
-                tempv = _mm_shuffle_ps( tempv, tempv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
-                _mm_storeu_ps( &green[row][col + 4], CLIPV( tempv ));
-
-                temp3v = _mm_shuffle_ps( temp5v, temp6v, _MM_SHUFFLE( 3, 2, 3, 2 ) );
-                temp3v = _mm_shuffle_ps( temp3v, temp3v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
-                temp3v = CLIPV( tempv - c65535v * temp3v );
-                _mm_storeu_ps( &red[row][col + 4], temp3v);
-                temp4v = _mm_shuffle_ps( temp7v, temp8v, _MM_SHUFFLE( 3, 2, 3, 2 ) );
-                temp4v = _mm_shuffle_ps( temp4v, temp4v, _MM_SHUFFLE( 3, 1, 2, 0 ) );
-                temp4v = CLIPV( tempv - c65535v * temp4v );
-                _mm_storeu_ps( &blue[row][col + 4], temp4v);
-            }
 
-            for(; col < width - 7; col++, indx += 2) {
-                red  [row][col] = CLIP(src1[indx >> 1] - 65535.f * redsrc0[indx >> 1]);
-                green[row][col] = CLIP(src1[indx >> 1]);
-                blue [row][col] = CLIP(src1[indx >> 1] - 65535.f * bluesrc0[indx >> 1]);
-                col++;
-                red  [row][col] = CLIP(src2[(indx + 1) >> 1] - 65535.f * redsrc1[(indx + 1) >> 1]);
-                green[row][col] = CLIP(src2[(indx + 1) >> 1]);
-                blue [row][col] = CLIP(src2[(indx + 1) >> 1] - 65535.f * bluesrc1[(indx + 1) >> 1]);
-            }
-        }
+        free(chrarray);
+        free(rgbarray);
+        free(vdif);
+        free(hdif);
     }// End of parallelization
     border_interpolate2(winw, winh, 8, rawData, red, green, blue);
 
     if (plistener) {
         plistener->setProgress (1.0);
     }
-
-    free(chrarray);
-    free(rgbarray);
-    free(vdif);
-    free(hdif);
 }
 #undef CLIPV
 #else
@@ -1525,250 +1401,179 @@ void RawImageSource::igv_interpolate(int winw, int winh)
     static const float eps = 1e-5f, epssq = 1e-5f; //mod epssq -10f =>-5f Jacques 3/2013 to prevent artifact (divide by zero)
     static const int h1 = 1, h2 = 2, h3 = 3, h4 = 4, h5 = 5, h6 = 6;
     const int width = winw, height = winh;
-    const int v1 = 1 * width, v2 = 2 * width, v3 = 3 * width, v4 = 4 * width, v5 = 5 * width, v6 = 6 * width;
-    float* rgb[3];
-    float* chr[2];
-    float *rgbarray, *vdif, *hdif, *chrarray;
-
-    rgbarray    = (float (*)) calloc(width * height * 3, sizeof( float));
-    rgb[0] = rgbarray;
-    rgb[1] = rgbarray + (width * height);
-    rgb[2] = rgbarray + 2 * (width * height);
-
-    chrarray    = (float (*)) calloc(width * height * 2, sizeof( float));
-    chr[0] = chrarray;
-    chr[1] = chrarray + (width * height);
-
-    vdif  = (float (*))    calloc(width * height / 2, sizeof * vdif);
-    hdif  = (float (*))    calloc(width * height / 2, sizeof * hdif);
+    // The image is processed in tiles of ts x ts pixels. Tiles overlap by tsBorder pixels, which is
+    // more than the sum of the filter radii of all steps (5 + 6 + 3 + 3), so the inner part of each
+    // tile gets the same values as processing the whole image at once.
+    constexpr int ts = 256;
+    constexpr int tsBorder = 18;
+    constexpr int tsCore = ts - 2 * tsBorder;
 
     if (plistener) {
         plistener->setProgressStr (Glib::ustring::compose(M("TP_RAW_DMETHOD_PROGRESSBAR"), M("TP_RAW_IGV")));
         plistener->setProgress (0.0);
     }
 
+    const int numTilesH = (height + tsCore - 1) / tsCore;
+    const int numTilesW = (width + tsCore - 1) / tsCore;
+    double progress = 0.0;
+
 #ifdef _OPENMP
-    #pragma omp parallel shared(rgb,vdif,hdif,chr)
+    #pragma omp parallel
 #endif
     {
 
         float ng, eg, wg, sg, nv, ev, wv, sv, nwg, neg, swg, seg, nwv, nev, swv, sev;
 
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for (int row = 0; row < height - 0; row++)
-            for (int col = 0, indx = row * width + col; col < width - 0; col++, indx++) {
-                int c = FC(row, col);
-                rgb[c][indx] = CLIP(rawData[row][col]); //rawData = RT data
-            }
+        float* rgb[3];
+        float* chr[2];
+        float *rgbarray, *vdif, *hdif, *chrarray;
 
-//  border_interpolate2(7, rgb);
+        rgbarray    = (float (*)) malloc(ts * ts * 3 * sizeof( float));
+        rgb[0] = rgbarray;
+        rgb[1] = rgbarray + (ts * ts);
+        rgb[2] = rgbarray + 2 * (ts * ts);
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.13);
-            }
-        }
+        chrarray    = (float (*)) malloc(ts * ts * 2 * sizeof( float));
+        chr[0] = chrarray;
+        chr[1] = chrarray + (ts * ts);
 
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+        vdif  = (float (*))    malloc(ts * ts / 2 * sizeof * vdif);
+        hdif  = (float (*))    malloc(ts * ts / 2 * sizeof * hdif);
 
-        for (int row = 5; row < height - 5; row++)
-            for (int col = 5 + (FC(row, 1) & 1), indx = row * width + col, c = FC(row, col); col < width - 5; col += 2, indx += 2) {
-                //N,E,W,S Gradients
-                ng = (eps + (fabsf(rgb[1][indx - v1] - rgb[1][indx - v3]) + fabsf(rgb[c][indx] - rgb[c][indx - v2])) / 65535.f);;
-                eg = (eps + (fabsf(rgb[1][indx + h1] - rgb[1][indx + h3]) + fabsf(rgb[c][indx] - rgb[c][indx + h2])) / 65535.f);
-                wg = (eps + (fabsf(rgb[1][indx - h1] - rgb[1][indx - h3]) + fabsf(rgb[c][indx] - rgb[c][indx - h2])) / 65535.f);
-                sg = (eps + (fabsf(rgb[1][indx + v1] - rgb[1][indx + v3]) + fabsf(rgb[c][indx] - rgb[c][indx + v2])) / 65535.f);
-                //N,E,W,S High Order Interpolation (Li & Randhawa)
-                //N,E,W,S Hamilton Adams Interpolation
-                // (48.f * 65535.f) = 3145680.f
-                nv = LIM(((23.0f * rgb[1][indx - v1] + 23.0f * rgb[1][indx - v3] + rgb[1][indx - v5] + rgb[1][indx + v1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx - v2] - 8.0f * rgb[c][indx - v4])) / 3145680.f, 0.0f, 1.0f);
-                ev = LIM(((23.0f * rgb[1][indx + h1] + 23.0f * rgb[1][indx + h3] + rgb[1][indx + h5] + rgb[1][indx - h1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx + h2] - 8.0f * rgb[c][indx + h4])) / 3145680.f, 0.0f, 1.0f);
-                wv = LIM(((23.0f * rgb[1][indx - h1] + 23.0f * rgb[1][indx - h3] + rgb[1][indx - h5] + rgb[1][indx + h1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx - h2] - 8.0f * rgb[c][indx - h4])) / 3145680.f, 0.0f, 1.0f);
-                sv = LIM(((23.0f * rgb[1][indx + v1] + 23.0f * rgb[1][indx + v3] + rgb[1][indx + v5] + rgb[1][indx - v1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx + v2] - 8.0f * rgb[c][indx + v4])) / 3145680.f, 0.0f, 1.0f);
-                //Horizontal and vertical color differences
-                vdif[indx >> 1] = (sg * nv + ng * sv) / (ng + sg) - (rgb[c][indx]) / 65535.f;
-                hdif[indx >> 1] = (wg * ev + eg * wv) / (eg + wg) - (rgb[c][indx]) / 65535.f;
-            }
+        int progresscounter = 0;
 
 #ifdef _OPENMP
-        #pragma omp single
+        #pragma omp for schedule(dynamic) collapse(2) nowait
 #endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.26);
-            }
-        }
 
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+        for (int tr = 0; tr < numTilesH; tr++) {
+            for (int tc = 0; tc < numTilesW; tc++) {
+                // tile position, top and left are even for the packed arrays, FC() always gets absolute coordinates
+                const int top = std::max(tr * tsCore - tsBorder, 0);
+                const int left = std::max(tc * tsCore - tsBorder, 0);
+                const int th = std::min(tr * tsCore + tsCore + tsBorder, height) - top;
+                const int tw = (std::min(tc * tsCore + tsCore + tsBorder, width) - left) & ~1;
+                const int v1 = 1 * tw, v2 = 2 * tw, v3 = 3 * tw, v4 = 4 * tw, v5 = 5 * tw, v6 = 6 * tw;
 
-        for (int row = 7; row < height - 7; row++)
-            for (int col = 7 + (FC(row, 1) & 1), indx = row * width + col, c = FC(row, col), d = c / 2; col < width - 7; col += 2, indx += 2) {
-                //H&V integrated gaussian vector over variance on color differences
-                //Mod Jacques 3/2013
-                ng = LIM(epssq + 78.0f * SQR(vdif[indx >> 1]) + 69.0f * (SQR(vdif[(indx - v2) >> 1]) + SQR(vdif[(indx + v2) >> 1])) + 51.0f * (SQR(vdif[(indx - v4) >> 1]) + SQR(vdif[(indx + v4) >> 1])) + 21.0f * (SQR(vdif[(indx - v6) >> 1]) + SQR(vdif[(indx + v6) >> 1])) - 6.0f * SQR(vdif[(indx - v2) >> 1] + vdif[indx >> 1] + vdif[(indx + v2) >> 1])
-                         - 10.0f * (SQR(vdif[(indx - v4) >> 1] + vdif[(indx - v2) >> 1] + vdif[indx >> 1]) + SQR(vdif[indx >> 1] + vdif[(indx + v2) >> 1] + vdif[(indx + v4) >> 1])) - 7.0f * (SQR(vdif[(indx - v6) >> 1] + vdif[(indx - v4) >> 1] + vdif[(indx - v2) >> 1]) + SQR(vdif[(indx + v2) >> 1] + vdif[(indx + v4) >> 1] + vdif[(indx + v6) >> 1])), 0.f, 1.f);
-                eg = LIM(epssq + 78.0f * SQR(hdif[indx >> 1]) + 69.0f * (SQR(hdif[(indx - h2) >> 1]) + SQR(hdif[(indx + h2) >> 1])) + 51.0f * (SQR(hdif[(indx - h4) >> 1]) + SQR(hdif[(indx + h4) >> 1])) + 21.0f * (SQR(hdif[(indx - h6) >> 1]) + SQR(hdif[(indx + h6) >> 1])) - 6.0f * SQR(hdif[(indx - h2) >> 1] + hdif[indx >> 1] + hdif[(indx + h2) >> 1])
-                         - 10.0f * (SQR(hdif[(indx - h4) >> 1] + hdif[(indx - h2) >> 1] + hdif[indx >> 1]) + SQR(hdif[indx >> 1] + hdif[(indx + h2) >> 1] + hdif[(indx + h4) >> 1])) - 7.0f * (SQR(hdif[(indx - h6) >> 1] + hdif[(indx - h4) >> 1] + hdif[(indx - h2) >> 1]) + SQR(hdif[(indx + h2) >> 1] + hdif[(indx + h4) >> 1] + hdif[(indx + h6) >> 1])), 0.f, 1.f);
-                //Limit chrominance using H/V neighbourhood
-                nv = median(0.725f * vdif[indx >> 1] + 0.1375f * vdif[(indx - v2) >> 1] + 0.1375f * vdif[(indx + v2) >> 1], vdif[(indx - v2) >> 1], vdif[(indx + v2) >> 1]);
-                ev = median(0.725f * hdif[indx >> 1] + 0.1375f * hdif[(indx - h2) >> 1] + 0.1375f * hdif[(indx + h2) >> 1], hdif[(indx - h2) >> 1], hdif[(indx + h2) >> 1]);
-                //Chrominance estimation
-                chr[d][indx] = (eg * nv + ng * ev) / (ng + eg);
-                //Green channel population
-                rgb[1][indx] = rgb[c][indx] + 65535.f * chr[d][indx];
-            }
+                memset(rgbarray, 0, ts * ts * 3 * sizeof(float));
+                memset(chrarray, 0, ts * ts * 2 * sizeof(float));
+                memset(vdif, 0, ts * ts / 2 * sizeof * vdif);
+                memset(hdif, 0, ts * ts / 2 * sizeof * hdif);
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.39);
-            }
-        }
+                for (int row = 0; row < th - 0; row++)
+                    for (int col = 0, indx = row * tw + col; col < tw - 0; col++, indx++) {
+                        int c = FC(top + row, left + col);
+                        rgb[c][indx] = CLIP(rawData[top + row][left + col]); //rawData = RT data
+                    }
 
-//  free(vdif); free(hdif);
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                for (int row = 5; row < th - 5; row++)
+                    for (int col = 5 + (FC(top + row, left + 1) & 1), indx = row * tw + col, c = FC(top + row, left + col); col < tw - 5; col += 2, indx += 2) {
+                        //N,E,W,S Gradients
+                        ng = (eps + (fabsf(rgb[1][indx - v1] - rgb[1][indx - v3]) + fabsf(rgb[c][indx] - rgb[c][indx - v2])) / 65535.f);;
+                        eg = (eps + (fabsf(rgb[1][indx + h1] - rgb[1][indx + h3]) + fabsf(rgb[c][indx] - rgb[c][indx + h2])) / 65535.f);
+                        wg = (eps + (fabsf(rgb[1][indx - h1] - rgb[1][indx - h3]) + fabsf(rgb[c][indx] - rgb[c][indx - h2])) / 65535.f);
+                        sg = (eps + (fabsf(rgb[1][indx + v1] - rgb[1][indx + v3]) + fabsf(rgb[c][indx] - rgb[c][indx + v2])) / 65535.f);
+                        //N,E,W,S High Order Interpolation (Li & Randhawa)
+                        //N,E,W,S Hamilton Adams Interpolation
+                        // (48.f * 65535.f) = 3145680.f
+                        nv = LIM(((23.0f * rgb[1][indx - v1] + 23.0f * rgb[1][indx - v3] + rgb[1][indx - v5] + rgb[1][indx + v1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx - v2] - 8.0f * rgb[c][indx - v4])) / 3145680.f, 0.0f, 1.0f);
+                        ev = LIM(((23.0f * rgb[1][indx + h1] + 23.0f * rgb[1][indx + h3] + rgb[1][indx + h5] + rgb[1][indx - h1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx + h2] - 8.0f * rgb[c][indx + h4])) / 3145680.f, 0.0f, 1.0f);
+                        wv = LIM(((23.0f * rgb[1][indx - h1] + 23.0f * rgb[1][indx - h3] + rgb[1][indx - h5] + rgb[1][indx + h1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx - h2] - 8.0f * rgb[c][indx - h4])) / 3145680.f, 0.0f, 1.0f);
+                        sv = LIM(((23.0f * rgb[1][indx + v1] + 23.0f * rgb[1][indx + v3] + rgb[1][indx + v5] + rgb[1][indx - v1] + 40.0f * rgb[c][indx] - 32.0f * rgb[c][indx + v2] - 8.0f * rgb[c][indx + v4])) / 3145680.f, 0.0f, 1.0f);
+                        //Horizontal and vertical color differences
+                        vdif[indx >> 1] = (sg * nv + ng * sv) / (ng + sg) - (rgb[c][indx]) / 65535.f;
+                        hdif[indx >> 1] = (wg * ev + eg * wv) / (eg + wg) - (rgb[c][indx]) / 65535.f;
+                    }
 
-        for (int row = 7; row < height - 7; row += 2)
-            for (int col = 7 + (FC(row, 1) & 1), indx = row * width + col, c = 1 - FC(row, col) / 2; col < width - 7; col += 2, indx += 2) {
-                //NW,NE,SW,SE Gradients
-                nwg = 1.0f / (eps + fabsf(chr[c][indx - v1 - h1] - chr[c][indx - v3 - h3]) + fabsf(chr[c][indx + v1 + h1] - chr[c][indx - v3 - h3]));
-                neg = 1.0f / (eps + fabsf(chr[c][indx - v1 + h1] - chr[c][indx - v3 + h3]) + fabsf(chr[c][indx + v1 - h1] - chr[c][indx - v3 + h3]));
-                swg = 1.0f / (eps + fabsf(chr[c][indx + v1 - h1] - chr[c][indx + v3 + h3]) + fabsf(chr[c][indx - v1 + h1] - chr[c][indx + v3 - h3]));
-                seg = 1.0f / (eps + fabsf(chr[c][indx + v1 + h1] - chr[c][indx + v3 - h3]) + fabsf(chr[c][indx - v1 - h1] - chr[c][indx + v3 + h3]));
-                //Limit NW,NE,SW,SE Color differences
-                nwv = median(chr[c][indx - v1 - h1], chr[c][indx - v3 - h1], chr[c][indx - v1 - h3]);
-                nev = median(chr[c][indx - v1 + h1], chr[c][indx - v3 + h1], chr[c][indx - v1 + h3]);
-                swv = median(chr[c][indx + v1 - h1], chr[c][indx + v3 - h1], chr[c][indx + v1 - h3]);
-                sev = median(chr[c][indx + v1 + h1], chr[c][indx + v3 + h1], chr[c][indx + v1 + h3]);
-                //Interpolate chrominance: R@B and B@R
-                chr[c][indx] = (nwg * nwv + neg * nev + swg * swv + seg * sev) / (nwg + neg + swg + seg);
-            }
+                for (int row = 7; row < th - 7; row++)
+                    for (int col = 7 + (FC(top + row, left + 1) & 1), indx = row * tw + col, c = FC(top + row, left + col), d = c / 2; col < tw - 7; col += 2, indx += 2) {
+                        //H&V integrated gaussian vector over variance on color differences
+                        //Mod Jacques 3/2013
+                        ng = LIM(epssq + 78.0f * SQR(vdif[indx >> 1]) + 69.0f * (SQR(vdif[(indx - v2) >> 1]) + SQR(vdif[(indx + v2) >> 1])) + 51.0f * (SQR(vdif[(indx - v4) >> 1]) + SQR(vdif[(indx + v4) >> 1])) + 21.0f * (SQR(vdif[(indx - v6) >> 1]) + SQR(vdif[(indx + v6) >> 1])) - 6.0f * SQR(vdif[(indx - v2) >> 1] + vdif[indx >> 1] + vdif[(indx + v2) >> 1])
+                                 - 10.0f * (SQR(vdif[(indx - v4) >> 1] + vdif[(indx - v2) >> 1] + vdif[indx >> 1]) + SQR(vdif[indx >> 1] + vdif[(indx + v2) >> 1] + vdif[(indx + v4) >> 1])) - 7.0f * (SQR(vdif[(indx - v6) >> 1] + vdif[(indx - v4) >> 1] + vdif[(indx - v2) >> 1]) + SQR(vdif[(indx + v2) >> 1] + vdif[(indx + v4) >> 1] + vdif[(indx + v6) >> 1])), 0.f, 1.f);
+                        eg = LIM(epssq + 78.0f * SQR(hdif[indx >> 1]) + 69.0f * (SQR(hdif[(indx - h2) >> 1]) + SQR(hdif[(indx + h2) >> 1])) + 51.0f * (SQR(hdif[(indx - h4) >> 1]) + SQR(hdif[(indx + h4) >> 1])) + 21.0f * (SQR(hdif[(indx - h6) >> 1]) + SQR(hdif[(indx + h6) >> 1])) - 6.0f * SQR(hdif[(indx - h2) >> 1] + hdif[indx >> 1] + hdif[(indx + h2) >> 1])
+                                 - 10.0f * (SQR(hdif[(indx - h4) >> 1] + hdif[(indx - h2) >> 1] + hdif[indx >> 1]) + SQR(hdif[indx >> 1] + hdif[(indx + h2) >> 1] + hdif[(indx + h4) >> 1])) - 7.0f * (SQR(hdif[(indx - h6) >> 1] + hdif[(indx - h4) >> 1] + hdif[(indx - h2) >> 1]) + SQR(hdif[(indx + h2) >> 1] + hdif[(indx + h4) >> 1] + hdif[(indx + h6) >> 1])), 0.f, 1.f);
+                        //Limit chrominance using H/V neighbourhood
+                        nv = median(0.725f * vdif[indx >> 1] + 0.1375f * vdif[(indx - v2) >> 1] + 0.1375f * vdif[(indx + v2) >> 1], vdif[(indx - v2) >> 1], vdif[(indx + v2) >> 1]);
+                        ev = median(0.725f * hdif[indx >> 1] + 0.1375f * hdif[(indx - h2) >> 1] + 0.1375f * hdif[(indx + h2) >> 1], hdif[(indx - h2) >> 1], hdif[(indx + h2) >> 1]);
+                        //Chrominance estimation
+                        chr[d][indx] = (eg * nv + ng * ev) / (ng + eg);
+                        //Green channel population
+                        rgb[1][indx] = rgb[c][indx] + 65535.f * chr[d][indx];
+                    }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.52);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                for (int row = 7; row < th - 7; row++)
+                    for (int col = 7 + (FC(top + row, left + 1) & 1), indx = row * tw + col, c = 1 - FC(top + row, left + col) / 2; col < tw - 7; col += 2, indx += 2) {
+                        //NW,NE,SW,SE Gradients
+                        nwg = 1.0f / (eps + fabsf(chr[c][indx - v1 - h1] - chr[c][indx - v3 - h3]) + fabsf(chr[c][indx + v1 + h1] - chr[c][indx - v3 - h3]));
+                        neg = 1.0f / (eps + fabsf(chr[c][indx - v1 + h1] - chr[c][indx - v3 + h3]) + fabsf(chr[c][indx + v1 - h1] - chr[c][indx - v3 + h3]));
+                        swg = 1.0f / (eps + fabsf(chr[c][indx + v1 - h1] - chr[c][indx + v3 + h3]) + fabsf(chr[c][indx - v1 + h1] - chr[c][indx + v3 - h3]));
+                        seg = 1.0f / (eps + fabsf(chr[c][indx + v1 + h1] - chr[c][indx + v3 - h3]) + fabsf(chr[c][indx - v1 - h1] - chr[c][indx + v3 + h3]));
+                        //Limit NW,NE,SW,SE Color differences
+                        nwv = median(chr[c][indx - v1 - h1], chr[c][indx - v3 - h1], chr[c][indx - v1 - h3]);
+                        nev = median(chr[c][indx - v1 + h1], chr[c][indx - v3 + h1], chr[c][indx - v1 + h3]);
+                        swv = median(chr[c][indx + v1 - h1], chr[c][indx + v3 - h1], chr[c][indx + v1 - h3]);
+                        sev = median(chr[c][indx + v1 + h1], chr[c][indx + v3 + h1], chr[c][indx + v1 + h3]);
+                        //Interpolate chrominance: R@B and B@R
+                        chr[c][indx] = (nwg * nwv + neg * nev + swg * swv + seg * sev) / (nwg + neg + swg + seg);
+                    }
 
-        for (int row = 8; row < height - 7; row += 2)
-            for (int col = 7 + (FC(row, 1) & 1), indx = row * width + col, c = 1 - FC(row, col) / 2; col < width - 7; col += 2, indx += 2) {
-                //NW,NE,SW,SE Gradients
-                nwg = 1.0f / (eps + fabsf(chr[c][indx - v1 - h1] - chr[c][indx - v3 - h3]) + fabsf(chr[c][indx + v1 + h1] - chr[c][indx - v3 - h3]));
-                neg = 1.0f / (eps + fabsf(chr[c][indx - v1 + h1] - chr[c][indx - v3 + h3]) + fabsf(chr[c][indx + v1 - h1] - chr[c][indx - v3 + h3]));
-                swg = 1.0f / (eps + fabsf(chr[c][indx + v1 - h1] - chr[c][indx + v3 + h3]) + fabsf(chr[c][indx - v1 + h1] - chr[c][indx + v3 - h3]));
-                seg = 1.0f / (eps + fabsf(chr[c][indx + v1 + h1] - chr[c][indx + v3 - h3]) + fabsf(chr[c][indx - v1 - h1] - chr[c][indx + v3 + h3]));
-                //Limit NW,NE,SW,SE Color differences
-                nwv = median(chr[c][indx - v1 - h1], chr[c][indx - v3 - h1], chr[c][indx - v1 - h3]);
-                nev = median(chr[c][indx - v1 + h1], chr[c][indx - v3 + h1], chr[c][indx - v1 + h3]);
-                swv = median(chr[c][indx + v1 - h1], chr[c][indx + v3 - h1], chr[c][indx + v1 - h3]);
-                sev = median(chr[c][indx + v1 + h1], chr[c][indx + v3 + h1], chr[c][indx + v1 + h3]);
-                //Interpolate chrominance: R@B and B@R
-                chr[c][indx] = (nwg * nwv + neg * nev + swg * swv + seg * sev) / (nwg + neg + swg + seg);
-            }
+                for (int row = 7; row < th - 7; row++)
+                    for (int col = 7 + (FC(top + row, left) & 1), indx = row * tw + col; col < tw - 7; col += 2, indx += 2) {
+                        //N,E,W,S Gradients
+                        ng = 1.0f / (eps + fabsf(chr[0][indx - v1] - chr[0][indx - v3]) + fabsf(chr[0][indx + v1] - chr[0][indx - v3]));
+                        eg = 1.0f / (eps + fabsf(chr[0][indx + h1] - chr[0][indx + h3]) + fabsf(chr[0][indx - h1] - chr[0][indx + h3]));
+                        wg = 1.0f / (eps + fabsf(chr[0][indx - h1] - chr[0][indx - h3]) + fabsf(chr[0][indx + h1] - chr[0][indx - h3]));
+                        sg = 1.0f / (eps + fabsf(chr[0][indx + v1] - chr[0][indx + v3]) + fabsf(chr[0][indx - v1] - chr[0][indx + v3]));
+                        //Interpolate chrominance: R@G and B@G
+                        chr[0][indx] = ((ng * chr[0][indx - v1] + eg * chr[0][indx + h1] + wg * chr[0][indx - h1] + sg * chr[0][indx + v1]) / (ng + eg + wg + sg));
+                    }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.65);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                for (int row = 7; row < th - 7; row++)
+                    for (int col = 7 + (FC(top + row, left) & 1), indx = row * tw + col; col < tw - 7; col += 2, indx += 2) {
 
-        for (int row = 7; row < height - 7; row++)
-            for (int col = 7 + (FC(row, 0) & 1), indx = row * width + col; col < width - 7; col += 2, indx += 2) {
-                //N,E,W,S Gradients
-                ng = 1.0f / (eps + fabsf(chr[0][indx - v1] - chr[0][indx - v3]) + fabsf(chr[0][indx + v1] - chr[0][indx - v3]));
-                eg = 1.0f / (eps + fabsf(chr[0][indx + h1] - chr[0][indx + h3]) + fabsf(chr[0][indx - h1] - chr[0][indx + h3]));
-                wg = 1.0f / (eps + fabsf(chr[0][indx - h1] - chr[0][indx - h3]) + fabsf(chr[0][indx + h1] - chr[0][indx - h3]));
-                sg = 1.0f / (eps + fabsf(chr[0][indx + v1] - chr[0][indx + v3]) + fabsf(chr[0][indx - v1] - chr[0][indx + v3]));
-                //Interpolate chrominance: R@G and B@G
-                chr[0][indx] = ((ng * chr[0][indx - v1] + eg * chr[0][indx + h1] + wg * chr[0][indx - h1] + sg * chr[0][indx + v1]) / (ng + eg + wg + sg));
-            }
+                        //N,E,W,S Gradients
+                        ng = 1.0f / (eps + fabsf(chr[1][indx - v1] - chr[1][indx - v3]) + fabsf(chr[1][indx + v1] - chr[1][indx - v3]));
+                        eg = 1.0f / (eps + fabsf(chr[1][indx + h1] - chr[1][indx + h3]) + fabsf(chr[1][indx - h1] - chr[1][indx + h3]));
+                        wg = 1.0f / (eps + fabsf(chr[1][indx - h1] - chr[1][indx - h3]) + fabsf(chr[1][indx + h1] - chr[1][indx - h3]));
+                        sg = 1.0f / (eps + fabsf(chr[1][indx + v1] - chr[1][indx + v3]) + fabsf(chr[1][indx - v1] - chr[1][indx + v3]));
+                        //Interpolate chrominance: R@G and B@G
+                        chr[1][indx] = ((ng * chr[1][indx - v1] + eg * chr[1][indx + h1] + wg * chr[1][indx - h1] + sg * chr[1][indx + v1]) / (ng + eg + wg + sg));
+                    }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.78);
-            }
-        }
-#ifdef _OPENMP
-        #pragma omp for
-#endif
+                // copy the inner part of the tile to the output
+                const int rowEnd = std::min(tr * tsCore + tsCore - top, th - 7);
+                const int colStart = std::max(tc * tsCore - left, 7);
+                const int colEnd = std::min(tc * tsCore + tsCore - left, tw - 7);
 
-        for (int row = 7; row < height - 7; row++)
-            for (int col = 7 + (FC(row, 0) & 1), indx = row * width + col; col < width - 7; col += 2, indx += 2) {
+                for(int row = std::max(tr * tsCore - top, 7); row < rowEnd; row++)
+                    for(int col = colStart, indx = row * tw + col; col < colEnd; col++, indx++) {
+                        red  [top + row][left + col] = CLIP(rgb[1][indx] - 65535.f * chr[0][indx]);
+                        green[top + row][left + col] = CLIP(rgb[1][indx]);
+                        blue [top + row][left + col] = CLIP(rgb[1][indx] - 65535.f * chr[1][indx]);
+                    }
 
-                //N,E,W,S Gradients
-                ng = 1.0f / (eps + fabsf(chr[1][indx - v1] - chr[1][indx - v3]) + fabsf(chr[1][indx + v1] - chr[1][indx - v3]));
-                eg = 1.0f / (eps + fabsf(chr[1][indx + h1] - chr[1][indx + h3]) + fabsf(chr[1][indx - h1] - chr[1][indx + h3]));
-                wg = 1.0f / (eps + fabsf(chr[1][indx - h1] - chr[1][indx - h3]) + fabsf(chr[1][indx + h1] - chr[1][indx - h3]));
-                sg = 1.0f / (eps + fabsf(chr[1][indx + v1] - chr[1][indx + v3]) + fabsf(chr[1][indx - v1] - chr[1][indx + v3]));
-                //Interpolate chrominance: R@G and B@G
-                chr[1][indx] = ((ng * chr[1][indx - v1] + eg * chr[1][indx + h1] + wg * chr[1][indx - h1] + sg * chr[1][indx + v1]) / (ng + eg + wg + sg));
-            }
+                if(plistener) {
+                    progresscounter++;
 
+                    if(progresscounter % 16 == 0) {
 #ifdef _OPENMP
-        #pragma omp single
+                        #pragma omp critical (igvprogress)
 #endif
-        {
-            if (plistener) {
-                plistener->setProgress (0.91);
+                        {
+                            progress += (double)16 * (tsCore * tsCore) / (height * width);
+                            progress = progress > 1.0 ? 1.0 : progress;
+                            plistener->setProgress(progress);
+                        }
+                    }
+                }
             }
-
-            //Interpolate borders
-//  border_interpolate2(7, rgb);
         }
-        /*
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-            for (int row=0; row < height; row++)  //borders
-                for (int col=0; col < width; col++) {
-                    if (col==7 && row >= 7 && row < height-7)
-                        col = width-7;
-                    int indxc=row*width+col;
-                    red  [row][col] = rgb[indxc][0];
-                    green[row][col] = rgb[indxc][1];
-                    blue [row][col] = rgb[indxc][2];
-                }
-        */
 
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-
-        for(int row = 7; row < height - 7; row++)
-            for(int col = 7, indx = row * width + col; col < width - 7; col++, indx++) {
-                red  [row][col] = CLIP(rgb[1][indx] - 65535.f * chr[0][indx]);
-                green[row][col] = CLIP(rgb[1][indx]);
-                blue [row][col] = CLIP(rgb[1][indx] - 65535.f * chr[1][indx]);
-            }
+        free(chrarray);
+        free(rgbarray);
+        free(vdif);
+        free(hdif);
     }// End of parallelization
     border_interpolate2(winw, winh, 8, rawData, red, green, blue);
 
@@ -1776,11 +1581,6 @@ void RawImageSource::igv_interpolate(int winw, int winh)
     if (plistener) {
         plistener->setProgress (1.0);
     }
-
-    free(chrarray);
-    free(rgbarray);
-    free(vdif);
-    free(hdif);
 }
 #endif
 
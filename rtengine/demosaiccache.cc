@@ -0,0 +1,281 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <glibmm.h>
+
+#include "demosaiccache.h"
+
+#include "cpufeatures.h"
+#include "procparams.h"
+#include "settings.h"
+#include "utils.h"
+
+#include "../rtgui/version.h"
+
+namespace
+{
+
+constexpr char cacheMagic[4] = {'R', 'T', 'D', 'C'};
+constexpr std::uint32_t cacheVersion = 2; // part of the key too, bump it when a change alters the output of demosaic or preprocessing
+
+struct CacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    double contrastThreshold;
+};
+
+}
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+DemosaicCache& DemosaicCache::getInstance()
+{
+    static DemosaicCache instance;
+    return instance;
+}
+
+std::string DemosaicCache::getFileId(const Glib::ustring& filename)
+{
+    GStatBuf st;
+
+    if (g_stat(filename.c_str(), &st) != 0) {
+        return {};
+    }
+
+    std::ostringstream id;
+    id << filename << ' ' << st.st_size << ' ' << st.st_mtime;
+    return id.str();
+}
+
+std::string DemosaicCache::getCodeId()
+{
+    std::ostringstream id;
+    id << RTVERSION << ' ' << cacheVersion << ' ' << (usesAvx2Clones() ? "avx2" : "generic");
+    return id.str();
+}
+
+std::string DemosaicCache::getRawParamsKey(const procparams::RAWParams& raw)
+{
+    const auto& bayer = raw.bayersensor;
+    const auto& xtrans = raw.xtranssensor;
+
+    std::ostringstream key;
+    key << std::setprecision(10)
+        << bayer.method << ' ' << bayer.border << ' ' << bayer.imageNum << ' ' << bayer.ccSteps << ' '
+        << bayer.black0 << ' ' << bayer.black1 << ' ' << bayer.black2 << ' ' << bayer.black3 << ' ' << bayer.twogreen << ' '
+        << bayer.linenoise << ' ' << static_cast<int>(bayer.linenoiseDirection) << ' ' << bayer.greenthresh << ' '
+        << bayer.dcb_iterations << ' ' << bayer.dcb_enhance << ' ' << bayer.lmmse_iterations << ' '
+        << bayer.dualDemosaicAutoContrast << ' ' << bayer.dualDemosaicContrast << ' '
+        << static_cast<int>(bayer.pixelShiftMotionCorrectionMethod) << ' ' << bayer.pixelShiftEperIso << ' ' << bayer.pixelShiftSigma << ' '
+        << bayer.pixelShiftShowMotion << ' ' << bayer.pixelShiftShowMotionMaskOnly << ' ' << bayer.pixelShiftHoleFill << ' '
+        << bayer.pixelShiftMedian << ' ' << bayer.pixelShiftGreen << ' ' << bayer.pixelShiftBlur << ' ' << bayer.pixelShiftSmoothFactor << ' '
+        << bayer.pixelShiftEqualBright << ' ' << bayer.pixelShiftEqualBrightChannel << ' ' << bayer.pixelShiftNonGreenCross << ' '
+        << bayer.pixelShiftDemosaicMethod << ' ' << bayer.pdafLinesFilter << '|'
+        << xtrans.method << ' ' << xtrans.dualDemosaicAutoContrast << ' ' << xtrans.dualDemosaicContrast << ' ' << xtrans.border << ' '
+        << xtrans.ccSteps << ' ' << xtrans.blackred << ' ' << xtrans.blackgreen << ' ' << xtrans.blackblue << '|'
+        << raw.dark_frame << ' ' << raw.df_autoselect << ' ' << raw.ff_file << ' ' << raw.ff_AutoSelect << ' '
+        << raw.ff_BlurRadius << ' ' << raw.ff_BlurType << ' ' << raw.ff_AutoClipControl << ' ' << raw.ff_clipControl << ' '
+        << raw.ca_autocorrect << ' ' << raw.ca_avoidcolourshift << ' ' << raw.caautoiterations << ' ' << settings->caAutoConvergence << ' ' << raw.cared << ' ' << raw.cablue << ' '
+        << raw.expos << ' ' << raw.hotPixelFilter << ' ' << raw.deadPixelFilter << ' ' << raw.hotdeadpix_thresh;
+    return key.str();
+}
+
+bool DemosaicCache::isWorthCaching(eSensorType sensorType, const procparams::RAWParams& raw)
+{
+    if (sensorType == ST_BAYER) {
+        using Bayer = procparams::RAWParams::BayerSensor;
+        const Glib::ustring& method = raw.bayersensor.method;
+        return method != Bayer::getMethodString(Bayer::Method::FAST)
+               && method != Bayer::getMethodString(Bayer::Method::MONO)
+               && method != Bayer::getMethodString(Bayer::Method::NONE);
+    } else if (sensorType == ST_FUJI_XTRANS) {
+        using XTrans = procparams::RAWParams::XTransSensor;
+        const Glib::ustring& method = raw.xtranssensor.method;
+        return method != XTrans::getMethodString(XTrans::Method::FAST)
+               && method != XTrans::getMethodString(XTrans::Method::MONO)
+               && method != XTrans::getMethodString(XTrans::Method::NONE);
+    }
+
+    return false;
+}
+
+bool DemosaicCache::load(const std::string& key, int W, int H, array2D<float>& red, array2D<float>& green, array2D<float>& blue, double& contrastThreshold)
+{
+    // store() prunes entries, don't let it remove the one we are reading nor let us remove one it just renamed
+    MyMutex::MyLock lock(mutex);
+
+    const Glib::ustring filename = getFilename(key);
+    FILE* const f = g_fopen(filename.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    CacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1
+              && !std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic))
+              && header.version == cacheVersion
+              && header.width == W
+              && header.height == H;
+
+    if (ok) {
+        if (red.width() != W || red.height() != H) {
+            red(W, H);
+        }
+
+        if (green.width() != W || green.height() != H) {
+            green(W, H);
+        }
+
+        if (blue.width() != W || blue.height() != H) {
+            blue(W, H);
+        }
+
+        for (array2D<float>* plane : {&red, &green, &blue}) {
+            for (int i = 0; ok && i < H; ++i) {
+                ok = fread((*plane)[i], sizeof(float), W, f) == static_cast<std::size_t>(W);
+            }
+        }
+    }
+
+    fclose(f);
+
+    if (!ok) {
+        g_remove(filename.c_str());
+        return false;
+    }
+
+    contrastThreshold = header.contrastThreshold;
+    // the modification time is used as last access time when pruning
+    g_utime(filename.c_str(), nullptr);
+
+    if (settings->verbose) {
+        std::cout << "Demosaic cache hit: " << filename << std::endl;
+    }
+
+    return true;
+}
+
+void DemosaicCache::store(const std::string& key, int W, int H, const array2D<float>& red, const array2D<float>& green, const array2D<float>& blue, double contrastThreshold)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (g_mkdir_with_parents(settings->demosaicCacheDir.c_str(), 0755) != 0) {
+        return;
+    }
+
+    const Glib::ustring filename = getFilename(key);
+    const Glib::ustring tmpFilename = Glib::ustring::compose("%1.%2.tmp", filename, g_get_real_time());
+    FILE* const f = g_fopen(tmpFilename.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.width = W;
+    header.height = H;
+    header.contrastThreshold = contrastThreshold;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    for (const array2D<float>* plane : {&red, &green, &blue}) {
+        for (int i = 0; ok && i < H; ++i) {
+            ok = fwrite((*plane)[i], sizeof(float), W, f) == static_cast<std::size_t>(W);
+        }
+    }
+
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || g_rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        g_remove(tmpFilename.c_str());
+        return;
+    }
+
+    prune();
+}
+
+Glib::ustring DemosaicCache::getFilename(const std::string& key) const
+{
+    return Glib::build_filename(settings->demosaicCacheDir, key + ".rtdc");
+}
+
+void DemosaicCache::prune()
+{
+    struct Entry {
+        std::string filename;
+        gint64 size;
+        gint64 time;
+    };
+
+    std::vector<Entry> entries;
+    gint64 totalSize = 0;
+
+    try {
+        Glib::Dir dir(settings->demosaicCacheDir);
+
+        for (const auto& name : dir) {
+            const std::string filename = Glib::build_filename(settings->demosaicCacheDir, name);
+            GStatBuf st;
+
+            if (getFileExtension(name) == "rtdc" && g_stat(filename.c_str(), &st) == 0) {
+                entries.push_back({filename, st.st_size, st.st_mtime});
+                totalSize += st.st_size;
+            }
+        }
+    } catch (Glib::FileError&) {
+        return;
+    }
+
+    const gint64 maxSize = static_cast<gint64>(settings->demosaicCacheSize) << 20;
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+    });
+
+    for (const auto& entry : entries) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+
+        if (g_remove(entry.filename.c_str()) == 0) {
+            totalSize -= entry.size;
+        }
+    }
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+
+#include <glibmm/ustring.h>
+
+#include "array2D.h"
+#include "imageformat.h"
+#include "noncopyable.h"
+
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+namespace procparams
+{
+
+struct RAWParams;
+
+}
+
+/*
+ * On-disk cache of demosaiced RGB planes, stored as floats in settings->demosaicCacheDir, so a cache hit
+ * gives exactly the same data as running demosaic. Half floats would halve the size of an entry, but their
+ * 11 bit mantissa can't hold the 16 bit range of the demosaiced values, and the difference shows up in the
+ * shadows as soon as exposure is raised. Entries are identified by an MD5 key which has to cover everything
+ * demosaic output depends on: the code version and path, the raw file, the frame, the dark frame and flat
+ * field in use and the raw parameters.
+ */
+class DemosaicCache final :
+    public NonCopyable
+{
+public:
+    static DemosaicCache& getInstance();
+
+    // Identifies a raw file by name, size and modification time. Hashing the contents would also catch a file
+    // rewritten in place with its size and time kept, but it means reading the whole raw for every lookup,
+    // which costs a good part of what a hit saves, and the calibration cache uses the same id for every dark
+    // frame and flat field candidate. Tools which restore the modification time after editing a raw are rare
+    // enough to accept that.
+    static std::string getFileId(const Glib::ustring& filename);
+    // RawTherapee version, cache format and the instruction set of the dispatched kernels
+    static std::string getCodeId();
+    // all raw parameters as text, to be part of a cache key
+    static std::string getRawParamsKey(const procparams::RAWParams& raw);
+    // false for the methods which are cheaper than reading a cache entry
+    static bool isWorthCaching(eSensorType sensorType, const procparams::RAWParams& raw);
+
+    bool load(const std::string& key, int W, int H, array2D<float>& red, array2D<float>& green, array2D<float>& blue, double& contrastThreshold);
+    void store(const std::string& key, int W, int H, const array2D<float>& red, const array2D<float>& green, const array2D<float>& blue, double contrastThreshold);
+
+private:
+    DemosaicCache() = default;
+
+    Glib::ustring getFilename(const std::string& key) const;
+    void prune();
+
+    MyMutex mutex;
+};
+
+}
@@ -17,10 +17,12 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "dfmanager.h"
+#include "calibrationcache.h"
 #include "../rtgui/options.h"
 #include <giomm.h>
 #include "../rtgui/guiutils.h"
 #include "rawimage.h"
+#include <set>
 #include <sstream>
 #include <iostream>
 #include <cstdio>
@@ -48,6 +50,9 @@ inline dfInfo& dfInfo::operator =(const dfInfo &o)
             delete ri;
             ri = nullptr;
         }
+
+        badPixels.clear();
+        badPixelsValid = false;
     }
 
     return *this;
@@ -105,23 +110,46 @@ double dfInfo::distance(const std::string &mak, const std::string &mod, int iso,
     return sqrt( dISO * dISO +  dShutter * dShutter);
 }
 
+std::string dfInfo::getCacheKey() const
+{
+    return CalibrationCache::getFrameKey("df", pathNames.empty() ? std::list<Glib::ustring>{pathname} : pathNames);
+}
+
 RawImage* dfInfo::getRawImage()
 {
     if(ri) {
         return ri;
     }
 
+    const std::string cacheKey = getCacheKey();
+    ri = CalibrationCache::getInstance().loadFrame(cacheKey, pathNames.empty() ? pathname : pathNames.front(), badPixelsValid ? nullptr : &badPixels);
+
+    if (ri) {
+        badPixelsValid = true;
+        return ri;
+    }
+
     updateRawImage();
-    updateBadPixelList( ri );
+
+    if (ri && !badPixelsValid) {
+        updateBadPixelList( ri );
+        badPixelsValid = true;
+    }
+
+    CalibrationCache::getInstance().storeFrame(cacheKey, ri, &badPixels);
 
     return ri;
 }
 
 std::vector<badPix>& dfInfo::getHotPixels()
 {
-    if( !ri ) {
-        updateRawImage();
-        updateBadPixelList( ri );
+    if (!badPixelsValid) {
+        // the hot pixels are cached with the master frame, but can be read without loading it
+        badPixelsValid = CalibrationCache::getInstance().loadHotPixels(getCacheKey(), badPixels);
+
+        if (!badPixelsValid) {
+            getRawImage();
+        }
     }
 
     return badPixels;
@@ -272,6 +300,8 @@ void dfInfo::updateBadPixelList( RawImage *df )
 
 void DFManager::init(const Glib::ustring& pathname)
 {
+    MyMutex::MyLock lock(mutex);
+
     if (pathname.empty()) {
         return;
     }
@@ -337,6 +367,16 @@ void DFManager::init(const Glib::ustring& pathname)
         }
     }
 
+    // drop the cached master frames which don't belong to the current templates anymore
+    std::set<std::string> cacheKeys;
+
+    for (const auto& entry : dfList) {
+        cacheKeys.insert(entry.second.getCacheKey());
+    }
+
+    CalibrationCache::getInstance().prune("df", cacheKeys);
+    CalibrationCache::getInstance().storeShotInfo();
+
     currentPath = pathname;
     return;
 }
@@ -371,10 +411,9 @@ dfInfo* DFManager::addFileInfo (const Glib::ustring& filename, bool pool)
             return nullptr;
         }
 
-        RawImage ri(filename);
-        int res = ri.loadRaw(false); // Read information about shot
+        const CalibrationCache::ShotInfo shot = CalibrationCache::getInstance().getShotInfo(filename); // Read information about shot
 
-        if (res != 0) {
+        if (!shot.valid) {
             return nullptr;
         }
 
@@ -386,23 +425,24 @@ dfInfo* DFManager::addFileInfo (const Glib::ustring& filename, bool pool)
             return &(iter->second);
         }
 
-        FramesData idata(filename, std::unique_ptr<RawMetaDataLocation>(new RawMetaDataLocation(ri.get_exifBase(), ri.get_ciffBase(), ri.get_ciffLen())), true);
+        const std::string maker = Glib::ustring(shot.maker).uppercase();
+        const std::string model = Glib::ustring(shot.model).uppercase();
         /* Files are added in the map, divided by same maker/model,ISO and shutter*/
-        std::string key(dfInfo::key(((Glib::ustring)idata.getMake()).uppercase(), ((Glib::ustring)idata.getModel()).uppercase(), idata.getISOSpeed(), idata.getShutterSpeed()));
+        std::string key(dfInfo::key(maker, model, shot.iso, shot.shutter));
         iter = dfList.find(key);
 
         if(iter == dfList.end()) {
-            dfInfo n(filename, ((Glib::ustring)idata.getMake()).uppercase(), ((Glib::ustring)idata.getModel()).uppercase(), idata.getISOSpeed(), idata.getShutterSpeed(), idata.getDateTimeAsTS());
+            dfInfo n(filename, maker, model, shot.iso, shot.shutter, shot.timestamp);
             iter = dfList.emplace(key, n);
         } else {
-            while(iter != dfList.end() && iter->second.key() == key && ABS(iter->second.timestamp - idata.getDateTimeAsTS()) > 60 * 60 * 6) { // 6 hour difference
+            while(iter != dfList.end() && iter->second.key() == key && ABS(iter->second.timestamp - shot.timestamp) > 60 * 60 * 6) { // 6 hour difference
                 ++iter;
             }
 
             if(iter != dfList.end()) {
                 iter->second.pathNames.push_back(filename);
             } else {
-                dfInfo n(filename, ((Glib::ustring)idata.getMake()).uppercase(), ((Glib::ustring)idata.getModel()).uppercase(), idata.getISOSpeed(), idata.getShutterSpeed(), idata.getDateTimeAsTS());
+                dfInfo n(filename, maker, model, shot.iso, shot.shutter, shot.timestamp);
                 iter = dfList.emplace(key, n);
             }
         }
@@ -416,6 +456,8 @@ dfInfo* DFManager::addFileInfo (const Glib::ustring& filename, bool pool)
 
 void DFManager::getStat( int &totFiles, int &totTemplates)
 {
+    MyMutex::MyLock lock(mutex);
+
     totFiles = 0;
     totTemplates = 0;
 
@@ -478,6 +520,8 @@ dfInfo* DFManager::find( const std::string &mak, const std::string &mod, int iso
 
 RawImage* DFManager::searchDarkFrame( const std::string &mak, const std::string &mod, int iso, double shut, time_t t )
 {
+    MyMutex::MyLock lock(mutex);
+
     dfInfo *df = find( ((Glib::ustring)mak).uppercase(), ((Glib::ustring)mod).uppercase(), iso, shut, t );
 
     if( df ) {
@@ -489,6 +533,8 @@ RawImage* DFManager::searchDarkFrame( const std::string &mak, const std::string
 
 RawImage* DFManager::searchDarkFrame( const Glib::ustring filename )
 {
+    MyMutex::MyLock lock(mutex);
+
     for ( dfList_t::iterator iter = dfList.begin(); iter != dfList.end(); ++iter ) {
         if( iter->second.pathname.compare( filename ) == 0  ) {
             return iter->second.getRawImage();
@@ -505,6 +551,8 @@ RawImage* DFManager::searchDarkFrame( const Glib::ustring filename )
 }
 std::vector<badPix> *DFManager::getHotPixels ( const Glib::ustring filename )
 {
+    MyMutex::MyLock lock(mutex);
+
     for ( dfList_t::iterator iter = dfList.begin(); iter != dfList.end(); ++iter ) {
         if( iter->second.pathname.compare( filename ) == 0  ) {
             return &iter->second.getHotPixels();
@@ -515,6 +563,8 @@ std::vector<badPix> *DFManager::getHotPixels ( const Glib::ustring filename )
 }
 std::vector<badPix> *DFManager::getHotPixels ( const std::string &mak, const std::string &mod, int iso, double shut, time_t t )
 {
+    MyMutex::MyLock lock(mutex);
+
     dfInfo *df = find( ((Glib::ustring)mak).uppercase(), ((Glib::ustring)mod).uppercase(), iso, shut, t );
 
     if( df ) {
@@ -588,6 +638,8 @@ int DFManager::scanBadPixelsFile( Glib::ustring filename )
 
 std::vector<badPix> *DFManager::getBadPixels ( const std::string &mak, const std::string &mod, const std::string &serial)
 {
+    MyMutex::MyLock lock(mutex);
+
     bpList_t::iterator iter;
     bool found = false;
 
@@ -27,6 +27,8 @@
 #include "pixelsmap.h"
 #include "rawimage.h"
 
+#include "../rtgui/threadutils.h"
+
 namespace rtengine
 {
 
@@ -44,10 +46,10 @@ public:
 
 
     dfInfo(const Glib::ustring &name, const std::string &mak, const std::string &mod, int iso, double shut, time_t t)
-        : pathname(name), maker(mak), model(mod), iso(iso), shutter(shut), timestamp(t), ri(nullptr) {}
+        : pathname(name), maker(mak), model(mod), iso(iso), shutter(shut), timestamp(t), ri(nullptr), badPixelsValid(false) {}
 
     dfInfo( const dfInfo &o)
-        : pathname(o.pathname), maker(o.maker), model(o.model), iso(o.iso), shutter(o.shutter), timestamp(o.timestamp), ri(nullptr) {}
+        : pathname(o.pathname), maker(o.maker), model(o.model), iso(o.iso), shutter(o.shutter), timestamp(o.timestamp), ri(nullptr), badPixelsValid(false) {}
     ~dfInfo()
     {
         if( ri ) {
@@ -70,10 +72,12 @@ public:
 
     RawImage *getRawImage();
     std::vector<badPix> &getHotPixels();
+    std::string getCacheKey() const; ///< key of the master frame in the calibration cache
 
 protected:
     RawImage *ri; ///< Dark Frame raw data
     std::vector<badPix> badPixels; ///< Extracted hot pixels
+    bool badPixelsValid; ///< badPixels has been extracted or loaded from the calibration cache
 
     void updateBadPixelList( RawImage *df );
     void updateRawImage();
@@ -85,6 +89,7 @@ public:
     void init(const Glib::ustring &pathname);
     Glib::ustring getPathname()
     {
+        MyMutex::MyLock lock(mutex);
         return currentPath;
     };
     void getStat( int &totFiles, int &totTemplate);
@@ -99,6 +104,7 @@ protected:
     typedef std::map<std::string, std::vector<badPix> > bpList_t;
     dfList_t dfList;
     bpList_t bpList;
+    MyMutex mutex; ///< protects the lists and the loading of the frames, as images are processed concurrently
     bool initialized;
     Glib::ustring currentPath;
     dfInfo *addFileInfo(const Glib::ustring &filename, bool pool = true );
@@ -31,12 +31,21 @@
 //#define BENCHMARK
 #include "StopWatch.h"
 #include "rt_algo.h"
+#include "settings.h"
 
 using namespace std;
 
 namespace rtengine
 {
 
+extern const Settings* settings;
+
+namespace
+{
+// blend factors below this value use only the fast demosaicer in fast dual demosaic mode
+constexpr float fastDualDemosaicThreshold = 1.f / 256.f;
+}
+
 void RawImageSource::dual_demosaic_RT(bool isBayer, const RAWParams &raw, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, double &contrast, bool autoContrast)
 {
     BENCHFUN
@@ -67,56 +76,92 @@ void RawImageSource::dual_demosaic_RT(bool isBayer, const RAWParams &raw, int wi
     array2D<float> blueTmp(winw, winh);
     array2D<float> L(winw, winh);
 
+    const float xyz_rgb[3][3] = {          // XYZ from RGB
+                                { 0.412453, 0.357580, 0.180423 },
+                                { 0.212671, 0.715160, 0.072169 },
+                                { 0.019334, 0.119193, 0.950227 }
+                                };
+
+    JaggedArray<float> blend(winw, winh);
+    float contrastf = contrast / 100.f;
+
+    // calculate contrast based blend factors to use vng4 in regions with low contrast
+    const auto calcBlendMask = [&](const array2D<float> &r, const array2D<float> &g, const array2D<float> &b) {
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for(int i = 0; i < winh; ++i) {
+            Color::RGB2L(r[i], g[i], b[i], L[i], xyz_rgb, winw);
+        }
+
+        buildBlendMask(L, blend, winw, winh, contrastf, 1.f, autoContrast);
+        contrast = contrastf * 100.f;
+    };
+
+    // In fast mode the blend mask is calculated from the output of the fast demosaicer,
+    // which allows the detailed demosaicer to skip the tiles where only the fast one is used
+    const bool fast = settings->fastDualDemosaic;
+
+    if (fast) {
+        if (isBayer) {
+            vng4_demosaic(rawData, redTmp, greenTmp, blueTmp);
+        } else {
+            fast_xtrans_interpolate(rawData, redTmp, greenTmp, blueTmp);
+        }
+        calcBlendMask(redTmp, greenTmp, blueTmp);
+
+        // The sigmoid of buildBlendMask never reaches 0, so blend factors below fastDualDemosaicThreshold
+        // are set to 0 and the fast result is used there exactly. This changes each pixel by at most
+        // fastDualDemosaicThreshold * |detailed - fast|, i.e. less than 0.4 % of the difference between both demosaicers
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for (int i = 0; i < winh; ++i) {
+            for (int j = 0; j < winw; ++j) {
+                if (blend[i][j] < fastDualDemosaicThreshold) {
+                    blend[i][j] = 0.f;
+                }
+            }
+        }
+    }
+
+    const float * const *detailMask = fast ? static_cast<const float * const *>(blend) : nullptr;
+
     if (isBayer) {
-        vng4_demosaic(rawData, redTmp, greenTmp, blueTmp);
+        if (!fast) {
+            vng4_demosaic(rawData, redTmp, greenTmp, blueTmp);
+        }
 
         if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::AMAZEVNG4) || raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::PIXELSHIFT)) {
-            amaze_demosaic_RT(0, 0, winw, winh, rawData, red, green, blue, options.chunkSizeAMAZE, options.measure);
+            amaze_demosaic_RT(0, 0, winw, winh, rawData, red, green, blue, options.chunkSizeAMAZE, options.measure, detailMask);
         } else if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::DCBVNG4) ) {
             dcb_demosaic(raw.bayersensor.dcb_iterations, raw.bayersensor.dcb_enhance);
         } else if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::RCDVNG4) ) {
-            rcd_demosaic(options.chunkSizeRCD, options.measure);
+            rcd_demosaic(options.chunkSizeRCD, options.measure, detailMask);
         }
     } else {
         if (raw.xtranssensor.method == RAWParams::XTransSensor::getMethodString(RAWParams::XTransSensor::Method::FOUR_PASS) ) {
-            xtrans_interpolate (3, true, options.chunkSizeXT, options.measure);
+            xtrans_interpolate (3, true, options.chunkSizeXT, options.measure, detailMask);
         } else {
-            xtrans_interpolate (1, false, options.chunkSizeXT, options.measure);
+            xtrans_interpolate (1, false, options.chunkSizeXT, options.measure, detailMask);
         }
-        fast_xtrans_interpolate(rawData, redTmp, greenTmp, blueTmp);
-    }
-
-    const float xyz_rgb[3][3] = {          // XYZ from RGB
-                                { 0.412453, 0.357580, 0.180423 },
-                                { 0.212671, 0.715160, 0.072169 },
-                                { 0.019334, 0.119193, 0.950227 }
-                                };
-
-#ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-        for(int i = 0; i < winh; ++i) {
-            Color::RGB2L(red[i], green[i], blue[i], L[i], xyz_rgb, winw);
+        if (!fast) {
+            fast_xtrans_interpolate(rawData, redTmp, greenTmp, blueTmp);
         }
     }
-    // calculate contrast based blend factors to use vng4 in regions with low contrast
-    JaggedArray<float> blend(winw, winh);
-    float contrastf = contrast / 100.f;
 
-    buildBlendMask(L, blend, winw, winh, contrastf, 1.f, autoContrast);
-    contrast = contrastf * 100.f;
+    if (!fast) {
+        calcBlendMask(red, green, blue);
+    }
 
     // the following is split into 3 loops intentionally to avoid cache conflicts on CPUs with only 4-way cache
+    // pixels with blend == 0 are taken from the fast demosaicer only, as the detailed one may have skipped them in fast mode
 #ifdef _OPENMP
     #pragma omp parallel for
 #endif
     for(int i = 0; i < winh; ++i) {
         for(int j = 0; j < winw; ++j) {
-            red[i][j] = intp(blend[i][j], red[i][j], redTmp[i][j]);
+            red[i][j] = blend[i][j] > 0.f ? intp(blend[i][j], red[i][j], redTmp[i][j]) : redTmp[i][j];
         }
     }
 #ifdef _OPENMP
@@ -124,7 +169,7 @@ void RawImageSource::dual_demosaic_RT(bool isBayer, const RAWParams &raw, int wi
 #endif
     for(int i = 0; i < winh; ++i) {
         for(int j = 0; j < winw; ++j) {
-            green[i][j] = intp(blend[i][j], green[i][j], greenTmp[i][j]);
+            green[i][j] = blend[i][j] > 0.f ? intp(blend[i][j], green[i][j], greenTmp[i][j]) : greenTmp[i][j];
         }
     }
 #ifdef _OPENMP
@@ -132,7 +177,7 @@ void RawImageSource::dual_demosaic_RT(bool isBayer, const RAWParams &raw, int wi
 #endif
     for(int i = 0; i < winh; ++i) {
         for(int j = 0; j < winw; ++j) {
-            blue[i][j] = intp(blend[i][j], blue[i][j], blueTmp[i][j]);
+            blue[i][j] = blend[i][j] > 0.f ? intp(blend[i][j], blue[i][j], blueTmp[i][j]) : blueTmp[i][j];
         }
     }
 
@@ -16,7 +16,11 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <set>
+
 #include "ffmanager.h"
+#include "calibrationcache.h"
 #include "../rtgui/options.h"
 #include "rawimage.h"
 #include "imagedata.h"
@@ -107,13 +111,24 @@ double ffInfo::distance(const std::string &mak, const std::string &mod, const st
     return sqrt( dfocallength * dfocallength + dAperture * dAperture);
 }
 
+std::string ffInfo::getCacheKey() const
+{
+    return CalibrationCache::getFrameKey("ff", pathNames.empty() ? std::list<Glib::ustring>{pathname} : pathNames);
+}
+
 RawImage* ffInfo::getRawImage()
 {
     if(ri) {
         return ri;
     }
 
-    updateRawImage();
+    const std::string cacheKey = getCacheKey();
+    ri = CalibrationCache::getInstance().loadFrame(cacheKey, pathNames.empty() ? pathname : pathNames.front(), nullptr);
+
+    if (!ri) {
+        updateRawImage();
+        CalibrationCache::getInstance().storeFrame(cacheKey, ri, nullptr);
+    }
 
     return ri;
 }
@@ -233,6 +248,8 @@ void ffInfo::updateRawImage()
 
 void FFManager::init(const Glib::ustring& pathname)
 {
+    MyMutex::MyLock lock(mutex);
+
     if (pathname.empty()) {
         return;
     }
@@ -254,6 +271,12 @@ void FFManager::init(const Glib::ustring& pathname)
 
     } catch (Glib::Exception&) {}
 
+    {
+        // the cached blurs refer to the flat fields which are deleted now
+        MyMutex::MyLock lock(blurCacheMutex);
+        blurCache.clear();
+    }
+
     ffList.clear();
 
     for (size_t i = 0; i < names.size(); i++) {
@@ -286,6 +309,16 @@ void FFManager::init(const Glib::ustring& pathname)
         }
     }
 
+    // drop the cached master frames which don't belong to the current templates anymore
+    std::set<std::string> cacheKeys;
+
+    for (const auto& entry : ffList) {
+        cacheKeys.insert(entry.second.getCacheKey());
+    }
+
+    CalibrationCache::getInstance().prune("ff", cacheKeys);
+    CalibrationCache::getInstance().storeShotInfo();
+
     currentPath = pathname;
     return;
 }
@@ -320,10 +353,9 @@ ffInfo* FFManager::addFileInfo (const Glib::ustring& filename, bool pool)
             return nullptr;
         }
 
-        RawImage ri(filename);
-        int res = ri.loadRaw(false); // Read information about shot
+        const CalibrationCache::ShotInfo shot = CalibrationCache::getInstance().getShotInfo(filename); // Read information about shot
 
-        if (res != 0) {
+        if (!shot.valid) {
             return nullptr;
         }
 
@@ -335,23 +367,22 @@ ffInfo* FFManager::addFileInfo (const Glib::ustring& filename, bool pool)
             return &(iter->second);
         }
 
-        FramesData idata(filename, std::unique_ptr<RawMetaDataLocation>(new RawMetaDataLocation(ri.get_exifBase(), ri.get_ciffBase(), ri.get_ciffLen())), true);
         /* Files are added in the map, divided by same maker/model,lens and aperture*/
-        std::string key(ffInfo::key(idata.getMake(), idata.getModel(), idata.getLens(), idata.getFocalLen(), idata.getFNumber()));
+        std::string key(ffInfo::key(shot.maker, shot.model, shot.lens, shot.focalLength, shot.aperture));
         iter = ffList.find(key);
 
         if(iter == ffList.end()) {
-            ffInfo n(filename, idata.getMake(), idata.getModel(), idata.getLens(), idata.getFocalLen(), idata.getFNumber(), idata.getDateTimeAsTS());
+            ffInfo n(filename, shot.maker, shot.model, shot.lens, shot.focalLength, shot.aperture, shot.timestamp);
             iter = ffList.emplace(key, n);
         } else {
-            while(iter != ffList.end() && iter->second.key() == key && ABS(iter->second.timestamp - ri.get_timestamp()) > 60 * 60 * 6) { // 6 hour difference
+            while(iter != ffList.end() && iter->second.key() == key && ABS(iter->second.timestamp - shot.rawTimestamp) > 60 * 60 * 6) { // 6 hour difference
                 ++iter;
             }
 
             if(iter != ffList.end()) {
                 iter->second.pathNames.push_back(filename);
             } else {
-                ffInfo n(filename, idata.getMake(), idata.getModel(), idata.getLens(), idata.getFocalLen(), idata.getFNumber(), idata.getDateTimeAsTS());
+                ffInfo n(filename, shot.maker, shot.model, shot.lens, shot.focalLength, shot.aperture, shot.timestamp);
                 iter = ffList.emplace(key, n);
             }
         }
@@ -365,6 +396,8 @@ ffInfo* FFManager::addFileInfo (const Glib::ustring& filename, bool pool)
 
 void FFManager::getStat( int &totFiles, int &totTemplates)
 {
+    MyMutex::MyLock lock(mutex);
+
     totFiles = 0;
     totTemplates = 0;
 
@@ -427,6 +460,8 @@ ffInfo* FFManager::find( const std::string &mak, const std::string &mod, const s
 
 RawImage* FFManager::searchFlatField( const std::string &mak, const std::string &mod, const std::string &len, double focal, double apert, time_t t )
 {
+    MyMutex::MyLock lock(mutex);
+
     ffInfo *ff = find( mak, mod, len, focal, apert, t );
 
     if( ff ) {
@@ -438,6 +473,8 @@ RawImage* FFManager::searchFlatField( const std::string &mak, const std::string
 
 RawImage* FFManager::searchFlatField( const Glib::ustring filename )
 {
+    MyMutex::MyLock lock(mutex);
+
     for ( ffList_t::iterator iter = ffList.begin(); iter != ffList.end(); ++iter ) {
         if( iter->second.pathname.compare( filename ) == 0  ) {
             return iter->second.getRawImage();
@@ -453,6 +490,58 @@ RawImage* FFManager::searchFlatField( const Glib::ustring filename )
     return nullptr;
 }
 
+std::shared_ptr<const std::vector<float>> FFManager::getBlurredFlatField( const RawImage *ff, int boxH, int boxW, const std::function<void(float*)> &blur )
+{
+    constexpr std::size_t maxBlurs = 3; // the vertical + horizontal blur type uses three blurs
+
+    {
+        MyMutex::MyLock lock(blurCacheMutex);
+
+        for (auto iter = blurCache.begin(); iter != blurCache.end(); ++iter) {
+            if (iter->ff == ff && iter->boxH == boxH && iter->boxW == boxW) {
+                std::rotate(blurCache.begin(), iter, iter + 1);
+                return blurCache.front().data;
+            }
+        }
+    }
+
+    std::string cacheKey;
+
+    {
+        MyMutex::MyLock lock(mutex);
+
+        for (const auto& entry : ffList) {
+            if (entry.second.getLoadedRawImage() == ff) {
+                cacheKey = CalibrationCache::getBlurredFlatFieldKey(entry.second.getCacheKey(), boxH, boxW);
+                break;
+            }
+        }
+    }
+
+    const int W = ff->get_width();
+    const int H = ff->get_height();
+    std::shared_ptr<std::vector<float>> data = std::make_shared<std::vector<float>>();
+
+    if (!CalibrationCache::getInstance().loadBlurredFlatField(cacheKey, W, H, *data)) {
+        data->resize(static_cast<std::size_t>(W) * H);
+        blur(data->data());
+        CalibrationCache::getInstance().storeBlurredFlatField(cacheKey, W, H, *data);
+    }
+
+    MyMutex::MyLock lock(blurCacheMutex);
+
+    // entries of other flat fields are not needed anymore
+    blurCache.erase(std::remove_if(blurCache.begin(), blurCache.end(), [ff](const BlurredFlatField &entry) {
+        return entry.ff != ff;
+    }), blurCache.end());
+    blurCache.insert(blurCache.begin(), {ff, boxH, boxW, data});
+
+    if (blurCache.size() > maxBlurs) {
+        blurCache.resize(maxBlurs);
+    }
+
+    return data;
+}
 
 // Global variable
 FFManager ffm;
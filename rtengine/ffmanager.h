@@ -19,13 +19,18 @@
 #pragma once
 
 #include <cmath>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <glibmm/ustring.h>
 
 #include "rawimage.h"
 
+#include "../rtgui/threadutils.h"
+
 namespace rtengine
 {
 
@@ -69,6 +74,11 @@ public:
     }
 
     RawImage *getRawImage();
+    const RawImage *getLoadedRawImage() const
+    {
+        return ri;
+    }
+    std::string getCacheKey() const; ///< key of the master frame in the calibration cache
 
 protected:
     RawImage *ri; ///< Flat Field raw data
@@ -82,15 +92,29 @@ public:
     void init(const Glib::ustring &pathname);
     Glib::ustring getPathname()
     {
+        MyMutex::MyLock lock(mutex);
         return currentPath;
     };
     void getStat( int &totFiles, int &totTemplate);
     RawImage *searchFlatField( const std::string &mak, const std::string &mod, const std::string &len, double focallength, double apert, time_t t );
     RawImage *searchFlatField( const Glib::ustring filename );
+    // box blurred flat field, computed by blur on first use and stored in the calibration cache. The blurs of the last used flat field
+    // are also kept in memory for the following images
+    std::shared_ptr<const std::vector<float>> getBlurredFlatField( const RawImage *ff, int boxH, int boxW, const std::function<void(float*)> &blur );
 
 protected:
     typedef std::multimap<std::string, ffInfo> ffList_t;
     ffList_t ffList;
+
+    struct BlurredFlatField {
+        const RawImage *ff;
+        int boxH;
+        int boxW;
+        std::shared_ptr<const std::vector<float>> data;
+    };
+    std::vector<BlurredFlatField> blurCache; ///< most recently used first
+    MyMutex blurCacheMutex;
+    MyMutex mutex; ///< protects ffList and the loading of the frames, as images are processed concurrently
     bool initialized;
     Glib::ustring currentPath;
     ffInfo *addFileInfo(const Glib::ustring &filename, bool pool = true );
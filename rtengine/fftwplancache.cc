@@ -0,0 +1,197 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdlib>
+#include <iostream>
+
+#include <glib/gstdio.h>
+#include <glibmm.h>
+
+#include "fftwplancache.h"
+
+#include "settings.h"
+
+namespace
+{
+
+constexpr std::size_t maxPlans = 16;
+
+enum PlanType {
+    MANY_R2R,
+    R2R_2D
+};
+
+}
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+FFTWPlanCache& FFTWPlanCache::getInstance()
+{
+    static FFTWPlanCache instance;
+    return instance;
+}
+
+void FFTWPlanCache::init()
+{
+#ifdef RT_FFTW3F_OMP
+    fftwf_init_threads();
+#endif
+
+    if (settings->fftwWisdomFile.empty()) {
+        return;
+    }
+
+    try {
+        const std::string wisdom = Glib::file_get_contents(settings->fftwWisdomFile);
+
+        if (!fftwf_import_wisdom_from_string(wisdom.c_str())) {
+            // written by another version of FFTW or damaged
+            g_remove(settings->fftwWisdomFile.c_str());
+        }
+    } catch (Glib::FileError&) {}
+}
+
+void FFTWPlanCache::cleanup()
+{
+    for (const auto& entry : plans) {
+        fftwf_destroy_plan(entry.second.plan);
+    }
+
+    plans.clear();
+}
+
+fftwf_plan FFTWPlanCache::planManyR2R(int rank, const int* n, int howmany, float* in, int idist, float* out, int odist, const fftwf_r2r_kind* kind, unsigned flags, int nthreads)
+{
+#ifndef RT_FFTW3F_OMP
+    nthreads = 1;
+#endif
+
+    std::vector<int> key = {MANY_R2R, rank, howmany, idist, odist, static_cast<int>(flags), fftwf_alignment_of(in), fftwf_alignment_of(out), in == out, nthreads};
+
+    for (int i = 0; i < rank; ++i) {
+        key.push_back(n[i]);
+        key.push_back(kind[i]);
+    }
+
+    fftwf_plan plan = find(key);
+
+    if (!plan) {
+#ifdef RT_FFTW3F_OMP
+        fftwf_plan_with_nthreads(nthreads);
+#endif
+        plan = fftwf_plan_many_r2r(rank, n, howmany, in, nullptr, 1, idist, out, nullptr, 1, odist, kind, flags);
+        insert(key, plan, flags);
+    }
+
+    return plan;
+}
+
+fftwf_plan FFTWPlanCache::plan2dR2R(int n0, int n1, float* in, float* out, fftwf_r2r_kind kind0, fftwf_r2r_kind kind1, unsigned flags, int nthreads)
+{
+#ifndef RT_FFTW3F_OMP
+    nthreads = 1;
+#endif
+
+    const std::vector<int> key = {R2R_2D, n0, n1, kind0, kind1, static_cast<int>(flags), fftwf_alignment_of(in), fftwf_alignment_of(out), in == out, nthreads};
+
+    fftwf_plan plan = find(key);
+
+    if (!plan) {
+#ifdef RT_FFTW3F_OMP
+        fftwf_plan_with_nthreads(nthreads);
+#endif
+        plan = fftwf_plan_r2r_2d(n0, n1, in, out, kind0, kind1, flags);
+        insert(key, plan, flags);
+    }
+
+    return plan;
+}
+
+fftwf_plan FFTWPlanCache::find(const std::vector<int>& key)
+{
+    const auto iter = plans.find(key);
+
+    if (iter == plans.end()) {
+        return nullptr;
+    }
+
+    iter->second.lastUse = ++useCounter;
+    return iter->second.plan;
+}
+
+void FFTWPlanCache::insert(const std::vector<int>& key, fftwf_plan plan, unsigned flags)
+{
+    if (!plan) {
+        return;
+    }
+
+    if (plans.size() >= maxPlans) {
+        // drop the least recently used plan. The plans handed out during the current lock are the most recent ones
+        auto oldest = plans.begin();
+
+        for (auto iter = plans.begin(); iter != plans.end(); ++iter) {
+            if (iter->second.lastUse < oldest->second.lastUse) {
+                oldest = iter;
+            }
+        }
+
+        fftwf_destroy_plan(oldest->second.plan);
+        plans.erase(oldest);
+    }
+
+    plans[key] = {plan, ++useCounter};
+
+    if (!(flags & FFTW_ESTIMATE)) {
+        // measuring has added wisdom. Store it now, not all frontends call rtengine::cleanup
+        saveWisdom();
+    }
+}
+
+void FFTWPlanCache::saveWisdom()
+{
+    if (settings->fftwWisdomFile.empty() || g_mkdir_with_parents(Glib::path_get_dirname(settings->fftwWisdomFile).c_str(), 0755) != 0) {
+        return;
+    }
+
+    char* const wisdom = fftwf_export_wisdom_to_string();
+
+    if (!wisdom) {
+        return;
+    }
+
+    const Glib::ustring tmpFilename = Glib::ustring::compose("%1.%2.tmp", settings->fftwWisdomFile, g_get_real_time());
+
+    try {
+        Glib::file_set_contents(tmpFilename, wisdom);
+
+        if (g_rename(tmpFilename.c_str(), settings->fftwWisdomFile.c_str()) != 0) {
+            g_remove(tmpFilename.c_str());
+        }
+    } catch (Glib::FileError&) {
+        g_remove(tmpFilename.c_str());
+    }
+
+    free(wisdom);
+
+    if (settings->verbose) {
+        std::cout << "Stored FFTW wisdom in " << settings->fftwWisdomFile << std::endl;
+    }
+}
+
+}
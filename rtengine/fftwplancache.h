@@ -0,0 +1,69 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <fftw3.h>
+
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/*
+ * Process wide cache of FFTW plans, so that the planning (which is expensive with FFTW_MEASURE) is done
+ * only once per size and kind of transform. The wisdom gathered by the planner is stored in
+ * settings->fftwWisdomFile and loaded on start, which makes FFTW_MEASURE planning cheap in later runs too.
+ *
+ * The FFTW planner is not thread safe, so all methods must be called with fftwMutex locked. A returned
+ * plan stays valid until the lock is released. It has to be executed with the new-array execute
+ * functions on arrays with the same alignment as the ones given for planning and it must not be destroyed.
+ */
+class FFTWPlanCache final :
+    public NonCopyable
+{
+public:
+    static FFTWPlanCache& getInstance();
+
+    void init();
+    void cleanup();
+
+    // in and out are used for planning only and can be overwritten if flags doesn't contain FFTW_ESTIMATE
+    fftwf_plan planManyR2R(int rank, const int* n, int howmany, float* in, int idist, float* out, int odist, const fftwf_r2r_kind* kind, unsigned flags, int nthreads = 1);
+    fftwf_plan plan2dR2R(int n0, int n1, float* in, float* out, fftwf_r2r_kind kind0, fftwf_r2r_kind kind1, unsigned flags, int nthreads = 1);
+
+private:
+    struct Entry {
+        fftwf_plan plan;
+        unsigned long long lastUse;
+    };
+
+    FFTWPlanCache() = default;
+
+    fftwf_plan find(const std::vector<int>& key);
+    void insert(const std::vector<int>& key, fftwf_plan plan, unsigned flags);
+    void saveWisdom();
+
+    std::map<std::vector<int>, Entry> plans;
+    unsigned long long useCounter = 0;
+};
+
+}
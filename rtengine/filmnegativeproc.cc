@@ -18,6 +18,7 @@
  */
 #include <cmath>
 #include <iostream>
+#include <sstream>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -85,7 +86,7 @@ bool channelsAvg(
 
             // Sample the original unprocessed values from RawImage, subtracting black levels.
             // Scaling is irrelevant, as we are only interested in the ratio between two spots.
-            avgs[ch] += ri->data[r][c] - cblacksom[ch];
+            avgs[ch] += ri->sample(r, c) - cblacksom[ch];
         }
     }
 
@@ -168,6 +169,12 @@ void rtengine::RawImageSource::filmNegativeProcess(const procparams::FilmNegativ
         return;
     }
 
+    if (!demosaicCacheKey.empty()) {
+        std::ostringstream key;
+        key << demosaicCacheKey << "|filmneg " << params.redRatio << ' ' << params.greenExp << ' ' << params.blueRatio;
+        demosaicCacheKey = key.str();
+    }
+
     // Exponents are expressed as positive in the parameters, so negate them in order
     // to get the reciprocals.
     const std::array<float, 3> exps = {
@@ -98,31 +98,20 @@ void CLASS init_fuji_compr (struct fuji_compressed_params* info)
     }
 }
 
-#define FUJI_BUF_SIZE 0x10000u
-
 void CLASS fuji_fill_buffer (struct fuji_compressed_block *info)
 {
     if (info->cur_pos >= info->cur_buf_size) {
         info->cur_pos = 0;
         info->cur_buf_offset += info->cur_buf_size;
-#ifdef MYFILE_MMAP
+        // RT: IMFILE always holds the whole file in memory (mapped or read), so every strip
+        // reads its data in place at its own offset, without locking the shared file position
         info->cur_buf_size = info->max_read_size;
-        info->cur_buf = fdata(info->cur_buf_offset, info->input);
-#else
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        {
-            fseek (info->input, info->cur_buf_offset, SEEK_SET);
-            info->cur_buf_size = fread (info->cur_buf, 1, std::min (info->max_read_size, FUJI_BUF_SIZE), info->input);
-        }
-#endif
-        if (info->cur_buf_size < 1) { // nothing read
-            if (info->fillbytes > 0) {
-                int ls = std::max (1, std::min (info->fillbytes, (int)FUJI_BUF_SIZE));
-                memset (info->cur_buf, 0, ls);
-                info->fillbytes -= ls;
-            }
+
+        if (info->cur_buf_size < 1) { // nothing left, feed zeros
+            static uchar zeros[16] = {};
+            info->cur_buf = zeros;
+        } else {
+            info->cur_buf = fdata(info->cur_buf_offset, info->input);
         }
 
         info->max_read_size -= info->cur_buf_size;
@@ -137,7 +126,6 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
     info->input = ifp;
     INT64 fsize = info->input->size;
     info->max_read_size = std::min (unsigned (fsize - raw_offset), dsize + 16); // Data size may be incorrect?
-    info->fillbytes = 1;
 
     info->linebuf[_R0] = info->linealloc;
 
@@ -146,10 +134,7 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
     }
 
     // init buffer
-#ifndef MYFILE_MMAP
-    info->cur_buf = (uchar*)malloc (FUJI_BUF_SIZE);
-    merror (info->cur_buf, "init_fuji_block()");
-#endif
+    info->cur_buf = nullptr;
     info->cur_bit = 0;
     info->cur_pos = 0;
     info->cur_buf_offset = raw_offset;
@@ -891,9 +876,6 @@ void CLASS fuji_decode_strip (const struct fuji_compressed_params* info_common,
 
     // release data
     free (info.linealloc);
-#ifndef MYFILE_MMAP
-    free (info.cur_buf);
-#endif
 }
 
 static unsigned sgetn (int n, uchar *s)
@@ -1060,26 +1042,6 @@ inline void unpack7bytesto4x16(unsigned char *src, unsigned short *dest)
   dest[3] = ((src[5] & 0x3f) << 8) | src[6];
 }
 
-inline void unpack28bytesto16x16ns(unsigned char *src, unsigned short *dest)
-{
-  dest[0] = (src[3] << 6) | (src[2] >> 2);
-  dest[1] = ((src[2] & 0x3) << 12) | (src[1] << 4) | (src[0] >> 4);
-  dest[2] = (src[0] & 0xf) << 10 | (src[7] << 2) | (src[6] >> 6);
-  dest[3] = ((src[6] & 0x3f) << 8) | src[5];
-  dest[4] = (src[4] << 6) | (src[11] >> 2);
-  dest[5] = ((src[11] & 0x3) << 12) | (src[10] << 4) | (src[9] >> 4);
-  dest[6] = (src[9] & 0xf) << 10 | (src[8] << 2) | (src[15] >> 6);
-  dest[7] = ((src[15] & 0x3f) << 8) | src[14];
-  dest[8] = (src[13] << 6) | (src[12] >> 2);
-  dest[9] = ((src[12] & 0x3) << 12) | (src[19] << 4) | (src[18] >> 4);
-  dest[10] = (src[18] & 0xf) << 10 | (src[17] << 2) | (src[16] >> 6);
-  dest[11] = ((src[16] & 0x3f) << 8) | src[23];
-  dest[12] = (src[22] << 6) | (src[21] >> 2);
-  dest[13] = ((src[21] & 0x3) << 12) | (src[20] << 4) | (src[27] >> 4);
-  dest[14] = (src[27] & 0xf) << 10 | (src[26] << 2) | (src[25] >> 6);
-  dest[15] = ((src[25] & 0x3f) << 8) | src[24];
-}
-
 #define swab32(x)                                                                                                      \
   ((unsigned int)((((unsigned int)(x) & (unsigned int)0x000000ffUL) << 24) |                                           \
                   (((unsigned int)(x) & (unsigned int)0x0000ff00UL) << 8) |                                            \
@@ -1099,24 +1061,41 @@ void CLASS fuji_14bit_load_raw()
 {
   const unsigned linelen = raw_width * 7 / 4;
   const unsigned pitch = raw_width;
-  unsigned char *buf = (unsigned char *)malloc(linelen);
-  merror(buf, "fuji_14bit_load_raw()");
+  const ssize_t start = ftell(ifp);
 
-  for (int row = 0; row < raw_height; row++)
+  // RT: rows are at fixed offsets, so they are unpacked in parallel straight from the file buffer
+#ifdef _OPENMP
+  #pragma omp parallel
+#endif
   {
-    unsigned bytesread = fread(buf, 1, linelen, ifp);
-    unsigned short *dest = &raw_image[pitch * row];
-    if (bytesread % 28)
+    std::vector<unsigned> words((linelen + 3) / 4);
+    unsigned char *buf = reinterpret_cast<unsigned char *>(words.data());
+
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic,16)
+#endif
+    for (int row = 0; row < raw_height; row++)
     {
+      const ssize_t pos = start + static_cast<ssize_t>(row) * linelen;
+      const unsigned bytesread = pos < ifp->size ? std::min<ssize_t>(linelen, ifp->size - pos) : 0;
+      memcpy(buf, fdata(pos, ifp), bytesread);
+      unsigned short *dest = &raw_image[pitch * row];
       swab32arr((unsigned *)buf, bytesread / 4);
-      for (int sp = 0, dp = 0; dp < pitch - 3 && sp < linelen - 6 && sp < bytesread - 6; sp += 7, dp += 4)
-        unpack7bytesto4x16(buf + sp, dest + dp);
+      if (bytesread % 28)
+      {
+        for (int sp = 0, dp = 0; dp < pitch - 3 && sp < linelen - 6 && sp < bytesread - 6; sp += 7, dp += 4)
+          unpack7bytesto4x16(buf + sp, dest + dp);
+      }
+      else
+      {
+        // after swapping the 32 bit words the row is a plain big endian 14 bit stream
+        const unsigned groups = std::min(pitch / 16, bytesread / 28);
+        rtengine::unpackBitsMsb(buf, dest, groups * 16, 14, bytesread);
+      }
     }
-    else
-      for (int sp = 0, dp = 0; dp < pitch - 15 && sp < linelen - 27 && sp < bytesread - 27; sp += 28, dp += 16)
-        unpack28bytesto16x16ns(buf + sp, dest + dp);
   }
-  free(buf);
+
+  fseek(ifp, start + static_cast<ssize_t>(linelen) * raw_height, SEEK_SET);
 }
 
 //-----------------------------------------------------------------------------
@@ -22,6 +22,7 @@
 #include <cstdlib>
 #include "opthelper.h"
 #include "boxblur.h"
+#include "cpufeatures.h"
 namespace
 {
 
@@ -1532,8 +1533,25 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
 }
 }
 
+#ifdef GAUSS_AVX2
+void gaussianBlur_avx2(float** src, float** dst, const int W, const int H, const double sigma, float *buffer, eGaussType gausstype, float** buffer2)
+{
+    gaussianBlurImpl<float>(src, dst, W, H, sigma, buffer, gausstype, buffer2);
+}
+#else
+#ifdef RT_AVX2_CLONES
+void gaussianBlur_avx2(float** src, float** dst, const int W, const int H, const double sigma, float *buffer, eGaussType gausstype, float** buffer2);
+#endif
+
 void gaussianBlur(float** src, float** dst, const int W, const int H, const double sigma, float *buffer, eGaussType gausstype, float** buffer2)
 {
+#ifdef RT_AVX2_CLONES
+    if (rtengine::cpuHasAvx2()) {
+        gaussianBlur_avx2(src, dst, W, H, sigma, buffer, gausstype, buffer2);
+        return;
+    }
+#endif
     gaussianBlurImpl<float>(src, dst, W, H, sigma, buffer, gausstype, buffer2);
 }
+#endif
 
@@ -0,0 +1,35 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// AVX2 build of gauss.cc
+#include "cpufeatures.h"
+
+#ifdef RT_AVX2_CLONES
+
+#include "gauss.h"
+#include "rt_math.h"
+#include <cmath>
+#include <cstdlib>
+#include "opthelper.h"
+#include "boxblur.h"
+
+#define GAUSS_AVX2
+
+RT_AVX2_TARGET_BEGIN
+#include "gauss.cc"
+RT_AVX2_TARGET_END
+
+#endif
@@ -27,6 +27,8 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "array2D.h"
 #include "opthelper.h"
@@ -283,6 +285,168 @@ void boxblur_resamp(const float* const* src, float** dst, float** temp, int H, i
     }
 }
 
+// Fills the gaps of one row of a directional highlight map with the five nearest values of the previous row.
+// src holds the highlight data of the row (channel 3 are the weights), prev and dst the colour channels of the
+// previous and the current row, prevWeight and weight their weights.
+void propagateRow(const float* const src[4], const float* const prev[3], const float* prevWeight, float* const dst[3], float* weight, int start, int end, float epsilon)
+{
+    int k = start;
+#ifdef __SSE2__
+    const vfloat epsilonv = F2V(epsilon);
+    const vfloat onev = F2V(1.f);
+    const vfloat tenthv = F2V(0.1f);
+
+    for (; k < end - 3; k += 4) {
+        const vfloat srcWeightv = LVFU(src[3][k]);
+        const vmask hilitev = vmaskf_gt(srcWeightv, epsilonv);
+        const vfloat weightSumv = LVFU(prevWeight[k - 2]) + LVFU(prevWeight[k - 1]) + LVFU(prevWeight[k]) + LVFU(prevWeight[k + 1]) + LVFU(prevWeight[k + 2]);
+        STVFU(weight[k], vself(hilitev, onev, vselfnotzero(vmaskf_eq(weightSumv, ZEROV), tenthv)));
+
+        for (int c = 0; c < 3; ++c) {
+            const vfloat sumv = LVFU(prev[c][k - 2]) + LVFU(prev[c][k - 1]) + LVFU(prev[c][k]) + LVFU(prev[c][k + 1]) + LVFU(prev[c][k + 2]);
+            STVFU(dst[c][k], vself(hilitev, LVFU(src[c][k]) / srcWeightv, tenthv * (sumv / (weightSumv + epsilonv))));
+        }
+    }
+
+#endif
+
+    for (; k < end; ++k) {
+        if (src[3][k] > epsilon) {
+            weight[k] = 1.f;
+
+            for (int c = 0; c < 3; ++c) {
+                dst[c][k] = src[c][k] / src[3][k];
+            }
+        } else {
+            const float weightSum = prevWeight[k - 2] + prevWeight[k - 1] + prevWeight[k] + prevWeight[k + 1] + prevWeight[k + 2];
+            weight[k] = weightSum == 0.f ? 0.f : 0.1f;
+
+            for (int c = 0; c < 3; ++c) {
+                dst[c][k] = 0.1f * ((prev[c][k - 2] + prev[c][k - 1] + prev[c][k] + prev[c][k + 1] + prev[c][k + 2]) / (weightSum + epsilon));
+            }
+        }
+    }
+}
+
+// Same as propagateRow for the weights only, but the gaps get weights relative to the weights of the previous row
+void propagateWeightRow(const float* srcWeight, const float* prevWeight, float* weight, int start, int end, float epsilon)
+{
+    int k = start;
+#ifdef __SSE2__
+    const vfloat epsilonv = F2V(epsilon);
+    const vfloat tenthv = F2V(0.1f);
+
+    for (; k < end - 3; k += 4) {
+        const vfloat srcWeightv = LVFU(srcWeight[k]);
+        const vfloat weightSumv = LVFU(prevWeight[k - 2]) + LVFU(prevWeight[k - 1]) + LVFU(prevWeight[k]) + LVFU(prevWeight[k + 1]) + LVFU(prevWeight[k + 2]);
+        STVFU(weight[k], vself(vmaskf_gt(srcWeightv, epsilonv), srcWeightv / srcWeightv, tenthv * (weightSumv / (weightSumv + epsilonv))));
+    }
+
+#endif
+
+    for (; k < end; ++k) {
+        if (srcWeight[k] > epsilon) {
+            weight[k] = srcWeight[k] / srcWeight[k];
+        } else {
+            const float weightSum = prevWeight[k - 2] + prevWeight[k - 1] + prevWeight[k] + prevWeight[k + 1] + prevWeight[k + 2];
+            weight[k] = 0.1f * (weightSum / (weightSum + epsilon));
+        }
+    }
+}
+
+// Calls rowFunc(row, start, end) for the rows from firstRow to lastRow in this order. As each row depends on the
+// previous one, the rows are split into blocks of columns which are processed in parallel.
+template<typename RowFunc>
+void processRows(int firstRow, int lastRow, int start, int end, const RowFunc &rowFunc)
+{
+    constexpr int blockSize = 256;
+    const int step = firstRow <= lastRow ? 1 : -1;
+    const int numBlocks = (end - start + blockSize - 1) / blockSize;
+
+#ifdef _OPENMP
+    #pragma omp parallel if (numBlocks > 1)
+#endif
+
+    for (int row = firstRow; row != lastRow + step; row += step) {
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+
+        for (int block = 0; block < numBlocks; ++block) {
+            rowFunc(row, start + block * blockSize, std::min(start + (block + 1) * blockSize, end));
+        }
+    }
+}
+
+struct ClipRegion {
+    int minx;
+    int miny;
+    int maxx;
+    int maxy;
+};
+
+// Returns the bounding boxes of the clusters of clipped pixels, extended by border and clamped to the image.
+// Clusters are collected in cells of border x border pixels, boxes which overlap after extension are merged.
+template<typename IsClipped>
+std::vector<ClipRegion> findClipRegions(int width, int height, int border, const IsClipped &isClipped)
+{
+    const int cellsW = (width + border - 1) / border;
+    const int cellsH = (height + border - 1) / border;
+    std::vector<ClipRegion> cells(cellsW * cellsH, {width, height, -1, -1});
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+
+    for (int cy = 0; cy < cellsH; ++cy) {
+        const int rowEnd = std::min(height, (cy + 1) * border);
+
+        for (int i = cy * border; i < rowEnd; ++i) {
+            for (int j = 0; j < width; ++j) {
+                if (isClipped(i, j)) {
+                    ClipRegion &cell = cells[cy * cellsW + j / border];
+                    cell.minx = std::min(cell.minx, j);
+                    cell.maxx = std::max(cell.maxx, j);
+                    cell.miny = std::min(cell.miny, i);
+                    cell.maxy = std::max(cell.maxy, i);
+                }
+            }
+        }
+    }
+
+    std::vector<ClipRegion> regions;
+
+    for (const auto &cell : cells) {
+        if (cell.maxx >= 0) {
+            regions.push_back({std::max(0, cell.minx - border), std::max(0, cell.miny - border), std::min(width - 1, cell.maxx + border), std::min(height - 1, cell.maxy + border)});
+        }
+    }
+
+    bool merged = true;
+
+    while (merged) {
+        merged = false;
+
+        for (size_t a = 0; a < regions.size(); ++a) {
+            for (size_t b = a + 1; b < regions.size();) {
+                if (regions[a].minx <= regions[b].maxx && regions[b].minx <= regions[a].maxx && regions[a].miny <= regions[b].maxy && regions[b].miny <= regions[a].maxy) {
+                    regions[a].minx = std::min(regions[a].minx, regions[b].minx);
+                    regions[a].miny = std::min(regions[a].miny, regions[b].miny);
+                    regions[a].maxx = std::max(regions[a].maxx, regions[b].maxx);
+                    regions[a].maxy = std::max(regions[a].maxy, regions[b].maxy);
+                    regions[b] = regions.back();
+                    regions.pop_back();
+                    merged = true;
+                } else {
+                    ++b;
+                }
+            }
+        }
+    }
+
+    return regions;
+}
+
 }
 
 namespace rtengine
@@ -391,24 +555,30 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
         medFactor[c] = max(1.0f, max_f[c] / medpt) / -blendpt;
     }
 
-    int minx = width - 1;
-    int maxx = 0;
-    int miny = height - 1;
-    int maxy = 0;
+    const auto isClipped = [&](int i, int j) {
+        return red[i][j] >= max_f[0] || green[i][j] >= max_f[1] || blue[i][j] >= max_f[2];
+    };
+
+    int clipMinx = width - 1;
+    int clipMaxx = 0;
+    int clipMiny = height - 1;
+    int clipMaxy = 0;
+    int clipped = 0;
 
-    #pragma omp parallel for reduction(min:minx,miny) reduction(max:maxx,maxy) schedule(dynamic, 16)
+    #pragma omp parallel for reduction(min:clipMinx,clipMiny) reduction(max:clipMaxx,clipMaxy) reduction(+:clipped) schedule(dynamic, 16)
     for (int i = 0; i < height; ++i) {
         for (int j = 0; j< width; ++j) {
-            if (red[i][j] >= max_f[0] || green[i][j] >= max_f[1] || blue[i][j] >= max_f[2]) {
-                minx = std::min(minx, j);
-                maxx = std::max(maxx, j);
-                miny = std::min(miny, i);
-                maxy = std::max(maxy, i);
+            if (isClipped(i, j)) {
+                clipMinx = std::min(clipMinx, j);
+                clipMaxx = std::max(clipMaxx, j);
+                clipMiny = std::min(clipMiny, i);
+                clipMaxy = std::max(clipMaxy, i);
+                ++clipped;
             }
         }
     }
 
-    if (minx > maxx || miny > maxy) { // nothing to reconstruct
+    if (clipMinx > clipMaxx || clipMiny > clipMaxy) { // nothing to reconstruct
         return;
     }
 
@@ -418,315 +588,264 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     }
 
     constexpr int blurBorder = 256;
-    minx = std::max(0, minx - blurBorder);
-    miny = std::max(0, miny - blurBorder);
-    maxx = std::min(width - 1, maxx + blurBorder);
-    maxy = std::min(height - 1, maxy + blurBorder);
-    const int blurWidth = maxx - minx + 1;
-    const int blurHeight = maxy - miny + 1;
-    const int bufferWidth = blurWidth + ((16 - (blurWidth % 16)) & 15);
+    const ClipRegion clipBox = {std::max(0, clipMinx - blurBorder), std::max(0, clipMiny - blurBorder), std::min(width - 1, clipMaxx + blurBorder), std::min(height - 1, clipMaxy + blurBorder)};
+    std::vector<ClipRegion> regions;
 
-    multi_array2D<float, 3> channelblur(bufferWidth, blurHeight, 0, 48);
-    array2D<float> temp(bufferWidth, blurHeight); // allocate temporary buffer
+    if (clipped < static_cast<int64_t>(width) * height / 100) {
+        // only few pixels are clipped, reconstruct the clusters of clipped pixels separately
+        // if that saves work compared to their common bounding box
+        regions = findClipRegions(width, height, blurBorder, isClipped);
+        int64_t regionsArea = 0;
 
-    // blur RGB channels
+        for (const auto &region : regions) {
+            regionsArea += static_cast<int64_t>(region.maxx - region.minx + 1) * (region.maxy - region.miny + 1);
+        }
 
-    boxblur2(red, channelblur[0], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
+        if (regionsArea >= static_cast<int64_t>(clipBox.maxx - clipBox.minx + 1) * (clipBox.maxy - clipBox.miny + 1)) {
+            regions.clear();
+        }
+    }
 
-    if (plistener) {
-        progress += 0.07;
-        plistener->setProgress(progress);
+    if (regions.empty()) {
+        regions.push_back(clipBox);
     }
 
-    boxblur2(green, channelblur[1], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
+    const double progressScale = 1.0 / regions.size();
 
-    if (plistener) {
-        progress += 0.07;
-        plistener->setProgress(progress);
-    }
+    for (const auto &region : regions) {
+        const int minx = region.minx;
+        const int miny = region.miny;
+        const int maxx = region.maxx;
+        const int maxy = region.maxy;
+        const int blurWidth = maxx - minx + 1;
+        const int blurHeight = maxy - miny + 1;
+        const int bufferWidth = blurWidth + ((16 - (blurWidth % 16)) & 15);
 
-    boxblur2(blue, channelblur[2], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
- 
-    if (plistener) {
-        progress += 0.07;
-        plistener->setProgress(progress);
-    }
+        multi_array2D<float, 3> channelblur(bufferWidth, blurHeight, 0, 48);
+        array2D<float> temp(bufferWidth, blurHeight); // allocate temporary buffer
 
-    // reduce channel blur to one array
-#ifdef _OPENMP
-    #pragma omp parallel for
-#endif
-    for (int i = 0; i < blurHeight; ++i) {
-        for (int j = 0; j < blurWidth; ++j) {
-            channelblur[0][i][j] = fabsf(channelblur[0][i][j] - red[i + miny][j + minx]) + fabsf(channelblur[1][i][j] - green[i + miny][j + minx]) + fabsf(channelblur[2][i][j] - blue[i + miny][j + minx]);
-        }
-    }
+        // blur RGB channels
 
-    for (int c = 1; c < 3; ++c) {
-        channelblur[c].free();    //free up some memory
-    }
+        boxblur2(red, channelblur[0], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
 
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
+        if (plistener) {
+            progress += 0.07 * progressScale;
+            plistener->setProgress(progress);
+        }
 
-    multi_array2D<float, 4> hilite_full(bufferWidth, blurHeight, ARRAY2D_CLEAR_DATA, 32);
+        boxblur2(green, channelblur[1], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
 
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
+        if (plistener) {
+            progress += 0.07 * progressScale;
+            plistener->setProgress(progress);
+        }
 
-    double hipass_sum = 0.0;
-    int hipass_norm = 0;
+        boxblur2(blue, channelblur[2], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
+ 
+        if (plistener) {
+            progress += 0.07 * progressScale;
+            plistener->setProgress(progress);
+        }
 
-    // set up which pixels are clipped or near clipping
+        // reduce channel blur to one array
 #ifdef _OPENMP
-    #pragma omp parallel for reduction(+:hipass_sum,hipass_norm) schedule(dynamic,16)
+        #pragma omp parallel for
 #endif
-    for (int i = 0; i < blurHeight; ++i) {
-        for (int j = 0; j < blurWidth; ++j) {
-            if (
-                (
-                    red[i + miny][j + minx] > thresh[0]
-                    || green[i + miny][j + minx] > thresh[1]
-                    || blue[i + miny][j + minx] > thresh[2]
-                )
-                && red[i + miny][j + minx] < max_f[0]
-                && green[i + miny][j + minx] < max_f[1]
-                && blue[i + miny][j + minx] < max_f[2]
-            ) {
-                // if one or more channels is highlight but none are blown, add to highlight accumulator
-                hipass_sum += channelblur[0][i][j];
-                ++hipass_norm;
-
-                hilite_full[0][i][j] = red[i + miny][j + minx];
-                hilite_full[1][i][j] = green[i + miny][j + minx];
-                hilite_full[2][i][j] = blue[i + miny][j + minx];
-                hilite_full[3][i][j] = 1.f;
+        for (int i = 0; i < blurHeight; ++i) {
+            for (int j = 0; j < blurWidth; ++j) {
+                channelblur[0][i][j] = fabsf(channelblur[0][i][j] - red[i + miny][j + minx]) + fabsf(channelblur[1][i][j] - green[i + miny][j + minx]) + fabsf(channelblur[2][i][j] - blue[i + miny][j + minx]);
             }
         }
-    }
 
-    const float hipass_ave = 2.f * hipass_sum / (hipass_norm + epsilon);
+        for (int c = 1; c < 3; ++c) {
+            channelblur[c].free();    //free up some memory
+        }
 
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
+        }
 
-    array2D<float> hilite_full4(bufferWidth, blurHeight);
-    //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-    //blur highlight data
-    boxblur2(hilite_full[3], hilite_full4, temp, 0, 0, blurHeight, blurWidth, bufferWidth, 1);
+        multi_array2D<float, 4> hilite_full(bufferWidth, blurHeight, ARRAY2D_CLEAR_DATA, 32);
 
-    temp.free(); // free temporary buffer
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
+        }
 
-    if (plistener) {
-        progress += 0.07;
-        plistener->setProgress(progress);
-    }
+        double hipass_sum = 0.0;
+        int hipass_norm = 0;
 
+        // set up which pixels are clipped or near clipping
 #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic,16)
+        #pragma omp parallel for reduction(+:hipass_sum,hipass_norm) schedule(dynamic,16)
 #endif
-    for (int i = 0; i < blurHeight; ++i) {
-        for (int j = 0; j < blurWidth; ++j) {
-            if (channelblur[0][i][j] > hipass_ave) {
-                //too much variation
-                hilite_full[0][i][j] = hilite_full[1][i][j] = hilite_full[2][i][j] = hilite_full[3][i][j] = 0.f;
-                continue;
-            }
-
-            if (hilite_full4[i][j] > epsilon && hilite_full4[i][j] < 0.95f) {
-                //too near an edge, could risk using CA affected pixels, therefore omit
-                hilite_full[0][i][j] = hilite_full[1][i][j] = hilite_full[2][i][j] = hilite_full[3][i][j] = 0.f;
+        for (int i = 0; i < blurHeight; ++i) {
+            for (int j = 0; j < blurWidth; ++j) {
+                if (
+                    (
+                        red[i + miny][j + minx] > thresh[0]
+                        || green[i + miny][j + minx] > thresh[1]
+                        || blue[i + miny][j + minx] > thresh[2]
+                    )
+                    && red[i + miny][j + minx] < max_f[0]
+                    && green[i + miny][j + minx] < max_f[1]
+                    && blue[i + miny][j + minx] < max_f[2]
+                ) {
+                    // if one or more channels is highlight but none are blown, add to highlight accumulator
+                    hipass_sum += channelblur[0][i][j];
+                    ++hipass_norm;
+
+                    hilite_full[0][i][j] = red[i + miny][j + minx];
+                    hilite_full[1][i][j] = green[i + miny][j + minx];
+                    hilite_full[2][i][j] = blue[i + miny][j + minx];
+                    hilite_full[3][i][j] = 1.f;
+                }
             }
         }
-    }
-
-    channelblur[0].free();    //free up some memory
-    hilite_full4.free();    //free up some memory
-
-    const int hfh = (blurHeight - blurHeight % pitch) / pitch;
-    const int hfw = (blurWidth - blurWidth % pitch) / pitch;
 
-    multi_array2D<float, 4> hilite(hfw + 1, hfh + 1, ARRAY2D_CLEAR_DATA, 48);
+        const float hipass_ave = 2.f * hipass_sum / (hipass_norm + epsilon);
 
-    //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-    // blur and resample highlight data; range=size of blur, pitch=sample spacing
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
+        }
 
-    array2D<float> temp2(blurWidth / pitch + (blurWidth % pitch == 0 ? 0 : 1), blurHeight);
+        array2D<float> hilite_full4(bufferWidth, blurHeight);
+        //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+        //blur highlight data
+        boxblur2(hilite_full[3], hilite_full4, temp, 0, 0, blurHeight, blurWidth, bufferWidth, 1);
 
-    for (int m = 0; m < 4; ++m) {
-        boxblur_resamp(hilite_full[m], hilite[m], temp2, blurHeight, blurWidth, range, pitch);
+        temp.free(); // free temporary buffer
 
         if (plistener) {
-            progress += 0.05;
+            progress += 0.07 * progressScale;
             plistener->setProgress(progress);
         }
-    }
 
-    temp2.free();
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic,16)
+#endif
+        for (int i = 0; i < blurHeight; ++i) {
+            for (int j = 0; j < blurWidth; ++j) {
+                if (channelblur[0][i][j] > hipass_ave) {
+                    //too much variation
+                    hilite_full[0][i][j] = hilite_full[1][i][j] = hilite_full[2][i][j] = hilite_full[3][i][j] = 0.f;
+                    continue;
+                }
 
-    for (int c = 0; c < 4; ++c) {
-        hilite_full[c].free();    //free up some memory
-    }
+                if (hilite_full4[i][j] > epsilon && hilite_full4[i][j] < 0.95f) {
+                    //too near an edge, could risk using CA affected pixels, therefore omit
+                    hilite_full[0][i][j] = hilite_full[1][i][j] = hilite_full[2][i][j] = hilite_full[3][i][j] = 0.f;
+                }
+            }
+        }
 
-    multi_array2D<float, 8> hilite_dir(hfw, hfh, ARRAY2D_CLEAR_DATA, 64);
-    // for faster processing we create two buffers using (height,width) instead of (width,height)
-    multi_array2D<float, 4> hilite_dir0(hfh, hfw, ARRAY2D_CLEAR_DATA, 64);
-    multi_array2D<float, 4> hilite_dir4(hfh, hfw, ARRAY2D_CLEAR_DATA, 64);
+        channelblur[0].free();    //free up some memory
+        hilite_full4.free();    //free up some memory
 
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
+        const int hfh = (blurHeight - blurHeight % pitch) / pitch;
+        const int hfw = (blurWidth - blurWidth % pitch) / pitch;
 
-    //fill gaps in highlight map by directional extension
-    //raster scan from four corners
-    for (int j = 1; j < hfw - 1; ++j) {
-        for (int i = 2; i < hfh - 2; ++i) {
-            //from left
-            if (hilite[3][i][j] > epsilon) {
-                hilite_dir0[3][j][i] = 1.f;
-            } else {
-                hilite_dir0[3][j][i] = (hilite_dir0[0 + 3][j - 1][i - 2] + hilite_dir0[0 + 3][j - 1][i - 1] + hilite_dir0[0 + 3][j - 1][i] + hilite_dir0[0 + 3][j - 1][i + 1] + hilite_dir0[0 + 3][j - 1][i + 2]) == 0.f ? 0.f : 0.1f;
+        multi_array2D<float, 4> hilite(hfw + 1, hfh + 1, ARRAY2D_CLEAR_DATA, 48);
+
+        //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+        // blur and resample highlight data; range=size of blur, pitch=sample spacing
+
+        array2D<float> temp2(blurWidth / pitch + (blurWidth % pitch == 0 ? 0 : 1), blurHeight);
+
+        for (int m = 0; m < 4; ++m) {
+            boxblur_resamp(hilite_full[m], hilite[m], temp2, blurHeight, blurWidth, range, pitch);
+
+            if (plistener) {
+                progress += 0.05 * progressScale;
+                plistener->setProgress(progress);
             }
         }
 
-        if (hilite[3][2][j] <= epsilon) {
-            hilite_dir[0 + 3][0][j]  = hilite_dir0[3][j][2];
-        }
+        temp2.free();
 
-        if (hilite[3][3][j] <= epsilon) {
-            hilite_dir[0 + 3][1][j]  = hilite_dir0[3][j][3];
+        for (int c = 0; c < 4; ++c) {
+            hilite_full[c].free();    //free up some memory
         }
 
-        if (hilite[3][hfh - 3][j] <= epsilon) {
-            hilite_dir[4 + 3][hfh - 1][j] = hilite_dir0[3][j][hfh - 3];
-        }
+        multi_array2D<float, 8> hilite_dir(hfw, hfh, ARRAY2D_CLEAR_DATA, 64);
+        // for faster processing we create two buffers using (height,width) instead of (width,height)
+        multi_array2D<float, 4> hilite_dir0(hfh, hfw, ARRAY2D_CLEAR_DATA, 64);
+        multi_array2D<float, 4> hilite_dir4(hfh, hfw, ARRAY2D_CLEAR_DATA, 64);
 
-        if (hilite[3][hfh - 4][j] <= epsilon) {
-            hilite_dir[4 + 3][hfh - 2][j] = hilite_dir0[3][j][hfh - 4];
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
         }
-    }
 
-    for (int i = 2; i < hfh - 2; ++i) {
-        if (hilite[3][i][hfw - 2] <= epsilon) {
-            hilite_dir4[3][hfw - 1][i] = hilite_dir0[3][hfw - 2][i];
-        }
-    }
+        //fill gaps in highlight map by directional extension
+        //raster scan from four corners
+        {
+            // transposed copy of the highlight data for the scans from left and right
+            multi_array2D<float, 4> hiliteT(hfh, hfw, 0, 64);
 
 #ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-#ifdef _OPENMP
-        #pragma omp for nowait
+            #pragma omp parallel for
 #endif
-        for (int c = 0; c < 3; ++c) {
-            for (int j = 1; j < hfw - 1; ++j) {
-                for (int i = 2; i < hfh - 2; ++i) {
-                    //from left
-                    if (hilite[3][i][j] > epsilon) {
-                        hilite_dir0[c][j][i] = hilite[c][i][j] / hilite[3][i][j];
-                    } else {
-                        hilite_dir0[c][j][i] = 0.1f * ((hilite_dir0[0 + c][j - 1][i - 2] + hilite_dir0[0 + c][j - 1][i - 1] + hilite_dir0[0 + c][j - 1][i] + hilite_dir0[0 + c][j - 1][i + 1] + hilite_dir0[0 + c][j - 1][i + 2]) /
-                                                       (hilite_dir0[0 + 3][j - 1][i - 2] + hilite_dir0[0 + 3][j - 1][i - 1] + hilite_dir0[0 + 3][j - 1][i] + hilite_dir0[0 + 3][j - 1][i + 1] + hilite_dir0[0 + 3][j - 1][i + 2] + epsilon));
+            for (int j = 0; j < hfw; ++j) {
+                for (int c = 0; c < 4; ++c) {
+                    for (int i = 0; i < hfh; ++i) {
+                        hiliteT[c][j][i] = hilite[c][i][j];
                     }
                 }
+            }
 
-                if (hilite[3][2][j] <= epsilon) {
-                    hilite_dir[0 + c][0][j]  = hilite_dir0[c][j][2];
-                }
+            //from left
+            processRows(1, hfw - 2, 2, hfh - 2, [&](int j, int start, int end) {
+                const float* const src[4] = {hiliteT[0][j], hiliteT[1][j], hiliteT[2][j], hiliteT[3][j]};
+                const float* const prev[3] = {hilite_dir0[0][j - 1], hilite_dir0[1][j - 1], hilite_dir0[2][j - 1]};
+                float* const dst[3] = {hilite_dir0[0][j], hilite_dir0[1][j], hilite_dir0[2][j]};
+                propagateRow(src, prev, hilite_dir0[3][j - 1], dst, hilite_dir0[3][j], start, end, epsilon);
+            });
 
-                if (hilite[3][3][j] <= epsilon) {
-                    hilite_dir[0 + c][1][j]  = hilite_dir0[c][j][3];
-                }
+            for (int c = 0; c < 4; ++c) {
+                for (int j = 1; j < hfw - 1; ++j) {
+                    if (hilite[3][2][j] <= epsilon) {
+                        hilite_dir[0 + c][0][j]  = hilite_dir0[c][j][2];
+                    }
 
-                if (hilite[3][hfh - 3][j] <= epsilon) {
-                    hilite_dir[4 + c][hfh - 1][j] = hilite_dir0[c][j][hfh - 3];
-                }
+                    if (hilite[3][3][j] <= epsilon) {
+                        hilite_dir[0 + c][1][j]  = hilite_dir0[c][j][3];
+                    }
 
-                if (hilite[3][hfh - 4][j] <= epsilon) {
-                    hilite_dir[4 + c][hfh - 2][j] = hilite_dir0[c][j][hfh - 4];
-                }
-            }
+                    if (hilite[3][hfh - 3][j] <= epsilon) {
+                        hilite_dir[4 + c][hfh - 1][j] = hilite_dir0[c][j][hfh - 3];
+                    }
 
-            for (int i = 2; i < hfh - 2; ++i) {
-                if (hilite[3][i][hfw - 2] <= epsilon) {
-                    hilite_dir4[c][hfw - 1][i] = hilite_dir0[c][hfw - 2][i];
+                    if (hilite[3][hfh - 4][j] <= epsilon) {
+                        hilite_dir[4 + c][hfh - 2][j] = hilite_dir0[c][j][hfh - 4];
+                    }
                 }
-            }
-        }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            for (int j = hfw - 2; j > 0; --j) {
                 for (int i = 2; i < hfh - 2; ++i) {
-                    //from right
-                    if (hilite[3][i][j] > epsilon) {
-                        hilite_dir4[3][j][i] = 1.f;
-                    } else {
-                        hilite_dir4[3][j][i] = (hilite_dir4[3][(j + 1)][(i - 2)] + hilite_dir4[3][(j + 1)][(i - 1)] + hilite_dir4[3][(j + 1)][(i)] + hilite_dir4[3][(j + 1)][(i + 1)] + hilite_dir4[3][(j + 1)][(i + 2)]) == 0.f ? 0.f : 0.1f;
+                    if (hilite[3][i][hfw - 2] <= epsilon) {
+                        hilite_dir4[c][hfw - 1][i] = hilite_dir0[c][hfw - 2][i];
                     }
                 }
-
-                if (hilite[3][2][j] <= epsilon) {
-                    hilite_dir[0 + 3][0][j] += hilite_dir4[3][j][2];
-                }
-
-                if (hilite[3][hfh - 3][j] <= epsilon) {
-                    hilite_dir[4 + 3][hfh - 1][j] += hilite_dir4[3][j][hfh - 3];
-                }
             }
 
-            for (int i = 2; i < hfh - 2; ++i) {
-                if (hilite[3][i][0] <= epsilon) {
-                    hilite_dir[0 + 3][i - 2][0] += hilite_dir4[3][0][i];
-                    hilite_dir[4 + 3][i + 2][0] += hilite_dir4[3][0][i];
-                }
-
-                if (hilite[3][i][1] <= epsilon) {
-                    hilite_dir[0 + 3][i - 2][1] += hilite_dir4[3][1][i];
-                    hilite_dir[4 + 3][i + 2][1] += hilite_dir4[3][1][i];
-                }
-
-                if (hilite[3][i][hfw - 2] <= epsilon) {
-                    hilite_dir[0 + 3][i - 2][hfw - 2] += hilite_dir4[3][hfw - 2][i];
-                    hilite_dir[4 + 3][i + 2][hfw - 2] += hilite_dir4[3][hfw - 2][i];
-                }
+            if (plistener) {
+                progress += 0.05 * progressScale;
+                plistener->setProgress(progress);
             }
+
+            //from right
+            processRows(hfw - 2, 1, 2, hfh - 2, [&](int j, int start, int end) {
+                const float* const src[4] = {hiliteT[0][j], hiliteT[1][j], hiliteT[2][j], hiliteT[3][j]};
+                const float* const prev[3] = {hilite_dir4[0][j + 1], hilite_dir4[1][j + 1], hilite_dir4[2][j + 1]};
+                float* const dst[3] = {hilite_dir4[0][j], hilite_dir4[1][j], hilite_dir4[2][j]};
+                propagateRow(src, prev, hilite_dir4[3][j + 1], dst, hilite_dir4[3][j], start, end, epsilon);
+            });
         }
-    }
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
 
-#ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-#ifdef _OPENMP
-        #pragma omp for nowait
-#endif
-        for (int c = 0; c < 3; ++c) {
+        for (int c = 0; c < 4; ++c) {
             for (int j = hfw - 2; j > 0; --j) {
-                for (int i = 2; i < hfh - 2; ++i) {
-                    //from right
-                    if (hilite[3][i][j] > epsilon) {
-                        hilite_dir4[c][j][i] = hilite[c][i][j] / hilite[3][i][j];
-                    } else {
-                        hilite_dir4[c][j][i] = 0.1f * ((hilite_dir4[c][(j + 1)][(i - 2)] + hilite_dir4[c][(j + 1)][(i - 1)] + hilite_dir4[c][(j + 1)][(i)] + hilite_dir4[c][(j + 1)][(i + 1)] + hilite_dir4[c][(j + 1)][(i + 2)]) /
-                                                      (hilite_dir4[3][(j + 1)][(i - 2)] + hilite_dir4[3][(j + 1)][(i - 1)] + hilite_dir4[3][(j + 1)][(i)] + hilite_dir4[3][(j + 1)][(i + 1)] + hilite_dir4[3][(j + 1)][(i + 2)] + epsilon));
-                    }
-                }
-
                 if (hilite[3][2][j] <= epsilon) {
                     hilite_dir[0 + c][0][j] += hilite_dir4[c][j][2];
                 }
@@ -754,52 +873,20 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
             }
         }
 
-#ifdef _OPENMP
-        #pragma omp single
-#endif
-        {
-            for (int i = 1; i < hfh - 1; ++i)
-                for (int j = 2; j < hfw - 2; ++j) {
-                    //from top
-                    if (hilite[3][i][j] > epsilon) {
-                        hilite_dir[0 + 3][i][j] = 1.f;
-                    } else {
-                        hilite_dir[0 + 3][i][j] = (hilite_dir[0 + 3][i - 1][j - 2] + hilite_dir[0 + 3][i - 1][j - 1] + hilite_dir[0 + 3][i - 1][j] + hilite_dir[0 + 3][i - 1][j + 1] + hilite_dir[0 + 3][i - 1][j + 2]) == 0.f ? 0.f : 0.1f;
-                    }
-                }
-
-            for (int j = 2; j < hfw - 2; ++j) {
-                if (hilite[3][hfh - 2][j] <= epsilon) {
-                    hilite_dir[4 + 3][hfh - 1][j] += hilite_dir[0 + 3][hfh - 2][j];
-                }
-            }
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
         }
-    }
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
 
-#ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-#ifdef _OPENMP
-        #pragma omp for nowait
-#endif
-        for (int c = 0; c < 3; ++c) {
-            for (int i = 1; i < hfh - 1; ++i) {
-                for (int j = 2; j < hfw - 2; ++j) {
-                    //from top
-                    if (hilite[3][i][j] > epsilon) {
-                        hilite_dir[0 + c][i][j] = hilite[c][i][j] / hilite[3][i][j];
-                    } else {
-                        hilite_dir[0 + c][i][j] = 0.1f * ((hilite_dir[0 + c][i - 1][j - 2] + hilite_dir[0 + c][i - 1][j - 1] + hilite_dir[0 + c][i - 1][j] + hilite_dir[0 + c][i - 1][j + 1] + hilite_dir[0 + c][i - 1][j + 2]) /
-                                                         (hilite_dir[0 + 3][i - 1][j - 2] + hilite_dir[0 + 3][i - 1][j - 1] + hilite_dir[0 + 3][i - 1][j] + hilite_dir[0 + 3][i - 1][j + 1] + hilite_dir[0 + 3][i - 1][j + 2] + epsilon));
-                    }
-                }
-            }
+        //from top
+        processRows(1, hfh - 2, 2, hfw - 2, [&](int i, int start, int end) {
+            const float* const src[4] = {hilite[0][i], hilite[1][i], hilite[2][i], hilite[3][i]};
+            const float* const prev[3] = {hilite_dir[0][i - 1], hilite_dir[1][i - 1], hilite_dir[2][i - 1]};
+            float* const dst[3] = {hilite_dir[0][i], hilite_dir[1][i], hilite_dir[2][i]};
+            propagateRow(src, prev, hilite_dir[3][i - 1], dst, hilite_dir[3][i], start, end, epsilon);
+        });
 
+        for (int c = 0; c < 4; ++c) {
             for (int j = 2; j < hfw - 2; ++j) {
                 if (hilite[3][hfh - 2][j] <= epsilon) {
                     hilite_dir[4 + c][hfh - 1][j] += hilite_dir[0 + c][hfh - 2][j];
@@ -807,316 +894,316 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
             }
         }
 
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
+        }
+
+        //from bottom
+        {
+            // the colours are extended using the weights of propagateRow, the final weights are relative to their neighbours
+            array2D<float> weight(hfw, hfh);
 
 #ifdef _OPENMP
-        #pragma omp single
+            #pragma omp parallel for
 #endif
-        for (int i = hfh - 2; i > 0; --i) {
-            for (int j = 2; j < hfw - 2; ++j) {
-                //from bottom
-                if (hilite[3][i][j] > epsilon) {
-                    hilite_dir[4 + 3][i][j] = 1.f;
-                } else {
-                    hilite_dir[4 + 3][i][j] = (hilite_dir[4 + 3][(i + 1)][(j - 2)] + hilite_dir[4 + 3][(i + 1)][(j - 1)] + hilite_dir[4 + 3][(i + 1)][(j)] + hilite_dir[4 + 3][(i + 1)][(j + 1)] + hilite_dir[4 + 3][(i + 1)][(j + 2)]) == 0.f ? 0.f : 0.1f;
+            for (int i = 0; i < hfh; ++i) {
+                for (int j = 0; j < hfw; ++j) {
+                    weight[i][j] = hilite_dir[4 + 3][i][j];
                 }
             }
-        }
-    }
 
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
+            processRows(hfh - 2, 1, 2, hfw - 2, [&](int i, int start, int end) {
+                const float* const src[4] = {hilite[0][i], hilite[1][i], hilite[2][i], hilite[3][i]};
+                const float* const prev[3] = {hilite_dir[4 + 0][i + 1], hilite_dir[4 + 1][i + 1], hilite_dir[4 + 2][i + 1]};
+                float* const dst[3] = {hilite_dir[4 + 0][i], hilite_dir[4 + 1][i], hilite_dir[4 + 2][i]};
+                propagateRow(src, prev, hilite_dir[4 + 3][i + 1], dst, hilite_dir[4 + 3][i], start, end, epsilon);
+                propagateWeightRow(hilite[3][i], weight[i + 1], weight[i], start, end, epsilon);
+            });
 
 #ifdef _OPENMP
-    #pragma omp parallel for
+            #pragma omp parallel for
 #endif
-    for (int c = 0; c < 4; ++c) {
-        for (int i = hfh - 2; i > 0; --i) {
-            for (int j = 2; j < hfw - 2; ++j) {
-                //from bottom
-                if (hilite[3][i][j] > epsilon) {
-                    hilite_dir[4 + c][i][j] = hilite[c][i][j] / hilite[3][i][j];
-                } else {
-                    hilite_dir[4 + c][i][j] = 0.1f * ((hilite_dir[4 + c][(i + 1)][(j - 2)] + hilite_dir[4 + c][(i + 1)][(j - 1)] + hilite_dir[4 + c][(i + 1)][(j)] + hilite_dir[4 + c][(i + 1)][(j + 1)] + hilite_dir[4 + c][(i + 1)][(j + 2)]) /
-                                                     (hilite_dir[4 + 3][(i + 1)][(j - 2)] + hilite_dir[4 + 3][(i + 1)][(j - 1)] + hilite_dir[4 + 3][(i + 1)][(j)] + hilite_dir[4 + 3][(i + 1)][(j + 1)] + hilite_dir[4 + 3][(i + 1)][(j + 2)] + epsilon));
+            for (int i = 0; i < hfh; ++i) {
+                for (int j = 0; j < hfw; ++j) {
+                    hilite_dir[4 + 3][i][j] = weight[i][j];
                 }
             }
         }
-    }
 
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
+        }
+
+        //fill in edges
+        for (int dir = 0; dir < 2; ++dir) {
+            for (int i = 1; i < hfh - 1; ++i) {
+                for (int c = 0; c < 4; ++c) {
+                    hilite_dir[dir * 4 + c][i][0] = hilite_dir[dir * 4 + c][i][1];
+                    hilite_dir[dir * 4 + c][i][hfw - 1] = hilite_dir[dir * 4 + c][i][hfw - 2];
+                }
+            }
+
+            for (int j = 1; j < hfw - 1; ++j) {
+                for (int c = 0; c < 4; ++c) {
+                    hilite_dir[dir * 4 + c][0][j] = hilite_dir[dir * 4 + c][1][j];
+                    hilite_dir[dir * 4 + c][hfh - 1][j] = hilite_dir[dir * 4 + c][hfh - 2][j];
+                }
+            }
+
+            for (int c = 0; c < 4; ++c) {
+                hilite_dir[dir * 4 + c][0][0] = hilite_dir[dir * 4 + c][1][0] = hilite_dir[dir * 4 + c][0][1] = hilite_dir[dir * 4 + c][1][1] = hilite_dir[dir * 4 + c][2][2];
+                hilite_dir[dir * 4 + c][0][hfw - 1] = hilite_dir[dir * 4 + c][1][hfw - 1] = hilite_dir[dir * 4 + c][0][hfw - 2] = hilite_dir[dir * 4 + c][1][hfw - 2] = hilite_dir[dir * 4 + c][2][hfw - 3];
+                hilite_dir[dir * 4 + c][hfh - 1][0] = hilite_dir[dir * 4 + c][hfh - 2][0] = hilite_dir[dir * 4 + c][hfh - 1][1] = hilite_dir[dir * 4 + c][hfh - 2][1] = hilite_dir[dir * 4 + c][hfh - 3][2];
+                hilite_dir[dir * 4 + c][hfh - 1][hfw - 1] = hilite_dir[dir * 4 + c][hfh - 2][hfw - 1] = hilite_dir[dir * 4 + c][hfh - 1][hfw - 2] = hilite_dir[dir * 4 + c][hfh - 2][hfw - 2] = hilite_dir[dir * 4 + c][hfh - 3][hfw - 3];
+            }
+        }
 
-    //fill in edges
-    for (int dir = 0; dir < 2; ++dir) {
         for (int i = 1; i < hfh - 1; ++i) {
             for (int c = 0; c < 4; ++c) {
-                hilite_dir[dir * 4 + c][i][0] = hilite_dir[dir * 4 + c][i][1];
-                hilite_dir[dir * 4 + c][i][hfw - 1] = hilite_dir[dir * 4 + c][i][hfw - 2];
+                hilite_dir0[c][0][i] = hilite_dir0[c][1][i];
+                hilite_dir0[c][hfw - 1][i] = hilite_dir0[c][hfw - 2][i];
             }
         }
 
         for (int j = 1; j < hfw - 1; ++j) {
             for (int c = 0; c < 4; ++c) {
-                hilite_dir[dir * 4 + c][0][j] = hilite_dir[dir * 4 + c][1][j];
-                hilite_dir[dir * 4 + c][hfh - 1][j] = hilite_dir[dir * 4 + c][hfh - 2][j];
+                hilite_dir0[c][j][0] = hilite_dir0[c][j][1];
+                hilite_dir0[c][j][hfh - 1] = hilite_dir0[c][j][hfh - 2];
             }
         }
 
         for (int c = 0; c < 4; ++c) {
-            hilite_dir[dir * 4 + c][0][0] = hilite_dir[dir * 4 + c][1][0] = hilite_dir[dir * 4 + c][0][1] = hilite_dir[dir * 4 + c][1][1] = hilite_dir[dir * 4 + c][2][2];
-            hilite_dir[dir * 4 + c][0][hfw - 1] = hilite_dir[dir * 4 + c][1][hfw - 1] = hilite_dir[dir * 4 + c][0][hfw - 2] = hilite_dir[dir * 4 + c][1][hfw - 2] = hilite_dir[dir * 4 + c][2][hfw - 3];
-            hilite_dir[dir * 4 + c][hfh - 1][0] = hilite_dir[dir * 4 + c][hfh - 2][0] = hilite_dir[dir * 4 + c][hfh - 1][1] = hilite_dir[dir * 4 + c][hfh - 2][1] = hilite_dir[dir * 4 + c][hfh - 3][2];
-            hilite_dir[dir * 4 + c][hfh - 1][hfw - 1] = hilite_dir[dir * 4 + c][hfh - 2][hfw - 1] = hilite_dir[dir * 4 + c][hfh - 1][hfw - 2] = hilite_dir[dir * 4 + c][hfh - 2][hfw - 2] = hilite_dir[dir * 4 + c][hfh - 3][hfw - 3];
+            hilite_dir0[c][0][0] = hilite_dir0[c][0][1] = hilite_dir0[c][1][0] = hilite_dir0[c][1][1] = hilite_dir0[c][2][2];
+            hilite_dir0[c][hfw - 1][0] = hilite_dir0[c][hfw - 1][1] = hilite_dir0[c][hfw - 2][0] = hilite_dir0[c][hfw - 2][1] = hilite_dir0[c][hfw - 3][2];
+            hilite_dir0[c][0][hfh - 1] = hilite_dir0[c][0][hfh - 2] = hilite_dir0[c][1][hfh - 1] = hilite_dir0[c][1][hfh - 2] = hilite_dir0[c][2][hfh - 3];
+            hilite_dir0[c][hfw - 1][hfh - 1] = hilite_dir0[c][hfw - 1][hfh - 2] = hilite_dir0[c][hfw - 2][hfh - 1] = hilite_dir0[c][hfw - 2][hfh - 2] = hilite_dir0[c][hfw - 3][hfh - 3];
         }
-    }
 
-    for (int i = 1; i < hfh - 1; ++i) {
-        for (int c = 0; c < 4; ++c) {
-            hilite_dir0[c][0][i] = hilite_dir0[c][1][i];
-            hilite_dir0[c][hfw - 1][i] = hilite_dir0[c][hfw - 2][i];
+        for (int i = 1; i < hfh - 1; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                hilite_dir4[c][0][i] = hilite_dir4[c][1][i];
+                hilite_dir4[c][hfw - 1][i] = hilite_dir4[c][hfw - 2][i];
+            }
         }
-    }
 
-    for (int j = 1; j < hfw - 1; ++j) {
-        for (int c = 0; c < 4; ++c) {
-            hilite_dir0[c][j][0] = hilite_dir0[c][j][1];
-            hilite_dir0[c][j][hfh - 1] = hilite_dir0[c][j][hfh - 2];
+        for (int j = 1; j < hfw - 1; ++j) {
+            for (int c = 0; c < 4; ++c) {
+                hilite_dir4[c][j][0] = hilite_dir4[c][j][1];
+                hilite_dir4[c][j][hfh - 1] = hilite_dir4[c][j][hfh - 2];
+            }
         }
-    }
 
-    for (int c = 0; c < 4; ++c) {
-        hilite_dir0[c][0][0] = hilite_dir0[c][0][1] = hilite_dir0[c][1][0] = hilite_dir0[c][1][1] = hilite_dir0[c][2][2];
-        hilite_dir0[c][hfw - 1][0] = hilite_dir0[c][hfw - 1][1] = hilite_dir0[c][hfw - 2][0] = hilite_dir0[c][hfw - 2][1] = hilite_dir0[c][hfw - 3][2];
-        hilite_dir0[c][0][hfh - 1] = hilite_dir0[c][0][hfh - 2] = hilite_dir0[c][1][hfh - 1] = hilite_dir0[c][1][hfh - 2] = hilite_dir0[c][2][hfh - 3];
-        hilite_dir0[c][hfw - 1][hfh - 1] = hilite_dir0[c][hfw - 1][hfh - 2] = hilite_dir0[c][hfw - 2][hfh - 1] = hilite_dir0[c][hfw - 2][hfh - 2] = hilite_dir0[c][hfw - 3][hfh - 3];
-    }
-
-    for (int i = 1; i < hfh - 1; ++i) {
         for (int c = 0; c < 4; ++c) {
-            hilite_dir4[c][0][i] = hilite_dir4[c][1][i];
-            hilite_dir4[c][hfw - 1][i] = hilite_dir4[c][hfw - 2][i];
+            hilite_dir4[c][0][0] = hilite_dir4[c][0][1] = hilite_dir4[c][1][0] = hilite_dir4[c][1][1] = hilite_dir4[c][2][2];
+            hilite_dir4[c][hfw - 1][0] = hilite_dir4[c][hfw - 1][1] = hilite_dir4[c][hfw - 2][0] = hilite_dir4[c][hfw - 2][1] = hilite_dir4[c][hfw - 3][2];
+            hilite_dir4[c][0][hfh - 1] = hilite_dir4[c][0][hfh - 2] = hilite_dir4[c][1][hfh - 1] = hilite_dir4[c][1][hfh - 2] = hilite_dir4[c][2][hfh - 3];
+            hilite_dir4[c][hfw - 1][hfh - 1] = hilite_dir4[c][hfw - 1][hfh - 2] = hilite_dir4[c][hfw - 2][hfh - 1] = hilite_dir4[c][hfw - 2][hfh - 2] = hilite_dir4[c][hfw - 3][hfh - 3];
         }
-    }
 
-    for (int j = 1; j < hfw - 1; ++j) {
-        for (int c = 0; c < 4; ++c) {
-            hilite_dir4[c][j][0] = hilite_dir4[c][j][1];
-            hilite_dir4[c][j][hfh - 1] = hilite_dir4[c][j][hfh - 2];
+        if (plistener) {
+            progress += 0.05 * progressScale;
+            plistener->setProgress(progress);
         }
-    }
-
-    for (int c = 0; c < 4; ++c) {
-        hilite_dir4[c][0][0] = hilite_dir4[c][0][1] = hilite_dir4[c][1][0] = hilite_dir4[c][1][1] = hilite_dir4[c][2][2];
-        hilite_dir4[c][hfw - 1][0] = hilite_dir4[c][hfw - 1][1] = hilite_dir4[c][hfw - 2][0] = hilite_dir4[c][hfw - 2][1] = hilite_dir4[c][hfw - 3][2];
-        hilite_dir4[c][0][hfh - 1] = hilite_dir4[c][0][hfh - 2] = hilite_dir4[c][1][hfh - 1] = hilite_dir4[c][1][hfh - 2] = hilite_dir4[c][2][hfh - 3];
-        hilite_dir4[c][hfw - 1][hfh - 1] = hilite_dir4[c][hfw - 1][hfh - 2] = hilite_dir4[c][hfw - 2][hfh - 1] = hilite_dir4[c][hfw - 2][hfh - 2] = hilite_dir4[c][hfw - 3][hfh - 3];
-    }
-
-    if (plistener) {
-        progress += 0.05;
-        plistener->setProgress(progress);
-    }
 
-    //free up some memory
-    for (int c = 0; c < 4; ++c) {
-        hilite[c].free();
-    }
+        //free up some memory
+        for (int c = 0; c < 4; ++c) {
+            hilite[c].free();
+        }
 
-    //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-    // now reconstruct clipped channels using color ratios
+        //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+        // now reconstruct clipped channels using color ratios
 
 #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic,16)
+        #pragma omp parallel for schedule(dynamic,16)
 #endif
-    for (int i = 0; i < blurHeight; ++i) {
-        const int i1 = min((i - i % pitch) / pitch, hfh - 1);
-
-        for (int j = 0; j < blurWidth; ++j) {
-            const float pixel[3] = {
-                red[i + miny][j + minx],
-                green[i + miny][j + minx],
-                blue[i + miny][j + minx]
-            };
-
-            if (pixel[0] < max_f[0] && pixel[1] < max_f[1] && pixel[2] < max_f[2]) {
-                continue;    //pixel not clipped
-            }
+        for (int i = 0; i < blurHeight; ++i) {
+            const int i1 = min((i - i % pitch) / pitch, hfh - 1);
+
+            for (int j = 0; j < blurWidth; ++j) {
+                const float pixel[3] = {
+                    red[i + miny][j + minx],
+                    green[i + miny][j + minx],
+                    blue[i + miny][j + minx]
+                };
 
-            const int j1 = min((j - j % pitch) / pitch, hfw - 1);
+                if (pixel[0] < max_f[0] && pixel[1] < max_f[1] && pixel[2] < max_f[2]) {
+                    continue;    //pixel not clipped
+                }
 
-            //estimate recovered values using modified HLRecovery_blend algorithm
-            float rgb[3] = {
-                pixel[0],
-                pixel[1],
-                pixel[2]
-            };// Copy input pixel to rgb so it's easier to access in loops
-            float rgb_blend[3] = {};
-            float cam[2][3];
-            float lab[2][3];
-            float sum[2];
+                const int j1 = min((j - j % pitch) / pitch, hfw - 1);
 
-            // Initialize cam with raw input [0] and potentially clipped input [1]
-            for (int c = 0; c < 3; ++c) {
-                cam[0][c] = rgb[c];
-                cam[1][c] = min(cam[0][c], clippt);
-            }
+                //estimate recovered values using modified HLRecovery_blend algorithm
+                float rgb[3] = {
+                    pixel[0],
+                    pixel[1],
+                    pixel[2]
+                };// Copy input pixel to rgb so it's easier to access in loops
+                float rgb_blend[3] = {};
+                float cam[2][3];
+                float lab[2][3];
+                float sum[2];
 
-            // Calculate the lightness correction ratio (chratio)
-            for (int i2 = 0; i2 < 2; ++i2) {
+                // Initialize cam with raw input [0] and potentially clipped input [1]
                 for (int c = 0; c < 3; ++c) {
-                    lab[i2][c] = 0;
-
-                    for (int j2 = 0; j2 < 3; ++j2) {
-                        lab[i2][c] += trans[c][j2] * cam[i2][j2];
-                    }
+                    cam[0][c] = rgb[c];
+                    cam[1][c] = min(cam[0][c], clippt);
                 }
 
-                sum[i2] = 0.f;
+                // Calculate the lightness correction ratio (chratio)
+                for (int i2 = 0; i2 < 2; ++i2) {
+                    for (int c = 0; c < 3; ++c) {
+                        lab[i2][c] = 0;
 
-                for (int c = 1; c < 3; ++c) {
-                    sum[i2] += SQR(lab[i2][c]);
-                }
-            }
+                        for (int j2 = 0; j2 < 3; ++j2) {
+                            lab[i2][c] += trans[c][j2] * cam[i2][j2];
+                        }
+                    }
 
-            // avoid division by zero
-            sum[0] = std::max(sum[0], epsilon);
+                    sum[i2] = 0.f;
 
-            const float chratio = sqrtf(sum[1] / sum[0]);
+                    for (int c = 1; c < 3; ++c) {
+                        sum[i2] += SQR(lab[i2][c]);
+                    }
+                }
 
-            // Apply ratio to lightness in lab space
-            for (int c = 1; c < 3; ++c) {
-                lab[0][c] *= chratio;
-            }
+                // avoid division by zero
+                sum[0] = std::max(sum[0], epsilon);
 
-            // Transform back from lab to RGB
-            for (int c = 0; c < 3; ++c) {
-                cam[0][c] = 0.f;
+                const float chratio = sqrtf(sum[1] / sum[0]);
 
-                for (int j2 = 0; j2 < 3; ++j2) {
-                    cam[0][c] += itrans[c][j2] * lab[0][j2];
+                // Apply ratio to lightness in lab space
+                for (int c = 1; c < 3; ++c) {
+                    lab[0][c] *= chratio;
                 }
-            }
 
-            for (int c = 0; c < 3; ++c) {
-                rgb[c] = cam[0][c] / 3;
-            }
+                // Transform back from lab to RGB
+                for (int c = 0; c < 3; ++c) {
+                    cam[0][c] = 0.f;
 
-            // Copy converted pixel back
-            if (pixel[0] > blendpt) {
-                const float rfrac = LIM01(medFactor[0] * (pixel[0] - blendpt));
-                rgb_blend[0] = rfrac * rgb[0] + (1.f - rfrac) * pixel[0];
-            }
+                    for (int j2 = 0; j2 < 3; ++j2) {
+                        cam[0][c] += itrans[c][j2] * lab[0][j2];
+                    }
+                }
 
-            if (pixel[1] > blendpt) {
-                const float gfrac = LIM01(medFactor[1] * (pixel[1] - blendpt));
-                rgb_blend[1] = gfrac * rgb[1] + (1.f - gfrac) * pixel[1];
-            }
+                for (int c = 0; c < 3; ++c) {
+                    rgb[c] = cam[0][c] / 3;
+                }
 
-            if (pixel[2] > blendpt) {
-                const float bfrac = LIM01(medFactor[2] * (pixel[2] - blendpt));
-                rgb_blend[2] = bfrac * rgb[2] + (1.f - bfrac) * pixel[2];
-            }
+                // Copy converted pixel back
+                if (pixel[0] > blendpt) {
+                    const float rfrac = LIM01(medFactor[0] * (pixel[0] - blendpt));
+                    rgb_blend[0] = rfrac * rgb[0] + (1.f - rfrac) * pixel[0];
+                }
 
-            //end of HLRecovery_blend estimation
-            //%%%%%%%%%%%%%%%%%%%%%%%
+                if (pixel[1] > blendpt) {
+                    const float gfrac = LIM01(medFactor[1] * (pixel[1] - blendpt));
+                    rgb_blend[1] = gfrac * rgb[1] + (1.f - gfrac) * pixel[1];
+                }
 
-            //there are clipped highlights
-            //first, determine weighted average of unclipped extensions (weighting is by 'hue' proximity)
-            bool totwt = false;
-            float clipfix[3] = {0.f, 0.f, 0.f};
+                if (pixel[2] > blendpt) {
+                    const float bfrac = LIM01(medFactor[2] * (pixel[2] - blendpt));
+                    rgb_blend[2] = bfrac * rgb[2] + (1.f - bfrac) * pixel[2];
+                }
 
-            float Y = epsilon + rgb_blend[0] + rgb_blend[1] + rgb_blend[2];
+                //end of HLRecovery_blend estimation
+                //%%%%%%%%%%%%%%%%%%%%%%%
 
-            for (int c = 0; c < 3; ++c) {
-                rgb_blend[c] /= Y;
-            }
+                //there are clipped highlights
+                //first, determine weighted average of unclipped extensions (weighting is by 'hue' proximity)
+                bool totwt = false;
+                float clipfix[3] = {0.f, 0.f, 0.f};
 
-            float Yhi = 1.f / (hilite_dir0[0][j1][i1] + hilite_dir0[1][j1][i1] + hilite_dir0[2][j1][i1]);
+                float Y = epsilon + rgb_blend[0] + rgb_blend[1] + rgb_blend[2];
 
-            if (Yhi < 2.f) {
-                const float dirwt = 1.f / ((1.f + 65535.f * (SQR(rgb_blend[0] - hilite_dir0[0][j1][i1] * Yhi) +
-                                                      SQR(rgb_blend[1] - hilite_dir0[1][j1][i1] * Yhi) +
-                                                      SQR(rgb_blend[2] - hilite_dir0[2][j1][i1] * Yhi))) * (hilite_dir0[3][j1][i1] + epsilon));
-                totwt = true;
-                clipfix[0] = dirwt * hilite_dir0[0][j1][i1];
-                clipfix[1] = dirwt * hilite_dir0[1][j1][i1];
-                clipfix[2] = dirwt * hilite_dir0[2][j1][i1];
-            }
+                for (int c = 0; c < 3; ++c) {
+                    rgb_blend[c] /= Y;
+                }
 
-            for (int dir = 0; dir < 2; ++dir) {
-                const float Yhi2 = 1.f / ( hilite_dir[dir * 4 + 0][i1][j1] + hilite_dir[dir * 4 + 1][i1][j1] + hilite_dir[dir * 4 + 2][i1][j1]);
+                float Yhi = 1.f / (hilite_dir0[0][j1][i1] + hilite_dir0[1][j1][i1] + hilite_dir0[2][j1][i1]);
 
-                if (Yhi2 < 2.f) {
-                    const float dirwt = 1.f / ((1.f + 65535.f * (SQR(rgb_blend[0] - hilite_dir[dir * 4 + 0][i1][j1] * Yhi2) +
-                                                          SQR(rgb_blend[1] - hilite_dir[dir * 4 + 1][i1][j1] * Yhi2) +
-                                                          SQR(rgb_blend[2] - hilite_dir[dir * 4 + 2][i1][j1] * Yhi2))) * (hilite_dir[dir * 4 + 3][i1][j1] + epsilon));
+                if (Yhi < 2.f) {
+                    const float dirwt = 1.f / ((1.f + 65535.f * (SQR(rgb_blend[0] - hilite_dir0[0][j1][i1] * Yhi) +
+                                                          SQR(rgb_blend[1] - hilite_dir0[1][j1][i1] * Yhi) +
+                                                          SQR(rgb_blend[2] - hilite_dir0[2][j1][i1] * Yhi))) * (hilite_dir0[3][j1][i1] + epsilon));
                     totwt = true;
-                    clipfix[0] += dirwt * hilite_dir[dir * 4 + 0][i1][j1];
-                    clipfix[1] += dirwt * hilite_dir[dir * 4 + 1][i1][j1];
-                    clipfix[2] += dirwt * hilite_dir[dir * 4 + 2][i1][j1];
+                    clipfix[0] = dirwt * hilite_dir0[0][j1][i1];
+                    clipfix[1] = dirwt * hilite_dir0[1][j1][i1];
+                    clipfix[2] = dirwt * hilite_dir0[2][j1][i1];
                 }
-            }
-
-
-            Yhi = 1.f / (hilite_dir4[0][j1][i1] + hilite_dir4[1][j1][i1] + hilite_dir4[2][j1][i1]);
 
-            if (Yhi < 2.f) {
-                const float dirwt = 1.f / ((1.f + 65535.f * (SQR(rgb_blend[0] - hilite_dir4[0][j1][i1] * Yhi) +
-                                                      SQR(rgb_blend[1] - hilite_dir4[1][j1][i1] * Yhi) +
-                                                      SQR(rgb_blend[2] - hilite_dir4[2][j1][i1] * Yhi))) * (hilite_dir4[3][j1][i1] + epsilon));
-                totwt = true;
-                clipfix[0] += dirwt * hilite_dir4[0][j1][i1];
-                clipfix[1] += dirwt * hilite_dir4[1][j1][i1];
-                clipfix[2] += dirwt * hilite_dir4[2][j1][i1];
-            }
+                for (int dir = 0; dir < 2; ++dir) {
+                    const float Yhi2 = 1.f / ( hilite_dir[dir * 4 + 0][i1][j1] + hilite_dir[dir * 4 + 1][i1][j1] + hilite_dir[dir * 4 + 2][i1][j1]);
+
+                    if (Yhi2 < 2.f) {
+                        const float dirwt = 1.f / ((1.f + 65535.f * (SQR(rgb_blend[0] - hilite_dir[dir * 4 + 0][i1][j1] * Yhi2) +
+                                                              SQR(rgb_blend[1] - hilite_dir[dir * 4 + 1][i1][j1] * Yhi2) +
+                                                              SQR(rgb_blend[2] - hilite_dir[dir * 4 + 2][i1][j1] * Yhi2))) * (hilite_dir[dir * 4 + 3][i1][j1] + epsilon));
+                        totwt = true;
+                        clipfix[0] += dirwt * hilite_dir[dir * 4 + 0][i1][j1];
+                        clipfix[1] += dirwt * hilite_dir[dir * 4 + 1][i1][j1];
+                        clipfix[2] += dirwt * hilite_dir[dir * 4 + 2][i1][j1];
+                    }
+                }
 
-            if (UNLIKELY(!totwt)) {
-                continue;
-            }
 
-            //now correct clipped channels
-            if (pixel[0] > max_f[0] && pixel[1] > max_f[1] && pixel[2] > max_f[2]) {
-                //all channels clipped
-
-                const float mult = whitept / (0.299f * clipfix[0] + 0.587f * clipfix[1] + 0.114f * clipfix[2]);
-                red[i + miny][j + minx]   = clipfix[0] * mult;
-                green[i + miny][j + minx] = clipfix[1] * mult;
-                blue[i + miny][j + minx]  = clipfix[2] * mult;
-            } else {//some channels clipped
-                const float notclipped[3] = {
-                    pixel[0] <= max_f[0] ? 1.f : 0.f,
-                    pixel[1] <= max_f[1] ? 1.f : 0.f,
-                    pixel[2] <= max_f[2] ? 1.f : 0.f
-                };
+                Yhi = 1.f / (hilite_dir4[0][j1][i1] + hilite_dir4[1][j1][i1] + hilite_dir4[2][j1][i1]);
 
-                if (notclipped[0] == 0.f) { //red clipped
-                    red[i + miny][j + minx]  = max(pixel[0], clipfix[0] * ((notclipped[1] * pixel[1] + notclipped[2] * pixel[2]) /
-                                                 (notclipped[1] * clipfix[1] + notclipped[2] * clipfix[2] + epsilon)));
+                if (Yhi < 2.f) {
+                    const float dirwt = 1.f / ((1.f + 65535.f * (SQR(rgb_blend[0] - hilite_dir4[0][j1][i1] * Yhi) +
+                                                          SQR(rgb_blend[1] - hilite_dir4[1][j1][i1] * Yhi) +
+                                                          SQR(rgb_blend[2] - hilite_dir4[2][j1][i1] * Yhi))) * (hilite_dir4[3][j1][i1] + epsilon));
+                    totwt = true;
+                    clipfix[0] += dirwt * hilite_dir4[0][j1][i1];
+                    clipfix[1] += dirwt * hilite_dir4[1][j1][i1];
+                    clipfix[2] += dirwt * hilite_dir4[2][j1][i1];
                 }
 
-                if (notclipped[1] == 0.f) { //green clipped
-                    green[i + miny][j + minx] = max(pixel[1], clipfix[1] * ((notclipped[2] * pixel[2] + notclipped[0] * pixel[0]) /
-                                                    (notclipped[2] * clipfix[2] + notclipped[0] * clipfix[0] + epsilon)));
+                if (UNLIKELY(!totwt)) {
+                    continue;
                 }
 
-                if (notclipped[2] == 0.f) { //blue clipped
-                    blue[i + miny][j + minx]  = max(pixel[2], clipfix[2] * ((notclipped[0] * pixel[0] + notclipped[1] * pixel[1]) /
-                                                   (notclipped[0] * clipfix[0] + notclipped[1] * clipfix[1] + epsilon)));
+                //now correct clipped channels
+                if (pixel[0] > max_f[0] && pixel[1] > max_f[1] && pixel[2] > max_f[2]) {
+                    //all channels clipped
+
+                    const float mult = whitept / (0.299f * clipfix[0] + 0.587f * clipfix[1] + 0.114f * clipfix[2]);
+                    red[i + miny][j + minx]   = clipfix[0] * mult;
+                    green[i + miny][j + minx] = clipfix[1] * mult;
+                    blue[i + miny][j + minx]  = clipfix[2] * mult;
+                } else {//some channels clipped
+                    const float notclipped[3] = {
+                        pixel[0] <= max_f[0] ? 1.f : 0.f,
+                        pixel[1] <= max_f[1] ? 1.f : 0.f,
+                        pixel[2] <= max_f[2] ? 1.f : 0.f
+                    };
+
+                    if (notclipped[0] == 0.f) { //red clipped
+                        red[i + miny][j + minx]  = max(pixel[0], clipfix[0] * ((notclipped[1] * pixel[1] + notclipped[2] * pixel[2]) /
+                                                     (notclipped[1] * clipfix[1] + notclipped[2] * clipfix[2] + epsilon)));
+                    }
+
+                    if (notclipped[1] == 0.f) { //green clipped
+                        green[i + miny][j + minx] = max(pixel[1], clipfix[1] * ((notclipped[2] * pixel[2] + notclipped[0] * pixel[0]) /
+                                                        (notclipped[2] * clipfix[2] + notclipped[0] * clipfix[0] + epsilon)));
+                    }
+
+                    if (notclipped[2] == 0.f) { //blue clipped
+                        blue[i + miny][j + minx]  = max(pixel[2], clipfix[2] * ((notclipped[0] * pixel[0] + notclipped[1] * pixel[1]) /
+                                                       (notclipped[0] * clipfix[0] + notclipped[1] * clipfix[1] + epsilon)));
+                    }
                 }
-            }
 
-            Y = 0.299f * red[i + miny][j + minx] + 0.587f * green[i + miny][j + minx] + 0.114f * blue[i + miny][j + minx];
+                Y = 0.299f * red[i + miny][j + minx] + 0.587f * green[i + miny][j + minx] + 0.114f * blue[i + miny][j + minx];
 
-            if (Y > whitept) {
-                const float mult = whitept / Y;
+                if (Y > whitept) {
+                    const float mult = whitept / Y;
 
-                red[i + miny][j + minx]   *= mult;
-                green[i + miny][j + minx] *= mult;
-                blue[i + miny][j + minx]  *= mult;
+                    red[i + miny][j + minx]   *= mult;
+                    green[i + miny][j + minx] *= mult;
+                    blue[i + miny][j + minx]  *= mult;
+                }
             }
         }
     }
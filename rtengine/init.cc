@@ -28,6 +28,7 @@
 #include "improccoordinator.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
+#include "fftwplancache.h"
 #include "rtthumbnail.h"
 #include "profilestore.h"
 #include "../rtgui/threadutils.h"
@@ -105,6 +106,7 @@ int init (const Settings* s, Glib::ustring baseDir, Glib::ustring userSettingsDi
     delete lcmsMutex;
     lcmsMutex = new MyMutex;
     fftwMutex = new MyMutex;
+    FFTWPlanCache::getInstance().init();
     return 0;
 }
 
@@ -113,6 +115,7 @@ void cleanup ()
     ProcParams::cleanup ();
     Color::cleanup ();
     RawImageSource::cleanup ();
+    FFTWPlanCache::getInstance().cleanup();
 
 #ifdef RT_FFTW3F_OMP
     fftwf_cleanup_threads();
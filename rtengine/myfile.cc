@@ -17,6 +17,7 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "myfile.h"
+#include <cerrno>
 #include <cstdarg>
 #include <glibmm.h>
 
@@ -104,23 +105,52 @@ IMFILE* fopen (const char* fname)
         return nullptr;
     }
 
-    void* data = mmap(nullptr, stat_buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-
-    if ( data == MAP_FAILED ) {
-        printf("no mmap %s\n", fname);
-        close(fd);
-        return nullptr;
-    }
+    void* data = stat_buffer.st_size > 0 ? mmap(nullptr, stat_buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
 
     IMFILE* mf = new IMFILE;
 
     memset(mf, 0, sizeof(*mf));
-    mf->fd = fd;
     mf->pos = 0;
     mf->size = stat_buffer.st_size;
-    mf->data = (char*)data;
     mf->eof = false;
 
+    if ( data == MAP_FAILED ) {
+        // e.g. empty files or file systems without mmap support: read the file into memory instead
+        mf->fd = -1;
+        mf->data = new char [mf->size];
+
+        // read() may return less than asked for, so loop until the whole file is in memory
+        bool ok = lseek(fd, 0, SEEK_SET) == 0;
+
+        for (ssize_t done = 0; ok && done < mf->size;) {
+            const auto count = read(fd, mf->data + done, mf->size - done);
+
+            if (count > 0) {
+                done += count;
+            } else if (count == 0 || errno != EINTR) {
+                ok = false;
+            }
+        }
+
+        if (!ok) {
+            printf("no mmap %s\n", fname);
+            close(fd);
+            delete [] mf->data;
+            delete mf;
+            return nullptr;
+        }
+
+        close(fd);
+        return mf;
+    }
+
+    mf->fd = fd;
+    mf->data = (char*)data;
+
+    // identify() seeks around in the file headers and thumbnail extraction only needs
+    // the embedded preview, so don't let the kernel read ahead until a decoder asks for it
+    imfile_advise(mf, IMFILE_ADVICE::RANDOM);
+
     return mf;
 }
 
@@ -299,3 +329,49 @@ void imfile_update_progress(IMFILE *f)
 
     f->plistener->setProgress(p * f->progress_range);
 }
+
+void imfile_advise(IMFILE *f, IMFILE_ADVICE advice, ssize_t offset, ssize_t length)
+{
+#if defined(MYFILE_MMAP) && !defined(WIN32)
+
+    if (f->fd == -1 || offset < 0 || offset >= f->size) {
+        return;
+    }
+
+    if (length <= 0 || offset + length > f->size) {
+        length = f->size - offset;
+    }
+
+    // posix_madvise() needs a page aligned start address
+    static const ssize_t pageSize = sysconf(_SC_PAGESIZE);
+    const ssize_t start = offset - offset % pageSize;
+
+    int posixAdvice = POSIX_MADV_NORMAL;
+
+    switch (advice) {
+        case IMFILE_ADVICE::NORMAL:
+            posixAdvice = POSIX_MADV_NORMAL;
+            break;
+
+        case IMFILE_ADVICE::SEQUENTIAL:
+            posixAdvice = POSIX_MADV_SEQUENTIAL;
+            break;
+
+        case IMFILE_ADVICE::RANDOM:
+            posixAdvice = POSIX_MADV_RANDOM;
+            break;
+
+        case IMFILE_ADVICE::WILLNEED:
+            posixAdvice = POSIX_MADV_WILLNEED;
+            break;
+    }
+
+    posix_madvise(f->data + start, offset + length - start, posixAdvice);
+
+#else
+    (void)f;
+    (void)advice;
+    (void)offset;
+    (void)length;
+#endif
+}
@@ -43,6 +43,19 @@ struct IMFILE {
 void imfile_set_plistener(IMFILE *f, rtengine::ProgressListener *plistener, double progress_range);
 void imfile_update_progress(IMFILE *f);
 
+/*
+  Access pattern hints for memory mapped files, forwarded to posix_madvise().
+  A length of 0 means up to the end of the file. The hints are ignored for files
+  which were read into memory.
+ */
+enum class IMFILE_ADVICE {
+    NORMAL,
+    SEQUENTIAL,
+    RANDOM,
+    WILLNEED
+};
+void imfile_advise(IMFILE *f, IMFILE_ADVICE advice, ssize_t offset = 0, ssize_t length = 0);
+
 IMFILE* fopen (const char* fname);
 IMFILE* gfopen (const char* fname);
 IMFILE* fopen (unsigned* buf, int size);
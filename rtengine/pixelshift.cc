@@ -21,6 +21,8 @@
 ////////////////////////////////////////////////////////////////
 
 #include <cmath>
+#include <stack>
+#include <vector>
 #include "rawimagesource.h"
 #include "../rtgui/multilangmgr.h"
 #include "procparams.h"
@@ -31,6 +33,71 @@
 namespace
 {
 
+// Gives access to two consecutive rows of the four frames. Frames which are kept as 16 bit samples
+// (settings->compactPixelShiftFrames) are converted row by row, so they never have to be expanded as a whole.
+class FrameRows
+{
+public:
+    FrameRows(array2D<float> * const frames[4], array2D<uint16_t> * const frames16[4], const float scale16[4], int width) :
+        frames(frames),
+        frames16(frames16),
+        scale16(scale16),
+        width(width),
+        buffer(frames16[0] || frames16[1] || frames16[2] || frames16[3] ? 4 * 2 * width : 0)
+    {
+        for (int i = 0; i < 4; ++i) {
+            cachedRow[i][0] = cachedRow[i][1] = -1;
+        }
+    }
+
+    // makes the rows row and row + 1 of all frames available
+    void set(int row)
+    {
+        for (int i = 0; i < 4; ++i) {
+            rows[i][0] = getRow(i, row);
+            rows[i][1] = getRow(i, row + 1);
+        }
+    }
+
+    // rowOffset has to be 0 or 1
+    const float* operator()(int frame, int rowOffset) const
+    {
+        return rows[frame][rowOffset];
+    }
+
+private:
+    const float* getRow(int frame, int row)
+    {
+        if (frames[frame]) {
+            return (*frames[frame])[row];
+        }
+
+        // odd and even rows have their own slot in the buffer, so the row shared with the previous call to set() is converted only once
+        float *dst = &buffer[(2 * frame + (row & 1)) * width];
+
+        if (cachedRow[frame][row & 1] != row) {
+            const uint16_t *src = (*frames16[frame])[row];
+            const float scale = scale16[frame];
+
+            for (int j = 0; j < width; ++j) {
+                dst[j] = src[j] * scale;
+            }
+
+            cachedRow[frame][row & 1] = row;
+        }
+
+        return dst;
+    }
+
+    array2D<float> * const *frames;
+    array2D<uint16_t> * const *frames16;
+    const float *scale16;
+    const int width;
+    std::vector<float> buffer;
+    int cachedRow[4][2];
+    const float *rows[4][2];
+};
+
 float greenDiff(float a, float b, float stddevFactor, float eperIso, float nreadIso, float prnu)
 {
     // calculate the difference between two green samples
@@ -64,6 +131,39 @@ float nonGreenDiffCross(float right, float left, float top, float bottom, float
     return std::min(hDiff, vDiff) - stddev;
 }
 
+#ifdef __SSE2__
+vfloat greenDiff(vfloat a, vfloat b, vfloat stddevFactor, vfloat eperIso, vfloat nreadIso, vfloat prnu)
+{
+    // calculate the difference between two green samples
+    vfloat gDiff = a - b;
+    gDiff *= eperIso;
+    gDiff *= gDiff;
+    vfloat avg = (a + b) * F2V(0.5f);
+    avg *= eperIso;
+    prnu *= avg;
+    vfloat stddev = stddevFactor * (avg + nreadIso + prnu * prnu);
+    return gDiff - stddev;
+}
+
+vfloat nonGreenDiffCross(vfloat right, vfloat left, vfloat top, vfloat bottom, vfloat centre, vfloat clippedVal, vfloat stddevFactor, vfloat eperIso, vfloat nreadIso, vfloat prnu)
+{
+    const vmask clipped = vmaskf_gt(vmaxf(vmaxf(vmaxf(right, left), vmaxf(top, bottom)), centre), clippedVal);
+
+    // check non green cross
+    vfloat hDiff = (right + left) * F2V(0.5f) - centre;
+    hDiff *= eperIso;
+    hDiff *= hDiff;
+    vfloat vDiff = (top + bottom) * F2V(0.5f) - centre;
+    vDiff *= eperIso;
+    vDiff *= vDiff;
+    vfloat avg = ((right + left) + (top + bottom)) * F2V(0.25f);
+    avg *= eperIso;
+    prnu *= avg;
+    vfloat stddev = stddevFactor * (avg + nreadIso + prnu * prnu);
+    return vselfnotzero(clipped, vminf(hDiff, vDiff) - stddev);
+}
+#endif
+
 void paintMotionMask(int index, bool showMotion, float *maskDest, float *nonMaskDest0, float *nonMaskDest1)
 {
     if(showMotion) {
@@ -119,7 +219,7 @@ void floodFill4Impl(int y, int x, int xStart, int xEnd, int yStart, int yEnd, ar
         if(mask[y][x] == 255) {
             auto yUp = y - 1, yDown = y + 1;
             bool lastXUp = false, lastXDown = false, firstXUp = false, firstXDown = false;
-            mask[y][x] = 0;
+            mask[y][x] = 1;
 
             if(yUp >= yStart && mask[yUp][x] == 255) {
                 coordStack.emplace(x, yUp);
@@ -134,7 +234,7 @@ void floodFill4Impl(int y, int x, int xStart, int xEnd, int yStart, int yEnd, ar
             auto xr = x + 1;
 
             while(xr < xEnd && mask[y][xr] == 255) {
-                mask[y][xr] = 0;
+                mask[y][xr] = 1;
 
                 if(yUp >= yStart && mask[yUp][xr] == 255) {
                     if(!lastXUp) {
@@ -162,7 +262,7 @@ void floodFill4Impl(int y, int x, int xStart, int xEnd, int yStart, int yEnd, ar
             lastXDown = firstXDown;
 
             while(xl >= xStart && mask[y][xl] == 255) {
-                mask[y][xl] = 0;
+                mask[y][xl] = 1;
 
                 if(yUp >= yStart && mask[yUp][xl] == 255) {
                     if(!lastXUp) {
@@ -185,84 +285,94 @@ void floodFill4Impl(int y, int x, int xStart, int xEnd, int yStart, int yEnd, ar
                 xl--;
             }
 
-            mask[y][x] = 0;
+            mask[y][x] = 1;
         }
     }
 }
 
 void floodFill4(int xStart, int xEnd, int yStart, int yEnd, array2D<uint8_t> &mask)
 {
-#ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-        std::stack<std::pair<uint16_t, uint16_t>, std::vector<std::pair<uint16_t, uint16_t>>> coordStack;
+    // Clears all pixels with value 255 which are connected to the border of the region.
+    // The region is split into horizontal strips which are filled in parallel. Filled pixels are marked with 1 first,
+    // so fills which reach the border of a strip can be continued in the neighbouring strip in the next pass.
+    if (xEnd <= xStart || yEnd <= yStart) {
+        return;
+    }
 
-#ifdef _OPENMP
-        #pragma omp for schedule(dynamic,128) nowait
-#endif
+    constexpr int stripHeight = 128;
+    const int numStrips = (yEnd - yStart + stripHeight - 1) / stripHeight;
+    std::vector<std::vector<std::pair<uint16_t, uint16_t>>> seeds(numStrips);
 
-        for(uint16_t i = yStart; i < yEnd; i++)
-        {
-            floodFill4Impl(i, xStart, xStart, xEnd, yStart, yEnd, mask, coordStack);
+    // the first pass starts at the border of the region
+    for (int s = 0; s < numStrips; ++s) {
+        for (int i = yStart + s * stripHeight; i < std::min(yStart + (s + 1) * stripHeight, yEnd); ++i) {
+            seeds[s].emplace_back(xStart, i);
+            seeds[s].emplace_back(xEnd - 1, i);
         }
+    }
 
-#ifdef _OPENMP
-        #pragma omp for schedule(dynamic,128) nowait
-#endif
+    for (int j = xStart; j < xEnd; ++j) {
+        seeds[0].emplace_back(j, yStart);
+        seeds[numStrips - 1].emplace_back(j, yEnd - 1);
+    }
 
-        for(int16_t i = yEnd - 1; i >= 0 ; i--)
-        {
-            floodFill4Impl(i, xEnd - 1, xStart, xEnd, yStart, yEnd, mask, coordStack);
-        }
+    bool seeded = true;
 
+    while (seeded) {
+        seeded = false;
 #ifdef _OPENMP
-        #pragma omp sections nowait
+        #pragma omp parallel
 #endif
         {
-#ifdef _OPENMP
-            #pragma omp section
-#endif
-            {
-                uint16_t i = yStart;
+            std::stack<std::pair<uint16_t, uint16_t>, std::vector<std::pair<uint16_t, uint16_t>>> coordStack;
 
-                for(uint16_t j = xStart; j < xEnd; j++)
-                {
-                    floodFill4Impl(i, j, xStart, xEnd, yStart, yEnd, mask, coordStack);
-                }
-            }
 #ifdef _OPENMP
-            #pragma omp section
+            #pragma omp for schedule(dynamic)
 #endif
-            {
-                uint16_t i = yStart;
 
-                for(uint16_t j = xEnd - 1; j >= xStart; j--)
-                {
-                    floodFill4Impl(i, j, xStart, xEnd, yStart, yEnd, mask, coordStack);
+            for (int s = 0; s < numStrips; ++s) {
+                const int top = yStart + s * stripHeight;
+                const int bottom = std::min(top + stripHeight, yEnd);
+
+                for (const auto &seed : seeds[s]) {
+                    floodFill4Impl(seed.second, seed.first, xStart, xEnd, top, bottom, mask, coordStack);
                 }
+
+                seeds[s].clear();
             }
+
 #ifdef _OPENMP
-            #pragma omp section
+            #pragma omp for schedule(dynamic) reduction(||:seeded)
 #endif
-            {
-                uint16_t i = yEnd;
 
-                for(uint16_t j = xStart; j < xEnd; j++)
-                {
-                    floodFill4Impl(i, j, xStart, xEnd, yStart, yEnd, mask, coordStack);
+            for (int s = 0; s < numStrips; ++s) {
+                // continue the fills of the neighbouring strips which stopped at the border of this strip
+                const int top = yStart + s * stripHeight;
+                const int bottom = std::min(top + stripHeight, yEnd);
+
+                for (int j = xStart; j < xEnd; ++j) {
+                    if (s > 0 && mask[top][j] == 255 && mask[top - 1][j] == 1) {
+                        seeds[s].emplace_back(j, top);
+                    }
+
+                    if (s < numStrips - 1 && mask[bottom - 1][j] == 255 && mask[bottom][j] == 1) {
+                        seeds[s].emplace_back(j, bottom - 1);
+                    }
                 }
+
+                seeded = seeded || !seeds[s].empty();
             }
+        }
+    }
+
 #ifdef _OPENMP
-            #pragma omp section
+    #pragma omp parallel for schedule(dynamic,16)
 #endif
-            {
-                uint16_t i = yEnd;
 
-                for(uint16_t j = xEnd - 1; j >= xStart; j--)
-                {
-                    floodFill4Impl(i, j, xStart, xEnd, yStart, yEnd, mask, coordStack);
-                }
+    for (int i = yStart; i < yEnd; ++i) {
+        for (int j = xStart; j < xEnd; ++j) {
+            if (mask[i][j] == 1) {
+                mask[i][j] = 0;
             }
         }
     }
@@ -323,24 +433,46 @@ BENCHFUN
     if(motionDetection) {
         if(!showOnlyMask) {
             if(bayerParams.pixelShiftMedian) { // We need the demosaiced frames for motion correction
-                if (bayerParams.pixelShiftDemosaicMethod == bayerParams.getPSDemosaicMethodString(RAWParams::BayerSensor::PSDemosaicMethod::LMMSE)) {
-                    lmmse_interpolate_omp(winw, winh, *(rawDataFrames[0]), red, green, blue, bayerParams.lmmse_iterations);
-                } else if (bayerParams.pixelShiftDemosaicMethod == bayerParams.getPSDemosaicMethodString(RAWParams::BayerSensor::PSDemosaicMethod::AMAZEVNG4)) {
-                    dual_demosaic_RT (true, rawParamsIn, winw, winh, *(rawDataFrames[0]), red, green, blue, bayerParams.dualDemosaicContrast, true);
-                } else {
-                    amaze_demosaic_RT(winx, winy, winw, winh, *(rawDataFrames[0]), red, green, blue, options.chunkSizeAMAZE, options.measure);
-                }
                 multi_array2D<float, 3> redTmp(winw, winh);
                 multi_array2D<float, 3> greenTmp(winw, winh);
                 multi_array2D<float, 3> blueTmp(winw, winh);
+                array2D<float>* const reds[4] = {&red, &redTmp[0], &redTmp[1], &redTmp[2]};
+                array2D<float>* const greens[4] = {&green, &greenTmp[0], &greenTmp[1], &greenTmp[2]};
+                array2D<float>* const blues[4] = {&blue, &blueTmp[0], &blueTmp[1], &blueTmp[2]};
 
-                for(int i = 0; i < 3; i++) {
+                const auto demosaicFrame = [&](array2D<float> &frameData, int i) {
                     if (bayerParams.pixelShiftDemosaicMethod == bayerParams.getPSDemosaicMethodString(RAWParams::BayerSensor::PSDemosaicMethod::LMMSE)) {
-                        lmmse_interpolate_omp(winw, winh, *(rawDataFrames[i + 1]), redTmp[i], greenTmp[i], blueTmp[i], bayerParams.lmmse_iterations);
+                        lmmse_interpolate_omp(winw, winh, frameData, *reds[i], *greens[i], *blues[i], bayerParams.lmmse_iterations);
                     } else if (bayerParams.pixelShiftDemosaicMethod == bayerParams.getPSDemosaicMethodString(RAWParams::BayerSensor::PSDemosaicMethod::AMAZEVNG4)) {
-                        dual_demosaic_RT (true, rawParamsIn, winw, winh, *(rawDataFrames[i + 1]), redTmp[i], greenTmp[i], blueTmp[i], bayerParams.dualDemosaicContrast, true);
+                        dual_demosaic_RT (true, rawParamsIn, winw, winh, frameData, *reds[i], *greens[i], *blues[i], bayerParams.dualDemosaicContrast, true);
                     } else {
-                        amaze_demosaic_RT(winx, winy, winw, winh, *(rawDataFrames[i + 1]), redTmp[i], greenTmp[i], blueTmp[i], options.chunkSizeAMAZE, options.measure);
+                        amaze_demosaic_RT(winx, winy, winw, winh, frameData, *reds[i], *greens[i], *blues[i], options.chunkSizeAMAZE, options.measure);
+                    }
+                };
+
+                // Frames stored as 16 bit samples are expanded one at a time into the red plane of the current frame's output,
+                // which is free until the current frame is demosaiced, last and straight from rawData. So no float frame is allocated
+                for (unsigned int i = 0; i < 4; ++i) {
+                    if (!rawDataFrames[i]) {
+                        array2D<float> &frameBuffer = *reds[frame];
+                        const array2D<uint16_t> &frame16 = *rawDataFrames16[i];
+                        const float scale = rawDataFrames16Scale[i];
+#ifdef _OPENMP
+                        #pragma omp parallel for
+#endif
+                        for (int row = 0; row < H; ++row) {
+                            for (int col = 0; col < W; ++col) {
+                                frameBuffer[row][col] = frame16[row][col] * scale;
+                            }
+                        }
+
+                        demosaicFrame(frameBuffer, i);
+                    }
+                }
+
+                for (unsigned int i = 0; i < 4; ++i) {
+                    if (rawDataFrames[i]) {
+                        demosaicFrame(*rawDataFrames[i], i);
                     }
                 }
 
@@ -618,6 +750,7 @@ BENCHFUN
             #pragma omp parallel
 #endif
             {
+                FrameRows frameRows(rawDataFrames, rawDataFrames16, rawDataFrames16Scale, W);
                 LUTu *histogreenThr[4];
                 LUTu *historedThr[4];
                 LUTu *histoblueThr[4];
@@ -637,17 +770,18 @@ BENCHFUN
                     int c = FC(i, j);
 
                     bool bluerow = (c + FC(i, j + 1)) == 3;
+                    frameRows.set(i);
 
                     for(int j = winx + 1, offset = FC(i, j) & 1; j < winw - 1; ++j, offset ^= 1) {
-                        (*histogreenThr[1 - offset])[(*rawDataFrames[1 - offset])[i - offset + 1][j]]++;
-                        (*histogreenThr[3 - offset])[(*rawDataFrames[3 - offset])[i + offset][j + 1]]++;
+                        (*histogreenThr[1 - offset])[frameRows(1 - offset, 1 - offset)[j]]++;
+                        (*histogreenThr[3 - offset])[frameRows(3 - offset, offset)[j + 1]]++;
 
                         if(bluerow) {
-                            (*historedThr[2 - offset])[(*rawDataFrames[2 - offset])[i + 1][j - offset + 1]]++;
-                            (*histoblueThr[(offset << 1) + offset])[(*rawDataFrames[(offset << 1) + offset])[i][j + offset]]++;
+                            (*historedThr[2 - offset])[frameRows(2 - offset, 1)[j - offset + 1]]++;
+                            (*histoblueThr[(offset << 1) + offset])[frameRows((offset << 1) + offset, 0)[j + offset]]++;
                         } else {
-                            (*historedThr[(offset << 1) + offset])[(*rawDataFrames[(offset << 1) + offset])[i][j + offset]]++;
-                            (*histoblueThr[2 - offset])[(*rawDataFrames[2 - offset])[i + 1][j - offset + 1]]++;
+                            (*historedThr[(offset << 1) + offset])[frameRows((offset << 1) + offset, 0)[j + offset]]++;
+                            (*histoblueThr[2 - offset])[frameRows(2 - offset, 1)[j - offset + 1]]++;
                         }
                     }
                 }
@@ -708,33 +842,40 @@ BENCHFUN
         array2D<float> psBlue(winw + 32, winh);
 
 #ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic,16)
+        #pragma omp parallel
+#endif
+        {
+            FrameRows frameRows(rawDataFrames, rawDataFrames16, rawDataFrames16Scale, W);
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic,16)
 #endif
 
-        for(int i = winy + 1; i < winh - 1; ++i) {
-            float *nonGreenDest0 = psRed[i];
-            float *nonGreenDest1 = psBlue[i];
-            float ngbright[2][4] = {{redBrightness[0], redBrightness[1], redBrightness[2], redBrightness[3]},
-                                    {blueBrightness[0], blueBrightness[1], blueBrightness[2], blueBrightness[3]}
-                                   };
-            int ng = 0;
-            int j = winx + 1;
-            int c = FC(i, j);
-
-            if((c + FC(i, j + 1)) == 3) {
-                // row with blue pixels => swap destination pointers for non green pixels
-                std::swap(nonGreenDest0, nonGreenDest1);
-                ng ^= 1;
-            }
+            for(int i = winy + 1; i < winh - 1; ++i) {
+                frameRows.set(i);
+                float *nonGreenDest0 = psRed[i];
+                float *nonGreenDest1 = psBlue[i];
+                float ngbright[2][4] = {{redBrightness[0], redBrightness[1], redBrightness[2], redBrightness[3]},
+                                        {blueBrightness[0], blueBrightness[1], blueBrightness[2], blueBrightness[3]}
+                                       };
+                int ng = 0;
+                int j = winx + 1;
+                int c = FC(i, j);
+
+                if((c + FC(i, j + 1)) == 3) {
+                    // row with blue pixels => swap destination pointers for non green pixels
+                    std::swap(nonGreenDest0, nonGreenDest1);
+                    ng ^= 1;
+                }
 
-            // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
-            unsigned int offset = c & 1;
+                // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
+                unsigned int offset = c & 1;
 
-            for(; j < winw - 1; ++j) {
-                // store the non green values from the 4 frames into 2 temporary planes
-                nonGreenDest0[j] = (*rawDataFrames[(offset << 1) + offset])[i][j + offset] * ngbright[ng][(offset << 1) + offset];
-                nonGreenDest1[j] = (*rawDataFrames[2 - offset])[i + 1][j - offset + 1] * ngbright[ng ^ 1][2 - offset];
-                offset ^= 1; // 0 => 1 or 1 => 0
+                for(; j < winw - 1; ++j) {
+                    // store the non green values from the 4 frames into 2 temporary planes
+                    nonGreenDest0[j] = frameRows((offset << 1) + offset, 0)[j + offset] * ngbright[ng][(offset << 1) + offset];
+                    nonGreenDest1[j] = frameRows(2 - offset, 1)[j - offset + 1] * ngbright[ng ^ 1][2 - offset];
+                    offset ^= 1; // 0 => 1 or 1 => 0
+                }
             }
         }
 
@@ -771,49 +912,108 @@ BENCHFUN
 
 
 #ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic,16)
+        #pragma omp parallel
+#endif
+        {
+            FrameRows frameRows(rawDataFrames, rawDataFrames16, rawDataFrames16Scale, W);
+            // the two green samples of each pixel, gathered from the frames for easy vectorization
+            std::vector<float> greenSamples0(winw);
+            std::vector<float> greenSamples1(winw);
+#ifdef __SSE2__
+            const vfloat noMotionv = F2V(noMotion);
+            const vfloat greenWeightv = F2V(greenWeight);
+            const vfloat redBlueWeightv = F2V(redBlueWeight);
+            const vfloat stddevFactorGreenv = F2V(stddevFactorGreen);
+            const vfloat stddevFactorRedv = F2V(stddevFactorRed);
+            const vfloat stddevFactorBluev = F2V(stddevFactorBlue);
+            const vfloat eperIsoGreenv = F2V(eperIsoGreen);
+            const vfloat eperIsoRedv = F2V(eperIsoRed);
+            const vfloat eperIsoBluev = F2V(eperIsoBlue);
+            const vfloat clippedRedv = F2V(clippedRed);
+            const vfloat clippedBluev = F2V(clippedBlue);
+            const vfloat nReadv = F2V(nRead);
+            const vfloat prnuv = F2V(prnu);
+#endif
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic,16)
 #endif
 
-        for(int i = winy + border - offsY; i < winh - (border + offsY); ++i) {
-            // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
-            unsigned int offset = FC(i, winx + border - offsX) & 1;
-
-            for(int j = winx + border - offsX; j < winw - (border + offsX); ++j, offset ^= 1) {
-                psMask[i][j] = noMotion;
+            for(int i = winy + border - offsY; i < winh - (border + offsY); ++i) {
+                const int startCol = winx + border - offsX;
+                const int endCol = winw - (border + offsX);
 
                 if(checkGreen) {
-                    if(greenDiff((*rawDataFrames[1 - offset])[i - offset + 1][j] * greenBrightness[1 - offset], (*rawDataFrames[3 - offset])[i + offset][j + 1] * greenBrightness[3 - offset], stddevFactorGreen, eperIsoGreen, nRead, prnu) > 0.f) {
-                        psMask[i][j] = greenWeight;
-                        // do not set the motion pixel values. They have already been set by demosaicer
-                        continue;
+                    frameRows.set(i);
+                    // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
+                    unsigned int offset = FC(i, startCol) & 1;
+
+                    for(int j = startCol; j < endCol; ++j, offset ^= 1) {
+                        greenSamples0[j] = frameRows(1 - offset, 1 - offset)[j] * greenBrightness[1 - offset];
+                        greenSamples1[j] = frameRows(3 - offset, offset)[j + 1] * greenBrightness[3 - offset];
                     }
                 }
 
-                if(checkNonGreenCross) {
-                    // check red cross
-                    float redTop    = psRed[i - 1][j];
-                    float redLeft   = psRed[i][j - 1];
-                    float redCentre = psRed[i][j];
-                    float redRight  = psRed[i][j + 1];
-                    float redBottom = psRed[i + 1][j];
-                    float redDiff   = nonGreenDiffCross(redRight, redLeft, redTop, redBottom, redCentre, clippedRed, stddevFactorRed, eperIsoRed, nRead, prnu);
-
-                    if(redDiff > 0.f) {
-                        psMask[i][j] = redBlueWeight;
-                        continue;
+                int j = startCol;
+#ifdef __SSE2__
+
+                for(; j < endCol - 3; j += 4) {
+                    vfloat maskv = noMotionv;
+
+                    if(checkNonGreenCross) {
+                        // check red and blue cross
+                        const vmask redMotion = vmaskf_gt(nonGreenDiffCross(LVFU(psRed[i][j + 1]), LVFU(psRed[i][j - 1]), LVFU(psRed[i - 1][j]), LVFU(psRed[i + 1][j]), LVFU(psRed[i][j]), clippedRedv, stddevFactorRedv, eperIsoRedv, nReadv, prnuv), ZEROV);
+                        const vmask blueMotion = vmaskf_gt(nonGreenDiffCross(LVFU(psBlue[i][j + 1]), LVFU(psBlue[i][j - 1]), LVFU(psBlue[i - 1][j]), LVFU(psBlue[i + 1][j]), LVFU(psBlue[i][j]), clippedBluev, stddevFactorBluev, eperIsoBluev, nReadv, prnuv), ZEROV);
+                        maskv = vself(vorm(redMotion, blueMotion), redBlueWeightv, maskv);
                     }
 
-                    // check blue cross
-                    float blueTop    = psBlue[i - 1][j];
-                    float blueLeft   = psBlue[i][j - 1];
-                    float blueCentre = psBlue[i][j];
-                    float blueRight  = psBlue[i][j + 1];
-                    float blueBottom = psBlue[i + 1][j];
-                    float blueDiff   = nonGreenDiffCross(blueRight, blueLeft, blueTop, blueBottom, blueCentre, clippedBlue, stddevFactorBlue, eperIsoBlue, nRead, prnu);
-
-                    if(blueDiff > 0.f) {
-                        psMask[i][j] = redBlueWeight;
-                        continue;
+                    if(checkGreen) {
+                        // green motion has precedence over red and blue motion
+                        const vmask greenMotion = vmaskf_gt(greenDiff(LVFU(greenSamples0[j]), LVFU(greenSamples1[j]), stddevFactorGreenv, eperIsoGreenv, nReadv, prnuv), ZEROV);
+                        maskv = vself(greenMotion, greenWeightv, maskv);
+                    }
+
+                    STVFU(psMask[i][j], maskv);
+                }
+
+#endif
+
+                for(; j < endCol; ++j) {
+                    psMask[i][j] = noMotion;
+
+                    if(checkGreen) {
+                        if(greenDiff(greenSamples0[j], greenSamples1[j], stddevFactorGreen, eperIsoGreen, nRead, prnu) > 0.f) {
+                            psMask[i][j] = greenWeight;
+                            // do not set the motion pixel values. They have already been set by demosaicer
+                            continue;
+                        }
+                    }
+
+                    if(checkNonGreenCross) {
+                        // check red cross
+                        float redTop    = psRed[i - 1][j];
+                        float redLeft   = psRed[i][j - 1];
+                        float redCentre = psRed[i][j];
+                        float redRight  = psRed[i][j + 1];
+                        float redBottom = psRed[i + 1][j];
+                        float redDiff   = nonGreenDiffCross(redRight, redLeft, redTop, redBottom, redCentre, clippedRed, stddevFactorRed, eperIsoRed, nRead, prnu);
+
+                        if(redDiff > 0.f) {
+                            psMask[i][j] = redBlueWeight;
+                            continue;
+                        }
+
+                        // check blue cross
+                        float blueTop    = psBlue[i - 1][j];
+                        float blueLeft   = psBlue[i][j - 1];
+                        float blueCentre = psBlue[i][j];
+                        float blueRight  = psBlue[i][j + 1];
+                        float blueBottom = psBlue[i + 1][j];
+                        float blueDiff   = nonGreenDiffCross(blueRight, blueLeft, blueTop, blueBottom, blueCentre, clippedBlue, stddevFactorBlue, eperIsoBlue, nRead, prnu);
+
+                        if(blueDiff > 0.f) {
+                            psMask[i][j] = redBlueWeight;
+                            continue;
+                        }
                     }
                 }
             }
@@ -882,68 +1082,75 @@ BENCHFUN
         }
 
 #ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic,16)
+        #pragma omp parallel
+#endif
+        {
+            FrameRows frameRows(rawDataFrames, rawDataFrames16, rawDataFrames16Scale, W);
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic,16)
 #endif
 
-        for(int i = winy + border - offsY; i < winh - (border + offsY); ++i) {
+            for(int i = winy + border - offsY; i < winh - (border + offsY); ++i) {
+                frameRows.set(i);
 #ifdef __SSE2__
 
-            // pow() is expensive => pre calculate blend factor using SSE
-            if(smoothTransitions) { //
-                vfloat onev = F2V(1.f);
-                vfloat smoothv = F2V(smoothFactor);
-                int j = winx + border - offsX;
-
-                for(; j < winw - (border + offsX) - 3; j += 4) {
-                    vfloat blendv = vmaxf(LVFU(psMask[i][j]), onev) - onev;
-                    blendv = pow_F(blendv, smoothv);
-                    blendv = vself(vmaskf_eq(smoothv, ZEROV), onev, blendv);
-                    STVFU(psMask[i][j], blendv);
-                }
+                // pow() is expensive => pre calculate blend factor using SSE
+                if(smoothTransitions) { //
+                    vfloat onev = F2V(1.f);
+                    vfloat smoothv = F2V(smoothFactor);
+                    int j = winx + border - offsX;
+
+                    for(; j < winw - (border + offsX) - 3; j += 4) {
+                        vfloat blendv = vmaxf(LVFU(psMask[i][j]), onev) - onev;
+                        blendv = pow_F(blendv, smoothv);
+                        blendv = vself(vmaskf_eq(smoothv, ZEROV), onev, blendv);
+                        STVFU(psMask[i][j], blendv);
+                    }
 
-                for(; j < winw - (border + offsX); ++j) {
-                    psMask[i][j] = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
+                    for(; j < winw - (border + offsX); ++j) {
+                        psMask[i][j] = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
+                    }
                 }
-            }
 
 #endif
-            float *greenDest = green[i + offsY];
-            float *redDest = red[i + offsY];
-            float *blueDest = blue[i + offsY];
+                float *greenDest = green[i + offsY];
+                float *redDest = red[i + offsY];
+                float *blueDest = blue[i + offsY];
 
-            // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
-            unsigned int offset = FC(i, winx + border - offsX) & 1;
+                // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
+                unsigned int offset = FC(i, winx + border - offsX) & 1;
 
-            for(int j = winx + border - offsX; j < winw - (border + offsX); ++j, offset ^= 1) {
-                if(showOnlyMask) {
-                    if(smoothTransitions) { // we want only motion mask => paint areas according to their motion (dark = no motion, bright = motion)
+                for(int j = winx + border - offsX; j < winw - (border + offsX); ++j, offset ^= 1) {
+                    if(showOnlyMask) {
+                        if(smoothTransitions) { // we want only motion mask => paint areas according to their motion (dark = no motion, bright = motion)
 #ifdef __SSE2__
-                        // use pre calculated blend factor
-                        const float blend = psMask[i][j];
+                            // use pre calculated blend factor
+                            const float blend = psMask[i][j];
 #else
-                        const float blend = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
+                            const float blend = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
 #endif
-                        redDest[j + offsX] = greenDest[j + offsX] = blueDest[j + offsX] = blend * 32768.f;
+                            redDest[j + offsX] = greenDest[j + offsX] = blueDest[j + offsX] = blend * 32768.f;
+                        } else {
+                            redDest[j + offsX] = greenDest[j + offsX] = blueDest[j + offsX] = mask[i][j] == 255 ? 65535.f : 0.f;
+                        }
+                    } else if(mask[i][j] == 255) {
+                        paintMotionMask(j + offsX, showMotion, greenDest, redDest, blueDest);
                     } else {
-                        redDest[j + offsX] = greenDest[j + offsX] = blueDest[j + offsX] = mask[i][j] == 255 ? 65535.f : 0.f;
-                    }
-                } else if(mask[i][j] == 255) {
-                    paintMotionMask(j + offsX, showMotion, greenDest, redDest, blueDest);
-                } else {
-                    if(smoothTransitions) {
+                        if(smoothTransitions) {
 #ifdef __SSE2__
-                        // use pre calculated blend factor
-                        const float blend = psMask[i][j];
+                            // use pre calculated blend factor
+                            const float blend = psMask[i][j];
 #else
-                        const float blend = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
+                            const float blend = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
 #endif
-                        redDest[j + offsX] = intp(blend, showMotion ? 0.f : redDest[j + offsX], psRed[i][j] );
-                        greenDest[j + offsX] = intp(blend, showMotion ? 13500.f : greenDest[j + offsX], ((*rawDataFrames[1 - offset])[i - offset + 1][j] * greenBrightness[1 - offset] + (*rawDataFrames[3 - offset])[i + offset][j + 1] * greenBrightness[3 - offset]) * 0.5f);
-                        blueDest[j + offsX] = intp(blend, showMotion ? 0.f : blueDest[j + offsX], psBlue[i][j]);
-                    } else {
-                        redDest[j + offsX] = psRed[i][j];
-                        greenDest[j + offsX] = ((*rawDataFrames[1 - offset])[i - offset + 1][j] * greenBrightness[1 - offset] + (*rawDataFrames[3 - offset])[i + offset][j + 1] * greenBrightness[3 - offset]) * 0.5f;
-                        blueDest[j + offsX] = psBlue[i][j];
+                            redDest[j + offsX] = intp(blend, showMotion ? 0.f : redDest[j + offsX], psRed[i][j] );
+                            greenDest[j + offsX] = intp(blend, showMotion ? 13500.f : greenDest[j + offsX], (frameRows(1 - offset, 1 - offset)[j] * greenBrightness[1 - offset] + frameRows(3 - offset, offset)[j + 1] * greenBrightness[3 - offset]) * 0.5f);
+                            blueDest[j + offsX] = intp(blend, showMotion ? 0.f : blueDest[j + offsX], psBlue[i][j]);
+                        } else {
+                            redDest[j + offsX] = psRed[i][j];
+                            greenDest[j + offsX] = (frameRows(1 - offset, 1 - offset)[j] * greenBrightness[1 - offset] + frameRows(3 - offset, offset)[j + 1] * greenBrightness[3 - offset]) * 0.5f;
+                            blueDest[j + offsX] = psBlue[i][j];
+                        }
                     }
                 }
             }
@@ -954,31 +1161,38 @@ BENCHFUN
                                 {blueBrightness[0], blueBrightness[1], blueBrightness[2], blueBrightness[3]}
         };
 #ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic,16)
+        #pragma omp parallel
+#endif
+        {
+            FrameRows frameRows(rawDataFrames, rawDataFrames16, rawDataFrames16Scale, W);
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic,16)
 #endif
 
-        for(int i = winy + 1; i < winh - 1; ++i) {
-            float *nonGreenDest0 = red[i];
-            float *nonGreenDest1 = blue[i];
-            int ng = 0;
-            int j = winx + 1;
-            int c = FC(i, j);
-
-            if((c + FC(i, j + 1)) == 3) {
-                // row with blue pixels => swap destination pointers for non green pixels
-                std::swap(nonGreenDest0, nonGreenDest1);
-                ng ^= 1;
-            }
+            for(int i = winy + 1; i < winh - 1; ++i) {
+                frameRows.set(i);
+                float *nonGreenDest0 = red[i];
+                float *nonGreenDest1 = blue[i];
+                int ng = 0;
+                int j = winx + 1;
+                int c = FC(i, j);
+
+                if((c + FC(i, j + 1)) == 3) {
+                    // row with blue pixels => swap destination pointers for non green pixels
+                    std::swap(nonGreenDest0, nonGreenDest1);
+                    ng ^= 1;
+                }
 
-            // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
-            unsigned int offset = c & 1;
+                // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
+                unsigned int offset = c & 1;
 
-            for(; j < winw - 1; ++j) {
-                // set red, green and blue values
-                green[i][j] = ((*rawDataFrames[1 - offset])[i - offset + 1][j] * greenBrightness[1 - offset] + (*rawDataFrames[3 - offset])[i + offset][j + 1] * greenBrightness[3 - offset]) * 0.5f;
-                nonGreenDest0[j] = (*rawDataFrames[(offset << 1) + offset])[i][j + offset] * ngbright[ng][(offset << 1) + offset];
-                nonGreenDest1[j] = (*rawDataFrames[2 - offset])[i + 1][j - offset + 1] * ngbright[ng ^ 1][2 - offset];
-                offset ^= 1; // 0 => 1 or 1 => 0
+                for(; j < winw - 1; ++j) {
+                    // set red, green and blue values
+                    green[i][j] = (frameRows(1 - offset, 1 - offset)[j] * greenBrightness[1 - offset] + frameRows(3 - offset, offset)[j + 1] * greenBrightness[3 - offset]) * 0.5f;
+                    nonGreenDest0[j] = frameRows((offset << 1) + offset, 0)[j + offset] * ngbright[ng][(offset << 1) + offset];
+                    nonGreenDest1[j] = frameRows(2 - offset, 1)[j - offset + 1] * ngbright[ng ^ 1][2 - offset];
+                    offset ^= 1; // 0 => 1 or 1 => 0
+                }
             }
         }
     }
@@ -987,3 +1201,43 @@ BENCHFUN
         plistener->setProgress(1.0);
     }
 }
+
+void RawImageSource::compressPixelShiftFrame(unsigned int i)
+{
+    // Keeps the frame as 16 bit samples to halve its memory usage.
+    // Values above 65535 are scaled down to fit, negative values are clipped.
+    const array2D<float> &frame = *rawDataFrames[i];
+    float maxVal = 0.f;
+
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(max:maxVal)
+#endif
+
+    for (int row = 0; row < H; ++row) {
+        for (int col = 0; col < W; ++col) {
+            maxVal = std::max(maxVal, frame[row][col]);
+        }
+    }
+
+    const float scale = maxVal > 65535.f ? 65535.f / maxVal : 1.f;
+    rawDataFrames16Scale[i] = maxVal > 65535.f ? maxVal / 65535.f : 1.f;
+
+    if (!rawDataFrames16[i]) {
+        rawDataFrames16[i] = new array2D<uint16_t>(W, H);
+    }
+
+    array2D<uint16_t> &frame16 = *rawDataFrames16[i];
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int row = 0; row < H; ++row) {
+        for (int col = 0; col < W; ++col) {
+            frame16[row][col] = static_cast<uint16_t>(std::min(std::max(frame[row][col], 0.f) * scale + 0.5f, 65535.f));
+        }
+    }
+
+    // the float buffer is reused by preprocess() for the next frame
+    rawDataFrames[i] = nullptr;
+}
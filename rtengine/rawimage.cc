@@ -23,11 +23,13 @@ extern const Settings* settings;
 
 RawImage::RawImage(  const Glib::ustring &name )
     : data(nullptr)
+    , data16(nullptr)
     , prefilters(0)
     , filename(name)
     , rotate_deg(0)
     , profile_data(nullptr)
     , allocation(nullptr)
+    , allocation16(nullptr)
 {
     memset(maximum_c4, 0, sizeof(maximum_c4));
     RT_matrix_from_constant = ThreeValBool::X;
@@ -61,6 +63,16 @@ RawImage::~RawImage()
         data = nullptr;
     }
 
+    if(allocation16) {
+        delete [] allocation16;
+        allocation16 = nullptr;
+    }
+
+    if(data16) {
+        delete [] data16;
+        data16 = nullptr;
+    }
+
     if(profile_data) {
         delete [] profile_data;
         profile_data = nullptr;
@@ -113,7 +125,7 @@ void RawImage::get_colorsCoeff( float *pre_mul_, float *scale_mul_, float *cblac
     }
 
     if (this->get_cam_mul(0) == -1 || forceAutoWB) {
-        if(!data) { // this happens only for thumbnail creation when get_cam_mul(0) == -1
+        if(!data && !data16) { // this happens only for thumbnail creation when get_cam_mul(0) == -1
             compress_image(0, false);
         }
         memset(dsum, 0, sizeof dsum);
@@ -143,7 +155,6 @@ void RawImage::get_colorsCoeff( float *pre_mul_, float *scale_mul_, float *cblac
                     whitefloat[c] = this->get_white(c) - whiteThreshold;
                 }
 
-                float *tempdata = data[0];
 #ifdef _OPENMP
                 #pragma omp for nowait
 #endif
@@ -158,7 +169,7 @@ void RawImage::get_colorsCoeff( float *pre_mul_, float *scale_mul_, float *cblac
                         for (size_t y = row; y < ymax; y++)
                             for (size_t x = col; x < xmax; x++) {
                                 int c = FC(y, x);
-                                val = tempdata[y * W + x];
+                                val = sample(y, x);
 
                                 if (val > whitefloat[c] || val < cblackfloat[c]) { // calculate number of pixels to be subtracted from sum and skip the block
                                     dsumthr[FC(row, col) + 4]      += (int)(((xmax - col + 1) / 2) * ((ymax - row + 1) / 2));
@@ -229,7 +240,7 @@ skip_block2:
                         for (size_t y = row; y < row + 8 && y < H; y++)
                             for (size_t x = col; x < col + 8 && x < W; x++) {
                                 int c = XTRANSFC(y, x);
-                                float val = data[y][x];
+                                float val = sample(y, x);
 
                                 if (val > whitefloat[c] || val < cblackfloat[c]) {
                                     goto skip_block3;
@@ -513,6 +524,8 @@ int RawImage::loadRaw (bool loadData, unsigned int imageNum, bool closeFile, Pro
         */
         // Load raw pixels data
         fseek (ifp, data_offset, SEEK_SET);
+        // decoders read the pixel data mostly front to back, let the kernel read ahead
+        imfile_advise(ifp, IMFILE_ADVICE::SEQUENTIAL, data_offset);
         (this->*load_raw)();
 
         if (!float_raw_image) { // apply baseline exposure only for float DNGs
@@ -689,12 +702,42 @@ int RawImage::loadRaw (bool loadData, unsigned int imageNum, bool closeFile, Pro
     return 0;
 }
 
-float** RawImage::compress_image(unsigned int frameNum, bool freeImage)
+float** RawImage::compress_image(unsigned int frameNum, bool freeImage, bool compact)
 {
     if( !image ) {
         return nullptr;
     }
 
+    if (compact && !float_raw_image && (isBayer() || isXtrans())) {
+        // integer sensor data fits into 16 bit, which halves the memory held for the original mosaic.
+        // It is widened to float when the working copy is made in RawImageSource::copyOriginalPixels
+        if (!allocation16) {
+            allocation16 = new uint16_t[static_cast<unsigned int>(height) * static_cast<unsigned int>(width) + frameNum * 64u];
+            data16 = new uint16_t*[height];
+
+            for (int i = 0; i < height; i++) {
+                data16[i] = allocation16 + i * width + frameNum * 64;
+            }
+        }
+
+        const bool xtrans = isXtrans();
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int row = 0; row < height; row++)
+            for (int col = 0; col < width; col++) {
+                this->data16[row][col] = image[row * width + col][xtrans ? XTRANSFC(row, col) : FC(row, col)];
+            }
+
+        if (freeImage) {
+            free(image); // we don't need this anymore
+            image = nullptr;
+        }
+
+        return nullptr;
+    }
+
     if (isBayer() || isXtrans()) {
         if (!allocation) {
             // shift the beginning of all frames but the first by 32 floats to avoid cache miss conflicts on CPUs which have <= 4-way associative L1-Cache
@@ -790,6 +833,50 @@ float** RawImage::compress_image(unsigned int frameNum, bool freeImage)
     return data;
 }
 
+RawImage::FrameLayout RawImage::getFrameLayout() const
+{
+    FrameLayout layout;
+    layout.width = width;
+    layout.height = height;
+    layout.filters = filters;
+    layout.colors = colors;
+
+    for (int row = 0; row < 6; row++) {
+        for (int col = 0; col < 6; col++) {
+            layout.xtrans[row][col] = xtrans[row][col];
+        }
+    }
+
+    return layout;
+}
+
+float** RawImage::allocateFrame(const FrameLayout& layout)
+{
+    if (allocation || (layout.filters == 0 && layout.colors != 1)) {
+        return nullptr;
+    }
+
+    iwidth = width = layout.width;
+    iheight = height = layout.height;
+    filters = layout.filters;
+    colors = layout.colors;
+
+    for (int row = 0; row < 6; row++) {
+        for (int col = 0; col < 6; col++) {
+            xtrans[row][col] = layout.xtrans[row][col];
+        }
+    }
+
+    allocation = new float[static_cast<unsigned long>(height) * static_cast<unsigned long>(width)];
+    data = new float*[height];
+
+    for (int i = 0; i < height; i++) {
+        data[i] = allocation + i * width;
+    }
+
+    return data;
+}
+
 bool
 RawImage::is_supportedThumb() const
 {
@@ -21,6 +21,7 @@
 
 #include <ctime>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 
 #include "dcraw.h"
@@ -49,8 +50,27 @@ public:
     {
         return image;
     }
-    float** compress_image(unsigned int frameNum, bool freeImage = true); // revert to compressed pixels format and release image data
+    float** compress_image(unsigned int frameNum, bool freeImage = true, bool compact = false); // revert to compressed pixels format and release image data
+    // size and cfa layout of the frame after loading the data, used to restore cached calibration frames without decoding them
+    struct FrameLayout {
+        std::int32_t width;
+        std::int32_t height;
+        std::uint32_t filters;
+        std::int32_t colors;
+        std::int32_t xtrans[6][6];
+    };
+    FrameLayout getFrameLayout() const;
+    float** allocateFrame(const FrameLayout& layout); // apply layout to an image read with loadRaw(false) and allocate data for it, only for single channel frames
     float** data;             // holds pixel values, data[i][j] corresponds to the ith row and jth column
+    uint16_t** data16;        // holds pixel values instead of data when compress_image was called with compact = true
+    float sample(int row, int col) const
+    {
+        return data16 ? data16[row][col] : data[row][col];
+    }
+    float sample(int row, int col, int c) const // for frames with 3 samples per pixel
+    {
+        return data16 ? data16[row][3 * col + c] : data[row][3 * col + c];
+    }
     unsigned prefilters;               // original filters saved ( used for 4 color processing )
     unsigned int getFrameCount() const { return is_raw; }
 
@@ -60,6 +80,7 @@ protected:
     int rotate_deg; // 0,90,180,270 degree of rotation: info taken by dcraw from exif
     char* profile_data; // Embedded ICC color profile
     float* allocation; // pointer to allocated memory
+    uint16_t* allocation16; // pointer to allocated memory of compact storage
     int maximum_c4[4];
     bool isFoveon() const
     {
@@ -18,6 +18,7 @@
  */
 #include <cmath>
 #include <iostream>
+#include <sstream>
 
 #include "rtengine.h"
 #include "rawimagesource.h"
@@ -30,6 +31,7 @@
 #include "curves.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
+#include "demosaiccache.h"
 #include "dcp.h"
 #include "rt_math.h"
 #include "improcfun.h"
@@ -38,6 +40,7 @@
 #include "camconst.h"
 #include "procparams.h"
 #include "color.h"
+#include "stageprofiler.h"
 //#define BENCHMARK
 //#include "StopWatch.h"
 #ifdef _OPENMP
@@ -488,6 +491,10 @@ RawImageSource::~RawImageSource ()
         delete rawDataBuffer[i];
     }
 
+    for(size_t i = 0; i < 4; ++i) {
+        delete rawDataFrames16[i];
+    }
+
     flushRGB();
     flushRawData();
 
@@ -1076,7 +1083,7 @@ int RawImageSource::load (const Glib::ustring &fname, bool firstFrameOnly)
 
     if(!errCode) {
         for(unsigned int i = 0; i < numFrames; ++i) {
-            riFrames[i]->compress_image(i);
+            riFrames[i]->compress_image(i, true, settings->compactRawStorage);
         }
     } else {
         return errCode;
@@ -1278,21 +1285,69 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         printf( "Flat Field Correction:%s\n", rif->get_filename().c_str());
     }
 
-    if(numFrames == 4) {
-        int bufferNumber = 0;
-        for(unsigned int i=0; i<4; ++i) {
-            if(i==currFrame) {
-                copyOriginalPixels(raw, ri, rid, rif, rawData);
-                rawDataFrames[i] = &rawData;
+    demosaicCacheKey.clear();
+
+    if (settings->demosaicCache && (ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS)) {
+        const std::string fileId = DemosaicCache::getFileId(ri->get_filename());
+
+        if (!fileId.empty()) {
+            std::ostringstream key;
+            key << DemosaicCache::getCodeId() << '|' << fileId << '|' << currFrame << '|' << DemosaicCache::getRawParamsKey(raw)
+                << '|' << (rid ? DemosaicCache::getFileId(rid->get_filename()) : "") << '|' << (rif ? DemosaicCache::getFileId(rif->get_filename()) : "");
+
+            if (!hasFlatField && lensProf.useVign && lensProf.lcMode != LensProfParams::LcMode::NONE) {
+                key << '|' << lensProf.getMethodString(lensProf.lcMode) << ' ' << lensProf.lcpFile << ' ' << lensProf.lfCameraMake
+                    << ' ' << lensProf.lfCameraModel << ' ' << lensProf.lfLens << ' ' << coarse.rotate << ' ' << coarse.hflip << ' ' << coarse.vflip;
+            }
+
+            demosaicCacheKey = key.str();
+        }
+    }
+
+    // lens profile for vignetting correction
+    std::unique_ptr<LensCorrection> pmap;
+
+    if (!hasFlatField && lensProf.useVign && lensProf.lcMode != LensProfParams::LcMode::NONE) {
+        if (lensProf.useLensfun()) {
+            pmap = LFDatabase::findModifier(lensProf, idata, W, H, coarse, -1);
+        } else {
+            const std::shared_ptr<LCPProfile> pLCPProf = LCPStore::getInstance()->getProfile(lensProf.lcpFile);
+
+            if (pLCPProf) { // don't check focal length to allow distortion correction for lenses without chip, also pass dummy focal length 1 in case of 0
+                pmap.reset(new LCPMapper(pLCPProf, max(idata->getFocalLen(), 1.0), idata->getFocalLen35mm(), idata->getFocusDist(), idata->getFNumber(), true, false, W, H, coarse, -1));
+            }
+        }
+    }
+
+    // Without flat field the per pixel corrections (dark frame, black level and scaling, vignetting) are applied in the same pass as the copy.
+    // The neighbourhood based corrections below (hot/dead pixels, PDAF lines, green equilibration, line denoise, bad pixel interpolation)
+    // still make one pass each over the complete corrected frame. Scheduling them on tiles with halos is not done yet
+    const bool fusedCopy = !hasFlatField && !(numFrames == 2 && currFrame == 2)
+                           && (ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1);
+    const auto copyPixels =
+        [&](RawImage *src, array2D<float> &dst)
+        {
+            if (fusedCopy) {
+                copyAndScalePixels(raw, src, rid, dst, pmap.get());
             } else {
-                if(!rawDataBuffer[bufferNumber]) {
-                    rawDataBuffer[bufferNumber] = new array2D<float>;
-                }
-                rawDataFrames[i] = rawDataBuffer[bufferNumber];
-                ++bufferNumber;
-                copyOriginalPixels(raw, riFrames[i], rid, rif, *rawDataFrames[i]);
+                copyOriginalPixels(raw, src, rid, rif, dst);
             }
+        };
+
+    StageTimer copyTimer("copy_raw_pixels");
+
+    if(numFrames == 4) {
+        // Pixel shift: only the current frame is prepared here, the other ones go through the same corrections one
+        // at a time before CA correction below. So with compact frames no more than one of them is held as floats
+        for(unsigned int i=0; i<4; ++i) {
+            // the compact copies of the last run are outdated now
+            delete rawDataFrames16[i];
+            rawDataFrames16[i] = nullptr;
+            rawDataFrames[i] = nullptr;
         }
+
+        copyPixels(ri, rawData);
+        rawDataFrames[currFrame] = &rawData;
     } else if (numFrames == 2 && currFrame == 2) { // average the frames
         if(!rawDataBuffer[0]) {
             rawDataBuffer[0] = new array2D<float>;
@@ -1307,10 +1362,12 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
             }
         }
     } else {
-        copyOriginalPixels(raw, ri, rid, rif, rawData);
+        copyPixels(ri, rawData);
     }
     //FLATFIELD end
 
+    copyTimer.stop();
+
 
     // Always correct camera badpixels from .badpixels file
     std::vector<badPix> *bp = dfm.getBadPixels( ri->get_maker(), ri->get_model(), idata->getSerialNumber() );
@@ -1348,58 +1405,29 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         }
     }
 
-    if(numFrames == 4) {
-        for(int i=0; i<4; ++i) {
-            scaleColors( 0, 0, W, H, raw, *rawDataFrames[i]);
-        }
-    } else {
+    if (!fusedCopy) {
+        StageTimer scaleTimer("scale_colors");
         scaleColors( 0, 0, W, H, raw, rawData); //+ + raw parameters for black level(raw.blackxx)
     }
 
     // Correct vignetting of lens profile
-    if (!hasFlatField && lensProf.useVign && lensProf.lcMode != LensProfParams::LcMode::NONE) {
-        std::unique_ptr<LensCorrection> pmap;
-        if (lensProf.useLensfun()) {
-            pmap = LFDatabase::findModifier(lensProf, idata, W, H, coarse, -1);
-        } else {
-            const std::shared_ptr<LCPProfile> pLCPProf = LCPStore::getInstance()->getProfile(lensProf.lcpFile);
-
-            if (pLCPProf) { // don't check focal length to allow distortion correction for lenses without chip, also pass dummy focal length 1 in case of 0
-                pmap.reset(new LCPMapper(pLCPProf, max(idata->getFocalLen(), 1.0), idata->getFocalLen35mm(), idata->getFocusDist(), idata->getFNumber(), true, false, W, H, coarse, -1));
-            }
-        }
-
-        if (pmap) {
-            LensCorrection &map = *pmap;
-            if (ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1) {
-                if(numFrames == 4) {
-                    for(int i = 0; i < 4; ++i) {
+    if (pmap && !fusedCopy) {
+        LensCorrection &map = *pmap;
+        if (ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1) {
 #ifdef _OPENMP
-                    #pragma omp parallel for schedule(dynamic,16)
-#endif
-
-                        for (int y = 0; y < H; y++) {
-                            map.processVignetteLine(W, y, (*rawDataFrames[i])[y]);
-                        }
-                    }
-                } else {
-
-#ifdef _OPENMP
-                    #pragma omp parallel for schedule(dynamic,16)
+            #pragma omp parallel for schedule(dynamic,16)
 #endif
 
-                    for (int y = 0; y < H; y++) {
-                        map.processVignetteLine(W, y, rawData[y]);
-                    }
-                }
-            } else if(ri->get_colors() == 3) {
+            for (int y = 0; y < H; y++) {
+                map.processVignetteLine(W, y, rawData[y]);
+            }
+        } else if(ri->get_colors() == 3) {
 #ifdef _OPENMP
-                #pragma omp parallel for schedule(dynamic,16)
+            #pragma omp parallel for schedule(dynamic,16)
 #endif
 
-                for (int y = 0; y < H; y++) {
-                    map.processVignetteLine3Channels(W, y, rawData[y]);
-                }
+            for (int y = 0; y < H; y++) {
+                map.processVignetteLine3Channels(W, y, rawData[y]);
             }
         }
     }
@@ -1424,8 +1452,13 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         }
     }
 
+    // kept for the other pixel shift frames
+    std::unique_ptr<PDAFLinesFilter> pdafFilter;
+    const GreenEqulibrateThreshold *pdafGreenThresh = nullptr;
+
     if (ri->getSensorType() == ST_BAYER && raw.bayersensor.pdafLinesFilter) {
-        PDAFLinesFilter f(ri);
+        pdafFilter.reset(new PDAFLinesFilter(ri));
+        PDAFLinesFilter &f = *pdafFilter;
 
         if (!bitmapBads) {
             bitmapBads.reset(new PixelsMap(W, H));
@@ -1439,14 +1472,8 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
                 printf("Marked %d hot pixels from PDAF lines\n", n);            
             }
 
-            auto &thresh = f.greenEqThreshold();        
-            if (numFrames == 4) {
-                for (int i = 0; i < 4; ++i) {
-                    green_equilibrate(thresh, *rawDataFrames[i]);
-                }
-            } else {
-                green_equilibrate(thresh, rawData);
-            }
+            pdafGreenThresh = &f.greenEqThreshold();
+            green_equilibrate(*pdafGreenThresh, rawData);
         }
     }
 
@@ -1459,47 +1486,34 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
             return cc && cc->get_globalGreenEquilibration();
         };
     
-    if ( ri->getSensorType() == ST_BAYER && (raw.bayersensor.greenthresh || (globalGreenEq() && raw.bayersensor.method != RAWParams::BayerSensor::getMethodString( RAWParams::BayerSensor::Method::VNG4))) ) {
+    const bool globalGreenEqNeeded = ri->getSensorType() == ST_BAYER && (raw.bayersensor.greenthresh || (globalGreenEq() && raw.bayersensor.method != RAWParams::BayerSensor::getMethodString( RAWParams::BayerSensor::Method::VNG4)));
+
+    if (globalGreenEqNeeded) {
         if (settings->verbose) {
             printf("Performing global green equilibration...\n");
         }
         // global correction
-        if(numFrames == 4) {
-            for(int i = 0; i < 4; ++i) {
-                green_equilibrate_global(*rawDataFrames[i]);
-            }
-        } else {
-            green_equilibrate_global(rawData);
-        }
+        green_equilibrate_global(rawData);
     }
 
     if ( ri->getSensorType() == ST_BAYER && raw.bayersensor.greenthresh > 0) {
+        StageTimer timer("green_equilibration");
+
         if (plistener) {
             plistener->setProgressStr ("PROGRESSBAR_GREENEQUIL");
             plistener->setProgress (0.0);
         }
 
         GreenEqulibrateThreshold thresh(0.01 * raw.bayersensor.greenthresh);
-
-        if(numFrames == 4) {
-            for(int i = 0; i < 4; ++i) {
-                green_equilibrate(thresh, *rawDataFrames[i]);
-            }
-        } else {
-            green_equilibrate(thresh, rawData);
-        }
+        green_equilibrate(thresh, rawData);
     }
 
 
     if( totBP ) {
+        StageTimer timer("bad_pixels");
+
         if ( ri->getSensorType() == ST_BAYER ) {
-            if(numFrames == 4) {
-                for(int i = 0; i < 4; ++i) {
-                    interpolateBadPixelsBayer(*(bitmapBads.get()), *rawDataFrames[i]);
-                }
-            } else {
-                interpolateBadPixelsBayer(*(bitmapBads.get()), rawData);
-            }
+            interpolateBadPixelsBayer(*(bitmapBads.get()), rawData);
         } else if ( ri->getSensorType() == ST_FUJI_XTRANS ) {
             interpolateBadPixelsXtrans(*(bitmapBads.get()));
         } else {
@@ -1508,6 +1522,8 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
     }
 
     if ( ri->getSensorType() == ST_BAYER && raw.bayersensor.linenoise > 0 ) {
+        StageTimer timer("line_denoise");
+
         if (plistener) {
             plistener->setProgressStr ("PROGRESSBAR_LINEDENOISE");
             plistener->setProgress (0.0);
@@ -1524,21 +1540,96 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         cfa_linedn(0.00002 * (raw.bayersensor.linenoise), int(raw.bayersensor.linenoiseDirection) & int(RAWParams::BayerSensor::LineNoiseDirection::VERTICAL), int(raw.bayersensor.linenoiseDirection) & int(RAWParams::BayerSensor::LineNoiseDirection::HORIZONTAL), *line_denoise_rowblender);
     }
 
-    if ( (raw.ca_autocorrect || fabs(raw.cared) > 0.001 || fabs(raw.cablue) > 0.001) && ri->getSensorType() == ST_BAYER ) { // Auto CA correction disabled for X-Trans, for now...
-        if (plistener) {
-            plistener->setProgressStr ("PROGRESSBAR_RAWCACORR");
-            plistener->setProgress (0.0);
+    const bool caCorrect = (raw.ca_autocorrect || fabs(raw.cared) > 0.001 || fabs(raw.cablue) > 0.001) && ri->getSensorType() == ST_BAYER; // Auto CA correction disabled for X-Trans, for now...
+
+    if (caCorrect && plistener) {
+        plistener->setProgressStr ("PROGRESSBAR_RAWCACORR");
+        plistener->setProgress (0.0);
+    }
+
+    if (numFrames == 4) {
+        // the other frames get the corrections the current one got above. CA correction runs on the frames in order,
+        // the first one providing the fit parameters for the others
+        const bool compactFrames = settings->compactPixelShiftFrames;
+        double fitParams[64];
+        float *caBuffer = nullptr;
+        int bufferNumber = 0;
+
+        if (compactFrames) {
+            // all frames share the first buffer, the other ones may be left from a run without compact frames
+            for (int i = 1; i < 3; ++i) {
+                delete rawDataBuffer[i];
+                rawDataBuffer[i] = nullptr;
+            }
         }
-        if(numFrames == 4) {
-            double fitParams[64];
-            float *buffer = CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, *rawDataFrames[0], fitParams, false, true, nullptr, false, options.chunkSizeCA, options.measure);
-            for(int i = 1; i < 3; ++i) {
-                CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, *rawDataFrames[i], fitParams, true, false, buffer, false, options.chunkSizeCA, options.measure);
+
+        for (unsigned int i = 0; i < 4; ++i) {
+            if (i != currFrame) {
+                StageTimer timer("pixelshift_frame");
+                const int buffer = compactFrames ? 0 : bufferNumber++;
+
+                if (!rawDataBuffer[buffer]) {
+                    rawDataBuffer[buffer] = new array2D<float>;
+                }
+
+                rawDataFrames[i] = rawDataBuffer[buffer];
+                array2D<float> &frame = *rawDataFrames[i];
+                copyPixels(riFrames[i], frame);
+
+                if (!fusedCopy) {
+                    scaleColors(0, 0, W, H, raw, frame);
+
+                    if (pmap) {
+#ifdef _OPENMP
+                        #pragma omp parallel for schedule(dynamic,16)
+#endif
+
+                        for (int y = 0; y < H; y++) {
+                            pmap->processVignetteLine(W, y, frame[y]);
+                        }
+                    }
+                }
+
+                if (pdafGreenThresh) {
+                    green_equilibrate(*pdafGreenThresh, frame);
+                }
+
+                if (globalGreenEqNeeded) {
+                    green_equilibrate_global(frame);
+                }
+
+                if (ri->getSensorType() == ST_BAYER && raw.bayersensor.greenthresh > 0) {
+                    GreenEqulibrateThreshold thresh(0.01 * raw.bayersensor.greenthresh);
+                    green_equilibrate(thresh, frame);
+                }
+
+                if (totBP && ri->getSensorType() == ST_BAYER) {
+                    interpolateBadPixelsBayer(*(bitmapBads.get()), frame);
+                }
             }
-            CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, *rawDataFrames[3], fitParams, true, false, buffer, true, options.chunkSizeCA, options.measure);
-        } else {
-            CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, rawData, nullptr, false, false, nullptr, true, options.chunkSizeCA, options.measure);
+
+            if (caCorrect) {
+                StageTimer timer("ca_correct");
+
+                if (i == 0) {
+                    caBuffer = CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, *rawDataFrames[0], fitParams, false, true, nullptr, false, options.chunkSizeCA, options.measure);
+                } else {
+                    CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, *rawDataFrames[i], fitParams, true, false, caBuffer, i == 3, options.chunkSizeCA, options.measure);
+                }
+            }
+
+            if (compactFrames && i != currFrame) {
+                compressPixelShiftFrame(i);
+            }
+        }
+
+        if (compactFrames) {
+            delete rawDataBuffer[0];
+            rawDataBuffer[0] = nullptr;
         }
+    } else if (caCorrect) {
+        StageTimer timer("ca_correct");
+        CA_correct_RT(raw.ca_autocorrect, raw.caautoiterations, raw.cared, raw.cablue, raw.ca_avoidcolourshift, rawData, nullptr, false, false, nullptr, true, options.chunkSizeCA, options.measure);
     }
 
     if(prepareDenoise && dirpyrdenoiseExpComp == INFINITY) {
@@ -1566,7 +1657,19 @@ void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &c
     MyTime t1, t2;
     t1.set();
 
-    if (ri->getSensorType() == ST_BAYER) {
+    std::string cacheKey;
+
+    if (!demosaicCacheKey.empty() && DemosaicCache::isWorthCaching(ri->getSensorType(), raw)) {
+        std::ostringstream key;
+        key << demosaicCacheKey << '|' << DemosaicCache::getRawParamsKey(raw) << '|' << autoContrast << ' ' << contrastThreshold << ' ' << settings->fastDualDemosaic << ' ' << (numFrames == 4 && settings->compactPixelShiftFrames);
+        cacheKey = Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, key.str());
+    }
+
+    const bool fromCache = !cacheKey.empty() && DemosaicCache::getInstance().load(cacheKey, W, H, red, green, blue, contrastThreshold);
+
+    if (fromCache) {
+        // red, green and blue have been read from the demosaic cache
+    } else if (ri->getSensorType() == ST_BAYER) {
         if ( raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::HPHD) ) {
             hphd_demosaic ();
         } else if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::VNG4) ) {
@@ -1627,6 +1730,10 @@ void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &c
         nodemosaic(true);
     }
 
+    if (!fromCache && !cacheKey.empty()) {
+        DemosaicCache::getInstance().store(cacheKey, W, H, red, green, blue, contrastThreshold);
+    }
+
     t2.set();
 
 
@@ -2390,22 +2497,32 @@ void RawImageSource::HLRecovery_Global(const ToneCurveParams &hrp)
 void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4])
 {
 //    BENCHFUN
-    float *cfablur = (float (*)) malloc (H * W * sizeof * cfablur);
     int BS = raw.ff_BlurRadius;
     BS += BS & 1;
 
+    // the blurs depend only on the flat field and the blur parameters, so they are kept by the flat field manager for the next images of a batch
+    const auto getBlur = [this, riFlatFile](int boxH, int boxW) {
+        return ffm.getBlurredFlatField(riFlatFile, boxH, boxW, [this, riFlatFile, boxH, boxW](float* cfablur) {
+            cfaboxblur(riFlatFile, cfablur, boxH, boxW);
+        });
+    };
+
+    std::shared_ptr<const std::vector<float>> cfablurMap;
+
     //function call to cfabloxblur
     if (raw.ff_BlurType == RAWParams::getFlatFieldBlurTypeString(RAWParams::FlatFieldBlurType::V)) {
-        cfaboxblur(riFlatFile, cfablur, 2 * BS, 0);
+        cfablurMap = getBlur(2 * BS, 0);
     } else if (raw.ff_BlurType == RAWParams::getFlatFieldBlurTypeString(RAWParams::FlatFieldBlurType::H)) {
-        cfaboxblur(riFlatFile, cfablur, 0, 2 * BS);
+        cfablurMap = getBlur(0, 2 * BS);
     } else if (raw.ff_BlurType == RAWParams::getFlatFieldBlurTypeString(RAWParams::FlatFieldBlurType::VH)) {
         //slightly more complicated blur if trying to correct both vertical and horizontal anomalies
-        cfaboxblur(riFlatFile, cfablur, BS, BS);    //first do area blur to correct vignette
+        cfablurMap = getBlur(BS, BS);    //first do area blur to correct vignette
     } else { //(raw.ff_BlurType == RAWParams::getFlatFieldBlurTypeString(RAWParams::area_ff))
-        cfaboxblur(riFlatFile, cfablur, BS, BS);
+        cfablurMap = getBlur(BS, BS);
     }
 
+    const float* const cfablur = cfablurMap->data();
+
     if(ri->getSensorType() == ST_BAYER || ri->get_colors() == 1) {
         float refcolor[2][2];
 
@@ -2563,8 +2680,14 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
 #endif
 
                 for (int row = 0; row < H; row++) {
+                    float rowRefcolor[6];
+
+                    for (int i = 0; i < 6; i++) {
+                        rowRefcolor[i] = refcolor[ri->XTRANSFC(row, i)];
+                    }
+
                     for (int col = 0; col < W; col++) {
-                        float tempval = (rawData[row][col] - black[0]) * ( refcolor[ri->XTRANSFC(row, col)] / max(1e-5f, cfablur[(row) * W + col] - black[0]) );
+                        float tempval = (rawData[row][col] - black[0]) * ( rowRefcolor[col % 6] / max(1e-5f, cfablur[(row) * W + col] - black[0]) );
 
                         if(tempval > maxvalthr) {
                             maxvalthr = tempval;
@@ -2598,26 +2721,57 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
 
         constexpr float minValue = 1.f; // if the pixel value in the flat field is less or equal this value, no correction will be applied.
 
+#ifdef __SSE2__
+        vfloat onev = F2V(1.f);
+        vfloat minValuev = F2V(minValue);
+#endif
 #ifdef _OPENMP
-        #pragma omp parallel for
+        #pragma omp parallel for schedule(dynamic,16)
 #endif
 
         for (int row = 0; row < H; row++) {
-            for (int col = 0; col < W; col++) {
-                int c  = ri->XTRANSFC(row, col);
-                float blur = cfablur[(row) * W + col] - black[c];
-                float vignettecorr = blur <= minValue ? 1.f : refcolor[c] / blur;
-                rawData[row][col] = (rawData[row][col] - black[c]) * vignettecorr + black[c];
+            // the xtrans pattern repeats every 6 columns, so 12 columns fill 3 vectors
+            float rowBlack[12];
+            float rowRefcolor[12];
+
+            for (int i = 0; i < 12; i++) {
+                int c = ri->XTRANSFC(row, i);
+                rowBlack[i] = black[c];
+                rowRefcolor[i] = refcolor[c];
+            }
+
+            int col = 0;
+#ifdef __SSE2__
+
+            for (; col < W - 11; col += 12) {
+                for (int i = 0; i < 12; i += 4) {
+                    vfloat blackv = LVFU(rowBlack[i]);
+                    vfloat blurv = LVFU(cfablur[row * W + col + i]) - blackv;
+                    vfloat vignettecorrv = LVFU(rowRefcolor[i]) / blurv;
+                    vignettecorrv = vself(vmaskf_le(blurv, minValuev), onev, vignettecorrv);
+                    vfloat valv = LVFU(rawData[row][col + i]);
+                    valv -= blackv;
+                    STVFU(rawData[row][col + i], valv * vignettecorrv + blackv);
+                }
+            }
+
+#endif
+
+            for (; col < W; col++) {
+                int i = col % 12;
+                float blur = cfablur[(row) * W + col] - rowBlack[i];
+                float vignettecorr = blur <= minValue ? 1.f : rowRefcolor[i] / blur;
+                rawData[row][col] = (rawData[row][col] - rowBlack[i]) * vignettecorr + rowBlack[i];
             }
         }
     }
 
     if (raw.ff_BlurType == RAWParams::getFlatFieldBlurTypeString(RAWParams::FlatFieldBlurType::VH)) {
-        float *cfablur1 = (float (*)) malloc (H * W * sizeof * cfablur1);
-        float *cfablur2 = (float (*)) malloc (H * W * sizeof * cfablur2);
         //slightly more complicated blur if trying to correct both vertical and horizontal anomalies
-        cfaboxblur(riFlatFile, cfablur1, 0, 2 * BS); //now do horizontal blur
-        cfaboxblur(riFlatFile, cfablur2, 2 * BS, 0); //now do vertical blur
+        const std::shared_ptr<const std::vector<float>> cfablurMap1 = getBlur(0, 2 * BS); //now do horizontal blur
+        const std::shared_ptr<const std::vector<float>> cfablurMap2 = getBlur(2 * BS, 0); //now do vertical blur
+        const float* const cfablur1 = cfablurMap1->data();
+        const float* const cfablur2 = cfablurMap2->data();
 
         if(ri->getSensorType() == ST_BAYER || ri->get_colors() == 1) {
             unsigned int c[2][2] {};
@@ -2667,26 +2821,47 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
                 }
             }
         } else if(ri->getSensorType() == ST_FUJI_XTRANS) {
+#ifdef __SSE2__
+            vfloat epsv = F2V(1e-5f);
+#endif
 #ifdef _OPENMP
-            #pragma omp parallel for
+            #pragma omp parallel for schedule(dynamic,16)
 #endif
 
             for (int row = 0; row < H; row++) {
-                for (int col = 0; col < W; col++) {
-                    int c  = ri->XTRANSFC(row, col);
-                    float hlinecorr = (max(1e-5f, cfablur[(row) * W + col] - black[c]) / max(1e-5f, cfablur1[(row) * W + col] - black[c]) );
-                    float vlinecorr = (max(1e-5f, cfablur[(row) * W + col] - black[c]) / max(1e-5f, cfablur2[(row) * W + col] - black[c]) );
-                    rawData[row][col] = ((rawData[row][col] - black[c]) * hlinecorr * vlinecorr + black[c]);
+                float rowBlack[12];
+
+                for (int i = 0; i < 12; i++) {
+                    rowBlack[i] = black[ri->XTRANSFC(row, i)];
+                }
+
+                int col = 0;
+#ifdef __SSE2__
+
+                for (; col < W - 11; col += 12) {
+                    for (int i = 0; i < 12; i += 4) {
+                        vfloat blackv = LVFU(rowBlack[i]);
+                        vfloat blurv = vmaxf(LVFU(cfablur[row * W + col + i]) - blackv, epsv);
+                        vfloat hlinecorrv = blurv / vmaxf(LVFU(cfablur1[row * W + col + i]) - blackv, epsv);
+                        vfloat vlinecorrv = blurv / vmaxf(LVFU(cfablur2[row * W + col + i]) - blackv, epsv);
+                        vfloat valv = LVFU(rawData[row][col + i]);
+                        valv -= blackv;
+                        STVFU(rawData[row][col + i], valv * hlinecorrv * vlinecorrv + blackv);
+                    }
+                }
+
+#endif
+
+                for (; col < W; col++) {
+                    int i = col % 12;
+                    float hlinecorr = (max(1e-5f, cfablur[(row) * W + col] - rowBlack[i]) / max(1e-5f, cfablur1[(row) * W + col] - rowBlack[i]) );
+                    float vlinecorr = (max(1e-5f, cfablur[(row) * W + col] - rowBlack[i]) / max(1e-5f, cfablur2[(row) * W + col] - rowBlack[i]) );
+                    rawData[row][col] = ((rawData[row][col] - rowBlack[i]) * hlinecorr * vlinecorr + rowBlack[i]);
                 }
             }
 
         }
-
-        free (cfablur1);
-        free (cfablur2);
     }
-
-    free (cfablur);
 }
 
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -2712,7 +2887,17 @@ void RawImageSource::copyOriginalPixels(const RAWParams &raw, RawImage *src, Raw
                 for (int col = 0; col < W; col++) {
                     int c  = FC(row, col);
                     int c4 = ( c == 1 && !(row & 1) ) ? 3 : c;
-                    rawData[row][col] = max(src->data[row][col] + black[c4] - riDark->data[row][col], 0.0f);
+                    rawData[row][col] = max(src->sample(row, col) + black[c4] - riDark->data[row][col], 0.0f);
+                }
+            }
+        } else if (src->data16) {
+#ifdef _OPENMP
+            #pragma omp parallel for
+#endif
+
+            for (int row = 0; row < H; row++) {
+                for (int col = 0; col < W; col++) {
+                    rawData[row][col] = src->data16[row][col];
                 }
             }
         } else {
@@ -2782,6 +2967,94 @@ void RawImageSource::copyOriginalPixels(const RAWParams &raw, RawImage *src, Raw
     }
 }
 
+/* Copy original pixel data, subtract dark frame (if present), scale colors and correct vignetting (if vignetteMap is set) in one pass.
+ * Gives the same result as copyOriginalPixels followed by scaleColors for the whole image and processVignetteLine,
+ * used for bayer, xtrans and monochrome sensors when there is no flat field
+ */
+void RawImageSource::copyAndScalePixels(const RAWParams &raw, RawImage *src, RawImage *riDark, array2D<float> &rawData, const LensCorrection *vignetteMap)
+{
+    const unsigned short black[4] = {
+        (unsigned short)ri->get_cblack(0), (unsigned short)ri->get_cblack(1),
+        (unsigned short)ri->get_cblack(2), (unsigned short)ri->get_cblack(3)
+    };
+
+    if (!rawData) {
+        rawData(W, H);
+    }
+
+    prepareScaleColors(raw);
+
+    const bool subtractDark = riDark && W == riDark->get_width() && H == riDark->get_height();
+    // the channel selection of copyOriginalPixels and scaleColors, which check the sensor types in different order
+    const bool cfa = ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS;
+    const bool bayer = ri->getSensorType() == ST_BAYER;
+    const bool mono = !bayer && ri->get_colors() == 1;
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        float tmpchmax[3] = {};
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic,16) nowait
+#endif
+
+        for (int row = 0; row < H; ++row) {
+            // the cfa patterns repeat every 2 (bayer) or 6 (xtrans) columns
+            int darkBlack[6];
+            int scaleChannel[6];
+            int maxChannel[6];
+
+            for (int k = 0; k < 6; ++k) {
+                const int c = FC(row, k);
+                const int c4 = (c == 1 && !(row & 1)) ? 3 : c;
+                darkBlack[k] = black[cfa ? c4 : 0];
+
+                if (bayer) {
+                    scaleChannel[k] = c4;
+                    maxChannel[k] = c;
+                } else if (mono) {
+                    scaleChannel[k] = maxChannel[k] = 0;
+                } else {
+                    scaleChannel[k] = maxChannel[k] = ri->XTRANSFC(row, k);
+                }
+            }
+
+            float* const dst = rawData[row];
+
+            for (int col = 0, k = 0; col < W; ++col, k = k == 5 ? 0 : k + 1) {
+                float val = src->sample(row, col);
+
+                if (subtractDark) {
+                    val = max(val + darkBlack[k] - riDark->data[row][col], 0.0f);
+                }
+
+                val -= cblacksom[scaleChannel[k]];
+                val *= scale_mul[scaleChannel[k]];
+                dst[col] = val;
+                tmpchmax[maxChannel[k]] = max(tmpchmax[maxChannel[k]], val);
+            }
+
+            if (vignetteMap) {
+                vignetteMap->processVignetteLine(W, row, dst);
+            }
+        }
+
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        {
+            if (mono) {
+                chmax[0] = chmax[1] = chmax[2] = chmax[3] = max(tmpchmax[0], chmax[0]);
+            } else {
+                chmax[0] = max(tmpchmax[0], chmax[0]);
+                chmax[1] = max(tmpchmax[1], chmax[1]);
+                chmax[2] = max(tmpchmax[2], chmax[2]);
+            }
+        }
+    }
+}
+
 void RawImageSource::cfaboxblur(RawImage *riFlatFile, float* cfablur, int boxH, int boxW)
 {
 
@@ -3030,7 +3303,7 @@ void RawImageSource::cfaboxblur(RawImage *riFlatFile, float* cfablur, int boxH,
 
 
 // Scale original pixels into the range 0 65535 using black offsets and multipliers
-void RawImageSource::scaleColors(int winx, int winy, int winw, int winh, const RAWParams &raw, array2D<float> &rawData)
+void RawImageSource::prepareScaleColors(const RAWParams &raw)
 {
     chmax[0] = chmax[1] = chmax[2] = chmax[3] = 0; //channel maxima
     float black_lev[4] = {0.f};//black level
@@ -3070,6 +3343,11 @@ void RawImageSource::scaleColors(int winx, int winy, int winw, int winh, const R
     for(int i = 0; i < 4 ; i++) {
         clmax[i] = (c_white[i] - cblacksom[i]) * scale_mul[i];    // raw clip level
     }
+}
+
+void RawImageSource::scaleColors(int winx, int winy, int winw, int winh, const RAWParams &raw, array2D<float> &rawData)
+{
+    prepareScaleColors(raw);
 
     // this seems strange, but it works
 
@@ -4338,26 +4616,26 @@ void RawImageSource::getRAWHistogram (LUTu & histRedRaw, LUTu & histGreenRaw, LU
                 c2 = ( fourColours && c2 == 1 && !(i & 1) ) ? 3 : c2;
 
                 for (j = start; j < end - 1; j += 2) {
-                    tmphist[c1][(int)(ri->data[i][j] * scale)]++;
-                    tmphist[c2][(int)(ri->data[i][j + 1] * scale)]++;
+                    tmphist[c1][(int)(ri->sample(i, j) * scale)]++;
+                    tmphist[c2][(int)(ri->sample(i, j + 1) * scale)]++;
                 }
 
                 if(j < end) { // last pixel of row if width is odd
-                    tmphist[c1][(int)(ri->data[i][j] * scale)]++;
+                    tmphist[c1][(int)(ri->sample(i, j) * scale)]++;
                 }
             } else if (ri->get_colors() == 1) {
                 for (int j = start; j < end; j++) {
-                    tmphist[0][(int)(ri->data[i][j] * scale)]++;
+                    tmphist[0][(int)(ri->sample(i, j) * scale)]++;
                 }
             } else if(ri->getSensorType() == ST_FUJI_XTRANS) {
                 for (int j = start; j < end - 1; j += 2) {
                     int c = ri->XTRANSFC(i, j);
-                    tmphist[c][(int)(ri->data[i][j] * scale)]++;
+                    tmphist[c][(int)(ri->sample(i, j) * scale)]++;
                 }
             } else {
                 for (int j = start; j < end; j++) {
                     for (int c = 0; c < 3; c++) {
-                        tmphist[c][(int)(ri->data[i][3 * j + c] * scale)]++;
+                        tmphist[c][(int)(ri->sample(i, j, c) * scale)]++;
                     }
                 }
             }
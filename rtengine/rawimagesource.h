@@ -35,6 +35,8 @@
 namespace rtengine
 {
 
+class LensCorrection;
+
 class RawImageSource : public ImageSource
 {
 private:
@@ -81,6 +83,8 @@ protected:
     array2D<float> rawData;  // holds preprocessed pixel values, rowData[i][j] corresponds to the ith row and jth column
     array2D<float> *rawDataFrames[6] = {nullptr};
     array2D<float> *rawDataBuffer[5] = {nullptr};
+    array2D<uint16_t> *rawDataFrames16[4] = {nullptr}; // preprocessed pixel shift frames stored as 16 bit samples instead of rawDataFrames, see settings->compactPixelShiftFrames
+    float rawDataFrames16Scale[4] = {1.f, 1.f, 1.f, 1.f}; // factor to get the float values from rawDataFrames16
 
     // the interpolated green plane:
     array2D<float> green;
@@ -95,6 +99,7 @@ protected:
     // the interpolated blue plane:
     array2D<float>* blueCache;
     bool rawDirty;
+    std::string demosaicCacheKey; // describes the input of demosaic for the on-disk cache, empty if not cacheable
     float psRedBrightness[4];
     float psGreenBrightness[4];
     float psBlueBrightness[4];
@@ -142,6 +147,8 @@ public:
     void        copyOriginalPixels(const RAWParams &raw, RawImage *ri, RawImage *riDark, RawImage *riFlatFile, array2D<float> &rawData  );
     void        cfaboxblur  (RawImage *riFlatFile, float* cfablur, int boxH, int boxW);
     void        scaleColors (int winx, int winy, int winw, int winh, const RAWParams &raw, array2D<float> &rawData); // raw for cblack
+    void        prepareScaleColors(const RAWParams &raw);
+    void        copyAndScalePixels(const RAWParams &raw, RawImage *src, RawImage *riDark, array2D<float> &rawData, const LensCorrection *vignetteMap);
 
     void        getImage    (const ColorTemp &ctemp, int tran, Imagefloat* image, const PreviewProps &pp, const procparams::ToneCurveParams &hrp, const procparams::RAWParams &raw) override;
     eSensorType getSensorType () const override
@@ -281,12 +288,14 @@ protected:
     void jdl_interpolate_omp();
     void igv_interpolate(int winw, int winh);
     void lmmse_interpolate_omp(int winw, int winh, array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, int iterations);
-    void amaze_demosaic_RT(int winx, int winy, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, size_t chunkSize = 1, bool measure = false);//Emil's code for AMaZE
+    // If detailMask is set, tiles without a positive value in detailMask are skipped and their output is left unset
+    void amaze_demosaic_RT(int winx, int winy, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, size_t chunkSize = 1, bool measure = false, const float * const *detailMask = nullptr);//Emil's code for AMaZE
     void dual_demosaic_RT(bool isBayer, const RAWParams &raw, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, double &contrast, bool autoContrast = false);
     void fast_demosaic();//Emil's code for fast demosaicing
     void dcb_demosaic(int iterations, bool dcb_enhance);
     void ahd_demosaic();
-    void rcd_demosaic(size_t chunkSize = 1, bool measure = false);
+    void rcd_demosaic(size_t chunkSize = 1, bool measure = false, const float * const *detailMask = nullptr);
+    void rcd_demosaic_avx2(size_t chunkSize, bool measure, const float * const *detailMask);
     void border_interpolate(unsigned int border, float (*image)[4], unsigned int start = 0, unsigned int end = 0);
     void border_interpolate2(int winw, int winh, int lborders, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue);
     void dcb_initTileLimits(int &colMin, int &rowMin, int &colMax, int &rowMax, int x0, int y0, int border);
@@ -305,9 +314,10 @@ protected:
     void dcb_color_full(float (*image)[3], int x0, int y0, float (*chroma)[2]);
     void cielab (const float (*rgb)[3], float* l, float* a, float *b, const int width, const int height, const int labWidth, const float xyz_cam[3][3]);
     void xtransborder_interpolate (int border, array2D<float> &red, array2D<float> &green, array2D<float> &blue);
-    void xtrans_interpolate (const int passes, const bool useCieLab, size_t chunkSize = 1, bool measure = false);
+    void xtrans_interpolate (const int passes, const bool useCieLab, size_t chunkSize = 1, bool measure = false, const float * const *detailMask = nullptr); // chunkSize 0 chooses the tiles per thread automatically
     void fast_xtrans_interpolate (const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue);
     void pixelshift(int winx, int winy, int winw, int winh, const RAWParams &rawParams, unsigned int frame, const std::string &make, const std::string &model, float rawWpCorrection);
+    void compressPixelShiftFrame(unsigned int i); // moves a preprocessed frame from rawDataFrames to rawDataFrames16
     void    hflip       (Imagefloat* im);
     void    vflip       (Imagefloat* im);
     void getRawValues(int x, int y, int rotate, int &R, int &G, int &B) override;
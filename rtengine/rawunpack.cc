@@ -0,0 +1,113 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rawunpack.h"
+#include "cpufeatures.h"
+
+#if defined(__SSSE3__) || defined(RT_SSSE3_DISPATCH)
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+
+#if defined(__SSSE3__) || defined(RT_SSSE3_DISPATCH)
+// 8 samples per iteration from bps bytes, loaded as 16 bytes. Each sample is assembled from
+// the big endian word at its first byte, shifted left by its bit offset (multiplication by
+// a power of 2), and the high bits of the following byte, shifted right accordingly.
+// Only for 8 <= bps <= 14. Returns the number of unpacked samples, which is a multiple of 8
+#ifndef __SSSE3__
+RT_SSSE3_TARGET
+#endif
+size_t unpackBitsMsbSsse3(const uint8_t* src, uint16_t* dst, size_t count, int bps, size_t srcBytes)
+{
+    size_t i = 0;
+
+    alignas(16) int8_t hiShuffle[16];
+    alignas(16) int8_t loShuffle[16];
+    alignas(16) uint16_t multipliers[8];
+
+    for (int k = 0; k < 8; ++k) {
+        const int bit = bps * k;
+        hiShuffle[2 * k] = bit / 8 + 1;
+        hiShuffle[2 * k + 1] = bit / 8;
+        loShuffle[2 * k] = -128;
+        loShuffle[2 * k + 1] = bit / 8 + 2;
+        multipliers[k] = 1 << (bit % 8);
+    }
+
+    const __m128i hiMask = _mm_load_si128(reinterpret_cast<const __m128i*>(hiShuffle));
+    const __m128i loMask = _mm_load_si128(reinterpret_cast<const __m128i*>(loShuffle));
+    const __m128i mulv = _mm_load_si128(reinterpret_cast<const __m128i*>(multipliers));
+    const __m128i shift = _mm_cvtsi32_si128(16 - bps);
+
+    for (; i + 8 <= count && (i / 8) * bps + 16 <= srcBytes; i += 8) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i / 8) * bps));
+        const __m128i hi = _mm_mullo_epi16(_mm_shuffle_epi8(in, hiMask), mulv);
+        const __m128i lo = _mm_mulhi_epu16(_mm_shuffle_epi8(in, loMask), mulv);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_srl_epi16(_mm_or_si128(hi, lo), shift));
+    }
+
+    return i;
+}
+#endif
+
+}
+
+namespace rtengine
+{
+
+bool unpackBitsMsbUsesSsse3()
+{
+#if defined(__SSSE3__)
+    return true;
+#elif defined(RT_SSSE3_DISPATCH)
+    return cpuHasSsse3();
+#else
+    return false;
+#endif
+}
+
+void unpackBitsMsb(const uint8_t* src, uint16_t* dst, size_t count, int bps, size_t srcBytes)
+{
+    size_t i = 0;
+
+#if defined(__SSSE3__) || defined(RT_SSSE3_DISPATCH)
+    if (bps >= 8 && bps <= 14 && unpackBitsMsbUsesSsse3()) {
+        i = unpackBitsMsbSsse3(src, dst, count, bps, srcBytes);
+    }
+#endif
+
+    // scalar fallback and tail
+    const uint8_t* sp = src + (i / 8) * bps;
+    const uint8_t* const end = src + srcBytes;
+    const uint32_t mask = (1u << bps) - 1;
+    uint64_t bitbuf = 0;
+    int vbits = 0;
+
+    for (; i < count; ++i) {
+        while (vbits < bps) {
+            bitbuf = (bitbuf << 8) | (sp < end ? *sp++ : 0);
+            vbits += 8;
+        }
+
+        vbits -= bps;
+        dst[i] = (bitbuf >> vbits) & mask;
+    }
+}
+
+}
@@ -0,0 +1,38 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtengine
+{
+
+/*
+ * Unpacks count samples of bps bits (1..16) from a big endian (most significant
+ * bit first) bit stream, as written by most cameras storing uncompressed packed
+ * raw data. src must hold at least srcBytes readable bytes, the stream starts at
+ * a byte boundary.
+ * 8..14 bit samples are unpacked with SSSE3 when the cpu supports it.
+ */
+void unpackBitsMsb(const uint8_t* src, uint16_t* dst, size_t count, int bps, size_t srcBytes);
+
+// true if unpackBitsMsb uses SSSE3 on this cpu
+bool unpackBitsMsbUsesSsse3();
+
+}
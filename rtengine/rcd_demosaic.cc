@@ -23,7 +23,9 @@
 #include "procparams.h"
 #include "../rtgui/multilangmgr.h"
 #include "opthelper.h"
+#include "rt_algo.h"
 #include "StopWatch.h"
+#include "cpufeatures.h"
 
 using namespace std;
 
@@ -40,8 +42,19 @@ namespace rtengine
 * Licensed under the GNU GPL version 3
 */
 // Tiled version by Ingo Weyrich (heckflosse67@gmx.de)
-void RawImageSource::rcd_demosaic(size_t chunkSize, bool measure)
+#ifdef RCD_DEMOSAIC_AVX2
+void RawImageSource::rcd_demosaic_avx2(size_t chunkSize, bool measure, const float * const *detailMask)
+#else
+void RawImageSource::rcd_demosaic(size_t chunkSize, bool measure, const float * const *detailMask)
+#endif
 {
+#if defined(RT_AVX2_CLONES) && !defined(RCD_DEMOSAIC_AVX2)
+    if (cpuHasAvx2()) {
+        rcd_demosaic_avx2(chunkSize, measure, detailMask);
+        return;
+    }
+#endif
+
     std::unique_ptr<StopWatch> stop;
 
     if (measure) {
@@ -92,6 +105,10 @@ void RawImageSource::rcd_demosaic(size_t chunkSize, bool measure)
             if(colStart + rcdBorder == colEnd - rcdBorder) {
                 continue;
             }
+            if (detailMask && !maskHasPositive(detailMask, rowStart + rcdBorder, colStart + rcdBorder, rowEnd - rcdBorder, colEnd - rcdBorder)) {
+                // the output of this tile would not be used
+                continue;
+            }
 
             const int tileRows = std::min(rowEnd - rowStart, tileSize);
             const int tilecols = std::min(colEnd - colStart, tileSize);
@@ -479,4 +479,17 @@ void buildBlendMask(const float* const * luminance, float **blend, int W, int H,
     }
 }
 
+bool maskHasPositive(const float* const * mask, int top, int left, int bottom, int right)
+{
+    for (int i = top; i < bottom; ++i) {
+        for (int j = left; j < right; ++j) {
+            if (mask[i][j] > 0.f) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 }
@@ -25,4 +25,6 @@ namespace rtengine
 {
 void findMinMaxPercentile(const float* data, size_t size, float minPrct, float& minOut, float maxPrct, float& maxOut, bool multiThread = true);
 void buildBlendMask(const float* const * luminance, float **blend, int W, int H, float &contrastThreshold, float amount = 1.f, bool autoContrast = false, float ** clipmask = nullptr);
+// true if any value of mask in rows [top, bottom) and columns [left, right) is > 0
+bool maskHasPositive(const float* const * mask, int top, int left, int bottom, int right);
 }
@@ -417,6 +417,7 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
 
     // See if it is something we support
     if (checkRawImageThumb (*ri)) {
+        imfile_advise(ri->get_file(), IMFILE_ADVICE::WILLNEED, ri->get_thumbOffset(), ri->get_thumbLength());
         const char* data ((const char*)fdata (ri->get_thumbOffset(), ri->get_file()));
 
         if ( (unsigned char)data[1] == 0xd8 ) {
@@ -88,6 +88,16 @@ public:
         RAW_IF_NOT_JPEG_FULLSIZE
     };
     ThumbnailInspectorMode thumbnail_inspector_mode;
+    bool            compactRawStorage;      ///< Keep the original sensor mosaic of integer raw files as 16 bit samples instead of floats
+    bool            demosaicCache;          ///< Store demosaiced images on disk and reuse them when the raw parameters did not change
+    int             demosaicCacheSize;      ///< Maximum size of the demosaic cache in MiB
+    Glib::ustring   demosaicCacheDir;       ///< The directory of the demosaic cache
+    bool            fastDualDemosaic;       ///< Build the dual demosaic blend mask from the fast demosaicer and skip the tiles of the detailed one which are not used
+    bool            compactPixelShiftFrames; ///< Keep the additional preprocessed frames of pixel shift files as 16 bit samples instead of floats
+    double          caAutoConvergence;      ///< Stop the iterations of auto raw CA correction when the remaining shift is below this value, 0 = always do all iterations
+    bool            calibrationCache;       ///< Store master dark frames, flat fields and the shot information of their directories on disk
+    Glib::ustring   calibrationCacheDir;    ///< The directory of the calibration cache
+    Glib::ustring   fftwWisdomFile;         ///< The file storing the FFTW wisdom, empty to not store it
 
     /** Creates a new instance of Settings.
       * @return a pointer to the new Settings instance. */
@@ -16,6 +16,8 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <cstring>
+
 #include "rtengine.h"
 #include "colortemp.h"
 #include "imagesource.h"
@@ -30,6 +32,7 @@
 #include "rawimagesource.h"
 #include "../rtgui/multilangmgr.h"
 #include "mytime.h"
+#include "stageprofiler.h"
 #undef THREAD_PRIORITY_NORMAL
 
 namespace rtengine
@@ -136,6 +139,7 @@ private:
 
     bool stage_init()
     {
+        StageTimer stageTimer ("stage_init");
         errorCode = 0;
 
         if (pl) {
@@ -207,7 +211,10 @@ private:
         ImProcFunctions &ipf = * (ipf_p.get());
 
         imgsrc->setCurrentFrame (params.raw.bayersensor.imageNum);
-        imgsrc->preprocess ( params.raw, params.lensProf, params.coarse, params.dirpyrDenoise.enabled);
+        {
+            StageTimer timer ("preprocess");
+            imgsrc->preprocess ( params.raw, params.lensProf, params.coarse, params.dirpyrDenoise.enabled);
+        }
 
         // After preprocess, run film negative processing if enabled
         if ((imgsrc->getSensorType() == ST_BAYER || (imgsrc->getSensorType() == ST_FUJI_XTRANS)) && params.filmNegative.enabled) {
@@ -220,8 +227,12 @@ private:
         bool autoContrast = imgsrc->getSensorType() == ST_BAYER ? params.raw.bayersensor.dualDemosaicAutoContrast : params.raw.xtranssensor.dualDemosaicAutoContrast;
         double contrastThreshold = imgsrc->getSensorType() == ST_BAYER ? params.raw.bayersensor.dualDemosaicContrast : params.raw.xtranssensor.dualDemosaicContrast;
 
-        imgsrc->demosaic (params.raw, autoContrast, contrastThreshold, params.pdsharpening.enabled && pl);
+        {
+            StageTimer timer ("demosaic");
+            imgsrc->demosaic (params.raw, autoContrast, contrastThreshold, params.pdsharpening.enabled && pl);
+        }
         if (params.pdsharpening.enabled) {
+            StageTimer timer ("capture_sharpening");
             imgsrc->captureSharpening(params.pdsharpening, false, params.pdsharpening.contrast, params.pdsharpening.deconvradius);
         }
 
@@ -232,6 +243,7 @@ private:
         pp = PreviewProps (0, 0, fw, fh, 1);
 
         if (params.retinex.enabled) { //enabled Retinex
+            StageTimer timer ("retinex");
             LUTf cdcurve (65536, 0);
             LUTf mapcurve (65536, 0);
             LUTu dummy;
@@ -252,7 +264,10 @@ private:
             pl->setProgress (0.40);
         }
 
-        imgsrc->HLRecovery_Global ( params.toneCurve );
+        {
+            StageTimer timer ("hl_recovery_global");
+            imgsrc->HLRecovery_Global ( params.toneCurve );
+        }
 
 
         if (pl) {
@@ -747,7 +762,10 @@ private:
         }
 
         baseImg = new Imagefloat (fw, fh);
-        imgsrc->getImage (currWB, tr, baseImg, pp, params.toneCurve, params.raw);
+        {
+            StageTimer timer ("get_image");
+            imgsrc->getImage (currWB, tr, baseImg, pp, params.toneCurve, params.raw);
+        }
 
         if (pl) {
             pl->setProgress (0.50);
@@ -799,6 +817,7 @@ private:
 
     void stage_denoise()
     {
+        StageTimer stageTimer ("stage_denoise");
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -847,6 +866,7 @@ private:
 //      ipf.RGB_denoise(baseImg, baseImg, calclum, imgsrc->isRAW(), denoiseParams, params.defringe, imgsrc->getDirPyrDenoiseExpComp(), noiseLCurve, lldenoiseutili);
             float nresi, highresi;
             int kall = 2;
+            StageTimer timer ("rgb_denoise");
             ipf.RGB_denoise (kall, baseImg, baseImg, calclum, ch_M, max_r, max_b, imgsrc->isRAW(), denoiseParams, imgsrc->getDirPyrDenoiseExpComp(), noiseLCurve, noiseCCurve, nresi, highresi);
 
         }
@@ -866,22 +886,33 @@ private:
 
     void stage_transform()
     {
+        StageTimer stageTimer ("stage_transform");
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
 
-        imgsrc->convertColorSpace (baseImg, params.icm, currWB);
+        {
+            StageTimer timer ("convert_colorspace");
+            imgsrc->convertColorSpace (baseImg, params.icm, currWB);
+        }
 
         // perform first analysis
         hist16 (65536);
 
         ipf.firstAnalysis (baseImg, params, hist16);
 
-        ipf.dehaze(baseImg);
-        ipf.ToneMapFattal02(baseImg);
+        {
+            StageTimer timer ("dehaze");
+            ipf.dehaze(baseImg);
+        }
+        {
+            StageTimer timer ("tonemap_fattal02");
+            ipf.ToneMapFattal02(baseImg);
+        }
 
         // perform transform (excepted resizing)
         if (ipf.needsTransform()) {
+            StageTimer timer ("transform");
             Imagefloat* trImg = nullptr;
             if (ipf.needsLuminanceOnly()) {
                 trImg = baseImg;
@@ -899,6 +930,7 @@ private:
 
     Imagefloat *stage_finish()
     {
+        StageTimer stageTimer ("stage_finish");
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -964,8 +996,6 @@ private:
             CurveFactory::curveToning (params.colorToning.cl2curve, cl2Toningcurve, 1);
         }
 
-        labView = new LabImage (fw, fh);
-
         if (params.blackwhite.enabled) {
             CurveFactory::curveBW (params.blackwhite.beforeCurve, params.blackwhite.afterCurve, hist16, dummy, customToneCurvebw1, customToneCurvebw2, 1);
         }
@@ -998,9 +1028,24 @@ private:
         DCPProfile::ApplyState as;
         DCPProfile *dcpProf = imgsrc->getDCP (params.icm, as);
 
+        int imw, imh;
+        const double tmpScale = ipf.resizeScale (&params, fw, fh, imw, imh);
+        const bool labResize = params.resize.enabled && params.resize.method != "Nearest" && (tmpScale != 1.0 || params.prsharpening.enabled);
+
+        if (isStreamable (params, labResize)) {
+            Imagefloat* readyImg = stage_finish_streamed (satLimit, satLimitOpacity, opautili, dcpProf, as);
+            const bool bwonly = params.blackwhite.enabled && !params.colorToning.enabled && !autili && !butili && !params.colorappearance.enabled;
+            return stage_output (readyImg, bwonly, tmpScale, imw, imh);
+        }
+
+        labView = new LabImage (fw, fh);
+
         LUTu histToneCurve;
 
-        ipf.rgbProc (baseImg, labView, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
+        {
+            StageTimer timer ("rgb_proc");
+            ipf.rgbProc (baseImg, labView, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
+        }
 
         if (settings->verbose) {
             printf ("Output image / Auto B&W coefs:   R=%.2f   G=%.2f   B=%.2f\n", autor, autog, autob);
@@ -1071,7 +1116,10 @@ private:
         CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
                                        params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
 
-        ipf.chromiLuminanceCurve (nullptr, 1, labView, labView, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+        {
+            StageTimer timer ("chromi_luminance_curve");
+            ipf.chromiLuminanceCurve (nullptr, 1, labView, labView, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+        }
 
         if ((params.colorappearance.enabled && !params.colorappearance.tonecie) || (!params.colorappearance.enabled)) {
             ipf.EPDToneMap (labView, 0, 1);
@@ -1128,6 +1176,7 @@ private:
         CurveFactory::curveWavContL (wavcontlutili, params.wavelet.wavclCurve, wavclCurve,/* hist16C, dummy,*/ 1);
 
         if (params.wavelet.enabled) {
+            StageTimer timer ("wavelet");
             ipf.ip_wavelet (labView, labView, 2, WaveParams, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW,  waOpacityCurveWL, wavclCurve, 1);
         }
 
@@ -1185,6 +1234,7 @@ private:
             float CAMMean = NAN;
 
             float d, dj, yb;
+            StageTimer timer ("ciecam02");
             ipf.ciecam_02float (cieView, float (adap), 1, 2, labView, &params, customColCurve1, customColCurve2, customColCurve3, dummy, dummy, CAMBrightCurveJ, CAMBrightCurveQ, CAMMean, 0, 1, true, d, dj, yb, 1);
         }
 
@@ -1202,9 +1252,6 @@ private:
             pl->setProgress (0.60);
         }
 
-        int imw, imh;
-        double tmpScale = ipf.resizeScale (&params, fw, fh, imw, imh);
-        bool labResize = params.resize.enabled && params.resize.method != "Nearest" && (tmpScale != 1.0 || params.prsharpening.enabled);
         LabImage *tmplab;
 
         // crop and convert to rgb16
@@ -1239,6 +1286,7 @@ private:
                 (params.resize.allowUpscaling || (labView->W >= imw && labView->H >= imh))) {
                 // resize image
                 tmplab = new LabImage (imw, imh);
+                StageTimer timer ("lanczos");
                 ipf.Lanczos (labView, tmplab, tmpScale);
                 delete labView;
                 labView = tmplab;
@@ -1256,9 +1304,6 @@ private:
             }
         }
 
-        cmsHPROFILE jprof = nullptr;
-        constexpr bool customGamma = false;
-        constexpr bool useLCMS = false;
         bool bwonly = params.blackwhite.enabled && !params.colorToning.enabled && !autili && !butili && !params.colorappearance.enabled;
 
         ///////////// Custom output gamma has been removed, the user now has to create
@@ -1267,7 +1312,9 @@ private:
         // if Default gamma mode: we use the profile selected in the "Output profile" combobox;
         // gamma come from the selected profile, otherwise it comes from "Free gamma" tool
 
+        StageTimer lab2rgbTimer ("lab2rgb");
         Imagefloat* readyImg = ipf.lab2rgbOut (labView, cx, cy, cw, ch, params.icm);
+        lab2rgbTimer.stop();
 
         if (settings->verbose) {
             printf ("Output profile_: \"%s\"\n", params.icm.outputProfile.c_str());
@@ -1276,13 +1323,26 @@ private:
         delete labView;
         labView = nullptr;
 
+        return stage_output (readyImg, bwonly, tmpScale, imw, imh);
+    }
 
+    Imagefloat *stage_output (Imagefloat *readyImg, bool bwonly, double tmpScale, int imw, int imh)
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        cmsHPROFILE jprof = nullptr;
+        constexpr bool customGamma = false;
+        constexpr bool useLCMS = false;
 
         if (bwonly) { //force BW r=g=b
             if (settings->verbose) {
                 printf ("Force BW\n");
             }
 
+            const int cw = readyImg->getWidth();
+            const int ch = readyImg->getHeight();
+
             for (int ccw = 0; ccw < cw; ccw++) {
                 for (int cch = 0; cch < ch; cch++) {
                     readyImg->r (cch, ccw) = readyImg->g (cch, ccw);
@@ -1298,6 +1358,7 @@ private:
         if (tmpScale != 1.0 && params.resize.method == "Nearest" &&
             (params.resize.allowUpscaling || (readyImg->getWidth() >= imw && readyImg->getHeight() >= imh))) { // resize rgb data (gamma applied)
             Imagefloat* tempImage = new Imagefloat (imw, imh);
+            StageTimer timer ("resize_nearest");
             ipf.resize (readyImg, tempImage, tmpScale);
             delete readyImg;
             readyImg = tempImage;
@@ -1380,8 +1441,141 @@ private:
         return readyImg;
     }
 
+    /*
+     * Returns true if every tool applied to the Lab image works on single pixels, which allows
+     * stage_finish_streamed to process the image in bands of rows instead of allocating a full
+     * size LabImage next to the working image.
+     */
+    bool isStreamable (const procparams::ProcParams &params, bool labResize) const
+    {
+        return params.labCurve.contrast == 0 // uses the histogram of the whole Lab image
+               && !params.epd.enabled
+               && !(params.colorToning.enabled && params.colorToning.method == "LabRegions")
+               && !(params.blackwhite.enabled && params.blackwhite.autoc && params.blackwhite.method == "ChannelMixer")
+               && !params.sh.enabled // guided filter at the end of rgbProc, would leave seams at the band edges
+               && !params.localContrast.enabled // same, blurs the L channel at the end of rgbProc
+               && !params.impulseDenoise.enabled
+               && !params.defringe.enabled
+               && !params.sharpenEdge.enabled
+               && !params.sharpenMicro.enabled
+               && !params.sharpening.enabled
+               && !(params.dirpyrequalizer.enabled && params.dirpyrequalizer.cbdlMethod == "aft")
+               && !params.wavelet.enabled
+               && !params.colorappearance.enabled
+               && !labResize;
+    }
+
+    /*
+     * rgbProc, Lab curves, vibrance, soft light and conversion to the output profile band by band.
+     * The output is written back into baseImg (or into a new image of the crop size), so peak
+     * memory is the working image plus a few bands instead of the working image plus a LabImage.
+     */
+    Imagefloat *stage_finish_streamed (float satLimit, float satLimitOpacity, bool opautili, DCPProfile *dcpProf, const DCPProfile::ApplyState &as)
+    {
+        StageTimer stageTimer ("stage_finish_streamed");
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        constexpr int bandHeight = 256;
+
+        // curve1 and curve2 are still needed by rgbProc, so the a and b curves get their own LUTs
+        LUTf acurve (65536);
+        LUTf bcurve (65536);
+
+        bool utili;
+        CurveFactory::complexLCurve (params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
+
+        bool clcutili;
+        CurveFactory::curveCL (clcutili, params.labCurve.clcurve, clcurve, 1);
+
+        bool ccutili, cclutili;
+        CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
+                                       params.labCurve.lccurve, acurve, bcurve, satcurve, lhskcurve, 1);
+
+        int cx = 0, cy = 0, cw = fw, ch = fh;
+
+        if (params.crop.enabled) {
+            cx = LIM (params.crop.x, 0, fw);
+            cy = LIM (params.crop.y, 0, fh);
+            cw = std::min (params.crop.w, fw - cx);
+            ch = std::min (params.crop.h, fh - cy);
+        }
+
+        // without crop, output band rows are written to rows of baseImg which have already been read
+        Imagefloat* readyImg = params.crop.enabled ? new Imagefloat (cw, ch) : baseImg;
+
+        double rrm, ggm, bbm;
+        float autor = -9000.f, autog, autob;
+        LUTu histToneCurve;
+
+        for (int row = 0; row < ch; row += bandHeight) {
+            const int bh = std::min (bandHeight, ch - row);
+
+            Imagefloat band (cw, bh);
+
+#ifdef _OPENMP
+            #pragma omp parallel for
+#endif
+
+            for (int i = 0; i < bh; ++i) {
+                memcpy (band.r (i), baseImg->r (cy + row + i) + cx, cw * sizeof (float));
+                memcpy (band.g (i), baseImg->g (cy + row + i) + cx, cw * sizeof (float));
+                memcpy (band.b (i), baseImg->b (cy + row + i) + cx, cw * sizeof (float));
+            }
+
+            LabImage bandLab (cw, bh);
+            ipf.rgbProc (&band, &bandLab, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
+            ipf.chromiLuminanceCurve (nullptr, 1, &bandLab, &bandLab, acurve, bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+            ipf.vibrance (&bandLab);
+            ipf.softLight (&bandLab);
+
+            const std::unique_ptr<Imagefloat> bandOut (ipf.lab2rgbOut (&bandLab, 0, 0, cw, bh, params.icm));
+
+#ifdef _OPENMP
+            #pragma omp parallel for
+#endif
+
+            for (int i = 0; i < bh; ++i) {
+                memcpy (readyImg->r (row + i), bandOut->r (i), cw * sizeof (float));
+                memcpy (readyImg->g (row + i), bandOut->g (i), cw * sizeof (float));
+                memcpy (readyImg->b (row + i), bandOut->b (i), cw * sizeof (float));
+            }
+
+            if (pl) {
+                pl->setProgress (0.55 + 0.15 * (row + bh) / ch);
+            }
+        }
+
+        if (settings->verbose) {
+            printf ("Output profile_: \"%s\"\n", params.icm.outputProfile.c_str());
+        }
+
+        // if clut was used and size of clut cache == 1 we free the memory used by the clutstore (default clut cache size = 1 for 32 bit OS)
+        if ( params.filmSimulation.enabled && !params.filmSimulation.clutFilename.empty() && options.clutCacheSize == 1) {
+            CLUTStore::getInstance().clearCache();
+        }
+
+        customToneCurve1.Reset();
+        customToneCurve2.Reset();
+        ctColorCurve.Reset();
+        ctOpacityCurve.Reset();
+        noiseLCurve.Reset();
+        noiseCCurve.Reset();
+        customToneCurvebw1.Reset();
+        customToneCurvebw2.Reset();
+
+        if (readyImg != baseImg) {
+            delete baseImg;
+        }
+
+        baseImg = nullptr;
+
+        return readyImg;
+    }
+
     void stage_early_resize()
     {
+        StageTimer stageTimer ("stage_early_resize");
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -1416,6 +1610,7 @@ private:
         // resize image
         if (params.resize.allowUpscaling || (imw <= fw && imh <= fh)) {
             std::unique_ptr<LabImage> resized (new LabImage (imw, imh));
+            StageTimer timer ("lanczos");
             ipf.Lanczos (tmplab.get(), resized.get(), scale_factor);
             tmplab = std::move (resized);
         }
@@ -0,0 +1,233 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "stageprofiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+thread_local rtengine::StageProfiler* currentProfiler = nullptr;
+
+double getCpuTime()
+{
+#ifdef WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0.0;
+    }
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    // 100 ns units
+    return (kernel.QuadPart + user.QuadPart) / 10000.0;
+#else
+    rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return 0.0;
+    }
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#endif
+}
+
+std::size_t getCurrentRss()
+{
+#ifdef __linux__
+    FILE* const file = std::fopen("/proc/self/statm", "r");
+
+    if (!file) {
+        return 0;
+    }
+
+    unsigned long size = 0, resident = 0;
+    const int count = std::fscanf(file, "%lu %lu", &size, &resident);
+    std::fclose(file);
+
+    return count == 2 ? static_cast<std::size_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+// highest resident memory since the last resetPeakRss()
+std::size_t getRecentPeakRss()
+{
+#ifdef __linux__
+    FILE* const file = std::fopen("/proc/self/status", "r");
+
+    if (!file) {
+        return 0;
+    }
+
+    char line[256];
+    unsigned long peak = 0;
+
+    while (std::fgets(line, sizeof(line), file)) {
+        if (std::sscanf(line, "VmHWM: %lu kB", &peak) == 1) {
+            break;
+        }
+    }
+
+    std::fclose(file);
+    return static_cast<std::size_t>(peak) * 1024;
+#else
+    return 0;
+#endif
+}
+
+void resetPeakRss()
+{
+#ifdef __linux__
+    // sets VmHWM to the current resident memory, see proc(5)
+    FILE* const file = std::fopen("/proc/self/clear_refs", "w");
+
+    if (file) {
+        std::fputs("5", file);
+        std::fclose(file);
+    }
+#endif
+}
+
+}
+
+namespace rtengine
+{
+
+StageProfiler::Attach::Attach(StageProfiler* profiler) :
+    previous(currentProfiler)
+{
+    currentProfiler = profiler;
+}
+
+StageProfiler::Attach::~Attach()
+{
+    currentProfiler = previous;
+}
+
+const std::vector<StageProfiler::Stage>& StageProfiler::getStages() const
+{
+    return stages;
+}
+
+std::size_t StageProfiler::getPeakRss()
+{
+#ifdef WIN32
+    return 0;
+#else
+    rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::size_t StageProfiler::begin(const char* name)
+{
+    Stage stage;
+    stage.name = openStages.empty() ? name : stages[openStages.back()].name + '/' + name;
+    stage.wallTime = 0.0;
+    stage.cpuTime = 0.0;
+    stage.rssStart = getCurrentRss();
+    stage.rssEnd = 0;
+    stage.peakRss = 0;
+
+    // the peak is reset for the new stage, so fold what the enclosing one reached so far into it first
+    if (!openStages.empty()) {
+        Stage& parent = stages[openStages.back()];
+        parent.peakRss = std::max(parent.peakRss, getRecentPeakRss());
+    }
+
+    resetPeakRss();
+
+    stages.push_back(stage);
+    openStages.push_back(stages.size() - 1);
+    return stages.size() - 1;
+}
+
+void StageProfiler::end(std::size_t index)
+{
+    stages[index].rssEnd = getCurrentRss();
+    stages[index].peakRss = std::max(stages[index].peakRss, getRecentPeakRss());
+
+    // timers are scoped, so the stage being ended is normally the innermost one
+    while (!openStages.empty()) {
+        const std::size_t last = openStages.back();
+        openStages.pop_back();
+
+        if (last == index) {
+            break;
+        }
+    }
+
+    if (!openStages.empty()) {
+        Stage& parent = stages[openStages.back()];
+        parent.peakRss = std::max(parent.peakRss, stages[index].peakRss);
+    }
+}
+
+StageTimer::StageTimer(const char* name) :
+    profiler(currentProfiler),
+    index(0),
+    startCpuTime(0.0)
+{
+    if (profiler) {
+        index = profiler->begin(name);
+        startCpuTime = getCpuTime();
+        startTime.set();
+    }
+}
+
+StageTimer::~StageTimer()
+{
+    stop();
+}
+
+void StageTimer::stop()
+{
+    if (profiler) {
+        MyTime stopTime;
+        stopTime.set();
+        StageProfiler::Stage& stage = profiler->stages[index];
+        stage.wallTime = stopTime.etime(startTime) / 1000.0;
+        stage.cpuTime = getCpuTime() - startCpuTime;
+        profiler->end(index);
+        profiler = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "mytime.h"
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * @brief Runtime enabled per-stage instrumentation of the processing of an image.
+ *
+ * A StageProfiler collects the stages measured by the StageTimer instances created on the threads it is attached to.
+ * When no profiler is attached to the calling thread, StageTimer does nothing, so the timers can stay in the code.
+ * CPU time and memory are process wide figures: they include all the threads of the process, and resetting the
+ * peak memory of a stage resets it for the whole process. The figures only belong to a stage when nothing else is
+ * processed at the same time, so the callers have to serialize the images while profiling.
+ */
+class StageProfiler :
+    public NonCopyable
+{
+public:
+    struct Stage {
+        std::string name;       // path of the stage, the enclosing stages being separated by '/'
+        double wallTime;        // in milliseconds
+        double cpuTime;         // in milliseconds
+        std::size_t rssStart;   // resident memory at the start of the stage in bytes, 0 if unknown
+        std::size_t rssEnd;     // resident memory at the end of the stage in bytes, 0 if unknown
+        std::size_t peakRss;    // highest resident memory during the stage in bytes (Linux only), 0 if unknown
+    };
+
+    /**
+     * @brief Attaches a profiler to the calling thread for the lifetime of the instance
+     */
+    class Attach :
+        public NonCopyable
+    {
+    public:
+        explicit Attach(StageProfiler* profiler);
+        ~Attach();
+
+    private:
+        StageProfiler* const previous;
+    };
+
+    const std::vector<Stage>& getStages() const;
+
+    // highest resident memory of the process since it started in bytes, 0 if unknown
+    static std::size_t getPeakRss();
+
+private:
+    friend class StageTimer;
+
+    std::size_t begin(const char* name);
+    void end(std::size_t index);
+
+    std::vector<Stage> stages;
+    std::vector<std::size_t> openStages;
+};
+
+/**
+ * @brief Measures the lifetime of the instance (or up to stop()) as a stage of the profiler attached to the thread
+ */
+class StageTimer :
+    public NonCopyable
+{
+public:
+    explicit StageTimer(const char* name);
+    ~StageTimer();
+
+    void stop();
+
+private:
+    StageProfiler* profiler;
+    std::size_t index;
+    MyTime startTime;
+    double startCpuTime;
+};
+
+}
@@ -66,6 +66,7 @@
 #include <fftw3.h>
 
 #include "array2D.h"
+#include "fftwplancache.h"
 #include "improcfun.h"
 #include "settings.h"
 #include "iccstore.h"
@@ -721,6 +722,16 @@ void tmo_fattal02 (size_t width,
 // for both solvers.
 
 
+// number of threads used by the fft routines
+int getFFTWThreads (bool multithread)
+{
+#ifdef _OPENMP
+    return multithread ? omp_get_max_threads() : 1;
+#else
+    return 1;
+#endif
+}
+
 // returns T = EVy A EVx^tr
 // note, modifies input data
 void transform_ev2normal (Array2Df *A, Array2Df *T, bool multithread)
@@ -760,11 +771,9 @@ void transform_ev2normal (Array2Df *A, Array2Df *T, bool multithread)
     // fftwf_free(in);
 
     // executes 2d discrete cosine transform
-    fftwf_plan p;
-    p = fftwf_plan_r2r_2d (height, width, A->data(), T->data(),
-                           FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE);
-    fftwf_execute (p);
-    fftwf_destroy_plan (p);
+    const fftwf_plan p = FFTWPlanCache::getInstance().plan2dR2R (height, width, A->data(), T->data(),
+                         FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE, getFFTWThreads (multithread));
+    fftwf_execute_r2r (p, A->data(), T->data());
 }
 
 
@@ -776,11 +785,9 @@ void transform_normal2ev (Array2Df *A, Array2Df *T, bool multithread)
     assert ((int)T->getCols() == width && (int)T->getRows() == height);
 
     // executes 2d discrete cosine transform
-    fftwf_plan p;
-    p = fftwf_plan_r2r_2d (height, width, A->data(), T->data(),
-                           FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE);
-    fftwf_execute (p);
-    fftwf_destroy_plan (p);
+    const fftwf_plan p = FFTWPlanCache::getInstance().plan2dR2R (height, width, A->data(), T->data(),
+                         FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE, getFFTWThreads (multithread));
+    fftwf_execute_r2r (p, A->data(), T->data());
 
     // need to scale the output matrix to get the right transform
     float factor = (1.0f / ((height - 1) * (width - 1)));
@@ -871,18 +878,6 @@ void solve_pde_fft (Array2Df *F, Array2Df *U, Array2Df *buf, bool multithread)/*
     assert ((int)U->getCols() == width && (int)U->getRows() == height);
     assert (buf->getCols() == width && buf->getRows() == height);
 
-    // activate parallel execution of fft routines
-#ifdef RT_FFTW3F_OMP
-
-    if (multithread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads ( omp_get_max_threads() );
-    }
-
-// #else
-//   fftwf_plan_with_nthreads( 2 );
-#endif
-
     // in general there might not be a solution to the Poisson pde
     // with Neumann boundary conditions unless the boundary satisfies
     // an integral condition, this function modifies the boundary so that
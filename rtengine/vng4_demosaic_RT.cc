@@ -31,26 +31,27 @@ namespace {
 
 using namespace rtengine;
 
-inline void vng4interpolate_row_redblue (const RawImage *ri, const array2D<float> &rawData, float* ar, float* ab, const float * const pg, const float * const cg, const float * const ng, int i, int width)
+// interpolates red and blue of row i for columns [startCol, endCol). The green rows start at column gLeft
+inline void vng4interpolate_row_redblue (const RawImage *ri, const array2D<float> &rawData, float* ar, float* ab, const float * const pg, const float * const cg, const float * const ng, int i, int startCol, int endCol, int gLeft)
 {
     if (ri->ISBLUE(i, 0) || ri->ISBLUE(i, 1)) {
         std::swap(ar, ab);
     }
 
     // RGRGR or GRGRGR line
-    for (int j = 3; j < width - 3; ++j) {
+    for (int j = startCol; j < endCol; ++j) {
         if (!ri->ISGREEN(i, j)) {
             // keep original value
             ar[j] = rawData[i][j];
             // cross interpolation of red/blue
-            float rb = (rawData[i - 1][j - 1] - pg[j - 1] + rawData[i + 1][j - 1] - ng[j - 1]);
-            rb += (rawData[i - 1][j + 1] - pg[j + 1] + rawData[i + 1][j + 1] - ng[j + 1]);
-            ab[j] = cg[j] + rb * 0.25f;
+            float rb = (rawData[i - 1][j - 1] - pg[j - 1 - gLeft] + rawData[i + 1][j - 1] - ng[j - 1 - gLeft]);
+            rb += (rawData[i - 1][j + 1] - pg[j + 1 - gLeft] + rawData[i + 1][j + 1] - ng[j + 1 - gLeft]);
+            ab[j] = cg[j - gLeft] + rb * 0.25f;
         } else {
             // linear R/B-G interpolation horizontally
-            ar[j] = cg[j] + (rawData[i][j - 1] - cg[j - 1] + rawData[i][j + 1] - cg[j + 1]) / 2;
+            ar[j] = cg[j - gLeft] + (rawData[i][j - 1] - cg[j - 1 - gLeft] + rawData[i][j + 1] - cg[j + 1 - gLeft]) / 2;
             // linear B/R-G interpolation vertically
-            ab[j] = cg[j] + (rawData[i - 1][j] - pg[j] + rawData[i + 1][j] - ng[j]) / 2;
+            ab[j] = cg[j - gLeft] + (rawData[i - 1][j] - pg[j - gLeft] + rawData[i + 1][j] - ng[j - gLeft]) / 2;
         }
     }
 }
@@ -102,7 +103,13 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
     const int width = W, height = H;
     constexpr unsigned int colors = 4;
 
-    float (*image)[4] = (float (*)[4]) calloc (height * width, sizeof * image);
+    // The image is processed in tiles of ts x ts pixels. The inner tsCore x tsCore pixels of each tile
+    // get the same values as processing the whole image at once: red/blue interpolation needs green
+    // one pixel around, VNG green needs the linear interpolation two pixels around, which in turn needs
+    // the raw data one pixel around.
+    constexpr int ts = 128;
+    constexpr int tsBorder = 4;
+    constexpr int tsCore = ts - 2 * tsBorder;
 
     int lcode[16][16][32];
     float mul[16][16][8];
@@ -124,7 +131,7 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
                     }
 
                     int color = fc(row + y, col + x);
-                    *ip++ = (width * y + x) * 4 + color;
+                    *ip++ = (ts * y + x) * 4 + color;
 
                     mul[row][col][mulcount] = (1 << shift);
                     *ip++ = color;
@@ -142,80 +149,6 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
                 }
         }
 
-#ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-        int firstRow = -1;
-        int lastRow = -1;
-#ifdef _OPENMP
-        // note, static scheduling is important in this implementation
-        #pragma omp for schedule(static)
-#endif
-
-        for (int ii = 0; ii < H; ii++) {
-            if (firstRow == -1) {
-                firstRow = ii;
-            }
-            lastRow = ii;
-            for (int jj = 0; jj < W; jj++) {
-                image[ii * W + jj][fc(ii, jj)] = rawData[ii][jj];
-            }
-            if (ii - 1 > firstRow) {
-                int row = ii - 1;
-                for (int col = 1; col < width - 1; col++) {
-                    float * pix = image[row * width + col];
-                    int * ip = lcode[row & 15][col & 15];
-                    float sum[4] = {};
-
-                    for (int i = 0; i < 8; i++, ip += 2) {
-                        sum[ip[1]] += pix[ip[0]] * mul[row & 15][col & 15][i];
-                    }
-
-                    for (unsigned int i = 0; i < colors - 1; i++, ip++) {
-                        pix[ip[0]] = sum[ip[0]] * csum[row & 15][col & 15][i];
-                    }
-                }
-            }
-        }
-
-        // now all rows are processed except the first and last row of each chunk
-        // let's process them now but skip row 0 and row H - 1
-        if (firstRow > 0 && firstRow < H - 1) {
-            const int row = firstRow;
-            for (int col = 1; col < width - 1; col++) {
-                float * pix = image[row * width + col];
-                int * ip = lcode[row & 15][col & 15];
-                float sum[4] = {};
-
-                for (int i = 0; i < 8; i++, ip += 2) {
-                    sum[ip[1]] += pix[ip[0]] * mul[row & 15][col & 15][i];
-                }
-
-                for (unsigned int i = 0; i < colors - 1; i++, ip++) {
-                    pix[ip[0]] = sum[ip[0]] * csum[row & 15][col & 15][i];
-                }
-            }
-        }
-
-        if (lastRow > 0 && lastRow < H - 1) {
-            const int row = lastRow;
-            for (int col = 1; col < width - 1; col++) {
-                float * pix = image[row * width + col];
-                int * ip = lcode[row & 15][col & 15];
-                float sum[4] = {};
-
-                for (int i = 0; i < 8; i++, ip += 2) {
-                    sum[ip[1]] += pix[ip[0]] * mul[row & 15][col & 15][i];
-                }
-
-                for (unsigned int i = 0; i < colors - 1; i++, ip++) {
-                    pix[ip[0]] = sum[ip[0]] * csum[row & 15][col & 15][i];
-                }
-            }
-        }
-    }
-
     constexpr int prow = 7, pcol = 1;
     int32_t *code[8][2];
     int32_t * ip = (int32_t *) calloc ((prow + 1) * (pcol + 1), 1280);
@@ -243,8 +176,8 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
                     continue;
                 }
 
-                *ip++ = (y1 * width + x1) * 4 + color;
-                *ip++ = (y2 * width + x2) * 4 + color;
+                *ip++ = (y1 * ts + x1) * 4 + color;
+                *ip++ = (y2 * ts + x2) * 4 + color;
 #ifdef __SSE2__
                 // at least on machines with SSE2 feature this cast is save
                 *reinterpret_cast<float*>(ip++) = 1 << weight;
@@ -265,11 +198,11 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
             for (int g = 0; g < 8; g++) {
                 int y = *cp++;
                 int x = *cp++;
-                *ip++ = (y * width + x) * 4;
+                *ip++ = (y * ts + x) * 4;
                 unsigned int color = fc(row, col);
 
                 if (fc(row + y, col + x) != color && fc(row + y * 2, col + x * 2) == color) {
-                    *ip++ = (y * width + x) * 8 + color;
+                    *ip++ = (y * ts + x) * 8 + color;
                 } else {
                     *ip++ = 0;
                 }
@@ -277,108 +210,148 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
         }
 
     if(plistenerActive) {
-        progress = 0.2;
+        progress = 0.1;
         plistener->setProgress (progress);
     }
 
+    // the inner parts of the tiles cover rows [3, height - 3) and columns [3, width - 3), the rest is done by border_interpolate2
+    const int numTilesH = std::max(height - 6, 0) / tsCore + (std::max(height - 6, 0) % tsCore ? 1 : 0);
+    const int numTilesW = std::max(width - 6, 0) / tsCore + (std::max(width - 6, 0) % tsCore ? 1 : 0);
+
 #ifdef _OPENMP
     #pragma omp parallel
 #endif
     {
-        constexpr int progressStep = 64;
-        const double progressInc = (1.0 - progress) / ((height - 2) / progressStep);
-        int firstRow = -1;
-        int lastRow = -1;
+        float (*image)[4] = (float (*)[4]) malloc (ts * ts * sizeof * image);
+        float *greenTile = (float *) malloc (ts * ts * sizeof(float));
+        int progresscounter = 0;
+
 #ifdef _OPENMP
-        // note, static scheduling is important in this implementation
-        #pragma omp for schedule(static)
+        #pragma omp for schedule(dynamic) collapse(2) nowait
 #endif
 
-        for (int row = 2; row < height - 2; row++) {    /* Do VNG interpolation */
-            if (firstRow == -1) {
-                firstRow = row;
-            }
-            lastRow = row;
-            for (int col = 2; col < width - 2; col++) {
-                float * pix = image[row * width + col];
-                int color = fc(row, col);
-                int32_t * ip = code[row & prow][col & pcol];
-                float gval[8] = {};
-
-                while (ip[0] != INT_MAX) {        /* Calculate gradients */
-#ifdef __SSE2__
-                    // at least on machines with SSE2 feature this cast is save and saves a lot of int => float conversions
-                    const float diff = std::fabs(pix[ip[0]] - pix[ip[1]]) * reinterpret_cast<float*>(ip)[2];
-#else
-                    const float diff = std::fabs(pix[ip[0]] - pix[ip[1]]) * ip[2];
-#endif
-                    gval[ip[3]] += diff;
-                    ip += 5;
-                    if (UNLIKELY(ip[-1] != -1)) {
-                        gval[ip[-1]] += diff;
-                        ip++;
+        for (int tr = 0; tr < numTilesH; tr++) {
+            for (int tc = 0; tc < numTilesW; tc++) {
+                const int coreTop = 3 + tr * tsCore;
+                const int coreLeft = 3 + tc * tsCore;
+                const int coreBottom = std::min(coreTop + tsCore, height - 3);
+                const int coreRight = std::min(coreLeft + tsCore, width - 3);
+                // tile position in image coordinates
+                const int top = std::max(coreTop - tsBorder, 0);
+                const int left = std::max(coreLeft - tsBorder, 0);
+                const int bottom = std::min(coreBottom + tsBorder, height);
+                const int right = std::min(coreRight + tsBorder, width);
+
+                for (int row = top; row < bottom; row++) {
+                    for (int col = left; col < right; col++) {
+                        float * pix = image[(row - top) * ts + col - left];
+                        pix[0] = pix[1] = pix[2] = pix[3] = 0.f;
+                        pix[fc(row, col)] = rawData[row][col];
                     }
                 }
-                ip++;
-
-                const float thold = rtengine::min(gval[0], gval[1], gval[2], gval[3], gval[4], gval[5], gval[6], gval[7])
-                                  + rtengine::max(gval[0], gval[1], gval[2], gval[3], gval[4], gval[5], gval[6], gval[7]) * 0.5f;
-
-                float sum0 = 0.f;
-                float sum1 = 0.f;
-                const float greenval = pix[color];
-                int num = 0;
-
-                if(color & 1) {
-                    color ^= 2;
-                    for (int g = 0; g < 8; g++, ip += 2) {  /* Average the neighbors */
-                        if (gval[g] <= thold) {
-                            if(ip[1]) {
-                                sum0 += greenval + pix[ip[1]];
-                            }
 
-                            sum1 += pix[ip[0] + color];
-                            num++;
+                for (int row = std::max(top + 1, 1); row < std::min(bottom - 1, height - 1); row++) {
+                    for (int col = std::max(left + 1, 1); col < std::min(right - 1, width - 1); col++) {
+                        float * pix = image[(row - top) * ts + col - left];
+                        int * ip = lcode[row & 15][col & 15];
+                        float sum[4] = {};
+
+                        for (int i = 0; i < 8; i++, ip += 2) {
+                            sum[ip[1]] += pix[ip[0]] * mul[row & 15][col & 15][i];
+                        }
+
+                        for (unsigned int i = 0; i < colors - 1; i++, ip++) {
+                            pix[ip[0]] = sum[ip[0]] * csum[row & 15][col & 15][i];
                         }
                     }
-                    sum0 *= 0.5f;
-                } else {
-                    for (int g = 0; g < 8; g++, ip += 2) {  /* Average the neighbors */
-                        if (gval[g] <= thold) {
-                            if(ip[1]) {
-                                sum0 += greenval + pix[ip[1]];
+                }
+
+                for (int row = coreTop - 1; row < coreBottom + 1; row++) {    /* Do VNG interpolation */
+                    for (int col = coreLeft - 1; col < coreRight + 1; col++) {
+                        float * pix = image[(row - top) * ts + col - left];
+                        int color = fc(row, col);
+                        int32_t * ip = code[row & prow][col & pcol];
+                        float gval[8] = {};
+
+                        while (ip[0] != INT_MAX) {        /* Calculate gradients */
+#ifdef __SSE2__
+                            // at least on machines with SSE2 feature this cast is save and saves a lot of int => float conversions
+                            const float diff = std::fabs(pix[ip[0]] - pix[ip[1]]) * reinterpret_cast<float*>(ip)[2];
+#else
+                            const float diff = std::fabs(pix[ip[0]] - pix[ip[1]]) * ip[2];
+#endif
+                            gval[ip[3]] += diff;
+                            ip += 5;
+                            if (UNLIKELY(ip[-1] != -1)) {
+                                gval[ip[-1]] += diff;
+                                ip++;
                             }
+                        }
+                        ip++;
 
-                            sum1 += pix[ip[0] + 1] + pix[ip[0] + 3];
-                            num++;
+                        const float thold = rtengine::min(gval[0], gval[1], gval[2], gval[3], gval[4], gval[5], gval[6], gval[7])
+                                          + rtengine::max(gval[0], gval[1], gval[2], gval[3], gval[4], gval[5], gval[6], gval[7]) * 0.5f;
+
+                        float sum0 = 0.f;
+                        float sum1 = 0.f;
+                        const float greenval = pix[color];
+                        int num = 0;
+
+                        if(color & 1) {
+                            color ^= 2;
+                            for (int g = 0; g < 8; g++, ip += 2) {  /* Average the neighbors */
+                                if (gval[g] <= thold) {
+                                    if(ip[1]) {
+                                        sum0 += greenval + pix[ip[1]];
+                                    }
+
+                                    sum1 += pix[ip[0] + color];
+                                    num++;
+                                }
+                            }
+                            sum0 *= 0.5f;
+                        } else {
+                            for (int g = 0; g < 8; g++, ip += 2) {  /* Average the neighbors */
+                                if (gval[g] <= thold) {
+                                    if(ip[1]) {
+                                        sum0 += greenval + pix[ip[1]];
+                                    }
+
+                                    sum1 += pix[ip[0] + 1] + pix[ip[0] + 3];
+                                    num++;
+                                }
+                            }
                         }
+                        greenTile[(row - top) * ts + col - left] = greenval + (sum1 - sum0) / (2 * num);
                     }
                 }
-                green[row][col] = greenval + (sum1 - sum0) / (2 * num);
-            }
-            if (row - 1 > firstRow) {
-                vng4interpolate_row_redblue(ri, rawData, red[row - 1], blue[row - 1], green[row - 2], green[row - 1], green[row], row - 1, W);
-            }
 
-            if(plistenerActive) {
-                if((row % progressStep) == 0)
+                for (int row = coreTop; row < coreBottom; row++) {
+                    const float * const cg = &greenTile[(row - top) * ts];
+                    vng4interpolate_row_redblue(ri, rawData, red[row], blue[row], cg - ts, cg, cg + ts, row, coreLeft, coreRight, left);
+
+                    for (int col = coreLeft; col < coreRight; col++) {
+                        green[row][col] = cg[col - left];
+                    }
+                }
+
+                if(plistenerActive) {
+                    progresscounter++;
+
+                    if(progresscounter % 16 == 0) {
 #ifdef _OPENMP
-                    #pragma omp critical (updateprogress)
+                        #pragma omp critical (updateprogress)
 #endif
-                {
-                    progress += progressInc;
-                    plistener->setProgress (progress);
+                        {
+                            progress += (double)16 * 0.9 * (tsCore * tsCore) / (height * width);
+                            progress = progress > 1.0 ? 1.0 : progress;
+                            plistener->setProgress (progress);
+                        }
+                    }
                 }
             }
         }
 
-        if (firstRow > 2 && firstRow < H - 3) {
-            vng4interpolate_row_redblue(ri, rawData, red[firstRow], blue[firstRow], green[firstRow - 1], green[firstRow], green[firstRow + 1], firstRow, W);
-        }
-
-        if (lastRow > 2 && lastRow < H - 3) {
-            vng4interpolate_row_redblue(ri, rawData, red[lastRow], blue[lastRow], green[lastRow - 1], green[lastRow], green[lastRow + 1], lastRow, W);
-        }
 #ifdef _OPENMP
         #pragma omp single
 #endif
@@ -386,10 +359,12 @@ void RawImageSource::vng4_demosaic (const array2D<float> &rawData, array2D<float
             // let the first thread, which is out of work, do the border interpolation
             border_interpolate2(W, H, 3, rawData, red, green, blue);
         }
+
+        free (greenTile);
+        free (image);
     }
 
     free (code[0][0]);
-    free (image);
 
     if(plistenerActive) {
         plistener->setProgress (1.0);
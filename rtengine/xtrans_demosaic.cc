@@ -23,10 +23,82 @@
 #include "rawimagesource.h"
 #include "rt_algo.h"
 #include "rt_math.h"
+#include "mytime.h"
 #include "../rtgui/multilangmgr.h"
+#include "../rtgui/threadutils.h"
 #include "opthelper.h"
 #include "StopWatch.h"
 
+namespace
+{
+
+// Chooses the number of tiles per thread for Markesteijn demosaic if it is not set by the user.
+// The tile size itself is fixed, because the output depends on the tile layout.
+// The first runs use each candidate once and measure the time per pixel, later runs use the fastest one.
+// Runs which overlap with another one are not measured, as they share the cpu.
+class XTransChunkSizeTuner
+{
+public:
+    size_t get(int passes)
+    {
+        MyMutex::MyLock lock(mutex);
+        const double* const times = timePerPixel[passes > 1];
+        int best = 0;
+
+        for (int i = 0; i < numCandidates; ++i) {
+            if (times[i] == 0.0) {
+                return candidates[i];
+            } else if (times[i] < times[best]) {
+                best = i;
+            }
+        }
+
+        return candidates[best];
+    }
+
+    void begin()
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (++running > 1) {
+            overlapped = true;
+        }
+    }
+
+    // time is only used if measured is true and no other run overlapped this one
+    void end(int passes, size_t chunkSize, bool measured, double time)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (measured && !overlapped) {
+            for (int i = 0; i < numCandidates; ++i) {
+                if (candidates[i] == chunkSize) {
+                    timePerPixel[passes > 1][i] = time;
+                }
+            }
+        }
+
+        if (--running == 0) {
+            overlapped = false;
+        }
+    }
+
+private:
+    static constexpr int numCandidates = 4;
+    static constexpr size_t candidates[numCandidates] = {2, 1, 4, 8};
+
+    MyMutex mutex;
+    double timePerPixel[2][numCandidates] = {};
+    int running = 0;
+    bool overlapped = false;
+};
+
+constexpr size_t XTransChunkSizeTuner::candidates[];
+
+XTransChunkSizeTuner xtransChunkSizeTuner;
+
+}
+
 namespace rtengine
 {
 const double xyz_rgb[3][3] = {          // XYZ from RGB
@@ -174,9 +246,21 @@ void RawImageSource::xtransborder_interpolate (int border, array2D<float> &red,
 */
 // override CLIP function to test unclipped output
 #define CLIP(x) (x)
-void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab, size_t chunkSize, bool measure)
+void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab, size_t chunkSize, bool measure, const float * const *detailMask)
 {
 
+    // skipped tiles would spoil the timings of the tuner
+    const bool tuneChunkSize = chunkSize == 0 && !detailMask;
+
+    if (chunkSize == 0) {
+        chunkSize = xtransChunkSizeTuner.get(passes);
+    }
+
+    xtransChunkSizeTuner.begin();
+
+    MyTime t1, t2;
+    t1.set();
+
     std::unique_ptr<StopWatch> stop;
 
     if (measure) {
@@ -292,10 +376,13 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
     {
         int progressCounter = 0;
 
-        float *buffer = (float *) malloc ((ts * ts * (ndir * 4 + 3) + 128) * sizeof(float));
+        // the lab buffer also holds homo and greenminmaxtile, the drv buffer also holds homosum, 128 floats for vector loads beyond the end
+        float *buffer = (float *) malloc ((ts * ts * ndir * 3 + (ts - 8) * (ts - 8) * 3 + (ts - 10) * (ts - 10) * ndir + 128) * sizeof(float));
         float (*rgb)[ts][ts][3] = (float(*)[ts][ts][3]) buffer;
         float (*lab)[ts - 8][ts - 8] = (float (*)[ts - 8][ts - 8])(buffer + ts * ts * (ndir * 3));
-        float (*drv)[ts - 10][ts - 10] = (float (*)[ts - 10][ts - 10])   (buffer + ts * ts * (ndir * 3 + 3));
+        float (*drv)[ts - 10][ts - 10] = (float (*)[ts - 10][ts - 10])   (buffer + ts * ts * (ndir * 3) + (ts - 8) * (ts - 8) * 3);
+        static_assert((ts - 8) * (ts - 8) * 3 * sizeof(float) >= 8 * ts * ts && (ts - 8) * (ts - 8) * 3 * sizeof(float) >= ts * (ts / 2) * 2 * sizeof(float), "homo and greenminmaxtile have to fit into the lab buffer");
+        static_assert((ts - 10) * (ts - 10) * sizeof(float) >= ts * ts, "homosum has to fit into the drv buffer");
         uint8_t (*homo)[ts][ts] = (uint8_t  (*)[ts][ts])   (lab); // we can reuse the lab-buffer because they are not used together
         s_minmaxgreen  (*greenminmaxtile)[tsh] = (s_minmaxgreen(*)[tsh]) (lab); // we can reuse the lab-buffer because they are not used together
         uint8_t (*homosum)[ts][ts] = (uint8_t (*)[ts][ts]) (drv); // we can reuse the drv-buffer because they are not used together
@@ -310,6 +397,11 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                 int mrow = MIN (top + ts, height - 3);
                 int mcol = MIN (left + ts, width - 3);
 
+                if (detailMask && !maskHasPositive(detailMask, top, left, mrow, mcol)) {
+                    // the output of this tile would not be used
+                    continue;
+                }
+
                 /* Set greenmin and greenmax to the minimum and maximum allowed values: */
                 for (int row = top; row < mrow; row++) {
                     // find first non-green pixel
@@ -658,12 +750,29 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                         cielab(&rgb[d][4][4], &lab[0][0][0], &lab[1][0][0], &lab[2][0][0], ts, mrow - 8, ts - 8, xyz_cam);
                         int f = dir[d & 3];
                         f = f == 1 ? 1 : f - 8;
+#ifdef __SSE2__
+                        const vfloat c2151v = F2V(2.1551724f);
+                        const vfloat c0862v = F2V(0.86206896f);
+#endif
+
+                        for (int row = 5; row < mrow - 5; row++) {
+                            int col = 5;
+#ifdef __SSE2__
+
+                            for (; col < mcol - 8; col += 4) {
+                                const float *l = &lab[0][row - 4][col - 4];
+                                const float *a = &lab[1][row - 4][col - 4];
+                                const float *b = &lab[2][row - 4][col - 4];
+
+                                const vfloat gv = LVFU(l[0]) + LVFU(l[0]) - LVFU(l[f]) - LVFU(l[-f]);
+                                STVFU(drv[d][row - 5][col - 5], SQR(gv)
+                                                                + SQR(LVFU(a[0]) + LVFU(a[0]) - LVFU(a[f]) - LVFU(a[-f]) + gv * c2151v)
+                                                                + SQR(LVFU(b[0]) + LVFU(b[0]) - LVFU(b[f]) - LVFU(b[-f]) - gv * c0862v));
+                            }
 
-                        for (int row = 5; row < mrow - 5; row++)
-#ifdef _OPENMP
-                            #pragma omp simd
 #endif
-                            for (int col = 5; col < mcol - 5; col++) {
+
+                            for (; col < mcol - 5; col++) {
                                 float *l = &lab[0][row - 4][col - 4];
                                 float *a = &lab[1][row - 4][col - 4];
                                 float *b = &lab[2][row - 4][col - 4];
@@ -673,7 +782,7 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                                                             + SQR((2 * a[0] - a[f] - a[-f] + g * 2.1551724f))
                                                             + SQR((2 * b[0] - b[f] - b[-f] - g * 0.86206896f));
                             }
-
+                        }
                     }
                 } else {
                     // For 1-pass demosaic we use YPbPr which requires much
@@ -723,8 +832,22 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                         int f = dir[d & 3];
                         f = f == 1 ? 1 : f - 8;
 
-                        for (int row = 5; row < mrow - 5; row++)
-                            for (int col = 5; col < mcol - 5; col++) {
+                        for (int row = 5; row < mrow - 5; row++) {
+                            int col = 5;
+#ifdef __SSE2__
+
+                            for (; col < mcol - 8; col += 4) {
+                                const float *y = &yuv[0][row - 4][col - 4];
+                                const float *u = &yuv[1][row - 4][col - 4];
+                                const float *v = &yuv[2][row - 4][col - 4];
+                                STVFU(drv[d][row - 5][col - 5], SQR(LVFU(y[0]) + LVFU(y[0]) - LVFU(y[f]) - LVFU(y[-f]))
+                                                                + SQR(LVFU(u[0]) + LVFU(u[0]) - LVFU(u[f]) - LVFU(u[-f]))
+                                                                + SQR(LVFU(v[0]) + LVFU(v[0]) - LVFU(v[f]) - LVFU(v[-f])));
+                            }
+
+#endif
+
+                            for (; col < mcol - 5; col++) {
                                 float *y = &yuv[0][row - 4][col - 4];
                                 float *u = &yuv[1][row - 4][col - 4];
                                 float *v = &yuv[2][row - 4][col - 4];
@@ -732,6 +855,7 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                                                            + SQR(2 * u[0] - u[f] - u[-f])
                                                            + SQR(2 * v[0] - v[f] - v[-f]);
                             }
+                        }
                     }
                 }
 
@@ -908,8 +1032,48 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                 /* Average the most homogeneous pixels for the final result: */
                 uint8_t hm[8] = {};
 
-                for (int row = MIN(top, 8); row < mrow - 8; row++)
-                    for (int col = MIN(left, 8); col < mcol - 8; col++) {
+                for (int row = MIN(top, 8); row < mrow - 8; row++) {
+                    int col = MIN(left, 8);
+#ifdef __SSE2__
+
+                    for (; col < mcol - 11; col += 4) {
+                        vfloat hmv[8];
+
+                        for (int d = 0; d < ndir; d++) {
+                            hmv[d] = _mm_cvtepi32_ps(_mm_setr_epi32(homosum[d][row][col], homosum[d][row][col + 1], homosum[d][row][col + 2], homosum[d][row][col + 3]));
+                        }
+
+                        for (int d = 4; d < ndir; d++) {
+                            const vmask ltmask = vmaskf_lt(hmv[d - 4], hmv[d]);
+                            const vmask gtmask = vmaskf_gt(hmv[d - 4], hmv[d]);
+                            hmv[d - 4] = vselfnotzero(ltmask, hmv[d - 4]);
+                            hmv[d] = vselfnotzero(gtmask, hmv[d]);
+                        }
+
+                        const vfloat maxvalv = _mm_cvtepi32_ps(_mm_setr_epi32(homosummax[row][col], homosummax[row][col + 1], homosummax[row][col + 2], homosummax[row][col + 3]));
+                        vfloat redsumv = ZEROV;
+                        vfloat greensumv = ZEROV;
+                        vfloat bluesumv = ZEROV;
+                        vfloat countv = ZEROV;
+
+                        for (int d = 0; d < ndir; d++) {
+                            const vmask selmask = vmaskf_ge(hmv[d], maxvalv);
+                            vfloat redv, greenv, bluev;
+                            vconvertrgbrgbrgbrgb2rrrrggggbbbb(rgb[d][row][col], redv, greenv, bluev);
+                            redsumv += vselfzero(selmask, redv);
+                            greensumv += vselfzero(selmask, greenv);
+                            bluesumv += vselfzero(selmask, bluev);
+                            countv += vselfzero(selmask, onev);
+                        }
+
+                        STVFU(red[row + top][col + left], redsumv / countv);
+                        STVFU(green[row + top][col + left], greensumv / countv);
+                        STVFU(blue[row + top][col + left], bluesumv / countv);
+                    }
+
+#endif
+
+                    for (; col < mcol - 8; col++) {
 
                         for (int d = 0; d < 4; d++) {
                             hm[d] = homosum[d][row][col];
@@ -941,6 +1105,7 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                         green[row + top][col + left] = avg[1] / avg[3];
                         blue[row + top][col + left] = avg[2] / avg[3];
                     }
+                }
 
                 if(plistenerActive && ((++progressCounter) % 32 == 0)) {
 #ifdef _OPENMP
@@ -960,8 +1125,12 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
     }
 
     xtransborder_interpolate(passes > 1 ? 8 : 11, red, green, blue);
+
+    t2.set();
+    xtransChunkSizeTuner.end(passes, chunkSize, tuneChunkSize, static_cast<double>(t2.etime(t1)) / (static_cast<double>(W) * H));
 }
 #undef CLIP
+
 void RawImageSource::fast_xtrans_interpolate (const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue)
 {
 
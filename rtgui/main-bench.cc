@@ -0,0 +1,700 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * rawtherapee-bench: runs individual engine kernels on a local set of raw files
+ * at fixed thread counts and reports median/p95 timings as JSON.
+ *
+ * Each kernel is run `warmup` times without being measured and then
+ * `repetitions` times with measurement. Inputs of a kernel are restored before
+ * every run, outside the measured section, so all runs process the same data.
+ * Demosaic kernels also report a checksum of their output, to compare the
+ * results of different builds.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <giomm.h>
+#include <glib/gstdio.h>
+#include <iostream>
+#include <tiffio.h>
+#include <cstring>
+#include <cstdlib>
+#include <locale.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "../rtengine/array2D.h"
+#include "../rtengine/cJSON.h"
+#include "../rtengine/cpufeatures.h"
+#include "../rtengine/gauss.h"
+#include "../rtengine/imagefloat.h"
+#include "../rtengine/imagesource.h"
+#include "../rtengine/improcfun.h"
+#include "../rtengine/labimage.h"
+#include "../rtengine/mytime.h"
+#include "../rtengine/procparams.h"
+#include "../rtengine/rtengine.h"
+#include "../rtengine/utils.h"
+#include "options.h"
+#include "version.h"
+
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+extern Options options;
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring creditsPath;
+Glib::ustring licensePath;
+Glib::ustring argv1;
+
+namespace
+{
+
+using namespace rtengine;
+using namespace rtengine::procparams;
+
+struct BenchSettings {
+    std::vector<std::string> kernels;
+    std::vector<int> threads;
+    int warmup = 1;
+    int repetitions = 5;
+    Glib::ustring outputFile;
+};
+
+struct Result {
+    Glib::ustring file;
+    std::string kernel;
+    int threads;
+    std::vector<double> times; // milliseconds
+    std::string checksum; // of the output, empty if not computed
+    double maxDeviation; // largest absolute difference of the output to the reference, < 0 if not computed
+    double meanDeviation; // mean absolute difference of the output to the reference
+};
+
+// Empty kernel list selects everything. "demosaic" selects all "demosaic:<method>" kernels.
+bool isSelected(const BenchSettings& bench, const std::string& kernel)
+{
+    if (bench.kernels.empty()) {
+        return true;
+    }
+
+    for (const auto& name : bench.kernels) {
+        if (kernel == name || (kernel.compare(0, name.size(), name) == 0 && kernel.size() > name.size() && kernel[name.size()] == ':')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::string::size_type start = 0;
+
+    while (start <= list.size()) {
+        const std::string::size_type end = std::min(list.find(',', start), list.size());
+
+        if (end > start) {
+            items.push_back(list.substr(start, end - start));
+        }
+
+        start = end + 1;
+    }
+
+    return items;
+}
+
+// Nearest-rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    const std::size_t rank = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(p / 100.0 * sorted.size())));
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+// FNV-1a hash of the bit patterns of all samples
+std::string imageChecksum(Imagefloat& image, int width, int height)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (int c = 0; c < 3; ++c) {
+        PlanarPtr<float>& plane = c == 0 ? image.r : c == 1 ? image.g : image.b;
+
+        for (int i = 0; i < height; ++i) {
+            const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(plane(i));
+
+            for (std::size_t j = 0; j < width * sizeof(float); ++j) {
+                hash = (hash ^ bytes[j]) * 1099511628211ULL;
+            }
+        }
+    }
+
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string(text);
+}
+
+// Largest and mean absolute difference of all samples of two images
+void imageDeviation(Imagefloat& image, Imagefloat& reference, int width, int height, double& maxDeviation, double& meanDeviation)
+{
+    maxDeviation = 0.0;
+    double sum = 0.0;
+
+    for (int c = 0; c < 3; ++c) {
+        PlanarPtr<float>& plane = c == 0 ? image.r : c == 1 ? image.g : image.b;
+        PlanarPtr<float>& refPlane = c == 0 ? reference.r : c == 1 ? reference.g : reference.b;
+
+        for (int i = 0; i < height; ++i) {
+            for (int j = 0; j < width; ++j) {
+                const double deviation = std::fabs(static_cast<double>(plane(i, j)) - refPlane(i, j));
+                maxDeviation = std::max(maxDeviation, deviation);
+                sum += deviation;
+            }
+        }
+    }
+
+    meanDeviation = width > 0 && height > 0 ? sum / (3.0 * width * height) : 0.0;
+}
+
+void measure(const BenchSettings& bench, const Glib::ustring& file, const std::string& kernel, int threads, const std::function<void()>& prepare, const std::function<void()>& run, std::vector<Result>& results, const std::function<std::string()>& checksum = nullptr)
+{
+    std::cerr << "  " << kernel << " (" << threads << " threads)" << std::endl;
+
+    Result result {file, kernel, threads, {}, {}, -1.0, 0.0};
+
+    for (int i = 0; i < bench.warmup + bench.repetitions; ++i) {
+        prepare();
+        MyTime t1, t2;
+        t1.set();
+        run();
+        t2.set();
+
+        if (i >= bench.warmup) {
+            result.times.push_back(t2.etime(t1) / 1000.0);
+        }
+    }
+
+    if (checksum) {
+        result.checksum = checksum();
+    }
+
+    results.push_back(std::move(result));
+}
+
+// Returns false if the output of an AVX2 clone differs from the generic one
+bool benchmarkFile(const BenchSettings& bench, const Glib::ustring& file, std::vector<Result>& results)
+{
+    int errorCode;
+    InitialImage* const ii = InitialImage::load(file, true, &errorCode, nullptr);
+
+    if (!ii) {
+        std::cerr << "Error loading file: " << file << std::endl;
+        return true;
+    }
+
+    ImageSource* const imgsrc = ii->getImageSource();
+
+    if (imgsrc->getSensorType() != ST_BAYER && imgsrc->getSensorType() != ST_FUJI_XTRANS) {
+        std::cerr << "Skipping " << file << ": only Bayer and X-Trans raw files are supported" << std::endl;
+        ii->decreaseRef();
+        return true;
+    }
+
+    std::cerr << file << std::endl;
+
+    const bool isBayer = imgsrc->getSensorType() == ST_BAYER;
+
+    ProcParams params;
+    params.pdsharpening.enabled = true;
+    params.dirpyrDenoise.enabled = true;
+    params.dirpyrDenoise.Cmethod = "MAN";
+    params.dirpyrDenoise.C2method = "MANU";
+    params.wavelet.enabled = true;
+    params.dehaze.enabled = true;
+    params.fattal.enabled = true;
+
+    imgsrc->setBorder(isBayer ? params.raw.bayersensor.border : params.raw.xtranssensor.border);
+    imgsrc->setCurrentFrame(0);
+    imgsrc->preprocess(params.raw, params.lensProf, params.coarse, false);
+
+    int fw, fh;
+    imgsrc->getFullSize(fw, fh, TR_NONE);
+
+    bool avx2Mismatch = false;
+
+    const std::vector<const char*>& methods = isBayer ? RAWParams::BayerSensor::getMethodStrings() : RAWParams::XTransSensor::getMethodStrings();
+
+    for (const int threads : bench.threads) {
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        const auto noop = [] {};
+
+        for (const auto method : methods) {
+            const std::string name = method;
+
+            if (name == "none" || name == "mono" || name == "pixelshift" || !isSelected(bench, "demosaic:" + name)) {
+                continue;
+            }
+
+            RAWParams raw = params.raw;
+
+            if (isBayer) {
+                raw.bayersensor.method = name;
+            } else {
+                raw.xtranssensor.method = name;
+            }
+
+            const auto runDemosaic = [&] {
+                double contrastThreshold = isBayer ? raw.bayersensor.dualDemosaicContrast : raw.xtranssensor.dualDemosaicContrast;
+                imgsrc->demosaic(raw, false, contrastThreshold, false);
+            };
+
+            // dual demosaic methods are also run in fast mode, and the methods with an AVX2 clone on the
+            // generic path, to compare their output with the default one
+            const bool isDual = name == "amazevng4" || name == "rcdvng4" || name == "dcbvng4" || name == "4-pass" || name == "2-pass";
+            const bool hasAvx2Clone = usesAvx2Clones() && (name == "rcd" || name == "rcdvng4");
+            std::unique_ptr<Imagefloat> reference;
+
+            measure(bench, file, "demosaic:" + name, threads, noop, runDemosaic, results, [&] {
+                std::unique_ptr<Imagefloat> image(new Imagefloat(fw, fh));
+                imgsrc->getImage(imgsrc->getWB(), TR_NONE, image.get(), PreviewProps(0, 0, fw, fh, 1), params.toneCurve, raw);
+                const std::string checksum = imageChecksum(*image, fw, fh);
+
+                if (isDual || hasAvx2Clone) {
+                    reference = std::move(image);
+                }
+
+                return checksum;
+            });
+
+            const auto measureVariant = [&](const std::string& variant, const std::function<void(bool)>& enable) {
+                if (!isSelected(bench, "demosaic:" + name + ":" + variant)) {
+                    return;
+                }
+
+                enable(true);
+                double maxDeviation = -1.0, meanDeviation = 0.0;
+
+                measure(bench, file, "demosaic:" + name + ":" + variant, threads, noop, runDemosaic, results, [&] {
+                    Imagefloat image(fw, fh);
+                    imgsrc->getImage(imgsrc->getWB(), TR_NONE, &image, PreviewProps(0, 0, fw, fh, 1), params.toneCurve, raw);
+                    imageDeviation(image, *reference, fw, fh, maxDeviation, meanDeviation);
+                    return imageChecksum(image, fw, fh);
+                });
+
+                results.back().maxDeviation = maxDeviation;
+                results.back().meanDeviation = meanDeviation;
+                enable(false);
+            };
+
+            if (isDual) {
+                measureVariant("fast", [](bool enable) {
+                    options.rtSettings.fastDualDemosaic = enable;
+                });
+            }
+
+            if (hasAvx2Clone) {
+                measureVariant("generic", [](bool enable) {
+                    setAvx2Dispatch(!enable);
+                });
+
+                if (results.back().kernel == "demosaic:" + name + ":generic" && results.back().maxDeviation != 0.0) {
+                    std::cerr << "Error: the AVX2 and generic output of " << name << " differ" << std::endl;
+                    avx2Mismatch = true;
+                }
+            }
+        }
+
+        // Demosaic with the default method and keep the result cached, so capture sharpening always starts from the same data
+        {
+            double contrastThreshold = isBayer ? params.raw.bayersensor.dualDemosaicContrast : params.raw.xtranssensor.dualDemosaicContrast;
+            imgsrc->demosaic(params.raw, false, contrastThreshold, true);
+        }
+
+        if (isSelected(bench, "capture_sharpening")) {
+            measure(bench, file, "capture_sharpening", threads, noop, [&] {
+                double contrast = params.pdsharpening.contrast;
+                double radius = params.pdsharpening.deconvradius;
+                imgsrc->captureSharpening(params.pdsharpening, false, contrast, radius);
+            }, results);
+        }
+
+        // The remaining kernels work on the converted image of the default pipeline
+        const ColorTemp currWB = imgsrc->getWB();
+        std::unique_ptr<Imagefloat> baseImg(new Imagefloat(fw, fh));
+        imgsrc->getImage(currWB, TR_NONE, baseImg.get(), PreviewProps(0, 0, fw, fh, 1), params.toneCurve, params.raw);
+        imgsrc->convertColorSpace(baseImg.get(), params.icm, currWB);
+
+        ImProcFunctions ipf(&params, true);
+        std::unique_ptr<Imagefloat> work;
+        const auto restoreImage = [&] {
+            work.reset(baseImg->copy());
+        };
+
+        if (isSelected(bench, "rgb_denoise")) {
+            NoiseCurve noiseLCurve;
+            NoiseCurve noiseCCurve;
+            params.dirpyrDenoise.getCurves(noiseLCurve, noiseCCurve);
+            // only read for the "PON" chrominance method, which is disabled above
+            std::vector<float> autoChroma(9, 0.f);
+
+            measure(bench, file, "rgb_denoise", threads, restoreImage, [&] {
+                float nresi, highresi;
+                ipf.RGB_denoise(2, work.get(), work.get(), nullptr, autoChroma.data(), autoChroma.data(), autoChroma.data(), true, params.dirpyrDenoise, imgsrc->getDirPyrDenoiseExpComp(), noiseLCurve, noiseCCurve, nresi, highresi);
+            }, results);
+        }
+
+        if (isSelected(bench, "dehaze")) {
+            measure(bench, file, "dehaze", threads, restoreImage, [&] {
+                ipf.dehaze(work.get());
+            }, results);
+        }
+
+        if (isSelected(bench, "tonemap_fattal02")) {
+            measure(bench, file, "tonemap_fattal02", threads, restoreImage, [&] {
+                ipf.ToneMapFattal02(work.get());
+            }, results);
+        }
+
+        LabImage baseLab(fw, fh);
+        ipf.rgb2lab(*baseImg, baseLab, params.icm.workingProfile);
+        work.reset();
+        baseImg.reset();
+
+        LabImage lab(fw, fh);
+        const auto restoreLab = [&] {
+            lab.CopyFrom(&baseLab);
+        };
+
+        if (isSelected(bench, "ip_wavelet")) {
+            WavCurve wavCLVCurve;
+            WavOpacityCurveRG waOpacityCurveRG;
+            WavOpacityCurveBY waOpacityCurveBY;
+            WavOpacityCurveW waOpacityCurveW;
+            WavOpacityCurveWL waOpacityCurveWL;
+            params.wavelet.getCurves(wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL);
+
+            LUTf wavclCurve(65536, 0);
+            bool wavcontlutili = false;
+            CurveFactory::curveWavContL(wavcontlutili, params.wavelet.wavclCurve, wavclCurve, 1);
+
+            measure(bench, file, "ip_wavelet", threads, restoreLab, [&] {
+                ipf.ip_wavelet(&lab, &lab, 2, params.wavelet, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL, wavclCurve, 1);
+            }, results);
+        }
+
+        if (isSelected(bench, "gaussian_blur")) {
+            array2D<float> blurred(fw, fh);
+
+            measure(bench, file, "gaussian_blur", threads, noop, [&] {
+#ifdef _OPENMP
+                #pragma omp parallel
+#endif
+                gaussianBlur(baseLab.L, blurred, fw, fh, 20.0);
+            }, results);
+        }
+
+        if (isSelected(bench, "lanczos")) {
+            LabImage resized(fw / 2, fh / 2);
+
+            measure(bench, file, "lanczos", threads, noop, [&] {
+                ipf.Lanczos(&baseLab, &resized, 0.5f);
+            }, results);
+        }
+    }
+
+    imgsrc->flushRawData();
+    imgsrc->flushRGB();
+    ii->decreaseRef();
+
+    return !avx2Mismatch;
+}
+
+cJSON* buildReport(const BenchSettings& bench, const std::vector<Result>& results)
+{
+    cJSON* const root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "version", RTVERSION);
+    cJSON_AddNumberToObject(root, "warmup", bench.warmup);
+    cJSON_AddNumberToObject(root, "repetitions", bench.repetitions);
+
+    cJSON* const entries = cJSON_AddArrayToObject(root, "results");
+
+    for (const auto& result : results) {
+        std::vector<double> sorted = result.times;
+        std::sort(sorted.begin(), sorted.end());
+
+        cJSON* const entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "file", result.file.c_str());
+        cJSON_AddStringToObject(entry, "kernel", result.kernel.c_str());
+        cJSON_AddNumberToObject(entry, "threads", result.threads);
+        cJSON_AddNumberToObject(entry, "median_ms", percentile(sorted, 50.0));
+        cJSON_AddNumberToObject(entry, "p95_ms", percentile(sorted, 95.0));
+        cJSON_AddNumberToObject(entry, "min_ms", sorted.empty() ? 0.0 : sorted.front());
+        cJSON_AddNumberToObject(entry, "max_ms", sorted.empty() ? 0.0 : sorted.back());
+
+        if (!result.checksum.empty()) {
+            cJSON_AddStringToObject(entry, "output_checksum", result.checksum.c_str());
+        }
+
+        if (result.maxDeviation >= 0.0) {
+            cJSON_AddNumberToObject(entry, "max_deviation", result.maxDeviation);
+            cJSON_AddNumberToObject(entry, "mean_deviation", result.meanDeviation);
+        }
+
+        cJSON* const times = cJSON_AddArrayToObject(entry, "times_ms");
+
+        for (const auto time : result.times) {
+            cJSON_AddItemToArray(times, cJSON_CreateNumber(time));
+        }
+
+        cJSON_AddItemToArray(entries, entry);
+    }
+
+    return root;
+}
+
+void addInput(const Glib::ustring& path, std::vector<Glib::ustring>& inputFiles)
+{
+    if (Glib::file_test(path, Glib::FILE_TEST_IS_DIR)) {
+        std::vector<Glib::ustring> names;
+
+        try {
+            Glib::Dir dir(path);
+
+            for (const auto& name : dir) {
+                const Glib::ustring fileName = Glib::build_filename(path, name);
+
+                if (Glib::file_test(fileName, Glib::FILE_TEST_IS_REGULAR) && options.is_extention_enabled(rtengine::getFileExtension(fileName))) {
+                    names.push_back(fileName);
+                }
+            }
+        } catch (Glib::FileError&) {
+            std::cerr << "Error reading directory \"" << path << "\", skipping." << std::endl;
+            return;
+        }
+
+        // sorted for reproducible ordering of the report
+        std::sort(names.begin(), names.end());
+        inputFiles.insert(inputFiles.end(), names.begin(), names.end());
+    } else if (Glib::file_test(path, Glib::FILE_TEST_IS_REGULAR)) {
+        inputFiles.push_back(path);
+    } else {
+        std::cerr << "\"" << path << "\" doesn't exist, skipping." << std::endl;
+    }
+}
+
+void printHelp(const char* name)
+{
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << name << " [-k <kernels>] [-t <threads>] [-w <n>] [-r <n>] [-o <file>] <file|dir>..." << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -k <kernels>  Comma-separated list of kernels to run (default: all):" << std::endl;
+    std::cout << "                demosaic (all methods), demosaic:<method> (with its variants), demosaic:<method>:fast," << std::endl;
+    std::cout << "                demosaic:<method>:generic, capture_sharpening, rgb_denoise, dehaze, tonemap_fattal02," << std::endl;
+    std::cout << "                ip_wavelet, gaussian_blur, lanczos" << std::endl;
+    std::cout << "  -t <threads>  Comma-separated list of thread counts (default: all available threads)" << std::endl;
+    std::cout << "  -w <n>        Number of unmeasured warm-up runs per kernel (default: 1)" << std::endl;
+    std::cout << "  -r <n>        Number of measured runs per kernel (default: 5)" << std::endl;
+    std::cout << "  -o <file>     Write the JSON report to <file> instead of stdout" << std::endl;
+    std::cout << "  -h            Display this help message" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Only raw files are benchmarked. Directories are scanned (non-recursively) for files" << std::endl;
+    std::cout << "with an extension enabled in the options file." << std::endl;
+    std::cout << "Demosaic results include an \"output_checksum\" of the demosaiced image, which allows" << std::endl;
+    std::cout << "to check that two builds give identical output. Dual demosaic methods are also run with" << std::endl;
+    std::cout << "FastDualDemosaic enabled (demosaic:<method>:fast), which reports the \"max_deviation\" and" << std::endl;
+    std::cout << "\"mean_deviation\" of its output from the default mode, in the 0..65535 range of the image." << std::endl;
+    std::cout << "On cpus with AVX2, RCD is also run with its AVX2 clone disabled (demosaic:<method>:generic)." << std::endl;
+    std::cout << "Both outputs have to be identical, otherwise the exit status is 1." << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Gio::init();
+
+#ifdef BUILD_BUNDLE
+    char exname[512] = {0};
+    Glib::ustring exePath;
+#ifdef WIN32
+    WCHAR exnameU[512] = {0};
+    GetModuleFileNameW(NULL, exnameU, 511);
+    WideCharToMultiByte(CP_UTF8, 0, exnameU, -1, exname, 511, 0, 0);
+#else
+
+    if (readlink("/proc/self/exe", exname, 511) < 0) {
+        strncpy(exname, argv[0], 511);
+    }
+
+#endif
+    exePath = Glib::path_get_dirname(exname);
+
+    if (Glib::path_is_absolute(DATA_SEARCH_PATH)) {
+        argv0 = DATA_SEARCH_PATH;
+    } else {
+        argv0 = Glib::build_filename(exePath, DATA_SEARCH_PATH);
+    }
+
+    creditsPath = CREDITS_SEARCH_PATH;
+    licensePath = LICENCE_SEARCH_PATH;
+#else
+    argv0 = DATA_SEARCH_PATH;
+    creditsPath = CREDITS_SEARCH_PATH;
+    licensePath = LICENCE_SEARCH_PATH;
+#endif
+    options.rtSettings.lensfunDbDirectory = LENSFUN_DB_PATH;
+
+    BenchSettings bench;
+    std::vector<Glib::ustring> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            printHelp(argv[0]);
+            return 0;
+        } else if ((arg == "-k" || arg == "-t" || arg == "-w" || arg == "-r" || arg == "-o") && i + 1 < argc) {
+            const std::string value = argv[++i];
+
+            if (arg == "-k") {
+                bench.kernels = splitList(value);
+            } else if (arg == "-t") {
+                bench.threads.clear();
+
+                for (const auto& count : splitList(value)) {
+                    bench.threads.push_back(std::max(1, std::atoi(count.c_str())));
+                }
+            } else if (arg == "-w") {
+                bench.warmup = std::max(0, std::atoi(value.c_str()));
+            } else if (arg == "-r") {
+                bench.repetitions = std::max(1, std::atoi(value.c_str()));
+            } else {
+                bench.outputFile = Glib::filename_to_utf8(value);
+            }
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            printHelp(argv[0]);
+            return -1;
+        } else {
+            inputs.push_back(Glib::filename_to_utf8(arg));
+        }
+    }
+
+    if (inputs.empty()) {
+        printHelp(argv[0]);
+        return -1;
+    }
+
+    if (bench.threads.empty()) {
+#ifdef _OPENMP
+        bench.threads.push_back(omp_get_max_threads());
+#else
+        bench.threads.push_back(1);
+#endif
+    }
+
+    try {
+        Options::load(true);
+    } catch (Options::Error &e) {
+        std::cerr << std::endl
+                  << "FATAL ERROR:" << std::endl
+                  << e.get_msg() << std::endl;
+        return -2;
+    }
+
+    TIFFSetWarningHandler(nullptr);
+
+    // fixed settings, so the timings measure the kernels only and are reproducible:
+    // no tuning of the X-Trans tiles per thread between the runs, no cached or reduced demosaic
+    if (options.chunkSizeXT == 0) {
+        options.chunkSizeXT = 2;
+    }
+
+    options.rtSettings.demosaicCache = false;
+    options.rtSettings.fastDualDemosaic = false;
+    options.rtSettings.compactRawStorage = false;
+
+    std::vector<Glib::ustring> inputFiles;
+
+    for (const auto& input : inputs) {
+        addInput(input, inputFiles);
+    }
+
+    if (inputFiles.empty()) {
+        std::cerr << "No input files found." << std::endl;
+        return -1;
+    }
+
+    std::vector<Result> results;
+    bool avx2Consistent = true;
+
+    for (const auto& file : inputFiles) {
+        avx2Consistent = benchmarkFile(bench, file, results) && avx2Consistent;
+    }
+
+    cJSON* const report = buildReport(bench, results);
+    char* const text = cJSON_Print(report);
+    // a difference between the AVX2 and generic output is reported by the exit status, so it can be used as a regression check
+    int ret = avx2Consistent ? 0 : 1;
+
+    if (bench.outputFile.empty()) {
+        std::cout << text << std::endl;
+    } else {
+        FILE* const f = g_fopen(bench.outputFile.c_str(), "wt");
+
+        if (f) {
+            fprintf(f, "%s\n", text);
+            fclose(f);
+        } else {
+            std::cerr << "Error writing report to " << bench.outputFile << std::endl;
+            ret = -2;
+        }
+    }
+
+    cJSON_free(text);
+    cJSON_Delete(report);
+
+    return ret;
+}
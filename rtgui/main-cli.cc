@@ -31,7 +31,26 @@
 #include <cstring>
 #include <cstdlib>
 #include <locale.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "../rtengine/cJSON.h"
+#include "../rtengine/cpufeatures.h"
+#include "../rtengine/imagesource.h"
 #include "../rtengine/procparams.h"
+#include "../rtengine/rawimage.h"
+#include "../rtengine/stageprofiler.h"
 #include "../rtengine/profilestore.h"
 #include "options.h"
 #include "soundman.h"
@@ -45,6 +64,13 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glibmm/threads.h>
+#include <csignal>
+#include <set>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
 #else
 #include <windows.h>
 #include <shlobj.h>
@@ -252,6 +278,974 @@ bool dontLoadCache ( int argc, char **argv )
     return false;
 }
 
+namespace
+{
+
+// Memory used per pixel at the peak of the pipeline. The batch processing doesn't flush the raw source,
+// so the raw frame, rawData and the demosaiced planes are still alive when simpleprocess.cc holds the
+// working image, the Lab image and the output image: 1 + 1 + 3 + 3 + 3 + 3 floats = 56 bytes.
+// Rounded up to 64 for the transient buffers of raw CA correction, denoise and the like.
+constexpr std::size_t bytesPerPixelEstimate = 64;
+// Each additional frame of a multi-frame raw file (pixel shift) keeps its float raw data too
+constexpr std::size_t bytesPerExtraFrameEstimate = sizeof (float);
+
+/* Estimates the memory needed to process a file from its header, without decoding it.
+ * Returns 0 if the header can't be read */
+std::size_t estimateMemory (const Glib::ustring& inputFile, bool isRaw)
+{
+    if (isRaw) {
+        rtengine::RawImage ri (inputFile);
+
+        if (ri.loadRaw (false) != 0) {
+            return 0;
+        }
+
+        const std::size_t pixels = static_cast<std::size_t> (ri.get_width()) * ri.get_height();
+        return pixels * (bytesPerPixelEstimate + (std::max (ri.getFrameCount(), 1u) - 1) * bytesPerExtraFrameEstimate);
+    }
+
+    gint width = 0, height = 0;
+    return gdk_pixbuf_get_file_info (inputFile.c_str(), &width, &height) ? static_cast<std::size_t> (width) * height * bytesPerPixelEstimate : 0;
+}
+
+class ProfileReport;
+
+struct BatchSettings {
+    ProfileReport* profileReport;   // nullptr if the stages are not profiled
+    rtengine::procparams::PartialProfile* rawParams;
+    rtengine::procparams::PartialProfile* imgParams;
+    const std::vector<rtengine::procparams::PartialProfile*>* processingParams;
+    Glib::ustring outputPath;
+    std::string outputType;
+    bool outputDirectory;
+    bool leaveUntouched;
+    bool overwriteFiles;
+    bool sideProcParams;
+    bool copyParamsFile;
+    bool skipIfNoSidecar;
+    bool useDefault;
+    unsigned int sideCarFilePos;
+    int compression;
+    int subsampling;
+    int bits;
+    bool isFloat;
+};
+
+std::mutex outputMutex;
+std::mutex dynamicProfileMutex;
+
+void printLine (std::ostream& stream, const std::string& line)
+{
+    std::lock_guard<std::mutex> lock (outputMutex);
+    stream << line << std::endl;
+}
+
+/* Limits the estimated amount of memory used by the images being processed concurrently.
+ * A job is always admitted when nothing else is running, so an image bigger than the budget
+ * is still processed, just alone. */
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget (std::size_t limit) :
+        limit (limit),
+        used (0)
+    {
+    }
+
+    void acquire (std::size_t bytes)
+    {
+        if (limit == 0) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock (mutex);
+        cond.wait (lock, [this, bytes]() {
+            return used == 0 || used + bytes <= limit;
+        });
+        used += bytes;
+    }
+
+    void release (std::size_t bytes)
+    {
+        if (limit == 0) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            used -= bytes;
+        }
+        cond.notify_all();
+    }
+
+private:
+    const std::size_t limit;
+    std::size_t used;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+/* Collects the per-stage measurements of the processed images as JSON */
+class ProfileReport
+{
+public:
+    ProfileReport () :
+        images (cJSON_CreateArray())
+    {
+    }
+
+    ~ProfileReport ()
+    {
+        cJSON_Delete (images);
+    }
+
+    void add (const Glib::ustring& inputFile, const rtengine::StageProfiler& profiler)
+    {
+        cJSON* image = cJSON_CreateObject();
+        cJSON_AddStringToObject (image, "input", inputFile.c_str());
+        // high-water mark of the whole process so far, not of this image
+        cJSON_AddNumberToObject (image, "process_peak_rss_bytes", rtengine::StageProfiler::getPeakRss());
+        cJSON* stages = cJSON_AddArrayToObject (image, "stages");
+
+        for (const auto& stage : profiler.getStages()) {
+            cJSON* item = cJSON_CreateObject();
+            cJSON_AddStringToObject (item, "name", stage.name.c_str());
+            cJSON_AddNumberToObject (item, "wall_ms", stage.wallTime);
+            cJSON_AddNumberToObject (item, "cpu_ms", stage.cpuTime);
+            cJSON_AddNumberToObject (item, "rss_start_bytes", stage.rssStart);
+            cJSON_AddNumberToObject (item, "rss_end_bytes", stage.rssEnd);
+            cJSON_AddNumberToObject (item, "peak_rss_bytes", stage.peakRss);
+            cJSON_AddItemToArray (stages, item);
+        }
+
+        std::lock_guard<std::mutex> lock (mutex);
+        cJSON_AddItemToArray (images, image);
+    }
+
+    // Hands the collected images over to the caller, who has to delete them
+    cJSON* detach ()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        cJSON* const result = images;
+        images = cJSON_CreateArray();
+        return result;
+    }
+
+    bool write (const Glib::ustring& fileName)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        char* text = cJSON_Print (images);
+
+        if (!text) {
+            return false;
+        }
+
+        std::ofstream file (fileName.c_str());
+        file << text << std::endl;
+        cJSON_free (text);
+        return static_cast<bool> (file);
+    }
+
+private:
+    cJSON* images;
+    std::mutex mutex;
+};
+
+/* Blocking FIFO used to hand the images over between the stages of the batch pipeline */
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue (std::size_t capacity) :
+        capacity (std::max<std::size_t> (capacity, 1)),
+        closed (false)
+    {
+    }
+
+    void push (T item)
+    {
+        {
+            std::unique_lock<std::mutex> lock (mutex);
+            notFull.wait (lock, [this]() {
+                return items.size() < capacity;
+            });
+            items.push_back (item);
+        }
+        notEmpty.notify_one();
+    }
+
+    // Returns false once the queue has been closed and drained
+    bool pop (T& item)
+    {
+        {
+            std::unique_lock<std::mutex> lock (mutex);
+            notEmpty.wait (lock, [this]() {
+                return !items.empty() || closed;
+            });
+
+            if (items.empty()) {
+                return false;
+            }
+
+            item = items.front();
+            items.pop_front();
+        }
+        notFull.notify_one();
+        return true;
+    }
+
+    void close ()
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+    }
+
+private:
+    const std::size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+/* An image travelling through the decode, develop and save stages of the batch pipeline */
+struct BatchImage {
+    Glib::ustring inputFile;
+    Glib::ustring outputFile;
+    rtengine::InitialImage* ii = nullptr;
+    rtengine::procparams::ProcParams params;
+    rtengine::IImagefloat* resultImage = nullptr;
+    std::size_t memoryEstimate = 0;
+    std::unique_ptr<rtengine::StageProfiler> profiler;
+};
+
+/* First stage: loads the input file and builds its processing parameters.
+ * Returns nullptr if the file has been skipped or couldn't be loaded, in the latter case error is set to true */
+BatchImage* decodeFile (const Glib::ustring& inputFile, const BatchSettings& batch, MemoryBudget& budget, bool& error)
+{
+    error = false;
+
+    printLine (std::cout, "Output is " + std::to_string (batch.bits) + "-bit " + (batch.isFloat ? "floating-point" : "integer") + ".");
+    printLine (std::cout, "Processing: " + inputFile);
+
+    rtengine::InitialImage* ii = nullptr;
+    int errorCode;
+    bool isRaw = false;
+
+    Glib::ustring outputFile;
+
+    if ( batch.outputPath.empty() ) {
+        Glib::ustring s = inputFile;
+        Glib::ustring::size_type ext = s.find_last_of ('.');
+        outputFile = s.substr (0, ext) + "." + batch.outputType;
+    } else if ( batch.outputDirectory ) {
+        Glib::ustring s = Glib::path_get_basename ( inputFile );
+        Glib::ustring::size_type ext = s.find_last_of ('.');
+        outputFile = Glib::build_filename (batch.outputPath, s.substr (0, ext) + "." + batch.outputType);
+    } else {
+        if (batch.leaveUntouched) {
+            outputFile = batch.outputPath;
+        } else {
+            Glib::ustring s = batch.outputPath;
+            Glib::ustring::size_type ext = s.find_last_of ('.');
+            outputFile = s.substr (0, ext) + "." + batch.outputType;
+        }
+    }
+
+    if ( inputFile == outputFile) {
+        printLine (std::cerr, "Cannot overwrite: " + inputFile);
+        return nullptr;
+    }
+
+    if ( !batch.overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
+        printLine (std::cerr, outputFile + " already exists: use -Y option to overwrite. This image has been skipped.");
+        return nullptr;
+    }
+
+    // Load the image
+    isRaw = true;
+    Glib::ustring ext = getExtension (inputFile);
+
+    if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
+        isRaw = false;
+    }
+
+    // the budget has to cover the decoded data too, so it is taken before decoding, from the size in the header
+    std::size_t memoryEstimate = estimateMemory (inputFile, isRaw);
+    budget.acquire (memoryEstimate);
+
+    std::unique_ptr<rtengine::StageProfiler> profiler (batch.profileReport ? new rtengine::StageProfiler : nullptr);
+    rtengine::StageProfiler::Attach attachProfiler (profiler.get());
+    rtengine::StageTimer loadTimer ("load");
+    ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
+    loadTimer.stop();
+
+    if (!ii) {
+        budget.release (memoryEstimate);
+        error = true;
+        printLine (std::cerr, "Error loading file: " + inputFile);
+        return nullptr;
+    }
+
+    // Has to be reinstanciated at each profile to have a ProcParams object with default values
+    BatchImage* image = new BatchImage;
+    image->inputFile = inputFile;
+    image->outputFile = outputFile;
+    image->ii = ii;
+
+    if (memoryEstimate == 0) {
+        // header not understood by estimateMemory(), e.g. some TIFF variants: fall back to the decoded size
+        int fw = 0, fh = 0;
+        ii->getImageSource()->getFullSize (fw, fh);
+        memoryEstimate = static_cast<std::size_t> (fw) * fh * bytesPerPixelEstimate;
+        budget.acquire (memoryEstimate);
+    }
+
+    image->memoryEstimate = memoryEstimate;
+    image->profiler = std::move (profiler);
+    rtengine::procparams::ProcParams& currentParams = image->params;
+
+    if (batch.useDefault) {
+        if (isRaw) {
+            if (options.defProfRaw == DEFPROFILE_DYNAMIC) {
+                rtengine::procparams::PartialProfile* dynamicParams;
+                {
+                    std::lock_guard<std::mutex> lock (dynamicProfileMutex);
+                    dynamicParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+                }
+                printLine (std::cout, "  Merging default raw processing profile.");
+                dynamicParams->applyTo (&currentParams);
+                dynamicParams->deleteInstance();
+                delete dynamicParams;
+            } else {
+                printLine (std::cout, "  Merging default raw processing profile.");
+                batch.rawParams->applyTo (&currentParams);
+            }
+        } else {
+            if (options.defProfImg == DEFPROFILE_DYNAMIC) {
+                rtengine::procparams::PartialProfile* dynamicParams;
+                {
+                    std::lock_guard<std::mutex> lock (dynamicProfileMutex);
+                    dynamicParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+                }
+                printLine (std::cout, "  Merging default non-raw processing profile.");
+                dynamicParams->applyTo (&currentParams);
+                dynamicParams->deleteInstance();
+                delete dynamicParams;
+            } else {
+                printLine (std::cout, "  Merging default non-raw processing profile.");
+                batch.imgParams->applyTo (&currentParams);
+            }
+        }
+    }
+
+    const std::vector<rtengine::procparams::PartialProfile*>& processingParams = *batch.processingParams;
+    bool sideCarFound = false;
+    unsigned int i = 0;
+
+    // Iterate the procparams file list in order to build the final ProcParams
+    do {
+        if (batch.sideProcParams && i == batch.sideCarFilePos) {
+            // using the sidecar file
+            Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+
+            // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
+            if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
+                printLine (std::cerr, "Warning: sidecar file requested but not found for: " + sideProcessingParams);
+            } else {
+                sideCarFound = true;
+                printLine (std::cout, "  Merging sidecar procparams.");
+            }
+        }
+
+        if ( processingParams.size() > i  ) {
+            printLine (std::cout, "  Merging procparams #" + std::to_string (i));
+            processingParams[i]->applyTo (&currentParams);
+        }
+
+        i++;
+    } while (i < processingParams.size() + (batch.sideProcParams ? 1 : 0));
+
+    if ( batch.sideProcParams && !sideCarFound && batch.skipIfNoSidecar ) {
+        budget.release (image->memoryEstimate);
+        delete ii;
+        delete image;
+        error = true;
+        printLine (std::cerr, "Error: no sidecar procparams found for: " + inputFile);
+        return nullptr;
+    }
+
+    return image;
+}
+
+/* Second stage: runs the processing pipeline on a decoded image.
+ * Returns false and deletes the image if an error occurred */
+bool developImage (BatchImage* image, MemoryBudget& budget)
+{
+    rtengine::StageProfiler::Attach attachProfiler (image->profiler.get());
+    rtengine::ProcessingJob* job = rtengine::ProcessingJob::create (image->ii, image->params, fast_export);
+
+    if ( !job ) {
+        printLine (std::cerr, "Error creating processing for: " + image->inputFile);
+        image->ii->decreaseRef();
+        budget.release (image->memoryEstimate);
+        delete image;
+        return false;
+    }
+
+    // Process image
+    int errorCode;
+    image->resultImage = rtengine::processImage (job, errorCode, nullptr);
+
+    if ( !image->resultImage ) {
+        printLine (std::cerr, "Error processing: " + image->inputFile);
+        rtengine::ProcessingJob::destroy ( job );
+        budget.release (image->memoryEstimate);
+        delete image;
+        return false;
+    }
+
+    return true;
+}
+
+/* Last stage: saves the developed image to disk and releases it.
+ * Returns false if an error occurred */
+bool saveImage (BatchImage* image, const BatchSettings& batch, MemoryBudget& budget)
+{
+    rtengine::IImagefloat* resultImage = image->resultImage;
+    const Glib::ustring& outputFile = image->outputFile;
+    int errorCode;
+    bool success = true;
+
+    rtengine::StageProfiler::Attach attachProfiler (image->profiler.get());
+    rtengine::StageTimer saveTimer ("save");
+
+    // save image to disk
+    if ( batch.outputType == "jpg" ) {
+        errorCode = resultImage->saveAsJPEG ( outputFile, batch.compression, batch.subsampling );
+    } else if ( batch.outputType == "tif" ) {
+        errorCode = resultImage->saveAsTIFF ( outputFile, batch.bits, batch.isFloat, batch.compression == 0  );
+    } else if ( batch.outputType == "png" ) {
+        errorCode = resultImage->saveAsPNG ( outputFile, batch.bits );
+    } else {
+        errorCode = resultImage->saveToFile (outputFile);
+    }
+
+    if (errorCode) {
+        success = false;
+        printLine (std::cerr, "Error saving to: " + outputFile);
+    } else {
+        if ( batch.copyParamsFile ) {
+            Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
+            image->params.save ( outputProcessingParams );
+        }
+    }
+
+    saveTimer.stop();
+
+    if (batch.profileReport) {
+        batch.profileReport->add (image->inputFile, *image->profiler);
+    }
+
+    // the metadata of the result image belongs to the initial image, so it must outlive the saving
+    image->ii->decreaseRef();
+    resultImage->free();
+    budget.release (image->memoryEstimate);
+    delete image;
+
+    return success;
+}
+
+/* Loads the default raw and non-raw processing profiles set in the preferences.
+ * Returns false if one of them couldn't be found, in which case none of them is kept */
+bool loadDefaultProfiles (rtengine::procparams::PartialProfile*& rawParams, rtengine::procparams::PartialProfile*& imgParams)
+{
+    rawParams = new rtengine::procparams::PartialProfile (true, true);
+    Glib::ustring profPath = options.findProfilePath (options.defProfRaw);
+
+    if (options.is_defProfRawMissing() || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && rawParams->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (options.defProfRaw) + paramFileExtension)))) {
+        std::cerr << "Error: default raw processing profile not found." << std::endl;
+        rawParams->deleteInstance();
+        delete rawParams;
+        rawParams = nullptr;
+        return false;
+    }
+
+    imgParams = new rtengine::procparams::PartialProfile (true);
+    profPath = options.findProfilePath (options.defProfImg);
+
+    if (options.is_defProfImgMissing() || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && imgParams->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (options.defProfImg) + paramFileExtension)))) {
+        std::cerr << "Error: default non-raw processing profile not found." << std::endl;
+        imgParams->deleteInstance();
+        delete imgParams;
+        imgParams = nullptr;
+        rawParams->deleteInstance();
+        delete rawParams;
+        rawParams = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+#ifndef WIN32
+
+class Server
+{
+    static constexpr std::size_t maxClients = 64; // further connections are refused
+    static constexpr int clientTimeout = 300; // seconds a client may stay idle before it's disconnected
+    static constexpr std::size_t maxRequestSize = 1 << 20; // a client sending a longer line is disconnected
+
+public:
+    Server (const BatchSettings& defaults, MemoryBudget& budget, int jobs) :
+        defaults (defaults),
+        budget (budget),
+#ifdef _OPENMP
+        threadsPerJob (std::max (1, omp_get_max_threads() / jobs)),
+#endif
+        maxJobs (jobs),
+        runningJobs (0),
+        listenFd (-1),
+        quit (false)
+    {
+    }
+
+    /* Listens on the unix socket and serves the clients until one of them sends the shutdown command.
+     * Returns false if the socket couldn't be created */
+    bool run (const Glib::ustring& socketPath)
+    {
+        sockaddr_un address;
+        std::memset (&address, 0, sizeof (address));
+        address.sun_family = AF_UNIX;
+
+        if (socketPath.bytes() >= sizeof (address.sun_path)) {
+            std::cerr << "Error: socket path too long: " << socketPath << std::endl;
+            return false;
+        }
+
+        std::strncpy (address.sun_path, socketPath.c_str(), sizeof (address.sun_path) - 1);
+
+        listenFd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+        if (listenFd < 0) {
+            std::cerr << "Error: can't create socket: " << std::strerror (errno) << std::endl;
+            return false;
+        }
+
+        // remove the socket left by a previous instance, but nothing else
+        struct stat fileInfo;
+
+        if (::lstat (address.sun_path, &fileInfo) == 0) {
+            if (!S_ISSOCK (fileInfo.st_mode)) {
+                std::cerr << "Error: " << socketPath << " exists and is not a socket" << std::endl;
+                ::close (listenFd);
+                return false;
+            }
+
+            ::unlink (address.sun_path);
+        }
+
+        // the jobs read and write files as the user running the server, so only this user may connect.
+        // The mode is set through the umask, a chmod after bind() would leave a window open
+        const mode_t previousMask = ::umask (0177);
+        const bool bound = ::bind (listenFd, reinterpret_cast<sockaddr*> (&address), sizeof (address)) == 0;
+        ::umask (previousMask);
+
+        if (!bound || ::listen (listenFd, 16) < 0) {
+            std::cerr << "Error: can't listen on " << socketPath << ": " << std::strerror (errno) << std::endl;
+            ::close (listenFd);
+            return false;
+        }
+
+        // a client which disconnects before reading its response must not terminate the server
+        std::signal (SIGPIPE, SIG_IGN);
+
+        printLine (std::cout, "Listening on " + socketPath);
+
+        while (!quit) {
+            const int clientFd = ::accept (listenFd, nullptr, nullptr);
+
+            if (clientFd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                break;
+            }
+
+            bool accepted;
+
+            {
+                std::lock_guard<std::mutex> lock (mutex);
+                accepted = clientFds.size() < maxClients;
+
+                if (accepted) {
+                    clientFds.insert (clientFd);
+                }
+            }
+
+            if (!accepted) {
+                writeAll (clientFd, makeError ("too many clients") + '\n');
+                ::close (clientFd);
+                continue;
+            }
+
+            // an idle client is disconnected after a while, so it can't keep the server from shutting down
+            timeval timeout;
+            timeout.tv_sec = clientTimeout;
+            timeout.tv_usec = 0;
+            ::setsockopt (clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+            std::thread (&Server::serveClient, this, clientFd).detach();
+        }
+
+        // wait for the clients which are still being served
+        {
+            std::unique_lock<std::mutex> lock (mutex);
+            clientsDone.wait (lock, [this]() {
+                return clientFds.empty();
+            });
+        }
+
+        ::close (listenFd);
+        ::unlink (address.sun_path);
+        return true;
+    }
+
+private:
+    /* Reads the newline separated requests of a client and answers each of them with a line */
+    void serveClient (int clientFd)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads (threadsPerJob);
+#endif
+        std::string buffer;
+        char chunk[4096];
+
+        while (!quit) {
+            const ssize_t count = ::read (clientFd, chunk, sizeof (chunk));
+
+            if (count < 0 && errno == EINTR) {
+                continue;
+            } else if (count <= 0) {
+                // disconnected, timed out or the server is shutting down
+                break;
+            }
+
+            buffer.append (chunk, count);
+            std::string::size_type eol;
+
+            while ((eol = buffer.find ('\n')) != std::string::npos) {
+                const std::string response = handleRequest (buffer.substr (0, eol)) + '\n';
+                buffer.erase (0, eol + 1);
+
+                if (!writeAll (clientFd, response)) {
+                    break;
+                }
+            }
+
+            if (buffer.size() > maxRequestSize) {
+                writeAll (clientFd, makeError ("request too long") + '\n');
+                break;
+            }
+        }
+
+        // closed while holding the lock, so the descriptor can't be reused by a new client before it's removed.
+        // Notified while holding the lock too, as run() returns and the server is destroyed as soon as it sees no client
+        std::lock_guard<std::mutex> lock (mutex);
+        ::close (clientFd);
+        clientFds.erase (clientFd);
+        clientsDone.notify_all();
+    }
+
+    static bool writeAll (int fd, const std::string& data)
+    {
+        std::size_t written = 0;
+
+        while (written < data.size()) {
+            const ssize_t count = ::write (fd, data.data() + written, data.size() - written);
+
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                return false;
+            }
+
+            written += count;
+        }
+
+        return true;
+    }
+
+    static std::string getString (const cJSON* request, const char* name, const std::string& defaultValue)
+    {
+        const cJSON* item = cJSON_GetObjectItemCaseSensitive (request, name);
+        return cJSON_IsString (item) ? item->valuestring : defaultValue;
+    }
+
+    static int getInt (const cJSON* request, const char* name, int defaultValue)
+    {
+        const cJSON* item = cJSON_GetObjectItemCaseSensitive (request, name);
+        return cJSON_IsNumber (item) ? item->valueint : defaultValue;
+    }
+
+    static bool getBool (const cJSON* request, const char* name, bool defaultValue)
+    {
+        const cJSON* item = cJSON_GetObjectItemCaseSensitive (request, name);
+        return cJSON_IsBool (item) ? cJSON_IsTrue (item) : defaultValue;
+    }
+
+    static std::string makeResponse (cJSON* response)
+    {
+        char* text = cJSON_PrintUnformatted (response);
+        const std::string result = text ? text : "{}";
+        cJSON_free (text);
+        cJSON_Delete (response);
+        return result;
+    }
+
+    static std::string makeError (const std::string& message)
+    {
+        cJSON* response = cJSON_CreateObject();
+        cJSON_AddStringToObject (response, "status", "error");
+        cJSON_AddStringToObject (response, "message", message.c_str());
+        return makeResponse (response);
+    }
+
+    /* A request is a JSON object:
+     *   {"command": "shutdown"} stops accepting connections, the server exits once the connected clients are gone
+     *   {"input": "<file>", "output": "<file>|<dir>", "profiles": ["<one.pp3>", ...], "default": false, "sidecar": false,
+     *    "format": "jpg|tif|png", "quality": 92, "subsampling": 3, "bits": 8|16|32, "float": false, "compress": false, "overwrite": false,
+     *    "profile": false}
+     *   processes an image, all members but "input" being optional
+     * The response holds the status ("ok", "skipped" or "error") and the time spent in each stage in milliseconds,
+     * plus the per-stage report of --profile-json if "profile" is true */
+    std::string handleRequest (const std::string& line)
+    {
+        cJSON* request = cJSON_Parse (line.c_str());
+
+        if (!cJSON_IsObject (request)) {
+            cJSON_Delete (request);
+            return makeError ("invalid request");
+        }
+
+        if (getString (request, "command", "") == "shutdown") {
+            cJSON_Delete (request);
+            quit = true;
+            // wakes up accept()
+            ::shutdown (listenFd, SHUT_RDWR);
+
+            {
+                // wakes up the clients waiting for their next request, a request being processed is still answered
+                std::lock_guard<std::mutex> lock (mutex);
+
+                for (const int fd : clientFds) {
+                    ::shutdown (fd, SHUT_RD);
+                }
+            }
+
+            cJSON* response = cJSON_CreateObject();
+            cJSON_AddStringToObject (response, "status", "ok");
+            return makeResponse (response);
+        }
+
+        const Glib::ustring inputFile = getString (request, "input", "");
+
+        if (inputFile.empty()) {
+            cJSON_Delete (request);
+            return makeError ("missing input file");
+        }
+
+        BatchSettings batch = defaults;
+        std::vector<rtengine::procparams::PartialProfile*> processingParams;
+        batch.processingParams = &processingParams;
+
+        batch.outputPath = getString (request, "output", "");
+        batch.outputDirectory = !batch.outputPath.empty() && Glib::file_test (batch.outputPath, Glib::FILE_TEST_IS_DIR);
+        batch.leaveUntouched = false;
+        batch.outputType = getString (request, "format", "jpg");
+        batch.overwriteFiles = getBool (request, "overwrite", false);
+        batch.useDefault = getBool (request, "default", false);
+        batch.sideProcParams = getBool (request, "sidecar", false);
+        batch.skipIfNoSidecar = false;
+        batch.copyParamsFile = false;
+        batch.subsampling = getInt (request, "subsampling", 3);
+        batch.isFloat = getBool (request, "float", false);
+
+        if (batch.subsampling < 1 || batch.subsampling > 3) {
+            cJSON_Delete (request);
+            return makeError ("subsampling has to be in the [1-3] range");
+        }
+
+        ProfileReport profileReport;
+        batch.profileReport = getBool (request, "profile", false) ? &profileReport : nullptr;
+
+        // same combinations as the -j, -t, -n and -b switches
+        const char* invalid = nullptr;
+
+        if (batch.outputType == "jpg") {
+            batch.compression = getInt (request, "quality", 92);
+            batch.bits = 8;
+
+            if (batch.compression < 0 || batch.compression > 100) {
+                invalid = "quality has to be in the [0-100] range";
+            } else if (batch.isFloat) {
+                invalid = "jpg output can't be floating-point";
+            }
+        } else if (batch.outputType == "tif") {
+            batch.compression = getBool (request, "compress", false) ? 1 : 0;
+            batch.bits = getInt (request, "bits", 16);
+
+            if (batch.bits == 32) {
+                batch.isFloat = true;
+            } else if (batch.bits != 8 && batch.bits != 16) {
+                invalid = "bits has to be 8, 16 or 32";
+            } else if (batch.bits == 8 && batch.isFloat) {
+                invalid = "8-bit output can't be floating-point";
+            }
+        } else if (batch.outputType == "png") {
+            batch.compression = -1;
+            batch.bits = getInt (request, "bits", 8);
+
+            if (batch.bits != 8 && batch.bits != 16) {
+                invalid = "bits has to be 8 or 16";
+            } else if (batch.isFloat) {
+                invalid = "png output can't be floating-point";
+            }
+        } else {
+            cJSON_Delete (request);
+            return makeError ("unknown output format: " + batch.outputType);
+        }
+
+        if (invalid) {
+            cJSON_Delete (request);
+            return makeError (invalid);
+        }
+
+        if (batch.useDefault && !(batch.rawParams && batch.imgParams)) {
+            cJSON_Delete (request);
+            return makeError ("default processing profiles not available");
+        }
+
+        const cJSON* profiles = cJSON_GetObjectItemCaseSensitive (request, "profiles");
+        const cJSON* profile;
+
+        cJSON_ArrayForEach (profile, profiles) {
+            rtengine::procparams::PartialProfile* currentParams = new rtengine::procparams::PartialProfile (true);
+            processingParams.push_back (currentParams);
+
+            if (!cJSON_IsString (profile) || currentParams->load (profile->valuestring)) {
+                cJSON_Delete (request);
+                deleteProcParams (processingParams);
+                return makeError ("processing profile not found");
+            }
+        }
+
+        cJSON_Delete (request);
+        batch.sideCarFilePos = processingParams.size();
+
+        cJSON* response = cJSON_CreateObject();
+        const char* status = "ok";
+
+        // at most -J images are processed at once, whatever the number of clients.
+        // A profiled image is processed alone, as the profiler measures process wide figures
+        JobSlot slot (*this, batch.profileReport != nullptr);
+        const auto start = std::chrono::steady_clock::now();
+        bool error;
+        BatchImage* image = decodeFile (inputFile, batch, budget, error);
+        const auto decoded = std::chrono::steady_clock::now();
+        auto developed = decoded;
+        auto saved = decoded;
+
+        if (!image) {
+            status = error ? "error" : "skipped";
+        } else {
+            cJSON_AddStringToObject (response, "output", image->outputFile.c_str());
+
+            if (!developImage (image, budget)) {
+                status = "error";
+                developed = saved = std::chrono::steady_clock::now();
+            } else {
+                developed = std::chrono::steady_clock::now();
+
+                if (!saveImage (image, batch, budget)) {
+                    status = "error";
+                }
+
+                saved = std::chrono::steady_clock::now();
+            }
+        }
+
+        deleteProcParams (processingParams);
+
+        typedef std::chrono::duration<double, std::milli> Milliseconds;
+        cJSON_AddStringToObject (response, "status", status);
+        cJSON_AddStringToObject (response, "input", inputFile.c_str());
+        cJSON_AddNumberToObject (response, "load_ms", Milliseconds (decoded - start).count());
+        cJSON_AddNumberToObject (response, "process_ms", Milliseconds (developed - decoded).count());
+        cJSON_AddNumberToObject (response, "save_ms", Milliseconds (saved - developed).count());
+        cJSON_AddNumberToObject (response, "total_ms", Milliseconds (saved - start).count());
+
+        if (batch.profileReport) {
+            cJSON_AddItemToObject (response, "profile", profileReport.detach());
+        }
+
+        return makeResponse (response);
+    }
+
+    /* Waits until less than maxJobs images are being processed, and holds one of the slots for its lifetime.
+     * An exclusive slot waits until no image is being processed and holds all of them */
+    class JobSlot
+    {
+    public:
+        JobSlot (Server& server, bool exclusive) :
+            server (server),
+            count (exclusive ? server.maxJobs : 1)
+        {
+            std::unique_lock<std::mutex> lock (server.mutex);
+            server.jobDone.wait (lock, [this]() {
+                return this->server.runningJobs + count <= this->server.maxJobs;
+            });
+            server.runningJobs += count;
+        }
+
+        ~JobSlot ()
+        {
+            std::lock_guard<std::mutex> lock (server.mutex);
+            server.runningJobs -= count;
+            server.jobDone.notify_all();
+        }
+
+    private:
+        Server& server;
+        const int count;
+    };
+
+    const BatchSettings& defaults;
+    MemoryBudget& budget;
+#ifdef _OPENMP
+    const int threadsPerJob;
+#endif
+    const int maxJobs;
+    int runningJobs; // protected by mutex
+    int listenFd;
+    std::atomic<bool> quit;
+    std::set<int> clientFds; // of the clients being served
+    std::mutex mutex;
+    std::condition_variable clientsDone;
+    std::condition_variable jobDone;
+};
+
+#endif
+
+}
+
 int processLineParams ( int argc, char **argv )
 {
     rtengine::procparams::PartialProfile *rawParams = nullptr, *imgParams = nullptr;
@@ -271,6 +1265,10 @@ int processLineParams ( int argc, char **argv )
     int subsampling = 3;
     int bits = -1;
     bool isFloat = false;
+    int jobs = 1;
+    int memoryLimit = 0;
+    Glib::ustring serveSocket;
+    Glib::ustring profileFile;
     std::string outputType;
     unsigned errors = 0;
 
@@ -286,7 +1284,31 @@ int processLineParams ( int argc, char **argv )
         if ( currParam.at (0) == '-' && currParam.size() > 1) {
             switch ( currParam.at (1) ) {
                 case '-':
-                    // GTK --argument, we're skipping it
+                    if (currParam == "--serve") {
+                        if (iArg + 1 >= argc) {
+                            std::cerr << "Error: socket path missing next to the --serve switch." << std::endl;
+                            deleteProcParams (processingParams);
+                            return -3;
+                        }
+
+                        iArg++;
+                        serveSocket = fname_to_utf8 (argv[iArg]);
+                    } else if (currParam == "--profile-json") {
+                        if (iArg + 1 >= argc) {
+                            std::cerr << "Error: file name missing next to the --profile-json switch." << std::endl;
+                            deleteProcParams (processingParams);
+                            return -3;
+                        }
+
+                        iArg++;
+                        profileFile = fname_to_utf8 (argv[iArg]);
+                    } else if (currParam == "--cpu-info") {
+                        std::cout << rtengine::getCpuDispatchInfo();
+                        deleteProcParams (processingParams);
+                        return 0;
+                    }
+
+                    // other GTK --argument, we're skipping them
                     break;
 
                 case 'O':
@@ -433,6 +1455,40 @@ int processLineParams ( int argc, char **argv )
                     fast_export = true;
                     break;
 
+                case 'J':
+                    if (currParam.length() < 3) {
+                        std::cerr << "Error: the -J switch requires a mandatory value!" << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    jobs = atoi (currParam.substr (2).c_str());
+
+                    if (jobs < 1) {
+                        std::cerr << "Error: the value accompanying the -J switch has to be greater than 0!" << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    break;
+
+                case 'M':
+                    if (currParam.length() < 3) {
+                        std::cerr << "Error: the -M switch requires a mandatory value!" << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    memoryLimit = atoi (currParam.substr (2).c_str());
+
+                    if (memoryLimit < 0) {
+                        std::cerr << "Error: the value accompanying the -M switch can't be negative!" << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    break;
+
                 case 'c': // MUST be last option
                     while (iArg + 1 < argc) {
                         iArg++;
@@ -539,7 +1595,8 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "  " << Glib::path_get_basename (argv[0]) << " <other options> -c <dir>|<files>   Convert files in batch with your own settings." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Options:" << std::endl;
-                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] -c <input>" << std::endl;
+                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] [-J<n>] [-M<MiB>] [--profile-json <file>] -c <input>" << std::endl;
+                    std::cout << "  " << Glib::path_get_basename (argv[0]) << " [-J<n>] [-M<MiB>] --serve <socket>" << std::endl;
                     std::cout << std::endl;
                     std::cout << "  -c <files>       Specify one or more input files or folders." << std::endl;
                     std::cout << "                   When specifying folders, Rawtherapee will look for image file types which comply" << std::endl;
@@ -581,6 +1638,24 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "                   Compression is hard-coded to PNG_FILTER_PAETH, Z_RLE." << std::endl;
                     std::cout << "  -Y               Overwrite output if present." << std::endl;
                     std::cout << "  -f               Use the custom fast-export processing pipeline." << std::endl;
+                    std::cout << "  -J<n>            Process up to n images concurrently (default: 1)." << std::endl;
+                    std::cout << "                   The available processing threads are split between the concurrent images." << std::endl;
+                    std::cout << "                   In any case, the next images are loaded and the previous ones saved while an image is processed." << std::endl;
+                    std::cout << "  -M<MiB>          Limit the estimated memory used by the concurrently processed images (default: 0 = no limit)." << std::endl;
+                    std::cout << "                   An image is always processed when no other image is being processed." << std::endl;
+                    std::cout << "  --profile-json <file>" << std::endl;
+                    std::cout << "                   Write the wall time, CPU time and memory usage of each processing stage to a JSON file." << std::endl;
+                    std::cout << "                   The images are processed one after the other, ignoring -J, so that the process wide" << std::endl;
+                    std::cout << "                   CPU time and memory figures belong to the stage being measured." << std::endl;
+                    std::cout << "  --cpu-info       Print which instruction set the runtime dispatched kernels use on this CPU, then exit." << std::endl;
+                    std::cout << "  --serve <socket> Initialize once, then process the jobs received on the given unix socket." << std::endl;
+                    std::cout << "                   Each job is a line holding a JSON object, e.g." << std::endl;
+                    std::cout << "                   {\"input\": \"a.raw\", \"output\": \"a.jpg\", \"profiles\": [\"one.pp3\"], \"format\": \"jpg\", \"quality\": 92}" << std::endl;
+                    std::cout << "                   and is answered with a line holding its status and timings." << std::endl;
+                    std::cout << "                   {\"command\": \"shutdown\"} stops the server." << std::endl;
+                    std::cout << "                   At most 64 clients are connected at the same time, a client idle for 5 minutes is disconnected." << std::endl;
+                    std::cout << "                   At most -J images are processed at the same time, the other jobs wait." << std::endl;
+                    std::cout << "                   The socket is only accessible to the user running the server." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Your " << pparamsExt << " files can be incomplete, RawTherapee will build the final values as follows:" << std::endl;
                     std::cout << "  1- A new processing profile is created using neutral values," << std::endl;
@@ -639,201 +1714,193 @@ int processLineParams ( int argc, char **argv )
         }
     }
 
-    if ( !argv1.empty() ) {
-        return 1;
-    }
-
-    if ( inputFiles.empty() ) {
-        return 2;
-    }
+    if ( !serveSocket.empty() ) {
+#ifdef WIN32
+        std::cerr << "Error: the --serve switch is not supported on this platform." << std::endl;
+        deleteProcParams (processingParams);
+        return -1;
+#else
+        // the default profiles are loaded once for all, and only used by the requests asking for them
+        if (!loadDefaultProfiles (rawParams, imgParams)) {
+            std::cerr << "Requests using the default processing profiles will fail." << std::endl;
+        }
 
-    if (useDefault) {
-        rawParams = new rtengine::procparams::PartialProfile (true, true);
-        Glib::ustring profPath = options.findProfilePath (options.defProfRaw);
+        BatchSettings defaults = BatchSettings();
+        defaults.profileReport = nullptr;
+        defaults.rawParams = rawParams;
+        defaults.imgParams = imgParams;
+        MemoryBudget budget (static_cast<std::size_t> (memoryLimit) << 20);
 
-        if (options.is_defProfRawMissing() || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && rawParams->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (options.defProfRaw) + paramFileExtension)))) {
-            std::cerr << "Error: default raw processing profile not found." << std::endl;
-            rawParams->deleteInstance();
-            delete rawParams;
-            deleteProcParams (processingParams);
-            return -3;
+        // the clients are served concurrently, which would skew the timings of the X-Trans tiles per thread tuner
+        if (options.chunkSizeXT == 0) {
+            options.chunkSizeXT = 2;
         }
 
-        imgParams = new rtengine::procparams::PartialProfile (true);
-        profPath = options.findProfilePath (options.defProfImg);
+        Server server (defaults, budget, std::max (jobs, 1));
+        const bool success = server.run (serveSocket);
 
-        if (options.is_defProfImgMissing() || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && imgParams->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (options.defProfImg) + paramFileExtension)))) {
-            std::cerr << "Error: default non-raw processing profile not found." << std::endl;
+        if (imgParams) {
             imgParams->deleteInstance();
             delete imgParams;
+        }
+
+        if (rawParams) {
             rawParams->deleteInstance();
             delete rawParams;
-            deleteProcParams (processingParams);
-            return -3;
         }
+
+        deleteProcParams (processingParams);
+        return success ? 0 : -2;
+#endif
     }
 
-    for ( size_t iFile = 0; iFile < inputFiles.size(); iFile++) {
+    if ( !argv1.empty() ) {
+        return 1;
+    }
 
-        // Has to be reinstanciated at each profile to have a ProcParams object with default values
-        rtengine::procparams::ProcParams currentParams;
+    if ( inputFiles.empty() ) {
+        return 2;
+    }
 
-        Glib::ustring inputFile = inputFiles[iFile];
-        std::cout << "Output is " << bits << "-bit " << (isFloat ? "floating-point" : "integer") << "." << std::endl;
-        std::cout << "Processing: " << inputFile << std::endl;
+    if (useDefault && !loadDefaultProfiles (rawParams, imgParams)) {
+        deleteProcParams (processingParams);
+        return -3;
+    }
 
-        rtengine::InitialImage* ii = nullptr;
-        rtengine::ProcessingJob* job = nullptr;
-        int errorCode;
-        bool isRaw = false;
+    if ( outputType.empty() ) {
+        outputType = "jpg";
+    }
 
-        Glib::ustring outputFile;
+    ProfileReport profileReport;
+
+    BatchSettings batch;
+    batch.profileReport = profileFile.empty() ? nullptr : &profileReport;
+    batch.rawParams = rawParams;
+    batch.imgParams = imgParams;
+    batch.processingParams = &processingParams;
+    batch.outputPath = outputPath;
+    batch.outputType = outputType;
+    batch.outputDirectory = outputDirectory;
+    batch.leaveUntouched = leaveUntouched;
+    batch.overwriteFiles = overwriteFiles;
+    batch.sideProcParams = sideProcParams;
+    batch.copyParamsFile = copyParamsFile;
+    batch.skipIfNoSidecar = skipIfNoSidecar;
+    batch.useDefault = useDefault;
+    batch.sideCarFilePos = sideCarFilePos;
+    batch.compression = compression;
+    batch.subsampling = subsampling;
+    batch.bits = bits;
+    batch.isFloat = isFloat;
+
+    MemoryBudget budget (static_cast<std::size_t> (memoryLimit) << 20);
+    jobs = std::max (1, std::min<int> (jobs, inputFiles.size()));
+
+    if (jobs > 1 && options.chunkSizeXT == 0) {
+        // concurrent images would skew the timings of the X-Trans tiles per thread tuner
+        options.chunkSizeXT = 2;
+    }
 
-        if ( outputType.empty() ) {
-            outputType = "jpg";
-        }
+    if (batch.profileReport) {
+        // the profiler measures process wide figures, so they only belong to a stage when nothing else runs
+        for (const auto& inputFile : inputFiles) {
+            bool error;
+            BatchImage* image = decodeFile (inputFile, batch, budget, error);
 
-        if ( outputPath.empty() ) {
-            Glib::ustring s = inputFile;
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = s.substr (0, ext) + "." + outputType;
-        } else if ( outputDirectory ) {
-            Glib::ustring s = Glib::path_get_basename ( inputFile );
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = Glib::build_filename (outputPath, s.substr (0, ext) + "." + outputType);
-        } else {
-            if (leaveUntouched) {
-                outputFile = outputPath;
-            } else {
-                Glib::ustring s = outputPath;
-                Glib::ustring::size_type ext = s.find_last_of ('.');
-                outputFile = s.substr (0, ext) + "." + outputType;
+            if (!image) {
+                errors += error ? 1 : 0;
+            } else if (!developImage (image, budget) || !saveImage (image, batch, budget)) {
+                errors++;
             }
         }
+    } else {
+        // Three stage pipeline: while an image is being developed, the next one is decoded and the previous one is saved.
+        // Each stage runs 'jobs' threads, the OpenMP thread budget being split between the concurrent jobs, and within a job
+        // between its stages when they run at the same time. Decoding is mostly serial dcraw code with a few parallel loops, so
+        // it gets a quarter of the threads and development the rest. A stage running alone (the first decode, the last
+        // development) gets all the threads of the job. Saving runs the serial encoders and gets a single thread.
+#ifdef _OPENMP
+        const int threadsPerJob = std::max (1, omp_get_max_threads() / jobs);
+        const int decodeThreads = std::max (1, threadsPerJob / 4);
+        const int developThreads = std::max (1, threadsPerJob - decodeThreads);
+#endif
+        BoundedQueue<BatchImage*> decoded (jobs);
+        BoundedQueue<BatchImage*> developed (jobs);
+        std::atomic<std::size_t> nextFile (0);
+        std::atomic<int> activeDecoders (jobs);
+        std::atomic<int> activeDevelopers (jobs);
+        std::atomic<int> developing (0);
+        std::atomic<unsigned> jobErrors (0);
+        std::vector<std::thread> workers;
+
+        for (int j = 0; j < jobs; ++j) {
+            workers.emplace_back ([&]() {
+                for (std::size_t iFile = nextFile++; iFile < inputFiles.size(); iFile = nextFile++) {
+#ifdef _OPENMP
+                    omp_set_num_threads (developing > 0 ? decodeThreads : threadsPerJob);
+#endif
+                    bool error;
+                    BatchImage* image = decodeFile (inputFiles[iFile], batch, budget, error);
 
-        if ( inputFile == outputFile) {
-            std::cerr << "Cannot overwrite: " << inputFile << std::endl;
-            continue;
-        }
-
-        if ( !overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
-            std::cerr << outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
-            continue;
-        }
-
-        // Load the image
-        isRaw = true;
-        Glib::ustring ext = getExtension (inputFile);
-
-        if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
-            isRaw = false;
-        }
-
-        ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
-
-        if (!ii) {
-            errors++;
-            std::cerr << "Error loading file: " << inputFile << std::endl;
-            continue;
-        }
-
-        if (useDefault) {
-            if (isRaw) {
-                if (options.defProfRaw == DEFPROFILE_DYNAMIC) {
-                    rawParams->deleteInstance();
-                    delete rawParams;
-                    rawParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+                    if (image) {
+                        decoded.push (image);
+                    } else if (error) {
+                        jobErrors++;
+                    }
                 }
 
-                std::cout << "  Merging default raw processing profile." << std::endl;
-                rawParams->applyTo (&currentParams);
-            } else {
-                if (options.defProfImg == DEFPROFILE_DYNAMIC) {
-                    imgParams->deleteInstance();
-                    delete imgParams;
-                    imgParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+                if (--activeDecoders == 0) {
+                    decoded.close();
                 }
+            });
 
-                std::cout << "  Merging default non-raw processing profile." << std::endl;
-                imgParams->applyTo (&currentParams);
-            }
-        }
+            workers.emplace_back ([&]() {
+                BatchImage* image;
 
-        bool sideCarFound = false;
-        unsigned int i = 0;
-
-        // Iterate the procparams file list in order to build the final ProcParams
-        do {
-            if (sideProcParams && i == sideCarFilePos) {
-                // using the sidecar file
-                Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+                while (decoded.pop (image)) {
+#ifdef _OPENMP
+                    omp_set_num_threads (activeDecoders > 0 ? developThreads : threadsPerJob);
+#endif
+                    developing++;
+                    const bool success = developImage (image, budget);
+                    developing--;
 
-                // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
-                if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
-                    std::cerr << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
-                } else {
-                    sideCarFound = true;
-                    std::cout << "  Merging sidecar procparams." << std::endl;
+                    if (success) {
+                        developed.push (image);
+                    } else {
+                        jobErrors++;
+                    }
                 }
-            }
-
-            if ( processingParams.size() > i  ) {
-                std::cout << "  Merging procparams #" << i << std::endl;
-                processingParams[i]->applyTo (&currentParams);
-            }
-
-            i++;
-        } while (i < processingParams.size() + (sideProcParams ? 1 : 0));
-
-        if ( sideProcParams && !sideCarFound && skipIfNoSidecar ) {
-            delete ii;
-            errors++;
-            std::cerr << "Error: no sidecar procparams found for: " << inputFile << std::endl;
-            continue;
-        }
-
-        job = rtengine::ProcessingJob::create (ii, currentParams, fast_export);
 
-        if ( !job ) {
-            errors++;
-            std::cerr << "Error creating processing for: " << inputFile << std::endl;
-            ii->decreaseRef();
-            continue;
-        }
+                if (--activeDevelopers == 0) {
+                    developed.close();
+                }
+            });
 
-        // Process image
-        rtengine::IImagefloat* resultImage = rtengine::processImage (job, errorCode, nullptr);
+            workers.emplace_back ([&]() {
+#ifdef _OPENMP
+                omp_set_num_threads (1);
+#endif
+                BatchImage* image;
 
-        if ( !resultImage ) {
-            errors++;
-            std::cerr << "Error processing: " << inputFile << std::endl;
-            rtengine::ProcessingJob::destroy ( job );
-            continue;
+                while (developed.pop (image)) {
+                    if (!saveImage (image, batch, budget)) {
+                        jobErrors++;
+                    }
+                }
+            });
         }
 
-        // save image to disk
-        if ( outputType == "jpg" ) {
-            errorCode = resultImage->saveAsJPEG ( outputFile, compression, subsampling );
-        } else if ( outputType == "tif" ) {
-            errorCode = resultImage->saveAsTIFF ( outputFile, bits, isFloat, compression == 0  );
-        } else if ( outputType == "png" ) {
-            errorCode = resultImage->saveAsPNG ( outputFile, bits );
-        } else {
-            errorCode = resultImage->saveToFile (outputFile);
+        for (auto& worker : workers) {
+            worker.join();
         }
 
-        if (errorCode) {
-            errors++;
-            std::cerr << "Error saving to: " << outputFile << std::endl;
-        } else {
-            if ( copyParamsFile ) {
-                Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
-                currentParams.save ( outputProcessingParams );
-            }
-        }
+        errors += jobErrors;
+    }
 
-        ii->decreaseRef();
-        resultImage->free();
+    if (batch.profileReport && !profileReport.write (profileFile)) {
+        errors++;
+        std::cerr << "Error writing the profiling report to: " << profileFile << std::endl;
     }
 
     if (imgParams) {
@@ -458,7 +458,7 @@ void Options::setDefaults()
     chunkSizeCA = 2;
     chunkSizeRCD = 2;
     chunkSizeRGB = 2;
-    chunkSizeXT = 2;
+    chunkSizeXT = 0;
     FileBrowserToolbarSingleRow = false;
     hideTPVScrollbar = false;
     whiteBalanceSpotSize = 8;
@@ -639,6 +639,13 @@ void Options::setDefaults()
     cropAutoFit = false;
 
     rtSettings.thumbnail_inspector_mode = rtengine::Settings::ThumbnailInspectorMode::JPEG;
+    rtSettings.compactRawStorage = false;
+    rtSettings.demosaicCache = false;
+    rtSettings.demosaicCacheSize = 4096;
+    rtSettings.fastDualDemosaic = false;
+    rtSettings.compactPixelShiftFrames = false;
+    rtSettings.caAutoConvergence = 0.0;
+    rtSettings.calibrationCache = true;
 }
 
 Options* Options::copyFrom(Options* other)
@@ -1112,12 +1119,40 @@ void Options::readFromFile(Glib::ustring fname)
                 }
 
                 if (keyFile.has_key("Performance", "ChunkSizeXT")) {
-                    chunkSizeXT = std::min(16, std::max(1, keyFile.get_integer("Performance", "ChunkSizeXT")));
+                    chunkSizeXT = std::min(16, std::max(0, keyFile.get_integer("Performance", "ChunkSizeXT")));
                 }
 
                 if (keyFile.has_key("Performance", "ThumbnailInspectorMode")) {
                     rtSettings.thumbnail_inspector_mode = static_cast<rtengine::Settings::ThumbnailInspectorMode>(keyFile.get_integer("Performance", "ThumbnailInspectorMode"));
                 }
+
+                if (keyFile.has_key("Performance", "CompactRawStorage")) {
+                    rtSettings.compactRawStorage = keyFile.get_boolean("Performance", "CompactRawStorage");
+                }
+
+                if (keyFile.has_key("Performance", "DemosaicCache")) {
+                    rtSettings.demosaicCache = keyFile.get_boolean("Performance", "DemosaicCache");
+                }
+
+                if (keyFile.has_key("Performance", "DemosaicCacheSize")) {
+                    rtSettings.demosaicCacheSize = std::max(0, keyFile.get_integer("Performance", "DemosaicCacheSize"));
+                }
+
+                if (keyFile.has_key("Performance", "FastDualDemosaic")) {
+                    rtSettings.fastDualDemosaic = keyFile.get_boolean("Performance", "FastDualDemosaic");
+                }
+
+                if (keyFile.has_key("Performance", "CompactPixelShiftFrames")) {
+                    rtSettings.compactPixelShiftFrames = keyFile.get_boolean("Performance", "CompactPixelShiftFrames");
+                }
+
+                if (keyFile.has_key("Performance", "CAAutoConvergence")) {
+                    rtSettings.caAutoConvergence = std::max(0.0, keyFile.get_double("Performance", "CAAutoConvergence"));
+                }
+
+                if (keyFile.has_key("Performance", "CalibrationCache")) {
+                    rtSettings.calibrationCache = keyFile.get_boolean("Performance", "CalibrationCache");
+                }
             }
 
             if (keyFile.has_group("GUI")) {
@@ -1997,6 +2032,13 @@ void Options::saveToFile(Glib::ustring fname)
         keyFile.set_integer("Performance", "ChunkSizeXT", chunkSizeXT);
         keyFile.set_integer("Performance", "ChunkSizeCA", chunkSizeCA);
         keyFile.set_integer("Performance", "ThumbnailInspectorMode", int(rtSettings.thumbnail_inspector_mode));
+        keyFile.set_boolean("Performance", "CompactRawStorage", rtSettings.compactRawStorage);
+        keyFile.set_boolean("Performance", "DemosaicCache", rtSettings.demosaicCache);
+        keyFile.set_integer("Performance", "DemosaicCacheSize", rtSettings.demosaicCacheSize);
+        keyFile.set_boolean("Performance", "FastDualDemosaic", rtSettings.fastDualDemosaic);
+        keyFile.set_boolean("Performance", "CompactPixelShiftFrames", rtSettings.compactPixelShiftFrames);
+        keyFile.set_double("Performance", "CAAutoConvergence", rtSettings.caAutoConvergence);
+        keyFile.set_boolean("Performance", "CalibrationCache", rtSettings.calibrationCache);
 
         keyFile.set_string("Output", "Format", saveFormat.format);
         keyFile.set_integer("Output", "JpegQuality", saveFormat.jpegQuality);
@@ -2352,6 +2394,10 @@ void Options::load(bool lightweight)
         printf("Cache directory (cacheBaseDir) = %s\n", cacheBaseDir.c_str());
     }
 
+    options.rtSettings.demosaicCacheDir = Glib::build_filename(cacheBaseDir, "demosaic");
+    options.rtSettings.calibrationCacheDir = Glib::build_filename(cacheBaseDir, "calibration");
+    options.rtSettings.fftwWisdomFile = Glib::build_filename(cacheBaseDir, "fftwf_wisdom");
+
     // Update profile's path and recreate it if necessary
     options.updatePaths();
 